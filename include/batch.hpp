@@ -0,0 +1,213 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef B2a25599824249f08714f157d9e909a8
+#define B2a25599824249f08714f157d9e909a8
+
+#include "device.hpp"
+#include "image.hpp"
+#include "image_view.hpp"
+#include "buffer.hpp"
+#include "command_pool.hpp"
+#include "command_buffer.hpp"
+#include "compute_pipeline.hpp"
+#include "descriptor_pool.hpp"
+#include "descriptor_set_layout.hpp"
+#include "timeline_semaphore.hpp"
+#include "frame_clock.hpp"
+#include "pixels.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief Runs a compute shader over a stream of images as fast as the device
+ * allows, with no window and nothing else going on.
+ *
+ * Each image goes through three stages: it's uploaded on the transfer queue,
+ * the shader is run over it on the compute queue, and the result is copied
+ * back on the transfer queue. The stages are chained with three timeline
+ * semaphores, one per stage, counting images, so the host submits all three
+ * at once and never waits on the device except to collect results. There's a
+ * fixed number of slots, each with its own images and buffers; with three,
+ * one image can be uploading while the next is computed and the one before
+ * read back. The command buffers for each slot are recorded once and reused.
+ *
+ * The shader has the minicomp interface (an RGBA8 storage image to write, and
+ * the frame data; see Bindings). It can also read an input image, the same
+ * size; if it doesn't, nothing is uploaded.
+ *
+ * Where the transfer and compute queues are in different families, the images
+ * are shared between them concurrently rather than handed back and forth.
+ */
+class Batch {
+public:
+    /*!
+     * \brief Returns the input for the image numbered n, or nothing to skip
+     * it.
+     */
+    using source_t = std::function<std::optional<Pixels>(uint64_t n)>;
+
+    /*!
+     * \brief Takes the output for the image numbered n, in order. px points
+     * straight into the slot's mapped download buffer, so it's only good
+     * until the callback returns, after which the slot may be reused; copy
+     * it (see PixelView::copy()) to keep it any longer.
+     */
+    using callback_t = std::function<void(uint64_t n, const PixelView& px)>;
+
+    /*!
+     * \brief Where things are in the shader's interface, all in the set
+     * called set.
+     */
+    struct Bindings {
+        std::string             set;
+        uint32_t                output;
+        uint32_t                frame_data;
+        std::optional<uint32_t> input;
+    };
+
+    struct Result {
+        uint64_t images = 0;
+        uint64_t skipped = 0;
+        std::chrono::duration<double> elapsed {0};
+
+        double per_sec() const
+        {
+            return elapsed.count() > 0 ? images / elapsed.count() : 0;
+        }
+    };
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev  The Device in use.
+     * \param pipel  The shader's pipeline.
+     * \param layts  The pipeline's descriptor set layouts.
+     * \param bnds   Where the shader expects things.
+     * \param extent The size of every image.
+     * \param slots  How many images can be in flight at once.
+     */
+    Batch(Device::ptr l_dev,
+          ComputePipeline::ptr pipel,
+          const std::vector<DescriptorSetLayout::ptr>& layts,
+          Bindings bnds,
+          VkExtent2D extent,
+          uint32_t slots = 3);
+
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+
+    /*!
+     * \brief Waits for anything still in flight.
+     */
+    ~Batch() noexcept;
+
+    /*!
+     * \brief Run the shader over count images and hand each result to done,
+     * on this thread, as it comes back.
+     *
+     * \param count How many images to run.
+     * \param clk   Where the time in the frame data comes from, one tick an
+     *              image.
+     * \param src   The inputs, if the shader reads one. Inputs that aren't
+     *              the right size are skipped. If src is empty, test_pattern()
+     *              is used.
+     * \param done  Takes the outputs.
+     */
+    Result run(uint64_t count,
+               FrameClock clk,
+               const source_t& src,
+               const callback_t& done);
+
+    /*!
+     * \brief Whether the shader reads an input image.
+     */
+    bool has_input() const { return bnds.input.has_value(); }
+
+    /*!
+     * \brief A simple moving pattern, different for each n, for when there's
+     * no input to hand.
+     */
+    static Pixels test_pattern(VkExtent2D extent, uint64_t n);
+
+private:
+    // the same layout as the minicomp shader's frame_data block (see
+    // Vulkan's MinicompFrameData)
+    struct frame_data {
+        float time;
+        alignas(8) uint32_t extent[2];
+    };
+
+    static constexpr VkDeviceSize frame_data_stride = 256;
+
+    struct slot {
+        std::unique_ptr<Image> input;
+        std::unique_ptr<ImageView> input_v;
+        Buffer::ptr upload;
+
+        std::unique_ptr<Image> output;
+        std::unique_ptr<ImageView> output_v;
+        Buffer::ptr download;
+
+        std::unique_ptr<DescriptorPool> descpl;
+
+        std::unique_ptr<CommandBuffer> upl_cmdb;
+        std::unique_ptr<CommandBuffer> cmp_cmdb;
+        std::unique_ptr<CommandBuffer> rdb_cmdb;
+
+        // which image it's working on, by source number
+        uint64_t n = 0;
+    };
+
+    Device::ptr dev;
+    ComputePipeline::ptr pipel;
+    Bindings bnds;
+    VkExtent2D ext;
+
+    CommandPool::ptr trnsfr_pool;
+    CommandPool::ptr cmpte_pool;
+    Buffer::ptr frm_dat;
+    std::vector<slot> slots;
+
+    // Each counts images through its stage: image k (from 1) has been
+    // uploaded when upl reaches k, and so on.
+    TimelineSemaphore upl;
+    TimelineSemaphore cmp;
+    TimelineSemaphore rdb;
+    uint64_t submitted = 0;
+    uint64_t collected = 0;
+
+    void record(slot& s, uint32_t ndx);
+    void submit(slot& s);
+    void collect(const callback_t& done);
+};
+
+} // namespace cu
+
+#endif
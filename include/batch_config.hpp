@@ -0,0 +1,55 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef H7d4129738754dfbb1444bb3540b928e
+#define H7d4129738754dfbb1444bb3540b928e
+
+#include <cstdint>
+#include <filesystem>
+
+namespace cu {
+
+/*!
+ * \brief How to run minicomp offline over a batch of images (see the --batch
+ * options and Batch).
+ */
+struct BatchConfig {
+    /*!
+     * \brief A directory of binary PPMs to run the shader over, in name
+     * order. If empty, frames are generated instead.
+     */
+    std::filesystem::path input;
+
+    /*!
+     * \brief How many frames to generate when there's no input.
+     */
+    uint64_t frames = 100;
+
+    /*!
+     * \brief How many images can be in flight at once; with three, one can be
+     * uploading while another is computed and a third read back.
+     */
+    uint32_t slots = 3;
+};
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef h1ce74c340df4592a824e86858a48576
+#define h1ce74c340df4592a824e86858a48576
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <system_error>
+
+namespace cu {
+
+/*!
+ * \brief How to run a benchmark (see the --bench options).
+ *
+ * A benchmark runs minicomp with the time handed to the shader advancing by a
+ * fixed step each frame (unless another FrameClock is asked for), so every run
+ * draws the same frames however fast the machine is. The first few frames are thrown away, so pipeline creation and
+ * the like don't count against it. See BenchReport for what's measured.
+ */
+struct BenchConfig {
+    /*!
+     * \brief Where default_shader() looks, relative to the executable's
+     * directory.
+     */
+    static constexpr const char* default_shader_rel = "shaders/comp.spv";
+
+    /*!
+     * \brief The shader run if none is given with -m; the example the build
+     * compiles, which it puts beside the executable. Resolved against the
+     * executable's directory, so it's found from any working directory; only
+     * if that can't be read does it fall back to the working directory.
+     */
+    static std::filesystem::path default_shader()
+    {
+        std::error_code ec;
+        auto exe = std::filesystem::read_symlink("/proc/self/exe", ec);
+        if (ec) {
+            return default_shader_rel;
+        }
+
+        return exe.parent_path() / default_shader_rel;
+    }
+
+    /*!
+     * \brief How many frames to measure, unless duration is set.
+     */
+    uint64_t frames = 600;
+
+    /*!
+     * \brief If set, measure for this long instead of a set number of frames.
+     */
+    std::optional<std::chrono::duration<double>> duration;
+
+    /*!
+     * \brief How many frames to render before measuring.
+     */
+    uint64_t warmup = 60;
+
+    /*!
+     * \brief The size to render at, if not the default (the window's size,
+     * or HeadlessConfig::extent).
+     */
+    std::optional<VkExtent2D> extent;
+
+    /*!
+     * \brief How far the shader's time moves each frame, unless another
+     * clock is given.
+     */
+    std::chrono::duration<double> time_step {1.0 / 60};
+
+    /*!
+     * \brief Where to write the results, as JSON or CSV depending on the
+     * extension (see BenchReport::format_for()). If empty, JSON goes to
+     * stdout.
+     */
+    std::filesystem::path output;
+};
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Sa452e8dcec2480b8574aa6738374745
+#define Sa452e8dcec2480b8574aa6738374745
+
+#include "frame_stats.hpp"
+#include "metrics.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief The results of a benchmark, in a form meant for scripts rather than
+ * people.
+ *
+ * Give it some labels with info(), call warmed_up() once the warmup frames are
+ * done (and then clear cu::metrics and cu::frame_stats), frame() with the
+ * length of each measured frame, and finish() at the end. What comes out is
+ * a list of rows, each a section, a name, a statistic and a value:
+ *
+ * - frame_time_ms: exact percentiles of every measured frame, and the frame
+ *   rate they come to.
+ * - cpu_phase_ms: each phase of the frame on the CPU, from FrameStats (so
+ *   over its window, if the run was longer than that).
+ * - gpu_ms: the GPU's time for the whole frame and each profiler zone, from
+ *   GpuProfiler's metrics; gpu has its other metrics (invocation counts and
+ *   the like).
+ * - allocations: Heap allocations and frees, during setup and warmup and
+ *   during the measured frames separately (a steady state ought to have none
+ *   of the latter).
+ * - memory: each Heap pool's high-water mark, and the process's peak
+ *   resident set size.
+ *
+ * write() puts out the lot as JSON, nested section, name, statistic, or as
+ * CSV, one row per line, which is easier to append to a history of runs.
+ */
+class BenchReport {
+public:
+    using clock = std::chrono::steady_clock;
+
+    enum class Format { json, csv };
+
+    /*!
+     * \brief The format that goes with path's extension (.json or .csv), if
+     * either does.
+     */
+    static std::optional<Format> format_for(const std::filesystem::path& path);
+
+    /*!
+     * \brief Label the results, e.g. with the shader or resolution used.
+     */
+    void info(std::string key, std::string value);
+
+    /*!
+     * \brief Note what m held at the end of warmup, so setup and measured
+     * allocations can be told apart.
+     */
+    void warmed_up(const Metrics& m);
+
+    /*!
+     * \brief Add a measured frame of length d.
+     */
+    void frame(clock::duration d);
+
+    /*!
+     * \brief Gather the results from what was recorded since warmed_up().
+     */
+    void finish(const FrameStats& fs, const Metrics& m);
+
+    struct Row {
+        std::string section;
+        std::string name;
+        std::string stat;
+        double value;
+    };
+
+    const std::vector<Row>& rows() const { return rws; }
+
+    /*!
+     * \brief The value of a row, if there is one.
+     */
+    std::optional<double> get(const std::string& section,
+                              const std::string& name,
+                              const std::string& stat) const;
+
+    void write(std::ostream& out, Format f) const;
+
+    /*!
+     * \brief Write to path in the format its extension calls for. Throws if
+     * that's neither, or if it can't be written.
+     */
+    void write(const std::filesystem::path& path) const;
+
+    /*!
+     * \brief The most memory this process has had resident at once, in MiB.
+     */
+    static double peak_rss_mib();
+
+private:
+    std::vector<std::pair<std::string, std::string>> inf;
+    std::vector<double> frame_ms;
+    std::map<std::string, Metrics::Series> setup;
+    std::vector<Row> rws;
+
+    void add(const std::string& section,
+             const std::string& name,
+             const std::string& stat,
+             double value);
+
+    void write_json(std::ostream& out) const;
+    void write_csv(std::ostream& out) const;
+};
+
+} // namespace cu
+
+#endif
@@ -49,6 +49,12 @@ public:
      */
     BinData(stream_t& istream, container_t::size_type size);
 
+    /*!
+     * \brief Reads in the whole of the file at path. Throws if it can't be
+     * opened.
+     */
+    static BinData read_file(const std::filesystem::path& path);
+
     BinData(const BinData&);
     BinData& operator=(const BinData&);
 
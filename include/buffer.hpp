@@ -0,0 +1,182 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef T93ea028193b4806a5f80db2c84cd957
+#define T93ea028193b4806a5f80db2c84cd957
+
+#include "deviced.hpp"
+#include "vulkan_util.hpp"
+#include "heap.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <bitset>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief A Vulkan buffer wrapper. Like Image, a Buffer allocates and binds its
+ * own memory from the Device's Heap and releases it when it goes out of scope.
+ */
+class Buffer : public Deviced<PFN_vkCreateBuffer,
+                              PFN_vkDestroyBuffer,
+                              VkBuffer> {
+public:
+    /*!
+     * \brief A pointer to the Buffer.
+     */
+    using ptr = std::shared_ptr<Buffer>;
+
+    /*!
+     * \brief See
+     * [VkBufferCreateInfo](https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkBufferCreateInfo.html).
+     */
+    struct params {
+        /*!
+         * \brief The size of the buffer in bytes.
+         */
+        VkDeviceSize          size;
+
+        /*!
+         * \brief What the buffer will be used for (uniform buffer, transfer
+         * source, etc.).
+         */
+        vk::BufferUsageFlags  usage;
+
+        /*!
+         * \brief See
+         * [VkBufferCreateFlagBits](https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkBufferCreateFlagBits.html).
+         */
+        vk::BufferCreateFlags flags            = 0;
+
+        /*!
+         * \brief \copybrief Image::params::sharing_mode
+         */
+        vk::SharingMode       sharing_mode     = vk::SharingMode::exclsv;
+
+        /*!
+         * \brief \copybrief Image::params::queue_fam_ndcies
+         */
+        std::vector<uint32_t> queue_fam_ndcies = {};
+
+        /*!
+         * \brief Which of the Heap's pools to allocate from. Pick
+         * Heap::Location::host if you want to write to the buffer through
+         * mapped().
+         */
+        Heap::Location        location         = Heap::Location::device;
+    };
+
+    /*!
+     * \brief (constructor) Create a new buffer, with bound memory.
+     *
+     * \param l_dev The logical device you want to create the buffer with.
+     * \param ps    The characteristics you want the buffer to have.
+     */
+    Buffer(Device::ptr l_dev, const params& ps);
+
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    Buffer(Buffer&&) = delete;
+    Buffer& operator=(Buffer&&) = delete;
+
+    ~Buffer() noexcept;
+
+    /*!
+     * \brief The size of the buffer in bytes, as requested at creation.
+     */
+    VkDeviceSize size() const { return sz; }
+
+    /*!
+     * \brief What the buffer can be used for.
+     */
+    vk::BufferUsageFlags usage() const { return usg; }
+
+    /*!
+     * \brief The pool the buffer's memory came from.
+     */
+    Heap::Location location() const { return loc; }
+
+    /*!
+     * \brief The size the buffer takes up in memory, in bytes.
+     */
+    VkDeviceSize mem_size() const { return mem_reqs.size; }
+
+    /*!
+     * \brief The required alignment of the buffer in memory, in bytes.
+     */
+    VkDeviceSize alignment() const { return mem_reqs.alignment; }
+
+    /*!
+     * \brief Whether the Vulkan memory type supports this buffer.
+     */
+    bool mem_type_supported(MemoryType type) const
+    {
+        return supported_types.test(type.ndx());
+    }
+
+    /*!
+     * \brief A host pointer to the buffer's memory, or nullptr if the buffer
+     * isn't in host-visible memory. Host memory is coherent, so writes through
+     * this pointer don't need to be flushed, but you do have to make sure the
+     * device isn't reading the same bytes at the same time. Readback memory
+     * may not be; see invalidate() and flush().
+     */
+    void* mapped() const { return mppd; }
+
+    /*!
+     * \copybrief Heap::invalidate()
+     */
+    void invalidate() { dev->invalidate(mem); }
+
+    /*!
+     * \copybrief Heap::flush()
+     */
+    void flush() { dev->flush(mem); }
+
+    /*!
+     * \brief mapped(), offset by offs bytes and cast to T*.
+     */
+    template<typename T>
+    T* mapped_as(VkDeviceSize offs = 0) const
+    {
+        return reinterpret_cast<T*>(static_cast<char*>(mppd) + offs);
+    }
+
+private:
+    VkDeviceSize         sz;
+    vk::BufferUsageFlags usg;
+    Heap::Location       loc;
+
+private:
+    VkMemoryRequirements mem_reqs {};
+    std::bitset<32>      supported_types;
+
+private:
+    Heap::handle_t mem  = Heap::null_handle;
+    void*          mppd = nullptr;
+};
+
+} // namespace cu
+
+#endif
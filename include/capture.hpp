@@ -0,0 +1,166 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Xa574eeae6d443368ea2599a89af07d1
+#define Xa574eeae6d443368ea2599a89af07d1
+
+#include "capture_config.hpp"
+#include "pixels.hpp"
+#include "log.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief Writes frames to disk off the render thread (see CaptureConfig).
+ *
+ * submit() only queues the frame; a pool of threads converts frames to the
+ * output format, and one more thread writes them, in order, a run of finished
+ * frames at a time through a large buffer, so the disk sees big sequential
+ * writes. If the queue is full when a frame is submitted, it's dropped and
+ * counted, rather than holding up the caller; the same goes for frames that
+ * don't match the size of the first one, in the single-file formats.
+ *
+ * Counts go to cu::metrics as capture.written and capture.dropped, along with
+ * the time spent converting and writing each frame.
+ */
+class Capture {
+public:
+    /*!
+     * \brief (constructor) Opens the output (or creates the directory, for
+     * ppm) and starts the threads. Throws std::runtime_error if the output
+     * can't be opened.
+     */
+    explicit Capture(CaptureConfig config);
+
+    Capture(const Capture&) = delete;
+    Capture& operator=(const Capture&) = delete;
+
+    /*!
+     * \brief Calls finish(), if it hasn't been, ignoring any error.
+     */
+    ~Capture() noexcept;
+
+    /*!
+     * \brief Whether the frame numbered frame should be captured, going by
+     * CaptureConfig::every.
+     */
+    bool wanted(uint64_t frame) const { return frame % cfg.every == 0; }
+
+    /*!
+     * \brief Queue px, the frame numbered frame, to be written. Never blocks
+     * unless CaptureConfig::block is set; returns false if the frame was
+     * dropped.
+     */
+    bool submit(uint64_t frame, Pixels px);
+
+    /*!
+     * \brief Like the other submit(), but the frame is read straight from
+     * wherever px points, and px is let go as soon as it's been converted,
+     * so the pixels are never copied on the calling thread.
+     */
+    bool submit(uint64_t frame, PixelView px);
+
+    /*!
+     * \brief Count a frame that was wanted but never made it to submit()
+     * (e.g. because a readback couldn't be started).
+     */
+    void missed();
+
+    /*!
+     * \brief Write everything queued, stop the threads and close the output.
+     * Throws std::runtime_error if anything couldn't be written.
+     */
+    void finish();
+
+    /*!
+     * \brief The number of frames written so far.
+     */
+    uint64_t written() const;
+
+    /*!
+     * \brief The number of frames dropped so far.
+     */
+    uint64_t dropped() const;
+
+private:
+    struct job {
+        uint64_t seq;
+        uint64_t frame;
+        PixelView px;
+    };
+
+    struct converted {
+        uint64_t frame;
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> bytes;
+    };
+
+    CaptureConfig cfg;
+
+    // raw and y4m go to one file; only the writer touches it after
+    // construction
+    std::ofstream file;
+    std::vector<char> file_buf;
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    mutable std::mutex mtx;
+    std::condition_variable work_cv;
+    std::condition_variable write_cv;
+    std::condition_variable room_cv;
+    std::deque<job> queue;
+    std::map<uint64_t, converted> done;
+    // submitted but not yet written, i.e. what's held in memory
+    std::size_t queued = 0;
+    uint64_t next_seq = 0;
+    uint64_t next_write = 0;
+    uint64_t n_written = 0;
+    uint64_t n_dropped = 0;
+    bool stopping = false;
+    bool finished = false;
+    std::exception_ptr error;
+
+    converted prepare(job& j) const;
+    void write_frame(converted& c);
+
+    void work();
+    void write();
+
+    // last, so the threads are joined before anything they use is destroyed
+    std::deque<GuardedThread> thrds;
+
+    // how much is gathered for the disk before writing
+    static constexpr std::size_t batch_bytes = 8 * 1024 * 1024;
+};
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef D00739e05fe74bb7b4702bac7ef539c5
+#define D00739e05fe74bb7b4702bac7ef539c5
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+namespace cu {
+
+/*!
+ * \brief How to capture frames to disk (see the --capture options and
+ * Capture).
+ */
+struct CaptureConfig {
+    /*!
+     * \brief What to write the frames as.
+     *
+     * - raw: packed 8-bit RGB, one frame after another in a single file, with
+     *   no header (e.g. for ffmpeg -f rawvideo -pix_fmt rgb24).
+     * - y4m: YUV4MPEG2, 4:2:0, in a single file.
+     * - ppm: a directory of binary PPMs, one per frame, named by frame number.
+     */
+    enum class Format { raw, y4m, ppm };
+    using enum Format;
+
+    /*!
+     * \brief The file to write, or for ppm, the directory.
+     */
+    std::filesystem::path out;
+
+    Format fmt = y4m;
+
+    /*!
+     * \brief Capture one frame out of this many (1 for every frame).
+     */
+    uint32_t every = 1;
+
+    /*!
+     * \brief How many frames can be waiting to be converted or written at
+     * once. Frames that come in beyond that are dropped, not waited for, so
+     * this bounds the memory used.
+     */
+    std::size_t max_queued = 8;
+
+    /*!
+     * \brief How many threads convert frames; 0 picks one from the number of
+     * cores. One more thread does all the writing.
+     */
+    unsigned threads = 0;
+
+    /*!
+     * \brief The frame rate written in the y4m header.
+     */
+    uint32_t fps = 60;
+
+    /*!
+     * \brief Whether the frames come in as BGRA rather than RGBA.
+     */
+    bool bgra = false;
+
+    /*!
+     * \brief Whether a frame submitted while the queue is full waits for room
+     * instead of being dropped; for offline runs, where every frame matters
+     * more than keeping pace.
+     */
+    bool block = false;
+
+    /*!
+     * \brief The format written on the command line ("raw", "y4m" or
+     * "ppm"), if it's one of those.
+     */
+    static std::optional<Format> format_from_str(const std::string& s)
+    {
+        if (s == "raw") {
+            return raw;
+        } else if (s == "y4m") {
+            return y4m;
+        } else if (s == "ppm") {
+            return ppm;
+        }
+
+        return std::nullopt;
+    }
+
+    /*!
+     * \brief The format to use for path if none is given: y4m for .y4m, raw
+     * for .raw or .rgb, otherwise a directory of PPMs.
+     */
+    static Format format_for(const std::filesystem::path& path)
+    {
+        const auto ext = path.extension();
+
+        if (ext == ".y4m") {
+            return y4m;
+        } else if (ext == ".raw" || ext == ".rgb") {
+            return raw;
+        }
+
+        return ppm;
+    }
+};
+
+} // namespace cu
+
+#endif
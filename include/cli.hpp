@@ -22,9 +22,17 @@
 #ifndef oe57235954a14256abd94ca26648c94e
 #define oe57235954a14256abd94ca26648c94e
 
+#include "present_config.hpp"
+#include "headless_config.hpp"
+#include "bench_config.hpp"
+#include "frame_clock.hpp"
+#include "capture_config.hpp"
+#include "batch_config.hpp"
+
 #include <vector>
 #include <string>
 #include <filesystem>
+#include <optional>
 
 namespace cu {
 
@@ -61,9 +69,10 @@ public:
     int status() const { return stat; }
 
     /*!
-     * \brief Whether to enable logging in general.
+     * \brief Whether to enable logging in general. Never when benchmarking,
+     * since writing the log would be measured too.
      */
-    bool log() const { return lg; };
+    bool log() const { return lg && !bnch; };
 
     /*!
      * \brief Whether to log debug messages from Vulkan.
@@ -75,6 +84,11 @@ public:
      */
     bool async_log() const { return async_lg; }
 
+    /*!
+     * \brief Whether to print the contents of cu::metrics on exit.
+     */
+    bool metrics() const { return mtrcs; }
+
     /*!
      * \brief Whether to print the help text.
      */
@@ -86,9 +100,82 @@ public:
     bool minicomp() const;
 
     /*!
-     * \brief The path to the compute shader, if any.
+     * \brief The path to the compute shader, if any. When benchmarking or
+     * running a batch without one given, BenchConfig::default_shader().
+     */
+    std::filesystem::path comp_path() const;
+
+    /*!
+     * \brief The present mode and swapchain image count asked for, if any.
+     */
+    PresentConfig present_config() const { return pres_cfg; }
+
+    /*!
+     * \brief The frame rate to cap at, if any.
+     */
+    std::optional<double> fps_cap() const { return fps_cp; }
+
+    /*!
+     * \brief Where to write a trace, if one should be recorded.
+     */
+    std::optional<std::filesystem::path> trace_path() const
+    {
+        return trace_pth;
+    }
+
+    /*!
+     * \brief How to run headless, if that's been asked for.
+     */
+    std::optional<HeadlessConfig> headless() const
+    {
+        if (hdls) {
+            return hdls_cfg;
+        }
+
+        return std::nullopt;
+    }
+
+    /*!
+     * \brief How to run a benchmark, if that's been asked for.
      */
-    std::filesystem::path comp_path() const { return compute_shdr_path; }
+    std::optional<BenchConfig> bench() const
+    {
+        if (bnch) {
+            return bnch_cfg;
+        }
+
+        return std::nullopt;
+    }
+
+    /*!
+     * \brief The clock minicomp mode's shader should go by, if one's been
+     * asked for.
+     */
+    std::optional<FrameClock> clock() const { return clk; }
+
+    /*!
+     * \brief How to run a batch, if that's been asked for.
+     */
+    std::optional<BatchConfig> batch() const
+    {
+        if (btch) {
+            return btch_cfg;
+        }
+
+        return std::nullopt;
+    }
+
+    /*!
+     * \brief How to capture frames to disk, if that's been asked for.
+     */
+    std::optional<CaptureConfig> capture() const
+    {
+        if (captr) {
+            return captr_cfg;
+        }
+
+        return std::nullopt;
+    }
 
 private:
     std::string outpt;
@@ -96,12 +183,28 @@ private:
 private:
     std::filesystem::path compute_shdr_path;
 
+private:
+    PresentConfig pres_cfg;
+    std::optional<double> fps_cp;
+    std::optional<std::filesystem::path> trace_pth;
+    HeadlessConfig hdls_cfg;
+    BenchConfig bnch_cfg;
+    std::optional<FrameClock> clk;
+    CaptureConfig captr_cfg;
+    BatchConfig btch_cfg;
+    std::optional<CaptureConfig::Format> captr_fmt;
+
 private:
     int stat = 0;
     bool lg = false;
     bool debg = false;
     bool async_lg = false;
     bool hlp = false;
+    bool mtrcs = false;
+    bool hdls = false;
+    bool bnch = false;
+    bool captr = false;
+    bool btch = false;
 };
 
 } // namespace cu
@@ -27,27 +27,70 @@
 #include "command_pool.hpp"
 #include "compute_pipeline.hpp"
 #include "image.hpp"
+#include "buffer.hpp"
 #include "pc_range.hpp"
+#include "gpu_profiler.hpp"
+
+#include <string>
+#include <vector>
 
 namespace cu {
 
 class CommandBuffer {
 public:
-    CommandBuffer(Device::ptr l_dev, CommandPool::ptr cmd_pool);
-
-    CommandBuffer& record();
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev    The current Device.
+     * \param cmd_pool The pool to allocate the buffer from.
+     * \param lvl      Primary buffers are submitted to a queue; secondary ones
+     *                 are run from a primary with execute(). Note that a
+     *                 secondary doesn't inherit anything bound in the primary,
+     *                 so it has to bind its own pipeline and descriptor sets.
+     */
+    CommandBuffer(Device::ptr l_dev,
+                  CommandPool::ptr cmd_pool,
+                  vk::CommandBufferLevel lvl = vk::CommandBufferLevel::prmry);
+
+    /*!
+     * \brief Begin recording. By default the buffer is recorded for a single
+     * submission; pass 0 (or other usage flags) if you want to submit the
+     * same recording more than once. Note that re-recording a buffer without
+     * resetting its whole CommandPool requires a pool created with
+     * vk::CommandPoolCreateFlag::reset_cmmnd_buffer.
+     */
+    CommandBuffer& record(vk::CommandBufferUsageFlags flags =
+                              flgs(vk::CommandBufferUsageFlag::one_time_submit));
 
     CommandBuffer& bind(ComputePipeline&);
     CommandBuffer& bind(ComputePipeline&, std::vector<VkDescriptorSet>);
     CommandBuffer& bind(ComputePipeline&,
                         uint32_t set_bndng_offset,
                         std::vector<VkDescriptorSet>);
-    // TODO: dynamic offsets
+
+    /*!
+     * \brief Bind the pipeline and descriptor sets, supplying one offset for
+     * each dynamic uniform/storage buffer descriptor in the sets, in binding
+     * order.
+     */
+    CommandBuffer& bind(ComputePipeline&,
+                        uint32_t set_bndng_offset,
+                        std::vector<VkDescriptorSet>,
+                        std::vector<uint32_t> dyn_offsets);
 
     CommandBuffer& dispatch(uint32_t x);
     CommandBuffer& dispatch(uint32_t x, uint32_t y);
     CommandBuffer& dispatch(uint32_t x, uint32_t y, uint32_t z);
 
+    /*!
+     * \brief Dispatch enough workgroups of the most recently bound pipeline
+     * to cover extent, rounding up on each axis. Since the last workgroup on
+     * an axis may hang off the edge, the shader should check its
+     * gl_GlobalInvocationID against the bounds of what it's writing.
+     */
+    CommandBuffer& dispatch_over(VkExtent3D extent);
+    CommandBuffer& dispatch_over(VkExtent2D extent);
+
     CommandBuffer& barrier(Image&                      img,
                            vk::PipelineStageFlag       src_stage,
                            vk::PipelineStageFlag       dst_stage,
@@ -57,16 +100,81 @@ public:
                            vk::ImageLayout             new_layt,
                            vk::ImageAspectFlag         aspect);
 
+    /*!
+     * \brief A global memory barrier, for when there's no one image to put
+     * it on (e.g. to make a copy into a Buffer visible to the host).
+     */
+    CommandBuffer& barrier(vk::PipelineStageFlag src_stage,
+                           vk::PipelineStageFlag dst_stage,
+                           vk::AccessFlag        src_access,
+                           vk::AccessFlag        dst_access);
+
     CommandBuffer& copy(Image& from, Image& to);
 
+    /*!
+     * \brief Copy the whole of from, which has to be in the transfer source
+     * layout and have four bytes per texel (e.g. RGBA8), into to, tightly
+     * packed.
+     */
+    CommandBuffer& copy(Image& from, Buffer& to);
+
+    /*!
+     * \brief Copy tightly packed texels from from into the whole of to, which
+     * has to be in the transfer destination layout and have four bytes per
+     * texel.
+     */
+    CommandBuffer& copy(Buffer& from, Image& to);
+
     CommandBuffer& push_constants(ComputePipeline&, PCRange&);
 
+    /*!
+     * \brief Run secondary command buffers from this (primary) one, in the
+     * order given. The secondaries must have finished recording.
+     */
+    CommandBuffer& execute(const std::vector<CommandBuffer*>& secondaries);
+
+    /*!
+     * \brief Time zones of this recording with prof, using its slot slot
+     * (see GpuProfiler). Records a reset of the slot's queries, so call it
+     * right after record(), before begin_zone().
+     */
+    CommandBuffer& profile(GpuProfiler& prof, uint32_t slot);
+
+    /*!
+     * \brief Start a zone called name. Zones can nest. Does nothing unless
+     * profile() has been called since record() and the profiler is enabled.
+     *
+     * \param count_invocations Whether to count the compute shader
+     *                          invocations in the zone as well, if the
+     *                          profiler can (see GpuProfiler::counting()).
+     *                          Throws if a zone that counts is already open.
+     */
+    CommandBuffer& begin_zone(std::string name,
+                              bool count_invocations = false);
+
+    /*!
+     * \brief End the innermost zone still open.
+     */
+    CommandBuffer& end_zone();
+
+    /*!
+     * \brief Finish recording. Throws if a zone is still open.
+     */
     CommandBuffer& end();
 
     const VkCommandBuffer* inner() const { return &nner; }
 
+    vk::CommandBufferLevel level() const { return lvl; }
+
 private:
     VkCommandBuffer nner;
+    vk::CommandBufferLevel lvl;
+    ComputePipeline* bound = nullptr;
+
+private:
+    GpuProfiler* prof = nullptr;
+    uint32_t prof_slot = 0;
+    std::vector<GpuProfiler::ZoneQueries> open_zones;
 
 private:
     CommandPool::ptr pool;
@@ -79,7 +187,14 @@ private:
     PFN_vkCmdPipelineBarrier     pipel_barr;
     PFN_vkCmdDispatch            vk_dispatch;
     PFN_vkCmdCopyImage           copy_image;
+    PFN_vkCmdCopyImageToBuffer   copy_img_to_buff;
+    PFN_vkCmdCopyBufferToImage   copy_buff_to_img;
     PFN_vkCmdPushConstants       push_consts;
+    PFN_vkCmdExecuteCommands     exec_cmds;
+    PFN_vkCmdResetQueryPool      reset_queries;
+    PFN_vkCmdWriteTimestamp      write_ts;
+    PFN_vkCmdBeginQuery          begin_query;
+    PFN_vkCmdEndQuery            end_query;
     PFN_vkEndCommandBuffer       vk_end;
 };
 
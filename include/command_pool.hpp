@@ -41,7 +41,23 @@ public:
      */
     using ptr = std::shared_ptr<CommandPool>;
 
-    CommandPool(Device::ptr l_dev, Device::QueueFlavor q_flav);
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev  The current Device.
+     * \param q_flav The flavor of queue the pool's command buffers will be
+     *               submitted to.
+     * \param flags  See
+     * [VkCommandPoolCreateFlagBits](https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkCommandPoolCreateFlagBits.html).
+     * The default suits command buffers that are re-recorded after every
+     * reset() of the pool; pick vk::CommandPoolCreateFlag::reset_cmmnd_buffer
+     * instead if you want to keep command buffers around and re-record them
+     * individually.
+     */
+    CommandPool(Device::ptr l_dev,
+                Device::QueueFlavor q_flav,
+                vk::CommandPoolCreateFlags flags =
+                    flgs(vk::CommandPoolCreateFlag::trnsnt));
 
     CommandPool(CommandPool&&) = delete;
     CommandPool& operator=(CommandPool&&) = delete;
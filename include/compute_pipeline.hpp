@@ -28,6 +28,12 @@
 #include "vulkan_util.hpp"
 #include "pipeline_layout.hpp"
 #include "deviced.hpp"
+#include "spirv_reflection.hpp"
+#include "sc_range.hpp"
+
+#include <chrono>
+#include <memory>
+#include <optional>
 
 namespace cu {
 
@@ -35,18 +41,74 @@ class ComputePipeline : public Deviced<PFN_vkCreateComputePipelines,
                                        PFN_vkDestroyPipeline,
                                        VkPipeline> {
 public:
+    using ptr = std::shared_ptr<ComputePipeline>;
+
+    /*!
+     * \brief The number of invocations in each workgroup along each axis,
+     * i.e. the shader's `local_size_x/y/z`.
+     */
+    using LocalSize = SpirvReflection::LocalSize;
+
+    /*!
+     * \brief What the implementation reported about creating the pipeline
+     * (see
+     * [VkPipelineCreationFeedback](https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPipelineCreationFeedback.html)).
+     */
+    struct CreationFeedback {
+        /*!
+         * \brief Whether the implementation filled in the feedback at all.
+         * If not, duration is measured on the host and cache_hit is false.
+         */
+        bool valid = false;
+
+        /*!
+         * \brief Whether the pipeline came out of the pipeline cache
+         * without needing to be compiled.
+         */
+        bool cache_hit = false;
+
+        std::chrono::nanoseconds duration {0};
+    };
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev      The current Device.
+     * \param shader     The compute shader to run.
+     * \param pipel_layt The layout of the resources the shader uses.
+     * \param spec       Values for the shader's specialization constants
+     *                   (see SpecConstants), or null to leave them at their
+     *                   defaults. Only needs to live as long as the
+     *                   constructor runs. Throws if a value's size doesn't
+     *                   match the constant it's for.
+     * \param local_sz   The workgroup size the shader runs with; it's what
+     *                   CommandBuffer::dispatch_over() uses to work out how
+     *                   many workgroups cover a given extent. If left out,
+     *                   it's read from the shader itself, taking into account
+     *                   any axes set by spec.
+     * \param flags      See
+     * [VkPipelineCreateFlagBits](https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkPipelineCreateFlagBits.html).
+     */
     ComputePipeline(Device::ptr l_dev,
                     ShaderModule::ptr shader,
                     PipelineLayout::ptr pipel_layt,
+                    SCRange* spec = nullptr,
+                    std::optional<LocalSize> local_sz = std::nullopt,
                     vk::PipelineCreateFlags flags = 0);
 
     ~ComputePipeline() noexcept { dstrct(); }
 
     PipelineLayout::ptr layout() { return pipelt; }
 
+    LocalSize local_size() const { return lcl_sz; }
+
+    const CreationFeedback& creation_feedback() const { return feedback; }
+
 private:
     ShaderModule::ptr   shdr;
     PipelineLayout::ptr pipelt;
+    LocalSize           lcl_sz;
+    CreationFeedback    feedback;
 };
 
 } // namespace cu
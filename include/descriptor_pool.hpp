@@ -26,8 +26,10 @@
 #include "deviced.hpp"
 #include "descriptor_set_layout.hpp"
 #include "image_view.hpp"
+#include "buffer.hpp"
 
 #include <initializer_list>
+#include <deque>
 #include <unordered_map>
 #include <string>
 
@@ -139,10 +141,27 @@ public:
                                     uint32_t offset,
                                     ImageView* v);
 
+        /*!
+         * \brief Point a uniform buffer descriptor at range bytes of b,
+         * starting at buff_offset. If dynamic is true, the descriptor is a
+         * dynamic uniform buffer, and the offset given here is added to the
+         * one passed to CommandBuffer::bind() at record time.
+         */
+        WriteCopyOps& uniform_buffer(std::string desc_name,
+                                     uint32_t binding_ndx,
+                                     uint32_t offset,
+                                     Buffer* b,
+                                     VkDeviceSize buff_offset,
+                                     VkDeviceSize range,
+                                     bool dynamic = false);
+
         void submit();
 
         std::vector<VkWriteDescriptorSet> writes;
-        std::vector<VkDescriptorImageInfo> img_infs;
+        // deques so that the pointers held in writes stay valid as more infos
+        // are added
+        std::deque<VkDescriptorImageInfo> img_infs;
+        std::deque<VkDescriptorBufferInfo> buff_infs;
         std::vector<VkCopyDescriptorSet> copies;
 
     private:
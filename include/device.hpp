@@ -25,10 +25,14 @@
 #include "instance.hpp"
 #include "phys_device.hpp"
 #include "heap.hpp"
+#include "pipeline_cache.hpp"
 
 #include <vulkan/vulkan.h>
 
+#include <chrono>
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 namespace cu {
 
@@ -51,8 +55,12 @@ public:
      *
      * \param dev The PhysDevice in use.
      * \param inst The Instance in use.
+     * \param presents Whether the device will present to a swapchain. If
+     *                 not (e.g. when running headless), the swapchain
+     *                 extensions aren't asked for and present() can't be
+     *                 used.
      */
-    Device(PhysDevice dev, Instance::ptr inst);
+    Device(PhysDevice dev, Instance::ptr inst, bool presents = true);
 
     Device(Device&&) = delete;
     Device(const Device&) = delete;
@@ -99,13 +107,94 @@ public:
 
     VkQueue queue(QueueFlavor f);
 
+    /*!
+     * \brief Submit buff to the queue of flavor f and wait for it to finish.
+     */
     void submit(QueueFlavor f, CommandBuffer& buff, Fence& fnce);
 
+    /*!
+     * \brief Submit buff to the queue of flavor f without waiting; fnce is
+     * signaled once it's finished.
+     */
+    void submit_async(QueueFlavor f, CommandBuffer& buff, Fence& fnce);
+
+    /*!
+     * \brief A value of a timeline semaphore (see TimelineSemaphore) that a
+     * submission waits for or signals. For waits, stage is where in the
+     * pipeline the wait applies.
+     */
+    struct TimelinePoint {
+        VkSemaphore          sem;
+        uint64_t             val;
+        VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    };
+
+    /*!
+     * \brief Submit buff to the queue of flavor f without waiting on the
+     * host; the queue waits for each of waits to be reached first, and sets
+     * each of signals once buff has finished.
+     */
+    void submit_async(QueueFlavor f,
+                      CommandBuffer& buff,
+                      const std::vector<TimelinePoint>& waits,
+                      const std::vector<TimelinePoint>& signals);
+
+    /*!
+     * \copydoc PhysDevice::name
+     */
+    const std::string& name() const { return phys_dev.name; }
+
     uint64_t max_timel_sem_val_diff() const
     {
         return phys_dev.max_timel_sem_val_diff;
     }
 
+    /*!
+     * \copydoc PhysDevice::timestamp_period
+     */
+    float timestamp_period() const { return phys_dev.timestamp_period; }
+
+    /*!
+     * \brief The number of meaningful bits in timestamps written on the queue
+     * of flavor f; 0 if it doesn't support timestamps.
+     */
+    uint32_t timestamp_bits(QueueFlavor f) const;
+
+    /*!
+     * \brief A GPU timestamp and the steady clock's time, taken as close to
+     * simultaneously as the driver can manage.
+     */
+    struct ClockSample {
+        uint64_t gpu;
+        std::chrono::steady_clock::time_point cpu;
+
+        // how far apart the two readings may have been taken
+        std::chrono::nanoseconds deviation;
+    };
+
+    /*!
+     * \brief Whether sample_clocks() works, which takes
+     * VK_KHR_calibrated_timestamps or VK_EXT_calibrated_timestamps (enabled
+     * whenever they're supported) and, for now, Linux.
+     */
+    bool calibrated_timestamps() const { return get_calib_ts != nullptr; }
+
+    /*!
+     * \brief Read the GPU's timestamp counter and the steady clock together,
+     * so GPU timestamps can be put on the CPU's timeline; nothing if
+     * calibrated_timestamps() is false.
+     */
+    std::optional<ClockSample> sample_clocks();
+
+    /*!
+     * \brief Whether pipeline statistics queries can be used. (Every feature
+     * the PhysDevice supports is enabled.)
+     */
+    bool pipeline_statistics() const
+    {
+        return phys_dev.features.features.pipelineStatisticsQuery;
+    }
+
     // present:
     //   multiple of:
     //     swapchain
@@ -116,16 +205,80 @@ public:
     /*!
      * \brief Returns true if present succeeded, false if the Swapchain needs to
      * be recereated.
+     *
+     * \param present_id If nonzero and present_wait() is true, tags the
+     *                   present so presented() can later tell when it's
+     *                   reached the screen. Ids must increase from one present
+     *                   to the next on the same swapchain.
+     */
+    bool present(Swapchain& swch, uint64_t present_id = 0);
+
+    /*!
+     * \brief Whether VK_KHR_present_id and VK_KHR_present_wait are enabled,
+     * which they are whenever the device supports them.
+     */
+    bool present_wait() const { return pres_wait; }
+
+    /*!
+     * \brief Whether the present tagged with present_id (or a later one) has
+     * been shown on screen yet. Doesn't block. Always false if present_wait()
+     * is.
+     */
+    bool presented(Swapchain& swch, uint64_t present_id);
+
+    /*!
+     * \brief Whether VK_EXT_swapchain_maintenance1 is enabled, and so every
+     * present() signals a fence from Swapchain::present_fence() once the
+     * presentation engine is done with what it was given. It is whenever the
+     * device supports it and the Instance enabled VK_EXT_surface_maintenance1.
+     */
+    bool present_fences() const { return pres_fnces; }
+
+    /*!
+     * \brief Block until the queue of flavor f is idle.
      */
-    bool present(Swapchain& swch);
+    void wait_idle(QueueFlavor f);
 
     Heap::handle_t alloc(Image& img);
 
+    Heap::handle_t alloc(Buffer& buff);
+
+    /*!
+     * \copydoc Heap::mapped()
+     */
+    void* mapped(Heap::handle_t h);
+
+    /*!
+     * \copydoc Heap::invalidate()
+     */
+    void invalidate(Heap::handle_t h) { heap.invalidate(*this, h); }
+
+    /*!
+     * \copydoc Heap::flush()
+     */
+    void flush(Heap::handle_t h) { heap.flush(*this, h); }
+
     /*!
      * \copydoc Heap::release()
      */
     void release(Heap::handle_t h);
 
+    /*!
+     * \copydoc Heap::available()
+     */
+    VkDeviceSize available(Heap::Location loc) { return heap.available(loc); }
+
+    /*!
+     * \brief The device-wide pipeline cache; pass this when creating
+     * pipelines.
+     */
+    VkPipelineCache pipeline_cache() { return pl_cache.inner(); }
+
+    /*!
+     * \copydoc PipelineCache::maybe_save()
+     */
+    void save_pipeline_cache() { pl_cache.maybe_save(*this); }
+
 private:
     VkDevice dev = VK_NULL_HANDLE;
 
@@ -137,8 +290,15 @@ private:
     PFN_vkGetDeviceQueue get_dev_queue;
     PFN_vkGetDeviceProcAddr get_dev_proc_addr;
     PFN_vkQueueSubmit queue_submit;
-    PFN_vkQueuePresentKHR queue_present;
+    PFN_vkQueuePresentKHR queue_present = nullptr;
     PFN_vkDestroyDevice destroy_dev;
+    PFN_vkQueueWaitIdle queue_wait_idle;
+    PFN_vkWaitForPresentKHR wait_for_pres = nullptr;
+    PFN_vkGetCalibratedTimestampsEXT get_calib_ts = nullptr;
+
+private:
+    bool pres_wait = false;
+    bool pres_fnces = false;
 
 private:
     using queue_map_t =
@@ -147,6 +307,7 @@ private:
 
 private:
     Heap heap;
+    PipelineCache pl_cache;
 };
 
 } // namespace cu
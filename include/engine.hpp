@@ -24,9 +24,22 @@
 
 #include "sdl.hpp"
 #include "vulkan.hpp"
+#include "frame_limiter.hpp"
+#include "present_config.hpp"
+#include "headless_config.hpp"
+#include "bench_config.hpp"
+#include "frame_clock.hpp"
+#include "capture_config.hpp"
+#include "batch_config.hpp"
+
+#include <chrono>
+#include <memory>
+#include <optional>
 
 namespace cu {
 
+class Capture;
+
 /*!
  * \brief The entry point into the game engine; coordinates its
  * components. The tentative long-term plan is for this to take a
@@ -42,8 +55,33 @@ public:
      *
      * \param debug Whether the Vulkan debug utils should be
      * enabled.
+     * \param pres_cfg How the swapchain should present (see
+     * PresentConfig).
+     * \param fps_cap The frame rate to cap at, if any (see
+     * FrameLimiter).
+     * \param headless If set, run without a window, as it says (see
+     * HeadlessConfig); SDL isn't initialized at all, and pres_cfg is
+     * ignored.
+     * \param bench If set, minicomp mode runs a benchmark rather than
+     * carrying on until closed (see BenchConfig); its extent, if any, takes
+     * the place of the headless one or the window's usual size.
+     * \param clock Where minicomp mode's shader gets the time from (see
+     * FrameClock). By default, the real clock, or when benchmarking, a fixed
+     * step of BenchConfig::time_step.
+     * \param capture If set, headless minicomp mode writes frames to disk as
+     * it goes (see Capture).
+     * \param batch If set, minicomp mode runs the shader over a batch of
+     * images instead of rendering frames (see BatchConfig); needs headless.
+     * The outputs are written with capture, if that's set too.
      */
-    Engine(bool debug = false);
+    Engine(bool debug = false,
+           PresentConfig pres_cfg = {},
+           std::optional<double> fps_cap = std::nullopt,
+           std::optional<HeadlessConfig> headless = std::nullopt,
+           std::optional<BenchConfig> bench = std::nullopt,
+           std::optional<FrameClock> clock = std::nullopt,
+           std::optional<CaptureConfig> capture = std::nullopt,
+           std::optional<BatchConfig> batch = std::nullopt);
 
     Engine(Engine&&) = delete;
     Engine(const Engine&) = delete;
@@ -95,21 +133,46 @@ public:
     void minicomp_mode(std::filesystem::path comp_spv_path);
 
     /*!
-     * \brief Add a new compiled (SPIR-V) shader.
+     * \copydoc Vulkan::add_shader()
      */
-    void add_shader(std::string name, BinData compiled_shader);
+    void add_shader(std::string name,
+                    BinData compiled_shader,
+                    std::filesystem::path source = {});
 
 private:
     bool dbg;
 
 private:
-    SDL sdl;
+    // not there when headless
+    std::optional<SDL> sdl;
+    std::optional<HeadlessConfig> hdls;
+    std::optional<BenchConfig> bnch;
+    std::optional<FrameClock> clk;
+    std::optional<CaptureConfig> captr;
+    std::optional<BatchConfig> btch;
 
 private:
-    Vulkan vulk;
+    std::unique_ptr<Vulkan> vulk;
+
+    void minicomp_loop();
+    void minicomp_headless();
+    void minicomp_bench(const std::filesystem::path& comp_spv_path);
+    void minicomp_batch();
+
+    // with --capture, called before each frame is rendered, and after the
+    // last
+    void capture_frame(Capture& capt, uint64_t frame);
+    void finish_capture(Capture& capt);
 
 private:
     Mode mde = normal;
+
+private:
+    std::optional<FrameLimiter> limiter;
+
+private:
+    // how often the frame stats are written to the log
+    static constexpr std::chrono::seconds stats_interval {5};
 };
 
 } // namespace cu
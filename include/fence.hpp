@@ -53,9 +53,16 @@ public:
 
     void reset();
 
+    /*!
+     * \brief Whether the fence has been signaled. Doesn't block or reset the
+     * fence.
+     */
+    bool signaled();
+
 private:
     PFN_vkWaitForFences vk_wait;
     PFN_vkResetFences   vk_reset;
+    PFN_vkGetFenceStatus vk_status;
 };
 
 } // namespace cu
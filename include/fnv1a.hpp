@@ -0,0 +1,52 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef x1d1265c00d94048850e5bc4192c69be
+#define x1d1265c00d94048850e5bc4192c69be
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cu {
+
+/*!
+ * \brief A 64-bit FNV-1a hash of sz bytes at data. Quick and well spread,
+ * for telling blobs apart (cache keys, checksums), but not for anything
+ * that has to hold up against someone trying to make it collide.
+ */
+inline uint64_t fnv1a(const void* data, std::size_t sz)
+{
+    constexpr uint64_t offset_basis = 0xcbf29ce484222325;
+    constexpr uint64_t prime        = 0x100000001b3;
+
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = offset_basis;
+    for (std::size_t i = 0; i < sz; ++i) {
+        h ^= bytes[i];
+        h *= prime;
+    }
+
+    return h;
+}
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef sa027c6ddfd2491e921d9f7baf1867c6
+#define sa027c6ddfd2491e921d9f7baf1867c6
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief Where the time handed to the minicomp shader comes from.
+ *
+ * The real clock goes by the steady clock, so no two runs draw quite the same
+ * frames. The other two make the time depend only on how many frames have
+ * been rendered: fixed advances it by a set step each frame, and scripted
+ * takes it from a list, e.g. one read from a file with read_script(). With
+ * either, every run does the same work on the GPU and draws the same images,
+ * which benchmarks and comparisons against reference images need.
+ *
+ * Once a script runs out, the time carries on at the pace of its last two
+ * entries (or stays put, if it only has one).
+ */
+class FrameClock {
+public:
+    using clock   = std::chrono::steady_clock;
+    using seconds = std::chrono::duration<double>;
+
+    enum class Mode { real, fixed, scripted };
+
+    /*!
+     * \brief (constructor) A real clock.
+     */
+    FrameClock() = default;
+
+    static FrameClock fixed(seconds step);
+
+    /*!
+     * \brief A clock that gives times in order, one each frame. Throws if
+     * times is empty.
+     */
+    static FrameClock scripted(std::vector<seconds> times);
+
+    /*!
+     * \brief A scripted clock with the times in the file at path, in seconds,
+     * one to a line. Blank lines and anything after a # are ignored. Throws if
+     * the file can't be read, has anything else in it, or has no times.
+     */
+    static FrameClock read_script(const std::filesystem::path& path);
+
+    /*!
+     * \brief The clock written on the command line: "real", "fixed" (a step
+     * of default_step), "fixed:SECONDS" or "script:FILE". Returns nothing if
+     * it's none of those; throws if it's a script that can't be read.
+     */
+    static std::optional<FrameClock> from_str(const std::string& s);
+
+    static constexpr seconds default_step {1.0 / 60};
+
+    Mode mode() const { return mde; }
+
+    /*!
+     * \brief The time for the next frame. Real clocks go by now; the others
+     * ignore it.
+     */
+    seconds next(clock::time_point now = clock::now());
+
+    /*!
+     * \brief Go back to time zero, which for a real clock is now.
+     */
+    void restart(clock::time_point now = clock::now());
+
+    /*!
+     * \brief How many times next() has been called since the last restart.
+     */
+    uint64_t frames() const { return frms; }
+
+    /*!
+     * \brief A short description, like "fixed 16.667 ms".
+     */
+    std::string str() const;
+
+private:
+    Mode mde = Mode::real;
+    seconds step {0};
+    std::vector<seconds> script;
+    std::string script_src;
+
+    clock::time_point start = clock::now();
+    uint64_t frms = 0;
+};
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef E06305b34ab640f4a91ae3861e91112d
+#define E06305b34ab640f4a91ae3861e91112d
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cu {
+
+/*!
+ * \brief Conversions from the four-byte pixels that come back from the GPU to
+ * the formats video tools want. Each takes whether the source is BGRA rather
+ * than RGBA (as swapchain images usually are).
+ *
+ * Packing to RGB uses SSSE3 shuffles when the CPU it runs on has them (see
+ * simd()), whatever the build targets; the rest is plain fixed-point
+ * arithmetic over whole rows, which the compiler can vectorize itself.
+ */
+namespace convert {
+
+/*!
+ * \brief Drop alpha: pixels four-byte pixels from src become three-byte ones
+ * in dst, in RGB order.
+ */
+void to_rgb(const uint8_t* src, uint8_t* dst, std::size_t pixels, bool bgra);
+
+/*!
+ * \brief Whether to_rgb() uses SIMD shuffles on this CPU, which is decided
+ * once, at its first call.
+ */
+bool simd();
+
+/*!
+ * \brief to_rgb() without SIMD, to check it against.
+ */
+void to_rgb_scalar(const uint8_t* src,
+                   uint8_t* dst,
+                   std::size_t pixels,
+                   bool bgra);
+
+/*!
+ * \brief The bytes to_yuv420() writes for a width x height image: a full-size
+ * Y plane, then U and V planes half the size each way (rounded up).
+ */
+constexpr std::size_t yuv420_size(uint32_t width, uint32_t height)
+{
+    const std::size_t cw = (width + 1) / 2;
+    const std::size_t ch = (height + 1) / 2;
+    return std::size_t {width} * height + 2 * cw * ch;
+}
+
+/*!
+ * \brief Convert to planar 4:2:0 YUV (BT.601, limited range), into
+ * yuv420_size() bytes at dst. Each chroma sample is taken from the average of
+ * the (up to) four pixels it covers.
+ */
+void to_yuv420(const uint8_t* src,
+               uint32_t width,
+               uint32_t height,
+               uint8_t* dst,
+               bool bgra);
+
+} // namespace convert
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,85 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef p7644fe0b2374d17b1cfb7f9429b7328
+#define p7644fe0b2374d17b1cfb7f9429b7328
+
+#include <chrono>
+
+namespace cu {
+
+/*!
+ * \brief Caps the frame rate by blocking until the next frame is due.
+ *
+ * Sleeping alone is too coarse for this (the OS tends to wake the thread up a
+ * good fraction of a millisecond late) and spinning alone burns a core, so
+ * wait() sleeps until shortly before the deadline and spins for the rest. How
+ * far ahead it wakes up adapts to how late the sleeps have actually been
+ * running.
+ *
+ * Frames are scheduled on a fixed grid, so one that's a little late doesn't
+ * push back the ones after it. If a frame is late by more than a whole period,
+ * though, the grid is restarted from then rather than letting the next few
+ * frames through back-to-back to catch up.
+ */
+class FrameLimiter {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param fps The frame rate to cap at. Throws unless it's positive.
+     */
+    explicit FrameLimiter(double fps);
+
+    /*!
+     * \brief Block until the next frame is due. The first call returns
+     * straight away.
+     */
+    void wait();
+
+    /*!
+     * \brief The time between frames.
+     */
+    clock::duration period() const { return perd; }
+
+    /*!
+     * \brief How long before each deadline wait() currently stops sleeping and
+     * starts spinning.
+     */
+    clock::duration margin() const { return mrgn; }
+
+    /*!
+     * \brief The least margin() will shrink to.
+     */
+    static constexpr std::chrono::microseconds min_margin {200};
+
+private:
+    clock::duration perd;
+    clock::duration mrgn = std::chrono::milliseconds {1};
+    clock::time_point next;
+    bool started = false;
+};
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef lf4be0735dd94a8b9412897df8de2b19
+#define lf4be0735dd94a8b9412897df8de2b19
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace cu {
+
+/*!
+ * \brief Frame times, broken down by phase, over a rolling window of recent
+ * frames.
+ *
+ * Each phase keeps the last `window` samples in a ring, plus a histogram of
+ * what's in the ring with log-linear buckets (16 to each power of two, so a
+ * bucket is never more than about 6% wide). Recording a sample is a handful of
+ * relaxed atomic operations, with no locking or allocation, so it's cheap
+ * enough to do for every phase of every frame; percentiles come from the
+ * histogram and are only worked out when asked for.
+ *
+ * It's safe to record from any thread and to read while recording is going
+ * on, but each phase is meant to have one writer at a time (in practice, the
+ * main loop); two writers on the same phase can briefly leave a sample
+ * counted in the wrong bucket.
+ *
+ * Anything can record to the global `frame_stats` object, which Engine
+ * reports on periodically in the log and main() prints on exit along with
+ * cu::metrics (see the --metrics option).
+ */
+class FrameStats {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /*!
+     * \brief A part of the frame. frame itself is the time from the start of
+     * one frame to the start of the next, which is what fps() and hitches()
+     * go by. gpu is the time the frame's work took on the GPU itself, as
+     * measured by GpuProfiler.
+     */
+    enum class Phase {
+        poll, acquire, record, submit, gpu_wait, present, gpu, frame,
+    };
+
+    static constexpr std::size_t phase_count = 8;
+
+    static constexpr const char* phase_name(Phase p)
+    {
+        using enum Phase;
+
+        switch (p) {
+        case poll:     return "poll";
+        case acquire:  return "acquire";
+        case record:   return "record";
+        case submit:   return "submit";
+        case gpu_wait: return "GPU wait";
+        case present:  return "present";
+        case gpu:      return "GPU";
+        case frame:    return "frame";
+        default:       return "UNKNOWN";
+        }
+    }
+
+    /*!
+     * \brief How many of the most recent samples of each phase are kept.
+     */
+    static constexpr std::size_t window = 1024;
+
+    /*!
+     * \brief A frame that takes more than this many times the median frame
+     * time is a hitch.
+     */
+    static constexpr double hitch_factor = 2.0;
+
+    /*!
+     * \brief Add a sample to phase p.
+     */
+    void record(Phase p, clock::duration d) noexcept;
+
+    /*!
+     * \brief The state of one phase over the window, in milliseconds.
+     * Percentiles are accurate to the width of a histogram bucket; mean and
+     * max are exact.
+     */
+    struct Summary {
+        std::size_t count = 0;
+        double mean = 0;
+        double p50  = 0;
+        double p95  = 0;
+        double p99  = 0;
+        double max  = 0;
+    };
+
+    Summary summary(Phase p) const;
+
+    /*!
+     * \brief Frames per second over the window.
+     */
+    double fps() const;
+
+    /*!
+     * \brief The number of frames in the window more than hitch_factor times
+     * as long as the median.
+     */
+    std::size_t hitches() const;
+
+    /*!
+     * \brief The number of frames ever recorded.
+     */
+    uint64_t total_frames() const { return of(Phase::frame).written.load(); }
+
+    /*!
+     * \brief A table of every phase that has any samples (empty if none do).
+     */
+    std::string report() const;
+
+    /*!
+     * \brief Throw everything away. Not safe to call while recording.
+     */
+    void clear() noexcept;
+
+    /*!
+     * \brief The histogram bucket a sample of ns nanoseconds goes in.
+     * Anything past about a minute goes in the last bucket.
+     */
+    static constexpr uint32_t bucket(uint64_t ns)
+    {
+        ns = ns < max_ns ? ns : max_ns;
+
+        if (ns < sub_buckets) {
+            return static_cast<uint32_t>(ns);
+        }
+
+        const uint32_t e   = std::bit_width(ns) - 1;
+        const uint32_t sub = (ns >> (e - sub_bits)) & (sub_buckets - 1);
+        return (e - sub_bits + 1) * sub_buckets + sub;
+    }
+
+    /*!
+     * \brief The smallest sample (in nanoseconds) that goes in bucket b.
+     */
+    static constexpr uint64_t bucket_floor(uint32_t b)
+    {
+        if (b < sub_buckets) {
+            return b;
+        }
+
+        const uint32_t e   = b / sub_buckets + sub_bits - 1;
+        const uint64_t sub = b % sub_buckets;
+        return (sub_buckets + sub) << (e - sub_bits);
+    }
+
+private:
+    static constexpr uint32_t sub_bits    = 4;
+    static constexpr uint64_t sub_buckets = 1 << sub_bits;
+    static constexpr uint32_t max_bits    = 36;
+    static constexpr uint64_t max_ns      = (uint64_t {1} << max_bits) - 1;
+
+public:
+    static constexpr uint32_t bucket_count =
+        (max_bits - sub_bits + 1) * sub_buckets;
+
+private:
+    struct series {
+        std::atomic<uint64_t> written = 0;
+        std::array<std::atomic<uint64_t>, window> ring = {};
+        std::array<std::atomic<uint32_t>, bucket_count> hist = {};
+    };
+
+    std::array<series, phase_count> phases;
+
+    series& of(Phase p) { return phases[static_cast<std::size_t>(p)]; }
+
+    const series& of(Phase p) const
+    {
+        return phases[static_cast<std::size_t>(p)];
+    }
+
+    // samples in the window
+    static std::size_t held(const series& s);
+
+    // the sample at quantile q, in nanoseconds
+    static double quantile(const series& s, double q);
+};
+
+// global frame stats
+extern FrameStats frame_stats;
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Ta892c88d80744beb3a81da87db3289b
+#define Ta892c88d80744beb3a81da87db3289b
+
+#include "device.hpp"
+#include "query_pool.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief Times regions of command buffers on the GPU, using timestamp
+ * queries.
+ *
+ * The queries are split into slots, one for each command buffer that can be
+ * in flight at once (e.g. one per swapchain image), each with room for
+ * max_zones zones. A command buffer is attached to a slot with
+ * CommandBuffer::profile() and its regions marked with
+ * CommandBuffer::begin_zone() and CommandBuffer::end_zone(). After
+ * submitting it, call submitted() with the slot; collect() then picks up the
+ * results of any submitted slots whose queries have all come in, without
+ * waiting for the rest, so they can be read back a frame or a few later.
+ *
+ * Each zone's duration goes into cu::metrics as gpu.NAME_ms, and the span of
+ * each slot's zones into frame_stats as the GPU phase.
+ *
+ * A zone can also count the compute shader invocations inside it, using a
+ * pipeline statistics query, if the device supports those (see counting()).
+ * The count goes into cu::metrics as gpu.NAME.invocations. Since queries of
+ * the same type can't be active at the same time, zones that count can't be
+ * nested in one another (though they can be nested in, or contain, ones that
+ * don't).
+ *
+ * If the device supports calibrated timestamps (see
+ * Device::calibrated_timestamps()), the GPU's clock is also correlated with
+ * the steady clock every calibration_interval, which puts the zones on the
+ * same timeline as the CPU's frame phases (see to_cpu_time()). Then each
+ * slot also records how long the GPU took to get started on it after it was
+ * submitted, as gpu.submit_to_start_ms, and how long the GPU sat idle
+ * between finishing the previous slot and starting it, as gpu.idle_ms; a
+ * frame where the GPU waited on the CPU shows up in the latter, and one where
+ * the CPU waited on the GPU in the former. The zones also go into cu::trace,
+ * if it's enabled, on a track for the queue.
+ *
+ * If the queue doesn't support timestamps, enabled() is false and everything
+ * does nothing.
+ */
+class GpuProfiler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /*!
+     * \brief How often the GPU's clock is correlated with the steady clock
+     * again, to keep them from drifting apart.
+     */
+    static constexpr clock::duration calibration_interval =
+        std::chrono::seconds {1};
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev     The current Device.
+     * \param q_flav    The flavor of queue the profiled command buffers will
+     *                  be submitted to.
+     * \param slots     The number of slots.
+     * \param max_zones The number of zones each slot has room for.
+     */
+    GpuProfiler(Device::ptr l_dev,
+                Device::QueueFlavor q_flav,
+                uint32_t slots,
+                uint32_t max_zones = 16);
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    bool enabled() const { return pool != nullptr; }
+
+    /*!
+     * \brief Whether zones can count compute shader invocations.
+     */
+    bool counting() const { return stat_pool != nullptr; }
+
+    /*!
+     * \brief Whether the GPU's clock has been correlated with the steady
+     * clock yet, so to_cpu_time() works.
+     */
+    bool calibrated() const { return calib.has_value(); }
+
+    /*!
+     * \brief The steady clock's time at the GPU timestamp ticks (as written
+     * by a timestamp query), if calibrated().
+     */
+    std::optional<clock::time_point> to_cpu_time(uint64_t ticks) const;
+
+    uint32_t slots() const { return static_cast<uint32_t>(slts.size()); }
+
+    /*!
+     * \brief The timestamp queries.
+     */
+    QueryPool& queries() { return *pool; }
+
+    /*!
+     * \brief The pipeline statistics queries, if counting().
+     */
+    QueryPool& invocation_queries() { return *stat_pool; }
+
+    /*!
+     * \brief The first query belonging to slot.
+     */
+    uint32_t slot_first(uint32_t slot) const { return slot * slot_size(); }
+
+    /*!
+     * \brief The number of timestamp queries in each slot.
+     */
+    uint32_t slot_size() const { return max_zns * 2; }
+
+    /*!
+     * \brief The first pipeline statistics query belonging to slot. Each slot
+     * has max_zones of them.
+     */
+    uint32_t invocation_slot_first(uint32_t slot) const
+    {
+        return slot * max_zns;
+    }
+
+    /*!
+     * \brief The queries a zone is written to.
+     */
+    struct ZoneQueries {
+        // the zone's start is written here and its end to the one after
+        uint32_t timestamp;
+
+        // the pipeline statistics query to begin and end around the zone,
+        // if it counts invocations
+        std::optional<uint32_t> invocations;
+    };
+
+    /*!
+     * \brief Forget the zones recorded into slot before (including any
+     * results not yet collected). Called by CommandBuffer::profile().
+     */
+    void begin_slot(uint32_t slot);
+
+    /*!
+     * \brief Make room for a zone called name in slot and return the queries
+     * to write it to. It only counts invocations if count_invocations is set
+     * and counting() is true. Throws if the slot is full. Called by
+     * CommandBuffer::begin_zone().
+     */
+    ZoneQueries add_zone(uint32_t slot,
+                         std::string name,
+                         bool count_invocations = false);
+
+    /*!
+     * \brief Note that a command buffer profiled into slot has been
+     * submitted, so its results can be collected.
+     */
+    void submitted(uint32_t slot);
+
+    /*!
+     * \brief Read back and publish the results of every submitted slot whose
+     * queries are all available, recalibrating first if it's time to.
+     * Doesn't block.
+     */
+    void collect();
+
+private:
+    void recalibrate();
+
+    // the metric names are put together when the zone is added, since
+    // it's collected far more often than it's recorded
+    struct zone {
+        std::string name;
+        std::string time_metric;
+        std::string invocations_metric;
+        bool counted;
+    };
+
+    struct slot_state {
+        std::vector<zone> zones;
+        bool pending = false;
+        clock::time_point submit_time;
+    };
+
+    Device::ptr dev;
+    uint32_t max_zns;
+    double ns_per_tick;
+    std::string track_name;
+    uint64_t ts_mask = 0;
+    QueryPool::ptr pool;
+    QueryPool::ptr stat_pool;
+    std::vector<slot_state> slts;
+    std::vector<uint64_t> ticks;
+    std::vector<uint64_t> invocs;
+    std::optional<Device::ClockSample> calib;
+    std::optional<clock::time_point> last_end;
+};
+
+} // namespace cu
+
+#endif
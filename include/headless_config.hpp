@@ -0,0 +1,91 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef F42b6a4ff59f47339680bf93d5c6c4a4
+#define F42b6a4ff59f47339680bf93d5c6c4a4
+
+#include <vulkan/vulkan.h>
+
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+namespace cu {
+
+/*!
+ * \brief How to run without a window (see Vulkan's headless constructor).
+ */
+struct HeadlessConfig {
+    /*!
+     * \brief The size to render at.
+     */
+    VkExtent2D extent = {1280, 720};
+
+    /*!
+     * \brief How many frames to render before stopping, since there's no
+     * window to close.
+     */
+    uint64_t frames = 1;
+
+    /*!
+     * \brief Where to write the last frame rendered (as a binary PPM), if
+     * anywhere.
+     */
+    std::filesystem::path readback;
+
+    /*!
+     * \brief The size written as WIDTHxHEIGHT on the command line (e.g.
+     * "1920x1080"), if it's in that form and neither side is zero.
+     */
+    static std::optional<VkExtent2D> extent_from_str(const std::string& s)
+    {
+        const auto x = s.find('x');
+        if (x == std::string::npos || x == 0 || x + 1 == s.size()
+            || !std::isdigit(static_cast<unsigned char>(s[0]))
+            || !std::isdigit(static_cast<unsigned char>(s[x + 1]))) {
+            return std::nullopt;
+        }
+
+        try {
+            std::size_t w_end;
+            std::size_t h_end;
+            const auto w = std::stoul(s.substr(0, x), &w_end);
+            const auto h = std::stoul(s.substr(x + 1), &h_end);
+
+            if (w_end != x || h_end != s.size() - x - 1
+                || w == 0 || h == 0 || w > UINT32_MAX || h > UINT32_MAX) {
+                return std::nullopt;
+            }
+
+            return VkExtent2D {static_cast<uint32_t>(w),
+                               static_cast<uint32_t>(h)};
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+};
+
+} // namespace cu
+
+#endif
@@ -25,10 +25,13 @@
 #include "phys_device.hpp"
 #include "log.hpp"
 
+#include <string>
+
 namespace cu {
 
 class Device;
 class Image;
+class Buffer;
 
 /*!
  * \brief An interface to "graphics memory."
@@ -39,6 +42,17 @@ class Image;
  * to allocate memory for e.g. an Image. In many ways it's reasonable to think
  * of this class as an implementation detail of Device.
  *
+ * The Heap keeps three pools: a large device-local one, which is where images
+ * and most buffers should go; a smaller host-visible, host-coherent one that
+ * stays mapped for as long as the Heap exists, meant for small buffers the
+ * host rewrites often (per-frame uniforms and the like); and one for reading
+ * results back, which is host-cached where the device allows and is only
+ * allocated once something asks for it. See Heap::Location.
+ *
+ * Every allocation and release is counted in cu::metrics, under
+ * "heap.main_pool" and "heap.host_pool"; the maximum of each pool's
+ * "in_use_mib" series is its high-water mark.
+ *
  * If you do create a Heap directly, note that it doesn't follow RAII; you have
  * to explicitly construct it using construct() and free it using the function
  * free_self(). The Device takes care of this automatically for its memory.
@@ -48,16 +62,71 @@ public:
     using handle_t = uint64_t;
     static constexpr handle_t null_handle = 0;
 
+    /*!
+     * \brief Which of the Heap's pools an allocation should come from.
+     */
+    enum class Location {
+        /*!
+         * \brief Device-local memory, not accessible from the host.
+         */
+        device,
+
+        /*!
+         * \brief Host-visible, host-coherent memory that is kept persistently
+         * mapped; see Heap::mapped().
+         */
+        host,
+
+        /*!
+         * \brief Host-visible memory that's cached on the host if the device
+         * has any such, for buffers the device writes and the host reads
+         * (see Readback), or that the host fills with a lot for the device to
+         * read (see Batch). Kept mapped like host memory, but it may not be
+         * coherent; call invalidate() before reading what the device wrote,
+         * and flush() after writing what it'll read.
+         */
+        readback,
+    };
+
     void construct(Device& l_dev, PhysDevice ph_dev);
 
     handle_t alloc_on_dev(Device& dev, Image& img);
 
+    handle_t alloc_on_dev(Device& dev, Buffer& buff);
+
+    /*!
+     * \brief A host pointer to the start of the memory associated with h, if h
+     * was allocated from host-visible memory, or nullptr otherwise.
+     */
+    void* mapped(handle_t h);
+
+    /*!
+     * \brief Make what the device has written to h visible to the host, if
+     * h's memory isn't host-coherent (does nothing if it is). Only the
+     * device's writes that have already been made available to the host (by
+     * a barrier with a host destination and a fence wait, say) are covered.
+     */
+    void invalidate(Device& dev, handle_t h);
+
+    /*!
+     * \brief Make what the host has written to h visible to the device, if
+     * h's memory isn't host-coherent (does nothing if it is). Call it before
+     * submitting the work that reads it.
+     */
+    void flush(Device& dev, handle_t h);
+
     /*!
      * \brief Free the memory associated with h. If h is Heap::null_handle, does
      * nothing.
      */
     void release(handle_t h);
 
+    /*!
+     * \brief How many bytes of the pool for loc haven't been handed out. An
+     * allocation that big may still not fit, if what's free is in pieces.
+     */
+    VkDeviceSize available(Location loc);
+
     void free_self(Device& dev) noexcept;
 
 private:
@@ -80,16 +149,33 @@ private:
         void log_attrs();
     };
 
+    // Handles from the host and readback pools have these bits set, so that
+    // release() and mapped() can tell which pool to look in without searching
+    // them all.
+    static constexpr handle_t host_bit     = handle_t{1} << 63;
+    static constexpr handle_t readback_bit = handle_t{1} << 62;
+
     struct Pool {
-        VkDeviceMemory nner;
+        std::string    name;
+        VkDeviceMemory nner = VK_NULL_HANDLE;
         VkDeviceSize   sz;
         MemoryType     type;
         Block* blocks;
+        handle_t tag = 0;
         handle_t next_handle = null_handle + 1;
+        void* mapped = nullptr;
         bool should_destroy = false;
 
+        // bytes handed out, and the prefix of the metrics the pool reports
+        // them under (see note_usage())
+        VkDeviceSize in_use = 0;
+        std::string  metric;
+
         Pool() = default;
-        Pool(VkDeviceSize size, MemoryType mem_type);
+        Pool(std::string pool_name,
+             VkDeviceSize size,
+             MemoryType mem_type,
+             handle_t handle_tag = 0);
 
         Pool(const Pool&) = delete;
         Pool& operator=(const Pool&) = delete;
@@ -100,15 +186,30 @@ private:
         ~Pool() noexcept;
 
         Block* reserve_space(VkDeviceSize sz, VkDeviceSize alignment);
+        Block* find(handle_t h);
         void release(handle_t h);
+
+        void note_usage() const;
     };
 
     Pool main_pool;
+    Pool host_pool;
+    Pool readback_pool;
+
+    Pool& pool_for(handle_t h);
+    Pool& pool_for(Location loc);
+
+    void alloc_pool(Device& dev, Pool& pool);
+    void map_pool(Device& dev, Pool& pool);
 
 private:
-    PFN_vkAllocateMemory  alloc_mem;
-    PFN_vkFreeMemory      free_mem;
-    PFN_vkBindImageMemory bind_img_mem;
+    PFN_vkAllocateMemory   alloc_mem;
+    PFN_vkFreeMemory       free_mem;
+    PFN_vkMapMemory        map_mem;
+    PFN_vkInvalidateMappedMemoryRanges invalidate_ranges;
+    PFN_vkFlushMappedMemoryRanges flush_ranges;
+    PFN_vkBindImageMemory  bind_img_mem;
+    PFN_vkBindBufferMemory bind_buff_mem;
 };
 
 } // namespace cu
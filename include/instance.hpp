@@ -46,9 +46,18 @@ public:
      *
      * \param exts The extensions required.
      * \param layers The layers to enable.
+     * \param gipa vkGetInstanceProcAddr() from the Vulkan loader to use. By
+     *             default it comes from SDL, which needs SDL to have been
+     *             initialized; pass VulkanLoader::get_inst_proc_addr() to do
+     *             without it.
+     * \param opt_exts Extensions that are nice to have; they're enabled
+     *                 together if every one of them is available, and
+     *                 otherwise none of them are. See enabled().
      */
     Instance(std::vector<const char*> exts,
-             std::vector<const char*> layers);
+             std::vector<const char*> layers,
+             PFN_vkGetInstanceProcAddr gipa = nullptr,
+             std::vector<const char*> opt_exts = {});
 
     Instance(Instance&&) = delete;
     Instance(const Instance&) = delete;
@@ -71,8 +80,15 @@ public:
      */
     PFN_vkVoidFunction get_proc_addr(const char* name);
 
+    /*!
+     * \brief Whether the extension ext was enabled, whether because it was
+     * required or because it was optional and available.
+     */
+    bool enabled(const std::string& ext) const;
+
 private:
     VkInstance inst = VK_NULL_HANDLE;
+    std::vector<std::string> enabled_exts;
 
     PFN_vkGetInstanceProcAddr get_inst_proc_addr;
     PFN_vkEnumerateInstanceLayerProperties enum_inst_layer_props;
@@ -81,8 +97,9 @@ private:
     PFN_vkDestroyInstance destroy_inst;
 
     void check_avail_layers(const std::vector<const char*>& layers);
-    void check_avail_exts(const std::vector<const char*>& exts,
-                          const std::vector<const char*>& layers);
+    std::vector<std::string>
+    check_avail_exts(const std::vector<const char*>& exts,
+                     const std::vector<const char*>& layers);
 };
 
 } // namespace cu
@@ -0,0 +1,58 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef l84cf71cb790461699b404c536daa300
+#define l84cf71cb790461699b404c536daa300
+
+#include <cstdio>
+#include <string>
+
+namespace cu {
+
+/*!
+ * \brief s escaped for use between the quotes of a JSON string: quotes and
+ * backslashes get a backslash, and other control characters become \\u
+ * escapes. Everything else, UTF-8 included, passes through as it is.
+ */
+inline std::string json_escape(const std::string& s)
+{
+    std::string out;
+    out.reserve(s.size());
+
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+
+    return out;
+}
+
+} // namespace cu
+
+#endif
@@ -197,9 +197,12 @@ struct LoggableObj {
  * within destructors. The one thing you should not do from a
  * destructor is sync/async switching.
  *
- * This class's functions are not designed to be called from
- * multiple threads. This will be changed in the future if
- * necessary.
+ * The logging functions can be called from multiple threads.
+ * Indentation is tracked per thread, so indent() on one thread
+ * won't affect entries written from another, and whole entries
+ * are written atomically with respect to each other. Runtime
+ * configuration (turn_on(), async_on() and friends) should
+ * still only be done from the main thread.
  *
  * For the time being, it just writes to stdout (unless it enters
  * an error state internally). This may be changed in the future
@@ -390,8 +393,9 @@ public:
 
 private:
     std::mutex msgs_mutex;
+    std::mutex write_mutex;
     std::deque<std::string> msgs;
-    std::string::size_type indent_amt = 0;
+    static thread_local std::string::size_type indent_amt;
     bool on = false;
     bool stopped = false;
     bool async = false;
@@ -0,0 +1,127 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef P46ae6fbdb2749ce90a179299c95cee2
+#define P46ae6fbdb2749ce90a179299c95cee2
+
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace cu {
+
+/*!
+ * \brief A map that holds at most a fixed number of entries, dropping the
+ * least recently used one to make room for a new one.
+ *
+ * Both find() and insert() count as a use. Not thread-safe.
+ */
+template<typename K, typename V, typename Hash = std::hash<K>>
+class LRUCache {
+public:
+    /*!
+     * \brief (constructor)
+     *
+     * \param capacity The most entries to hold at once; must be at least 1.
+     */
+    explicit LRUCache(std::size_t capacity)
+        : cap {capacity}
+    {
+        if (cap == 0) {
+            throw std::runtime_error("LRUCache capacity must be at least 1");
+        }
+    }
+
+    /*!
+     * \brief The value for k, or nullptr if there isn't one. The pointer is
+     * good until the entry is erased or evicted.
+     */
+    V* find(const K& k)
+    {
+        auto search = index.find(k);
+        if (search == index.end()) {
+            return nullptr;
+        }
+
+        entries.splice(entries.begin(), entries, search->second);
+
+        return &search->second->second;
+    }
+
+    /*!
+     * \brief Set the value for k, evicting the least recently used entry if
+     * that puts this over capacity.
+     */
+    V& insert(const K& k, V v)
+    {
+        if (auto existing = find(k)) {
+            *existing = std::move(v);
+            return *existing;
+        }
+
+        entries.emplace_front(k, std::move(v));
+        index.emplace(k, entries.begin());
+
+        if (entries.size() > cap) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+
+        return entries.front().second;
+    }
+
+    bool erase(const K& k)
+    {
+        auto search = index.find(k);
+        if (search == index.end()) {
+            return false;
+        }
+
+        entries.erase(search->second);
+        index.erase(search);
+
+        return true;
+    }
+
+    void clear()
+    {
+        index.clear();
+        entries.clear();
+    }
+
+    std::size_t size() const { return entries.size(); }
+    std::size_t capacity() const { return cap; }
+
+private:
+    using entry_t = std::pair<K, V>;
+
+    // most recently used at the front
+    std::list<entry_t> entries;
+    std::unordered_map<K, typename std::list<entry_t>::iterator, Hash> index;
+    std::size_t cap;
+};
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef J9c4c89a106e41e48995c9eab5e97d9e
+#define J9c4c89a106e41e48995c9eab5e97d9e
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace cu {
+
+/*!
+ * \brief Named counters and timings gathered while the engine runs.
+ *
+ * Anything can add to it through the global `metrics` object; it's meant for
+ * numbers that are more useful summed up than read line-by-line in the log,
+ * like how long each pipeline took to create or how often the pipeline cache
+ * was hit. Every series keeps its count, sum, minimum, maximum and most recent
+ * value. report() formats the lot as a table (see the --metrics option).
+ *
+ * Recording is thread-safe.
+ */
+class Metrics {
+public:
+    /*!
+     * \brief The running summary of one named series.
+     */
+    struct Series {
+        uint64_t count = 0;
+        double   sum   = 0;
+        double   min   = 0;
+        double   max   = 0;
+        double   last  = 0;
+
+        double mean() const { return count ? sum / count : 0; }
+    };
+
+    /*!
+     * \brief Add a sample to the series called name.
+     */
+    void record(const std::string& name, double value) noexcept;
+
+    /*!
+     * \brief Add a duration to the series called name, in milliseconds.
+     */
+    void record(const std::string& name,
+                std::chrono::steady_clock::duration d) noexcept
+    {
+        record(name,
+               std::chrono::duration<double, std::milli>(d).count());
+    }
+
+    /*!
+     * \brief Bump the counter called name by n.
+     */
+    void count(const std::string& name, uint64_t n = 1) noexcept
+    {
+        record(name, static_cast<double>(n));
+    }
+
+    /*!
+     * \brief A copy of every series, ordered by name.
+     */
+    std::map<std::string, Series> snapshot() const;
+
+    /*!
+     * \brief The series called name (all zeroes if there's nothing in it).
+     */
+    Series get(const std::string& name) const;
+
+    /*!
+     * \brief A table of every series.
+     */
+    std::string report() const;
+
+    /*!
+     * \brief Throw everything away.
+     */
+    void clear() noexcept;
+
+private:
+    mutable std::mutex mtx;
+    std::map<std::string, Series> series;
+};
+
+// global metrics
+extern Metrics metrics;
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef jd87f096ebd749c6b06ecda078205653
+#define jd87f096ebd749c6b06ecda078205653
+
+#include "device.hpp"
+#include "image.hpp"
+#include "image_view.hpp"
+#include "pixels.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief A set of images to render into in place of a Swapchain, for running
+ * without a window (see Vulkan's headless constructor).
+ *
+ * The images are RGBA8 (UNORM) and can be used as storage images and copied
+ * from. They're handed out in turn by next(), like swapchain images are
+ * acquired, so each can have its own command buffer and descriptor set.
+ */
+class Offscreen {
+public:
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev  The Device in use.
+     * \param extent The size of each image.
+     * \param count  The number of images.
+     */
+    Offscreen(Device::ptr l_dev, VkExtent2D extent, uint32_t count = 2);
+
+    Offscreen(const Offscreen&) = delete;
+    Offscreen& operator=(const Offscreen&) = delete;
+
+    /*!
+     * \brief Move on to the next image and return its index.
+     */
+    uint32_t next();
+
+    /*!
+     * \brief The index of the image last returned by next().
+     */
+    uint32_t ndx() const { return current_ndx; }
+
+    Image&     img(uint32_t ndx) { return imgs.at(ndx); }
+    ImageView& view(uint32_t ndx) { return views.at(ndx); }
+
+    uint32_t img_count() const { return static_cast<uint32_t>(imgs.size()); }
+
+    VkFormat format() const { return VK_FORMAT_R8G8B8A8_UNORM; }
+
+    uint32_t width() const { return extent.width; }
+    uint32_t height() const { return extent.height; }
+
+private:
+    VkExtent2D extent;
+    std::vector<Image> imgs;
+    std::vector<ImageView> views;
+    uint32_t current_ndx;
+};
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef o0066840806c4090b49727f09da585d7
+#define o0066840806c4090b49727f09da585d7
+
+#include "device.hpp"
+#include "command_pool.hpp"
+#include "command_buffer.hpp"
+#include "log.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief Records secondary command buffers on a set of worker threads.
+ *
+ * Each worker has its own CommandPool (command pools can only be used from one
+ * thread at a time), and the secondaries it records come from that pool. Work
+ * is handed out round-robin by position, so a given batch of jobs is always
+ * split across the workers the same way, and record() hands the secondaries
+ * back in the same order as the jobs, ready to be passed to
+ * CommandBuffer::execute():
+ *
+ * ```
+ * auto secs = recorder.record({
+ *     [&](CommandBuffer& b) { b.bind(blur, {blur_set}).dispatch(64, 64); },
+ *     [&](CommandBuffer& b) { b.bind(tone, {tone_set}).dispatch(64, 64); },
+ * });
+ *
+ * primary.record().execute(secs).end();
+ * ```
+ *
+ * The secondaries stay valid until the next call to record(), which resets
+ * the workers' pools; so don't call it again while a primary that executes
+ * the previous batch is still pending.
+ */
+class ParallelRecorder {
+public:
+    /*!
+     * \brief A job adds commands to a secondary that's already been begun;
+     * the recorder ends it afterwards.
+     */
+    using job_t = std::function<void(CommandBuffer&)>;
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev      The current Device.
+     * \param q_flav     The flavor of queue the primaries executing the
+     *                   secondaries will be submitted to.
+     * \param thread_cnt The number of worker threads to start. 0 means one per
+     *                   hardware thread.
+     */
+    ParallelRecorder(Device::ptr l_dev,
+                     Device::QueueFlavor q_flav,
+                     unsigned thread_cnt = 0);
+
+    ParallelRecorder(const ParallelRecorder&) = delete;
+    ParallelRecorder& operator=(const ParallelRecorder&) = delete;
+
+    ParallelRecorder(ParallelRecorder&&) = delete;
+    ParallelRecorder& operator=(ParallelRecorder&&) = delete;
+
+    ~ParallelRecorder() noexcept;
+
+    /*!
+     * \brief Record each job into its own secondary command buffer, spread
+     * across the worker threads, and wait for them all to finish. If a job
+     * throws, the first exception is rethrown here once the rest are done.
+     *
+     * \param jobs  The jobs to record.
+     * \param flags The usage flags to begin each secondary with.
+     *
+     * \return The secondaries, in the same order as jobs.
+     */
+    std::vector<CommandBuffer*>
+    record(const std::vector<job_t>& jobs,
+           vk::CommandBufferUsageFlags flags =
+               flgs(vk::CommandBufferUsageFlag::one_time_submit));
+
+    /*!
+     * \brief The number of worker threads.
+     */
+    unsigned thread_count() const { return workers.size(); }
+
+private:
+    struct Worker {
+        CommandPool::ptr pool;
+        std::vector<CommandBuffer*> buffs;
+    };
+
+    Device::ptr dev;
+    std::vector<Worker> workers;
+
+private:
+    std::mutex mtx;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    uint64_t batch = 0;
+    unsigned pending = 0;
+    bool stopping = false;
+
+    const std::vector<job_t>* jobs = nullptr;
+    std::vector<CommandBuffer*>* out = nullptr;
+    vk::CommandBufferUsageFlags usage = 0;
+    std::exception_ptr err;
+
+private:
+    // declared last so the threads are joined before anything they use is
+    // destroyed
+    std::deque<GuardedThread> thrds;
+
+    void work(unsigned ndx);
+};
+
+} // namespace cu
+
+#endif
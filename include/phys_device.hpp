@@ -28,6 +28,7 @@
 
 #include <vulkan/vulkan.h>
 
+#include <array>
 #include <string>
 #include <vector>
 
@@ -131,12 +132,24 @@ struct PhysDevice {
      */
     uint32_t vk_vend_dev_id;
 
+    /*!
+     * \brief Identifies the format of the data in a VkPipelineCache; data
+     * written under a different UUID can't be reused.
+     */
+    std::array<uint8_t, VK_UUID_SIZE> pipeline_cache_uuid;
+
     /*!
      * \brief The maximum difference the physical device supports between the
      * current value of a timeline semaphore and the next value.
      */
     uint64_t max_timel_sem_val_diff;
 
+    /*!
+     * \brief The number of nanoseconds it takes for a timestamp query's value
+     * to go up by one.
+     */
+    float timestamp_period;
+
     /*!
      * \brief The amount of video memory available to the device
      * in bytes.
@@ -158,6 +171,11 @@ struct PhysDevice {
      */
     std::vector<std::string> extensions;
 
+    /*!
+     * \brief Whether ext is among the extensions supported by the device.
+     */
+    bool supports(const std::string& ext) const;
+
     /*!
      * \brief The queue families available on the device.
      */
@@ -204,6 +222,24 @@ struct PhysDevice {
      */
     PhysicalHeap largest_dev_local_heap() const;
 
+    /*!
+     * \brief A host-visible, host-coherent memory type. If there's more than
+     * one, prefers one that is also device-local, since those are usually the
+     * fastest for the device to read from. Throws if there are none (which
+     * shouldn't happen on a conforming implementation).
+     */
+    MemoryType host_visible_type() const;
+
+    /*!
+     * \brief A memory type for the device to write results to and the host to
+     * read them from: host-visible and, if there's one like that,
+     * host-cached, since reading uncached memory from the host is slow. Among
+     * those it prefers types that are also host-coherent, then ones that
+     * aren't device-local (i.e. that are in system memory). Falls back on
+     * host_visible_type().
+     */
+    MemoryType readback_type() const;
+
     /*!
      * \brief Whether this physical device supports graphics operations. (Note
      * that this also implies support for compute operations per the Vulkan
@@ -238,6 +274,28 @@ public:
     VkPhysicalDeviceFeatures2 features = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
     };
+
+    // These two are only queried (and so only ever nonzero) if the device
+    // supports VK_KHR_present_id and VK_KHR_present_wait respectively.
+
+public:
+    VkPhysicalDevicePresentIdFeaturesKHR present_id = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+    };
+
+public:
+    VkPhysicalDevicePresentWaitFeaturesKHR present_wait = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+    };
+
+    // Likewise only queried if the device supports
+    // VK_EXT_swapchain_maintenance1.
+
+public:
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swch_maint1 = {
+        .sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT,
+    };
 };
 
 } // namespace cu
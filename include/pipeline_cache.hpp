@@ -0,0 +1,139 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef e207f8abd37b4fb28ddcd6a1e66b796f
+#define e207f8abd37b4fb28ddcd6a1e66b796f
+
+#include "phys_device.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace cu {
+
+class Device;
+
+/*!
+ * \brief A device-wide VkPipelineCache that persists between runs.
+ *
+ * On construction the cache is seeded from a file on disk, if there is one and
+ * it was written for the same vendor, device, driver version and pipeline cache
+ * UUID; otherwise it starts out empty. save() writes it back out, first to a
+ * temporary file which is then renamed over the old one, so a crash partway
+ * through never leaves a truncated cache behind.
+ *
+ * The file lives at default_path() unless another is given. Set
+ * `XDG_CACHE_HOME` to somewhere empty to get a cold start.
+ *
+ * Like Heap, this doesn't follow RAII: the Device calls construct() and
+ * free_self() for its own cache, and saves it on the way out.
+ */
+class PipelineCache {
+public:
+    /*!
+     * \brief Where the cache is kept by default:
+     * `$XDG_CACHE_HOME/crypt_underworld/pipeline_cache.bin`, falling back on
+     * `~/.cache` if `XDG_CACHE_HOME` is unset. Empty if neither that nor
+     * `HOME` is set, in which case nothing is loaded or saved.
+     */
+    static std::filesystem::path default_path();
+
+    /*!
+     * \brief How often maybe_save() actually saves.
+     */
+    static constexpr std::chrono::seconds save_interval {30};
+
+    void construct(Device& dev,
+                   const PhysDevice& ph_dev,
+                   std::filesystem::path file_path = default_path());
+
+    VkPipelineCache inner() { return nner; }
+
+    /*!
+     * \brief How many bytes of cache data construct() seeded the cache with;
+     * zero if there was no file, or it was thrown out.
+     */
+    std::size_t loaded_size() const { return loaded_sz; }
+
+    /*!
+     * \brief Write the cache out, unless it hasn't changed since it was loaded
+     * or last saved. Failing to save is logged rather than thrown; a missing
+     * cache only costs startup time.
+     */
+    void save(Device& dev) noexcept;
+
+    /*!
+     * \brief save(), if at least save_interval has passed since the last
+     * time. Cheap enough to call every frame.
+     */
+    void maybe_save(Device& dev) noexcept;
+
+    /*!
+     * \brief Saves, then destroys the underlying VkPipelineCache.
+     */
+    void free_self(Device& dev) noexcept;
+
+    /*!
+     * \brief The layout of the header in front of the cache data on disk.
+     * Vulkan puts a header on the data as well, but it's implementation-defined
+     * how much of it a driver checks; this lets us throw out a stale cache
+     * before the driver ever sees it.
+     */
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendor_id;
+        uint32_t device_id;
+        uint32_t driver_version;
+        uint8_t  uuid[VK_UUID_SIZE];
+        uint64_t data_size;
+        uint64_t data_hash;
+    };
+
+    static constexpr uint32_t file_magic   = 0x43504355; // "UCPC"
+    static constexpr uint32_t file_version = 1;
+
+private:
+    VkPipelineCache nner = VK_NULL_HANDLE;
+    std::filesystem::path path;
+    FileHeader expected_hdr = {};
+    uint64_t saved_hash = 0;
+    std::size_t loaded_sz = 0;
+    std::chrono::steady_clock::time_point last_save;
+    std::mutex save_mtx;
+
+private:
+    PFN_vkCreatePipelineCache  create_cache;
+    PFN_vkDestroyPipelineCache destroy_cache;
+    PFN_vkGetPipelineCacheData get_cache_data;
+
+private:
+    std::vector<char> load() const;
+};
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,163 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef q2de36eb66014835a9957e69dbef3ca4
+#define q2de36eb66014835a9957e69dbef3ca4
+
+#include "device.hpp"
+#include "bin_data.hpp"
+#include "shader_module.hpp"
+#include "pipeline_layout.hpp"
+#include "compute_pipeline.hpp"
+#include "sc_range.hpp"
+#include "log.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace cu {
+
+/*!
+ * \brief Builds shader modules and pipelines on a pool of worker threads.
+ *
+ * Each request is queued and handed back as a std::shared_future straight
+ * away, so the caller can go on with something else (or carry on rendering
+ * with the old pipeline) while it compiles. Requests are picked up in the
+ * order they're made, so independent ones run in parallel and a pipeline can
+ * be requested with the future of the shader it uses before that shader is
+ * ready:
+ *
+ * ```
+ * auto shdr  = compiler.shader("blur", BinData::read_file("blur.spv"));
+ * auto pipel = compiler.compute(shdr, {.layout = blur_layt});
+ *
+ * // ...later, e.g. once a frame
+ * if (PipelineCompiler::ready(pipel)) {
+ *     use(pipel.get());
+ * }
+ * ```
+ *
+ * If a build throws, the exception comes out of the future's get(). Requests
+ * still queued when the compiler is destroyed are dropped, and their futures
+ * throw std::future_error (broken_promise).
+ */
+class PipelineCompiler {
+public:
+    template<typename T>
+    using handle_t = std::shared_future<T>;
+
+    /*!
+     * \brief Everything needed to build a ComputePipeline apart from the
+     * shader; see ComputePipeline::ComputePipeline().
+     */
+    struct ComputeDesc {
+        PipelineLayout::ptr                      layout;
+        std::shared_ptr<SCRange>                 spec;
+        std::optional<ComputePipeline::LocalSize> local_sz;
+        vk::PipelineCreateFlags                  flags = 0;
+    };
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev      The current Device.
+     * \param thread_cnt The number of worker threads. 0 means one fewer than
+     *                   there are hardware threads (but at least one), leaving
+     *                   one for the main loop.
+     */
+    PipelineCompiler(Device::ptr l_dev, unsigned thread_cnt = 0);
+
+    PipelineCompiler(const PipelineCompiler&) = delete;
+    PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+    /*!
+     * \brief Waits for the builds in progress, drops the rest and joins the
+     * workers.
+     */
+    ~PipelineCompiler() noexcept;
+
+    /*!
+     * \brief Build a ShaderModule.
+     */
+    handle_t<ShaderModule::ptr> shader(std::string name, BinData bin);
+
+    /*!
+     * \brief Build a ComputePipeline once shdr is ready.
+     */
+    handle_t<ComputePipeline::ptr> compute(handle_t<ShaderModule::ptr> shdr,
+                                           ComputeDesc desc);
+
+    /*!
+     * \brief Build a ComputePipeline from a shader that's already built.
+     */
+    handle_t<ComputePipeline::ptr> compute(ShaderModule::ptr shdr,
+                                           ComputeDesc desc);
+
+    /*!
+     * \brief Whether h can be get() without blocking.
+     */
+    template<typename T>
+    static bool ready(const handle_t<T>& h)
+    {
+        return h.valid()
+               && h.wait_for(std::chrono::seconds {0})
+                  == std::future_status::ready;
+    }
+
+    /*!
+     * \brief The number of requests not yet finished.
+     */
+    std::size_t pending() const;
+
+    unsigned thread_count() const { return thrds.size(); }
+
+private:
+    Device::ptr dev;
+
+private:
+    mutable std::mutex mtx;
+    std::condition_variable work_cv;
+    std::deque<std::packaged_task<void()>> queue;
+    std::size_t in_flight = 0;
+    bool stopping = false;
+
+    template<typename T>
+    handle_t<T> enqueue(std::function<T()> job);
+
+private:
+    // declared last so the threads are joined before anything they use is
+    // destroyed
+    std::deque<GuardedThread> thrds;
+
+    void work();
+};
+
+} // namespace cu
+
+#endif
@@ -26,6 +26,7 @@
 #include "descriptor_set_layout.hpp"
 #include "deviced.hpp"
 #include "pc_range.hpp"
+#include "spirv_reflection.hpp"
 
 #include <vector>
 #include <algorithm>
@@ -45,17 +46,44 @@ public:
     PipelineLayout(Device::ptr l_dev,
                    std::vector<DescriptorSetLayout::ptr> dscrpt_set_layouts);
 
+    /*!
+     * \brief (constructor) Builds the layout a shader asks for: one
+     * DescriptorSetLayout per set it uses (empty ones for any it skips) and
+     * a push constant range covering its push constant block, if it has one.
+     *
+     * \param l_dev       The current Device.
+     * \param refl        The shader's reflection data.
+     * \param name_prefix The set layouts are named "<name_prefix> set <n>",
+     *                    which is also what DescriptorPool knows them by.
+     */
+    PipelineLayout(Device::ptr l_dev,
+                   const SpirvReflection& refl,
+                   std::string name_prefix);
+
     ~PipelineLayout() noexcept { dstrct(); }
 
     void log_attrs(unsigned indent = 1) const;
 
+    const std::vector<DescriptorSetLayout::ptr>& set_layouts() const
+    {
+        return dscr_layts;
+    }
+
+    /*!
+     * \brief A hash of what the layout is made of (the bindings in each set
+     * and the push constant ranges, but not the names). Layouts built from
+     * the same description hash the same.
+     */
+    uint64_t hash() const { return hsh; }
+
 private:
     std::vector<DescriptorSetLayout::ptr> dscr_layts;
+    uint64_t hsh;
 
 private:
     PipelineLayout(Device::ptr l_dev,
-                   std::vector<VkDescriptorSetLayout> layts,
-                   std::vector<const VkPushConstantRange*> pcrs);
+                   std::vector<DescriptorSetLayout::ptr> dscrpt_set_layouts,
+                   std::vector<VkPushConstantRange> pcrs);
 };
 
 } // namespace cu
@@ -0,0 +1,131 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Pb55fc79ff72437ea92fbad8376b4725
+#define Pb55fc79ff72437ea92fbad8376b4725
+
+#include "pipeline_compiler.hpp"
+#include "lru_cache.hpp"
+#include "bin_data.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace cu {
+
+/*!
+ * \brief Hands out shader modules and pipelines by what they're built from,
+ * so the same thing is only ever built once.
+ *
+ * Shader modules are looked up by a hash of their SPIR-V and then compared
+ * byte for byte, so identical bytecode loaded under two names shares a module
+ * (which keeps the name it was first built under), and two shaders whose
+ * hashes happen to collide never do. Compute pipelines are keyed by which
+ * module they use (see Shader::id), the hash of their layout (see
+ * PipelineLayout::hash()), their specialization constants and their flags, so
+ * asking again for one that's already been built is just a lookup. Anything
+ * not already here is built on the PipelineCompiler given.
+ *
+ * Each kind is capped at a fixed number of entries; past that the least
+ * recently requested is dropped. Dropping an entry only drops the registry's
+ * reference, so anything still in use stays alive.
+ *
+ * Safe to use from several threads at once.
+ */
+class PipelineRegistry {
+public:
+    /*!
+     * \brief A shader module and what it was built from.
+     */
+    struct Shader {
+        uint64_t hash = 0;
+
+        /*!
+         * \brief Different for every module the registry builds, unlike
+         * hash.
+         */
+        uint64_t id = 0;
+
+        std::shared_ptr<const BinData> bin;
+        PipelineCompiler::handle_t<ShaderModule::ptr> module;
+
+        /*!
+         * \brief Whether o was built from the same SPIR-V.
+         */
+        bool same_code(const Shader& o) const
+        {
+            return bin == o.bin
+                   || (bin && o.bin && bin->dta == o.bin->dta);
+        }
+    };
+
+    static constexpr std::size_t default_capacity = 64;
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param compiler      Where to build anything not already here. Must
+     *                      outlive the registry.
+     * \param shader_cap    The most shader modules to hold on to.
+     * \param pipeline_cap  The most pipelines to hold on to.
+     */
+    PipelineRegistry(PipelineCompiler& compiler,
+                     std::size_t shader_cap   = default_capacity,
+                     std::size_t pipeline_cap = default_capacity);
+
+    PipelineRegistry(const PipelineRegistry&) = delete;
+    PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+    /*!
+     * \brief The shader module for bin, built if need be.
+     */
+    Shader shader(std::string name, BinData bin);
+
+    /*!
+     * \brief The compute pipeline for shdr and desc, built if need be.
+     * desc.layout is required.
+     */
+    PipelineCompiler::handle_t<ComputePipeline::ptr>
+    compute(const Shader& shdr, PipelineCompiler::ComputeDesc desc);
+
+    std::size_t shader_count() const;
+    std::size_t pipeline_count() const;
+
+    /*!
+     * \brief Drop everything held.
+     */
+    void clear();
+
+private:
+    PipelineCompiler& cmplr;
+
+    mutable std::mutex mtx;
+    uint64_t next_id = 1;
+    LRUCache<uint64_t, Shader> shdrs;
+    LRUCache<std::string, PipelineCompiler::handle_t<ComputePipeline::ptr>>
+        pipels;
+};
+
+} // namespace cu
+
+#endif
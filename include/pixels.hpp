@@ -0,0 +1,106 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef G9b5c7dc0b7d407ebcfa69876bd1034e
+#define G9b5c7dc0b7d407ebcfa69876bd1034e
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief Pixels copied back from the GPU, tightly packed, four bytes each.
+ */
+struct Pixels {
+    uint32_t width;
+    uint32_t height;
+    std::vector<uint8_t> rgba;
+};
+
+/*!
+ * \brief Pixels laid out like Pixels, but in memory that belongs to something
+ * else, e.g. a mapped staging buffer. They're only good for as long as keep
+ * is held; once every copy of it is let go, the memory is given back.
+ */
+struct PixelView {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    const uint8_t* rgba = nullptr;
+    std::shared_ptr<const void> keep;
+
+    /*!
+     * \brief A view of px, which it takes and holds on to.
+     */
+    static PixelView of(Pixels px);
+
+    /*!
+     * \brief A copy of the pixels that doesn't depend on keep.
+     */
+    Pixels copy() const;
+};
+
+/*!
+ * \brief Write px to path as a binary PPM, which is simple enough to need no
+ * library and which most image viewers and converters understand. Alpha is
+ * dropped. Throws if the file can't be written.
+ */
+void write_ppm(const std::filesystem::path& path, const Pixels& px);
+
+/*!
+ * \brief Read a binary PPM written by write_ppm() (or anything else with 8
+ * bits a channel), with alpha filled in as opaque. Throws if it can't be read
+ * or isn't one of those.
+ */
+Pixels read_ppm(const std::filesystem::path& path);
+
+/*!
+ * \brief How two images of the same size differ, going by their color
+ * channels (alpha is ignored).
+ */
+struct PixelDiff {
+    /*!
+     * \brief The pixels with a channel that differs by more than the
+     * tolerance compare() was given.
+     */
+    uint64_t over = 0;
+
+    /*!
+     * \brief The largest difference in any channel.
+     */
+    uint8_t max = 0;
+
+    /*!
+     * \brief The mean difference over every color channel.
+     */
+    double mean = 0;
+};
+
+/*!
+ * \brief Compare a with b. Throws if they aren't the same size.
+ */
+PixelDiff compare(const Pixels& a, const Pixels& b, uint8_t tolerance);
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Nd081ecd769544b2bd1d663ca9a97a93
+#define Nd081ecd769544b2bd1d663ca9a97a93
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace cu {
+
+/*!
+ * \brief How the swapchain should present. Anything left unset is chosen by
+ * Swapchain (see Swapchain::Swapchain()).
+ */
+struct PresentConfig {
+    /*!
+     * \brief The present mode to ask for. If the surface doesn't support it,
+     * FIFO (which every surface does) is used instead.
+     */
+    std::optional<VkPresentModeKHR> mode;
+
+    /*!
+     * \brief The number of images to ask for. Clamped to what the surface
+     * allows.
+     */
+    std::optional<uint32_t> img_count;
+
+    /*!
+     * \brief Whether the images should be usable as a transfer source, so
+     * frames can be copied out of them (e.g. to capture them), if the surface
+     * allows it.
+     */
+    bool readable = false;
+
+    /*!
+     * \brief The present mode called name on the command line ("immediate",
+     * "mailbox", "fifo" or "fifo-relaxed"), if it's one of those.
+     */
+    static std::optional<VkPresentModeKHR>
+    mode_from_str(const std::string& name)
+    {
+        if (name == "immediate") {
+            return VK_PRESENT_MODE_IMMEDIATE_KHR;
+        } else if (name == "mailbox") {
+            return VK_PRESENT_MODE_MAILBOX_KHR;
+        } else if (name == "fifo") {
+            return VK_PRESENT_MODE_FIFO_KHR;
+        } else if (name == "fifo-relaxed") {
+            return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    /*!
+     * \brief The inverse of mode_from_str() ("other" for any other mode).
+     */
+    static std::string mode_name(VkPresentModeKHR mode)
+    {
+        switch (mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "mailbox";
+        case VK_PRESENT_MODE_FIFO_KHR:
+            return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "fifo-relaxed";
+        default:
+            return "other";
+        }
+    }
+};
+
+} // namespace cu
+
+#endif
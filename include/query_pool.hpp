@@ -0,0 +1,101 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Qf97a7ddbd634fd0b0d7c2f93aaad837
+#define Qf97a7ddbd634fd0b0d7c2f93aaad837
+
+#include "deviced.hpp"
+#include "vulkan_util.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief A Vulkan
+ * <a href="https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkQueryPool.html">query pool</a>
+ * wrapper.
+ *
+ * Queries are reset and written from command buffers (see
+ * CommandBuffer::profile() and GpuProfiler); this class just owns the pool and
+ * reads the results back.
+ */
+class QueryPool : public Deviced<PFN_vkCreateQueryPool,
+                                 PFN_vkDestroyQueryPool,
+                                 VkQueryPool> {
+public:
+    /*!
+     * \brief A pointer to the QueryPool.
+     */
+    using ptr = std::shared_ptr<QueryPool>;
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev The current Device.
+     * \param type  The type of query in the pool.
+     * \param count The number of queries in the pool.
+     * \param stats For pipeline statistics queries, which statistics to
+     *              gather; ignored otherwise.
+     */
+    QueryPool(Device::ptr l_dev,
+              vk::QueryType type,
+              uint32_t count,
+              vk::QueryPipelineStatisticFlags stats = 0);
+
+    QueryPool(QueryPool&&) = delete;
+    QueryPool& operator=(QueryPool&&) = delete;
+
+    QueryPool(const QueryPool&) = delete;
+    QueryPool& operator=(const QueryPool&) = delete;
+
+    ~QueryPool() noexcept { Deviced::dstrct(); }
+
+    vk::QueryType type() const { return typ; }
+
+    uint32_t size() const { return cnt; }
+
+    /*!
+     * \brief The number of 64-bit values each query produces: one, except
+     * for pipeline statistics queries, which produce one per statistic.
+     */
+    uint32_t values_per_query() const { return vals_per; }
+
+    /*!
+     * \brief Read back the results of queries first through first + count - 1
+     * into out, without waiting. Returns false (leaving out in an unspecified
+     * state) if any of them aren't available yet.
+     */
+    bool results(uint32_t first, uint32_t count, std::vector<uint64_t>& out);
+
+private:
+    vk::QueryType typ;
+    uint32_t cnt;
+    uint32_t vals_per;
+
+private:
+    PFN_vkGetQueryPoolResults get_results;
+};
+
+} // namespace cu
+
+#endif
@@ -127,6 +127,12 @@ public:
      */
     uint32_t index()             const { return ndx; }
 
+    /*!
+     * \brief The number of meaningful bits in timestamps written by queues in
+     * this family; 0 if they don't support timestamps.
+     */
+    uint32_t timestamp_bits()    const { return ts_bits; }
+
     /*!
      * \brief Write a description of the queue family to the log.
      */
@@ -136,6 +142,7 @@ private:
     VkQueueFlags flags;
     uint32_t     queue_cnt;
     uint32_t     ndx;
+    uint32_t     ts_bits;
     bool         pres_support = false;
 
     PFN_vkGetPhysicalDeviceSurfaceSupportKHR get_surf_support;
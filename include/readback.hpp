@@ -0,0 +1,161 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Vf254887bbf048cfa2ce7b236b73bd2b
+#define Vf254887bbf048cfa2ce7b236b73bd2b
+
+#include "device.hpp"
+#include "image.hpp"
+#include "buffer.hpp"
+#include "command_pool.hpp"
+#include "command_buffer.hpp"
+#include "fence.hpp"
+#include "pixels.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief Copies images back to the host without stalling the frame.
+ *
+ * request() records a copy of the image into a staging buffer in readback
+ * memory (host-cached where the device has it; see Heap::Location) and
+ * submits it straight away, with a fence of its own. poll(), which is meant
+ * to be called once a frame, hands every copy that has finished since to its
+ * callback, on the calling thread; usually that's a frame or two later.
+ * Nothing here waits on the device except flush(), and that only on the
+ * copies' own fences, never vkDeviceWaitIdle().
+ *
+ * There's a fixed number of slots, each with its own staging buffer, so one
+ * copy can be in flight while the last one is being read. If they're all busy
+ * when a copy is asked for, it's dropped rather than waited for, and counted
+ * in cu::metrics as readback.dropped.
+ *
+ * request_view() hands over a PixelView of the staging buffer itself rather
+ * than a copy, and its slot stays busy until the view is let go, which may
+ * be on any thread. That way the pixels can be read somewhere else (e.g. by
+ * Capture's threads) without the calling thread ever touching them.
+ *
+ * The image has to have four bytes a texel (e.g. RGBA8 or BGRA8) and have
+ * been written in an earlier submission to the same queue. By default it's
+ * expected to be in the transfer source layout, written by a compute shader;
+ * the copy waits for that, and later compute work on the queue waits for the
+ * copy, so the image can't be overwritten while it's being read. An image in
+ * any other layout (e.g. a swapchain image waiting to be presented) is moved
+ * to the transfer source layout for the copy and back again afterward.
+ */
+class Readback {
+public:
+    using callback_t = std::function<void(Pixels)>;
+    using view_callback_t = std::function<void(PixelView)>;
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param l_dev  The Device in use.
+     * \param slots  How many copies can be in flight at once.
+     * \param q_flav The flavor of queue the images are written on.
+     */
+    Readback(Device::ptr l_dev,
+             uint32_t slots = 2,
+             Device::QueueFlavor q_flav = Device::compute_queue);
+
+    Readback(const Readback&) = delete;
+    Readback& operator=(const Readback&) = delete;
+
+    /*!
+     * \brief Waits for any copies still in flight, without handing them over.
+     */
+    ~Readback() noexcept;
+
+    /*!
+     * \brief Start copying img back; done is called with its pixels by a
+     * later poll(). Returns false, and never calls done, if every slot is
+     * busy.
+     */
+    bool request(Image& img, callback_t done);
+
+    /*!
+     * \brief Like request(), but done is given a view of the staging buffer,
+     * and the slot isn't free again until every copy of the view's keep has
+     * been let go.
+     */
+    bool request_view(Image& img,
+                      view_callback_t done,
+                      vk::ImageLayout layout =
+                          vk::ImageLayout::trnsfr_src_optml);
+
+    /*!
+     * \brief Whether a slot is free, i.e. whether a request made now would
+     * be started rather than dropped.
+     */
+    bool ready() const;
+
+    /*!
+     * \brief Hand every finished copy to its callback, oldest first. Doesn't
+     * block. Returns how many were handed over.
+     */
+    std::size_t poll();
+
+    /*!
+     * \brief Wait for every copy in flight and hand them over.
+     */
+    void flush();
+
+    /*!
+     * \brief The number of copies that haven't been handed over yet.
+     */
+    uint32_t in_flight() const;
+
+private:
+    struct slot {
+        Buffer::ptr staging;
+        CommandBuffer* cmdb;
+        std::unique_ptr<Fence> fnce;
+        view_callback_t done;
+        VkExtent3D extent;
+        uint64_t seq = 0;
+        bool busy = false;
+        // set while a view of staging is out; shared with the view, which
+        // clears it when it's let go, whichever thread that's on
+        std::shared_ptr<std::atomic<bool>> viewed;
+    };
+
+    Device::ptr dev;
+    Device::QueueFlavor flav;
+    CommandPool::ptr pool;
+    std::vector<std::unique_ptr<CommandBuffer>> cmdbs;
+    std::vector<slot> slots;
+    uint64_t next_seq = 0;
+
+    // the oldest busy slot, if wait, once its copy has finished
+    slot* oldest_done(bool wait);
+    void hand_over(slot& s);
+};
+
+} // namespace cu
+
+#endif
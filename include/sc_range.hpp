@@ -0,0 +1,89 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef L64d3398e3094a54be635edb19a79c3f
+#define L64d3398e3094a54be635edb19a79c3f
+
+#include "vulkan_util.hpp"
+
+#include <cstring>
+#include <optional>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief The type-erased side of SpecConstants: a block of values and the map
+ * saying which specialization constant each one sets.
+ */
+class SCRange {
+public:
+    const std::vector<VkSpecializationMapEntry>& entries() const
+    {
+        return entrs;
+    }
+
+    /*!
+     * \brief The VkSpecializationInfo for these constants. Only valid while
+     * this object is alive and unchanged.
+     */
+    VkSpecializationInfo info()
+    {
+        return {
+            .mapEntryCount = static_cast<uint32_t>(entrs.size()),
+            .pMapEntries   = entrs.empty() ? NULL : entrs.data(),
+            .dataSize      = size(),
+            .pData         = values_voidp(),
+        };
+    }
+
+    /*!
+     * \brief The value given for the 32-bit constant with the given ID, if
+     * there is one.
+     */
+    std::optional<uint32_t> u32(uint32_t id)
+    {
+        for (const auto& e : entrs) {
+            if (e.constantID == id && e.size == sizeof(uint32_t)) {
+                uint32_t out;
+                std::memcpy(&out,
+                            static_cast<const char*>(values_voidp())
+                                + e.offset,
+                            sizeof(out));
+                return out;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    virtual const void* values_voidp() = 0;
+    virtual std::size_t size() const = 0;
+
+    virtual ~SCRange() = default;
+
+protected:
+    std::vector<VkSpecializationMapEntry> entrs;
+};
+
+} // namespace cu
+
+#endif
@@ -24,6 +24,8 @@
 
 #include "instance.hpp"
 
+#include <chrono>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -86,8 +88,12 @@ public:
     /*!
      * \brief (constructor) Initializes SDL, including the
      * spawning of a platform window.
+     *
+     * \param win_size The size to open the window at, in screen
+     * coordinates. If not given, the window is a square most of the
+     * height of the display.
      */
-    SDL();
+    SDL(std::optional<WinSize> win_size = std::nullopt);
 
     SDL(SDL&&) = delete;
     SDL(const SDL&) = delete;
@@ -131,10 +137,32 @@ public:
      */
     bool quit() const;
 
+    /*!
+     * \brief Whether the window has changed size since the last call (as of
+     * the last poll()).
+     */
+    bool resized();
+
+    /*!
+     * \brief Whether F12 has been pressed since the last call (as of the
+     * last poll()), asking for the trace to be written out.
+     */
+    bool trace_requested();
+
+    /*!
+     * \brief When the earliest input event (a key or mouse button press, or
+     * mouse motion) handled by poll() since the last call arrived, if there
+     * were any. Accurate to about a millisecond.
+     */
+    std::optional<std::chrono::steady_clock::time_point> input_time();
+
 private:
     SDL_Window* win;
 
     bool should_quit = false;
+    bool was_resized = false;
+    bool dump_trace = false;
+    std::optional<std::chrono::steady_clock::time_point> first_input;
 };
 
 } // namespace cu
@@ -26,6 +26,7 @@
 
 #include "bin_data.hpp"
 #include "deviced.hpp"
+#include "spirv_reflection.hpp"
 
 namespace cu {
 
@@ -70,11 +71,17 @@ public:
 
     constexpr std::string name() const { return nme; }
 
+    /*!
+     * \brief What the shader's bytecode says about its interface.
+     */
+    SpirvReflection::ptr reflection() const { return refl; }
+
 public:
     bool free_inner = false;
 
 private:
-    std::string nme;
+    std::string          nme;
+    SpirvReflection::ptr refl;
 };
 
 } // namespace cu
@@ -0,0 +1,106 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Kd3389b876b140549391a1cf3baa2bdb
+#define Kd3389b876b140549391a1cf3baa2bdb
+
+#include "log.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace cu {
+
+/*!
+ * \brief Calls back whenever one of a set of files is rewritten.
+ *
+ * Meant for picking up recompiled shaders without restarting. Each file's
+ * directory is watched rather than the file itself, so tools that write a new
+ * file and rename it over the old one (which most editors and compilers do)
+ * are noticed as well as ones that write in place. Events that arrive in quick
+ * succession are coalesced, so a file written in several pieces only triggers
+ * one callback.
+ *
+ * The callback runs on the watcher's own thread; if it needs to touch anything
+ * the main thread uses, it has to hand it over safely.
+ *
+ * Only implemented on Linux (via inotify). Elsewhere, watch() logs that it's
+ * unsupported and nothing ever happens.
+ */
+class ShaderWatcher {
+public:
+    using callback_t = std::function<void(const std::filesystem::path&)>;
+
+    /*!
+     * \brief Whether this platform can watch files at all.
+     */
+    static const bool supported;
+
+    /*!
+     * \brief How long a file has to go without changing before the callback
+     * fires.
+     */
+    static constexpr std::chrono::milliseconds settle_time {50};
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param on_change Called with the path of each file that changed, in the
+     *                  form it was given to watch().
+     */
+    ShaderWatcher(callback_t on_change);
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    /*!
+     * \brief Stops watching and joins the watcher thread.
+     */
+    ~ShaderWatcher() noexcept;
+
+    /*!
+     * \brief Start watching file. Watching the same file twice is harmless.
+     */
+    void watch(std::filesystem::path file);
+
+private:
+    callback_t cb;
+    int fd = -1;
+
+    std::mutex mtx;
+    std::unordered_map<int, std::filesystem::path> dirs;
+    // absolute path -> path as given to watch()
+    std::map<std::filesystem::path, std::filesystem::path> files;
+
+    std::atomic<bool> stopping = false;
+    GuardedThread thrd;
+
+private:
+    void run() noexcept;
+};
+
+} // namespace cu
+
+#endif
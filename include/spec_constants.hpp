@@ -0,0 +1,111 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef L4b551a20f094479a2339584cf36b0fe
+#define L4b551a20f094479a2339584cf36b0fe
+
+#include "sc_range.hpp"
+
+#include <vulkan/vulkan.h>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace cu {
+
+/*!
+ * \brief Values for a shader's specialization constants, baked into a pipeline
+ * when it's created.
+ *
+ * T is a plain struct holding the values; entry() says which constant each
+ * member sets. For instance, for a shader with
+ *
+ *     layout(local_size_x_id = 0, local_size_y_id = 1) in;
+ *     layout(constant_id = 2) const bool dither = false;
+ *
+ * you might write
+ *
+ *     struct Spec { uint32_t wg_x; uint32_t wg_y; VkBool32 dither; };
+ *     SpecConstants<Spec> sc {{8, 8, VK_TRUE}};
+ *     sc.entry(0, &Spec::wg_x)
+ *       .entry(1, &Spec::wg_y)
+ *       .entry(2, &Spec::dither);
+ *
+ * Note that booleans are VkBool32s on the host side.
+ */
+template<typename T>
+class SpecConstants : public SCRange {
+public:
+    SpecConstants(T vals = {});
+
+    /*!
+     * \brief Set the constant with ID id from member.
+     */
+    template<typename M>
+    SpecConstants& entry(uint32_t id, M T::* member);
+
+    T* values() { return &vs; }
+    const void* values_voidp() override { return values(); }
+    std::size_t size() const override { return sizeof(T); }
+
+private:
+    T vs;
+};
+
+template<typename T>
+SpecConstants<T>::SpecConstants(T vals)
+    : vs {vals}
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "SpecConstants values must be trivially copyable");
+}
+
+template<typename T>
+template<typename M>
+SpecConstants<T>& SpecConstants<T>::entry(uint32_t id, M T::* member)
+{
+    static_assert(std::is_scalar_v<M> && !std::is_same_v<M, bool>,
+                  "specialization constants must be scalars (use VkBool32 "
+                  "for booleans)");
+
+    for (const auto& e : entrs) {
+        if (e.constantID == id) {
+            throw std::runtime_error("specialization constant "
+                                     + std::to_string(id)
+                                     + " already has an entry");
+        }
+    }
+
+    const auto offs = reinterpret_cast<const char*>(&(vs.*member))
+                      - reinterpret_cast<const char*>(&vs);
+
+    entrs.push_back({
+        .constantID = id,
+        .offset     = static_cast<uint32_t>(offs),
+        .size       = sizeof(M),
+    });
+
+    return *this;
+}
+
+} // namespace cu
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef if37e7e254c0450e9410a4821982cbf1
+#define if37e7e254c0450e9410a4821982cbf1
+
+#include "bin_data.hpp"
+#include "vulkan_util.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief The interface of a SPIR-V module, read straight out of the bytecode.
+ *
+ * This walks the module's instruction stream once and picks out what the host
+ * side needs to line up with the shader: the descriptor bindings it declares
+ * (from OpVariable plus their DescriptorSet/Binding decorations), the size of
+ * its push constant block, its workgroup size (from OpExecutionMode,
+ * OpExecutionModeId or a WorkgroupSize built-in), and its specialization
+ * constants. PipelineLayout can be built directly from the result.
+ *
+ * Reflecting the same bytecode twice is cheap: reflect() keeps the results in
+ * a process-wide cache keyed by a hash of the module, holding the
+ * cache_capacity most recently used.
+ *
+ * Only the first entry point is considered, which is fine for the
+ * single-entry-point modules glslangValidator produces.
+ */
+class SpirvReflection {
+public:
+    using ptr = std::shared_ptr<const SpirvReflection>;
+
+    /*!
+     * \brief The number of invocations in each workgroup along each axis.
+     */
+    struct LocalSize {
+        uint32_t x = 1;
+        uint32_t y = 1;
+        uint32_t z = 1;
+
+        bool operator==(const LocalSize&) const = default;
+    };
+
+    /*!
+     * \brief A single descriptor binding.
+     */
+    struct Binding {
+        uint32_t           set;
+        uint32_t           binding;
+        vk::DescriptorType type;
+
+        /*!
+         * \brief The number of descriptors (more than one for arrays).
+         */
+        uint32_t           count;
+
+        /*!
+         * \brief The variable's name, if the module has debug names.
+         */
+        std::string        name;
+    };
+
+    /*!
+     * \brief The part of the push constant space the shader uses.
+     */
+    struct PushConstantBlock {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    /*!
+     * \brief A specialization constant and the size of its value in bytes
+     * (booleans are VkBool32s on the host side, so 4).
+     */
+    struct SpecConstant {
+        uint32_t    spec_id;
+        uint32_t    size;
+        std::string name;
+    };
+
+    /*!
+     * \brief (constructor) Reflect a module. Throws if the data isn't valid
+     * SPIR-V or uses something this class can't describe (e.g. a runtime-sized
+     * array of descriptors).
+     *
+     * \param words The module.
+     * \param sz    The size of the module in bytes.
+     */
+    SpirvReflection(const std::uint32_t* words, std::size_t sz);
+
+    /*!
+     * \copydoc SpirvReflection(const std::uint32_t*, std::size_t)
+     */
+    explicit SpirvReflection(const BinData& bin);
+
+    /*!
+     * \brief The most modules reflect() keeps the results for.
+     */
+    static constexpr std::size_t cache_capacity = 64;
+
+    /*!
+     * \brief Reflect a module, or fetch the result of having done so before.
+     * Safe to call from multiple threads.
+     */
+    static ptr reflect(const std::uint32_t* words, std::size_t sz);
+
+    /*!
+     * \copydoc reflect(const std::uint32_t*, std::size_t)
+     */
+    static ptr reflect(const BinData& bin);
+
+    /*!
+     * \brief The hash of the module this was reflected from.
+     */
+    uint64_t hash() const { return hsh; }
+
+    /*!
+     * \brief The shader stage of the module's entry point.
+     */
+    vk::ShaderStageFlags stages() const { return stgs; }
+
+    /*!
+     * \brief Every descriptor binding, ordered by set, then binding.
+     */
+    const std::vector<Binding>& bindings() const { return bndgs; }
+
+    /*!
+     * \brief The descriptor bindings in set.
+     */
+    std::vector<Binding> bindings(uint32_t set) const;
+
+    /*!
+     * \brief One more than the highest descriptor set index used, or 0 if
+     * the shader doesn't use any descriptors. (Sets below that which the
+     * shader skips still need a layout, albeit an empty one.)
+     */
+    uint32_t set_count() const;
+
+    /*!
+     * \brief The push constant block, if the shader has one.
+     */
+    std::optional<PushConstantBlock> push_constants() const { return pcs; }
+
+    /*!
+     * \brief The workgroup size, with specialization constants at their
+     * default values.
+     */
+    LocalSize local_size() const { return lcl_sz; }
+
+    /*!
+     * \brief For each axis of the workgroup size, the ID of the
+     * specialization constant that sets it, if there is one.
+     */
+    std::array<std::optional<uint32_t>, 3> local_size_spec_ids() const
+    {
+        return lcl_sz_spec_ids;
+    }
+
+    /*!
+     * \brief The module's specialization constants, ordered by ID.
+     */
+    const std::vector<SpecConstant>& spec_constants() const
+    {
+        return spec_consts;
+    }
+
+    /*!
+     * \brief Nothing in SPIR-V distinguishes a dynamic uniform or storage
+     * buffer from a regular one; that's decided by how the host binds it.
+     * This marks the buffer at set/binding as dynamic. Throws if there's no
+     * buffer there.
+     */
+    void make_dynamic(uint32_t set, uint32_t binding);
+
+    /*!
+     * \brief Whether a pipeline layout built for other would also suit this
+     * shader, i.e. they have the same stage, descriptor bindings (names
+     * aside) and push constant block.
+     */
+    bool layout_compatible(const SpirvReflection& other) const;
+
+private:
+    uint64_t                                hsh;
+    vk::ShaderStageFlags                    stgs = 0;
+    std::vector<Binding>                    bndgs;
+    std::optional<PushConstantBlock>        pcs;
+    LocalSize                               lcl_sz;
+    std::array<std::optional<uint32_t>, 3>  lcl_sz_spec_ids;
+    std::vector<SpecConstant>               spec_consts;
+
+    void parse(const std::uint32_t* words, std::size_t word_cnt);
+};
+
+} // namespace cu
+
+#endif
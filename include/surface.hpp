@@ -77,12 +77,33 @@ public:
      */
     std::vector<VkPresentModeKHR> present_modes(PhysDevice& dev);
 
+    /*!
+     * \brief Returns a list of the format/color space pairs a swapchain
+     * for the surface can be created with (see
+     * [VkSurfaceFormatKHR](https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkSurfaceFormatKHR.html)
+     * in the Vulkan manual).
+     *
+     * \copydetails capabilities()
+     */
+    std::vector<VkSurfaceFormatKHR> formats(PhysDevice& dev);
+
+    /*!
+     * \brief Returns the features dev supports for optimally-tiled images
+     * in format fmt (see
+     * [VkFormatProperties](https://registry.khronos.org/vulkan/specs/1.3-extensions/man/html/VkFormatProperties.html)
+     * in the Vulkan manual), i.e. what a swapchain image in that format
+     * could be used for.
+     */
+    VkFormatFeatureFlags format_features(PhysDevice& dev, VkFormat fmt);
+
     uint32_t width() const { return w; }
     uint32_t height() const { return h; }
 
 private:
     PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR get_surf_caps;
     PFN_vkGetPhysicalDeviceSurfacePresentModesKHR get_pres_modes;
+    PFN_vkGetPhysicalDeviceSurfaceFormatsKHR get_surf_fmts;
+    PFN_vkGetPhysicalDeviceFormatProperties get_fmt_props;
     PFN_vkDestroySurfaceKHR destroy_surf;
 
     Instance::ptr inst;
@@ -27,9 +27,13 @@
 #include "device.hpp"
 #include "binary_semaphore.hpp"
 #include "fence.hpp"
+#include "present_config.hpp"
 
 #include <vulkan/vulkan.h>
 
+#include <deque>
+#include <memory>
+#include <optional>
 #include <vector>
 
 namespace cu {
@@ -51,9 +55,17 @@ public:
      * \param p_dev The PhysDevice in use.
      * \param l_dev The Device in use.
      * \param surf The Surface in use.
-     * \param sdl The SDL instance in use.
+     * \param storage Whether to make the images usable as storage images
+     *                if the surface and device allow it (see storage()).
+     * \param cfg The present mode and image count to ask for. By default,
+     *            mailbox is used where available (FIFO otherwise), with as
+     *            few images as the surface allows but no fewer than two.
      */
-    Swapchain(PhysDevice p_dev, Device::ptr l_dev, Surface& surf);
+    Swapchain(PhysDevice p_dev,
+              Device::ptr l_dev,
+              Surface& surf,
+              bool storage = false,
+              PresentConfig cfg = {});
 
     Swapchain(const Swapchain&) = delete;
     Swapchain& operator=(const Swapchain&) = delete;
@@ -73,11 +85,83 @@ public:
     ImageView& view();
     Image&     img();
 
+    /*!
+     * \brief The image at index ndx, as opposed to the most recently acquired
+     * one.
+     */
+    Image&     img(uint32_t ndx) { return imgs.at(ndx); }
+
+    /*!
+     * \brief A view of the image at index ndx.
+     */
+    ImageView& view(uint32_t ndx) { return _img_views.at(ndx); }
+
+    /*!
+     * \brief Whether the images can be written to directly as storage
+     * images. Only ever true if it was asked for at construction. To make
+     * this possible the swapchain uses a UNORM format rather than the sRGB
+     * one it would otherwise, with the same (sRGB) color space, so the bytes
+     * written end up on screen exactly as they would if they'd been copied
+     * into an sRGB image.
+     */
+    bool storage() const { return strg; }
+
+    /*!
+     * \brief Whether the images can be copied out of. Only ever true if
+     * PresentConfig::readable was set.
+     */
+    bool readable() const { return rdbl; }
+
+    VkFormat format() const { return fmt; }
+
+    /*!
+     * \brief The present mode actually in use, which may not be the one asked
+     * for.
+     */
+    VkPresentModeKHR present_mode() const { return pres_mode; }
+
+    /*!
+     * \brief The number of images in the swapchain. This can change when the
+     * swapchain is recreated.
+     */
+    uint32_t img_count() const { return imgs.size(); }
+
     const uint32_t* ndx() { return &current_ndx; }
     const VkSwapchainKHR* inner() { return &swch; }
 
+    /*!
+     * \brief Replace the swapchain with one that fits the surface as it is
+     * now. The old one is retired rather than destroyed straight away, since
+     * the presentation engine may still be showing its images; see
+     * collect_retired().
+     */
     void recreate();
 
+    /*!
+     * \brief Call once per frame, after presenting. Destroys any retired
+     * swapchains the presentation engine is done with. With
+     * VK_EXT_swapchain_maintenance1 (see Device::present_fences()) that's
+     * once the fences of every present made from one have signaled, which
+     * never blocks. Without it, the only fallback is to count off as many
+     * frames as it had images and then wait for the present queue to go idle.
+     */
+    void collect_retired();
+
+    /*!
+     * \brief Whether the last image acquired came with VK_SUBOPTIMAL_KHR. The
+     * image is still usable (and has to be presented), but the swapchain
+     * should be recreated before long.
+     */
+    bool suboptimal() const { return subopt; }
+
+    /*!
+     * \brief A fence for Device::present() to have signaled once the
+     * presentation engine is done with the image being presented. Only for
+     * when Device::present_fences() is true; the Swapchain keeps the fence and
+     * reuses it once it's signaled.
+     */
+    VkFence present_fence();
+
     uint32_t width() { return extent.width; }
     uint32_t height() { return extent.height; }
 
@@ -90,6 +174,27 @@ private:
     std::vector<ImageView> _img_views;
     VkExtent2D extent;
     uint32_t current_ndx;
+    bool subopt = false;
+    bool want_strg;
+    bool strg = false;
+    bool rdbl = false;
+    VkFormat fmt;
+    PresentConfig cfg;
+    VkPresentModeKHR pres_mode;
+
+    // the fences of the presents made from this swapchain that haven't been
+    // seen to signal yet, oldest first, and those free to use again
+    std::deque<std::unique_ptr<Fence>> pres_fnces;
+    std::vector<std::unique_ptr<Fence>> spare_fnces;
+
+    struct retired_swch {
+        VkSwapchainKHR swch;
+        uint32_t frames_left;
+        std::deque<std::unique_ptr<Fence>> fnces;
+        bool done = false;
+    };
+
+    std::vector<retired_swch> retired;
 
     PFN_vkCreateSwapchainKHR create_swch;
     PFN_vkGetSwapchainImagesKHR get_swch_imgs;
@@ -99,6 +204,9 @@ private:
     SwapchainResult next_img(VkFence fnce, VkSemaphore sem, uint64_t timeout);
 
     void create(VkSwapchainKHR old_swapchain = VK_NULL_HANDLE);
+    std::optional<VkFormat> storage_format();
+    VkPresentModeKHR choose_present_mode();
+    uint32_t choose_img_count(const VkSurfaceCapabilitiesKHR& caps);
 };
 
 } // namespace cu
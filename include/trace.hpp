@@ -0,0 +1,241 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef wa505cab1c7945ee8b33fec0bdd0f9c1
+#define wa505cab1c7945ee8b33fec0bdd0f9c1
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace cu {
+
+/*!
+ * \brief Timed regions of code ("zones") on every thread, kept for writing
+ * out as a Chrome trace, which Perfetto (https://ui.perfetto.dev) and
+ * chrome://tracing can open.
+ *
+ * Zones are usually marked with CU_ZONE, which times the rest of the
+ * enclosing scope; complete() records one directly, given its start and end,
+ * for regions that don't line up with a scope. Each zone is stored as a single
+ * event with its beginning and end, so the ring holding it can drop the oldest
+ * without leaving half a zone behind.
+ *
+ * Every thread records into a ring of its own, set up the first time it
+ * records anything, so threads never contend with one another. Once a ring
+ * fills up it starts overwriting its oldest events, which are counted in
+ * dropped(). Regions that don't belong to a CPU thread (e.g. GPU work, see
+ * GpuProfiler) go on a named track() instead.
+ *
+ * Nothing is recorded until start() is called; until then, and after stop(),
+ * a zone costs one check of a flag. dump() writes what the rings hold to the
+ * path given to start(), and can be called as often as liked.
+ *
+ * Anything can record to the global `trace` object, which main() starts and
+ * dumps at exit if asked to (see the --trace option).
+ */
+class Trace {
+public:
+    using clock = std::chrono::steady_clock;
+
+    /*!
+     * \brief Identifies a thread or track to record onto.
+     */
+    using track_id = uint32_t;
+
+    /*!
+     * \brief The number of events each ring holds by default.
+     */
+    static constexpr std::size_t default_ring_size = 1 << 16;
+
+    /*!
+     * \brief (constructor)
+     *
+     * \param ring_size The number of events each ring holds.
+     */
+    explicit Trace(std::size_t ring_size = default_ring_size);
+
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    /*!
+     * \brief Whether zones are being recorded.
+     */
+    bool enabled() const noexcept
+    {
+        return on.load(std::memory_order_relaxed);
+    }
+
+    /*!
+     * \brief Begin recording, to be written to out by dump().
+     */
+    void start(std::filesystem::path out);
+
+    /*!
+     * \brief Stop recording. What's been recorded so far is kept.
+     */
+    void stop() noexcept { on.store(false, std::memory_order_relaxed); }
+
+    /*!
+     * \brief Record a zone called name on the calling thread. name has to
+     * outlive the Trace; string literals and intern() results do. Does
+     * nothing if not enabled().
+     */
+    void complete(const char* name,
+                  clock::time_point start,
+                  clock::time_point end) noexcept;
+
+    /*!
+     * \overload
+     *
+     * Records onto the thread or track t instead.
+     */
+    void complete(track_id t,
+                  const char* name,
+                  clock::time_point start,
+                  clock::time_point end) noexcept;
+
+    /*!
+     * \brief A track called name, for regions that don't happen on a CPU
+     * thread. Asking for the same name again gives the same track.
+     */
+    track_id track(const std::string& name);
+
+    /*!
+     * \brief Give the calling thread a name in the trace (otherwise it's
+     * just numbered).
+     */
+    void name_thread(std::string name);
+
+    /*!
+     * \brief A copy of name that lives as long as the Trace, for zones with
+     * names that are worked out at runtime.
+     */
+    const char* intern(const std::string& name);
+
+    /*!
+     * \brief The number of events overwritten so far because a ring was
+     * full.
+     */
+    uint64_t dropped() const;
+
+    /*!
+     * \brief Write everything recorded as Chrome trace JSON.
+     */
+    void write(std::ostream& out) const;
+
+    /*!
+     * \brief write() to the path given to start(), replacing anything
+     * already there, and return how many events were written. Throws if the
+     * file can't be written or start() hasn't been called.
+     */
+    std::size_t dump() const;
+
+    /*!
+     * \brief Forget everything recorded so far. Not safe while other threads
+     * are recording.
+     */
+    void clear();
+
+private:
+    struct event {
+        const char* name;
+        clock::time_point start;
+        clock::duration dur;
+    };
+
+    struct ring {
+        mutable std::mutex mtx;
+        std::string name;
+        std::vector<event> evs;
+        uint64_t written = 0;
+    };
+
+    ring& this_ring();
+    track_id add_ring(std::string name);
+    void push(ring& r, const event& e) noexcept;
+    uint64_t dropped_locked() const;
+
+    const std::size_t ring_sz;
+    const clock::time_point epoch;
+    std::atomic<bool> on = false;
+
+    mutable std::mutex mtx;
+    std::filesystem::path out_path;
+    std::vector<std::unique_ptr<ring>> rings;
+    std::unordered_set<std::string> names;
+
+    // tells apart Trace objects for the per-thread ring lookup, even one
+    // created where a destroyed one used to be
+    const uint64_t serial;
+};
+
+extern Trace trace;
+
+/*!
+ * \brief Times from its construction to its destruction as a zone in the
+ * global trace, if it's enabled when constructed. See CU_ZONE.
+ */
+class TraceZone {
+public:
+    explicit TraceZone(const char* name) noexcept
+    {
+        if (trace.enabled()) {
+            nm = name;
+            start = Trace::clock::now();
+        }
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+
+    ~TraceZone() noexcept
+    {
+        if (nm) {
+            trace.complete(nm, start, Trace::clock::now());
+        }
+    }
+
+private:
+    const char* nm = nullptr;
+    Trace::clock::time_point start;
+};
+
+} // namespace cu
+
+#define CU_ZONE_CAT_INNER(a, b) a##b
+#define CU_ZONE_CAT(a, b) CU_ZONE_CAT_INNER(a, b)
+
+/*!
+ * \brief Time the rest of the enclosing scope as a zone called name (a
+ * string literal) in cu::trace.
+ */
+#define CU_ZONE(name) \
+    ::cu::TraceZone CU_ZONE_CAT(cu_zone_, __LINE__) {name}
+
+#endif
@@ -22,10 +22,16 @@
 #ifndef q765e99c966249c6aa35adad25b72458
 #define q765e99c966249c6aa35adad25b72458
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <optional>
 #include <vector>
 #include <string>
+#include <utility>
 #include <memory>
 #include <unordered_map>
+#include <mutex>
 
 #include "instance.hpp"
 #include "debug_msgr.hpp"
@@ -33,11 +39,21 @@
 #include "phys_devices.hpp"
 #include "device.hpp"
 #include "swapchain.hpp"
+#include "offscreen.hpp"
+#include "frame_clock.hpp"
+#include "readback.hpp"
+#include "batch.hpp"
 #include "shader_module.hpp"
 #include "command_pool.hpp"
 #include "descriptor_pool.hpp"
 #include "compute_pipeline.hpp"
 #include "pc_range.hpp"
+#include "buffer.hpp"
+#include "spec_constants.hpp"
+#include "shader_watcher.hpp"
+#include "pipeline_compiler.hpp"
+#include "pipeline_registry.hpp"
+#include "gpu_profiler.hpp"
 
 namespace cu {
 
@@ -96,10 +112,29 @@ public:
      * \param layers The layers to enable.
      * \param sdl The SDL instance in use.
      * \param debug Whether to enable the debug utils.
+     * \param pres_cfg How the swapchain should present (see PresentConfig).
      */
     Vulkan(std::vector<const char*> exts,
            std::vector<const char*> layers,
            SDL& sdl,
+           bool debug = false,
+           PresentConfig pres_cfg = {});
+
+    /*!
+     * \brief (constructor) Initializes Vulkan headless, without a window:
+     * the Vulkan loader is loaded directly rather than through SDL, no
+     * surface or swapchain is made, and frames are rendered into offscreen
+     * images (see Offscreen) instead of being presented.
+     *
+     * \param extent The size to render at.
+     * \param exts   The instance extensions required (none are needed for
+     *               presenting).
+     * \param layers The layers to enable.
+     * \param debug  Whether to enable the debug utils.
+     */
+    Vulkan(VkExtent2D extent,
+           std::vector<const char*> exts = {},
+           std::vector<const char*> layers = {},
            bool debug = false);
 
     Vulkan(Vulkan&&) = delete;
@@ -110,54 +145,281 @@ public:
 
     /*!
      * \brief Add a new compiled (SPIR-V) shader.
+     *
+     * The shader module is built in the background (see PipelineCompiler),
+     * so adding several shaders in a row builds them in parallel.
+     *
+     * \param name            What to call the shader.
+     * \param compiled_shader The shader.
+     * \param source          The file the shader was read from, if any. If
+     *                        given, the file is watched (see ShaderWatcher),
+     *                        and when it changes the shader is rebuilt in the
+     *                        background and swapped in at the start of the
+     *                        next frame.
+     */
+    void add_shader(std::string name,
+                    BinData compiled_shader,
+                    std::filesystem::path source = {});
+
+    /*!
+     * \brief Let the Vulkan side know the window has changed size. The
+     * swapchain is recreated once the size has stopped changing for a
+     * moment (see resize_settle); until then, frames are still rendered at
+     * the old size.
      */
-    void add_shader(std::string name, BinData compiled_shader);
+    void window_resized();
 
     // TODO: replace with something more general-purpose
     void minicomp_setup();
 
-    void minicomp_frame();
+    /*!
+     * \brief Render and present one frame in minicomp mode.
+     *
+     * \param input When the earliest input handled since the last frame
+     *              arrived, if there was any (see SDL::input_time()). The time
+     *              from then until the frame is presented is recorded in
+     *              cu::metrics as latency.MODE.input_to_present_ms, MODE being
+     *              the present mode in use. If the device supports
+     *              VK_KHR_present_wait, the time until it's actually on screen
+     *              is recorded as well, as latency.MODE.input_to_display_ms.
+     */
+    void minicomp_frame(std::optional<std::chrono::steady_clock::time_point>
+                            input = std::nullopt);
+
+    /*!
+     * \brief Take the time handed to the minicomp shader from clk, restarted
+     * now, instead of the real clock (see FrameClock).
+     */
+    void minicomp_clock(FrameClock clk);
+
+    /*!
+     * \brief Whether this is running without a window (see the headless
+     * constructor).
+     */
+    bool headless() const { return !swch; }
+
+    /*!
+     * \brief Copy the last frame rendered back to the host, as RGBA8. Only
+     * works headless. Waits for the copy to finish, so it's meant for the
+     * end of a run rather than every frame.
+     */
+    Pixels read_back_frame();
+
+    /*!
+     * \brief Start copying the last frame rendered back to the host, and
+     * hand a view of it to done from a later minicomp_frame() once it's there
+     * (see Readback::request_view()). Only works headless. Never waits;
+     * returns false, and never calls done, if too many copies are in flight
+     * or still being looked at already.
+     */
+    bool read_back_frame_async(Readback::view_callback_t done);
+
+    /*!
+     * \brief Have the next frame minicomp_frame() renders copied back to the
+     * host, and a view of it handed to done (see Readback::request_view()).
+     * Unlike read_back_frame_async(), this works with a window too, as long
+     * as the swapchain was made readable (see PresentConfig::readable); the
+     * frame is copied out of the swapchain image before it's presented.
+     * Returns false, and never calls done, if a frame is already waiting to
+     * be read back or every readback slot is busy.
+     */
+    bool read_back_next_frame(Readback::view_callback_t done);
+
+    /*!
+     * \brief Whether frames read back come as BGRA rather than RGBA.
+     */
+    bool read_back_bgra() const;
+
+    /*!
+     * \brief Wait for any frames still being read back by
+     * read_back_frame_async() and hand them over.
+     */
+    void flush_read_backs();
+
+    /*!
+     * \brief Run the minicomp shader over count images as fast as the device
+     * allows, rather than rendering frames (see Batch). The shader can read
+     * each input as a storage image at binding 2 of set 0. Doesn't need
+     * minicomp_setup().
+     *
+     * \param extent The size of every image.
+     * \param count  How many images to run.
+     * \param slots  How many can be in flight at once.
+     * \param clk    Where the shader's time comes from, one tick an image.
+     * \param src    The inputs; if empty, a test pattern for shaders that
+     *               read one. Throws if given for a shader that doesn't.
+     * \param done   Takes the outputs, in order.
+     */
+    Batch::Result minicomp_batch(VkExtent2D extent,
+                                 uint64_t count,
+                                 uint32_t slots,
+                                 FrameClock clk,
+                                 const Batch::source_t& src,
+                                 const Batch::callback_t& done);
+
+    /*!
+     * \brief What's being rendered with, as name/value pairs: the device,
+     * the size of the images rendered into and, with a window, the present
+     * mode. Benchmark results are labeled with these.
+     */
+    std::vector<std::pair<std::string, std::string>> describe();
 
 private:
     Instance::ptr inst;
     DebugMsgr dbg_msgr;
 
 private:
-    Surface surf;
+    // no surface when headless
+    std::unique_ptr<Surface> surf;
     PhysDevices phys_devs;
     Device::ptr logi_dev;
 
 private:
-    Swapchain swch;
+    // Exactly one of these is set: the swapchain when there's a window, the
+    // offscreen images when headless. The minicomp code goes through the
+    // target_*() functions, which pick whichever is there.
+    std::unique_ptr<Swapchain> swch;
+    std::unique_ptr<Offscreen> offscr;
+    std::optional<uint32_t> last_rendered;
+
+    // made the first time a frame is read back
+    std::unique_ptr<Readback> rdbk;
+    Readback& readback();
+    Image& last_frame();
+
+    // see read_back_next_frame()
+    Readback::view_callback_t next_read_back;
+
+    uint32_t target_count();
+    VkExtent2D target_extent();
+    Image& target_img(uint32_t ndx);
+    ImageView& target_view(uint32_t ndx);
+
+    // Set when the swapchain no longer matches the window but can still be
+    // presented to; it's recreated once resizes have stopped coming in for
+    // resize_settle, so dragging a window edge doesn't rebuild it every frame.
+    bool swch_stale = false;
+    std::chrono::steady_clock::time_point last_resize;
+    static constexpr std::chrono::milliseconds resize_settle {100};
+
+private:
+    // Presents tagged with an id (see Device::present()) because there was
+    // input behind them, oldest first. They're checked without blocking at
+    // the top of each frame, so the display latency recorded for each is
+    // only accurate to within a frame. Ids are only meaningful for the
+    // swapchain they were presented to, so the list is dropped whenever it's
+    // recreated.
+    struct tagged_present {
+        uint64_t id;
+        std::chrono::steady_clock::time_point input;
+    };
+
+    uint64_t last_present_id = 0;
+    std::deque<tagged_present> tagged_presents;
+
+    // The latency metrics are named after the present mode, which can only
+    // change when the swapchain is (re)created, so the names are only put
+    // together then.
+    std::string input_to_present_metric;
+    std::string input_to_display_metric;
+    void name_latency_metrics();
+
+    void collect_presented();
 
 private:
-    std::unordered_map<std::string, ShaderModule::ptr> shdrs;
+    // builds shader modules and pipelines off the main thread; destroyed
+    // after the watcher (which queues work on it) but before the device
+    std::unique_ptr<PipelineCompiler> compiler;
+
+    // where shader modules and pipelines are actually asked for, so that
+    // nothing is built twice; declared after the compiler it builds with
+    std::unique_ptr<PipelineRegistry> registry;
+
+    std::unordered_map<std::string, PipelineRegistry::Shader> shdrs;
 
 private:
-    struct MinicompPCs {
+    // Everything the minicomp shader reads that changes from frame to frame.
+    // Each swapchain image gets its own slot in a host-visible uniform buffer,
+    // selected with a dynamic offset, so the command buffers never need to be
+    // re-recorded just because this changed.
+    struct MinicompFrameData {
         float time;
+
+        // The part of the scratch image in view (it's usually larger than
+        // the window). std140 puts a uvec2 on an 8-byte boundary.
+        alignas(8) uint32_t extent[2];
+    };
+
+    // 256 bytes is the largest minUniformBufferOffsetAlignment the spec
+    // permits, so slots this far apart are suitably aligned on any device.
+    static constexpr VkDeviceSize minicomp_frame_data_stride = 256;
+
+    static_assert(sizeof(MinicompFrameData) <= minicomp_frame_data_stride);
+
+    // Where things live in the minicomp shader's interface. The layouts
+    // themselves are reflected from the shader; these just name the slots the
+    // host writes to.
+    static constexpr const char* minicomp_set = "minicomp set 0";
+    static constexpr uint32_t minicomp_scratch_binding    = 0;
+    static constexpr uint32_t minicomp_frame_data_binding = 1;
+
+    // only in batch mode, and only if the shader asks for it
+    static constexpr uint32_t minicomp_input_binding      = 2;
+
+    // Baked into the minicomp pipeline when it's created. 8x8 fills a
+    // 64-wide wavefront or two 32-wide warps and keeps each workgroup's
+    // writes within a small square of the image.
+    //
+    // swap_rb tells the shader to write its colors out as BGRA. That's needed
+    // when it renders into the RGBA scratch image that's then copied
+    // byte-for-byte into a BGRA swapchain image; when it writes to the
+    // swapchain image directly, the format takes care of the channel order.
+    struct MinicompSpec {
+        uint32_t local_size_x = 8;
+        uint32_t local_size_y = 8;
+        VkBool32 swap_rb      = VK_FALSE;
     };
 
     struct minicomp_state {
-        std::vector<DescriptorSetLayoutBinding> bns;
         std::vector<DescriptorSetLayout::ptr> dls;
-        std::vector<PCRange*> pcs;
         PipelineLayout::ptr pl;
         ShaderModule::ptr shdr;
-        ComputePipeline* ppl;
-        DescriptorPool* descpl;
+        ComputePipeline::ptr ppl;
+        std::vector<DescriptorPool*> descpls;
         Image* scrtch;
         ImageView* scrtch_v;
+        VkExtent2D scrtch_ext;
+
+        // Whether the shader writes straight into the swapchain images (see
+        // Swapchain::storage()) rather than into the scratch image, which is
+        // then copied into them. Decided once by minicomp_setup(); only then
+        // does each swapchain image need its own descriptor set, but they
+        // all get one either way.
+        bool direct;
+        Buffer::ptr frm_dat;
         CommandPool::ptr cmdp;
-        CommandBuffer* cmdb;
+        std::vector<CommandBuffer*> cmdbs;
+
+        // times the recorded work on the GPU, one slot per command buffer
+        std::unique_ptr<GpuProfiler> prof;
         Fence* f;
-        std::chrono::time_point<std::chrono::steady_clock> start;
 
-        std::vector<PCRange*>& push_consts() { return pcs; }
-        void push_consts(std::vector<PCRange*> p) { pcs = p; }
+        // what the time in the frame data comes from; restarted by
+        // minicomp_setup()
+        FrameClock clk;
+
+        // Bumped whenever something baked into the recorded command buffers
+        // (the pipeline, the swapchain images, the scratch image) changes. A
+        // command buffer whose entry in rec_keys doesn't match gets
+        // re-recorded before it's next submitted.
+        uint64_t key = 1;
+        std::vector<uint64_t> rec_keys;
 
-        std::vector<DescriptorSetLayoutBinding>& bndgs() { return bns; }
-        void bndgs(std::vector<DescriptorSetLayoutBinding> b) { bns = b; }
+        // What the pipeline layout was built from. Set once by
+        // minicomp_setup(), which then sets ready; after that both are safe
+        // to read from the shader watcher's thread.
+        std::shared_ptr<const SpirvReflection> layt_refl;
+        std::atomic<bool> ready = false;
 
         std::vector<DescriptorSetLayout::ptr>& d_layts() { return dls; }
         void d_layts(std::vector<DescriptorSetLayout::ptr> d) { dls = d; }
@@ -169,10 +431,9 @@ private:
         void minicomp_shdr(ShaderModule::ptr p ) { shdr = p; }
 
         ComputePipeline& pipel() { return *ppl; }
-        void pipel(ComputePipeline* newp) { ppl = newp; }
+        void pipel(ComputePipeline::ptr newp) { ppl = newp; }
 
-        DescriptorPool& descpool() { return *descpl; }
-        void descpool(DescriptorPool* newp) { descpl = newp; }
+        DescriptorPool& descpool(uint32_t ndx) { return *descpls.at(ndx); }
 
         Image& scratch() { return *scrtch; }
         void scratch(Image* img) { scrtch = img; }
@@ -180,21 +441,64 @@ private:
         ImageView& scratch_v() { return *scrtch_v; }
         void scratch_v(ImageView* imgv) { scrtch_v = imgv; }
 
+        Buffer::ptr frame_data_buff() { return frm_dat; }
+        void frame_data_buff(Buffer::ptr b) { frm_dat = b; }
+
+        MinicompFrameData& frame_data(uint32_t ndx)
+        {
+            return *frm_dat->mapped_as<MinicompFrameData>(
+                ndx * minicomp_frame_data_stride
+            );
+        }
+
         CommandPool::ptr cmd_pool() { return cmdp; }
         void cmd_pool(CommandPool::ptr newp) { cmdp = newp; }
 
-        CommandBuffer& cmd_buff() { return *cmdb; }
-        void cmd_buff(CommandBuffer* newp) { cmdb = newp; }
+        CommandBuffer& cmd_buff(uint32_t ndx) { return *cmdbs.at(ndx); }
+
+        GpuProfiler& profiler() { return *prof; }
 
         Fence& fnce() { return *f; }
         void fnce(Fence* newp) { f = newp; }
 
+        void invalidate() { ++key; }
+
         ~minicomp_state() noexcept;
     };
 
     minicomp_state minist = {};
 
+    void minicomp_fit_scratch();
+    void minicomp_fit_to_swch();
+    void minicomp_record(uint32_t ndx);
+    SpirvReflection minicomp_reflection(const SpirvReflection& shdr_refl);
+    PipelineCompiler::ComputeDesc minicomp_pipeline_desc();
+    PipelineCompiler::ComputeDesc
+    minicomp_pipeline_desc(PipelineLayout::ptr layt, bool swap_rb);
     void minicomp_recreate_swch();
+
+private:
+    // Hot reloading. The watcher thread asks the registry for the new shaders
+    // (and the minicomp pipeline, if that's what changed) and notes them in
+    // pending_reloads; at the top of each frame the main thread swaps in the
+    // ones that have finished, so rendering carries on with the old ones
+    // until the new ones are ready.
+    struct shader_reload {
+        std::string name;
+        PipelineRegistry::Shader shdr;
+        PipelineCompiler::handle_t<ComputePipeline::ptr> pipel;
+    };
+
+    std::mutex reload_mtx;
+    std::unordered_map<std::string, std::filesystem::path> shdr_srcs;
+    std::vector<shader_reload> pending_reloads;
+
+    void reload_shaders(const std::filesystem::path& src);
+    void apply_reloads();
+
+    // declared last so that its thread is stopped before anything it touches
+    // is destroyed
+    std::unique_ptr<ShaderWatcher> watcher;
 };
 
 } // namespace cu
@@ -0,0 +1,47 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#ifndef Yb5454560fef4bdea5eec4775f997b41
+#define Yb5454560fef4bdea5eec4775f997b41
+
+#include <vulkan/vulkan.h>
+
+namespace cu {
+
+/*!
+ * \brief Loads the Vulkan loader library itself, for when there's no SDL
+ * window to get it from (see SDL::get_get_inst_proc_addr()), e.g. when
+ * running headless.
+ */
+class VulkanLoader {
+public:
+    /*!
+     * \brief Returns vkGetInstanceProcAddr() from the system's Vulkan
+     * loader, loading it the first time. The library stays loaded until the
+     * program exits, since anything built with it may still be around until
+     * then. Throws if it can't be found.
+     */
+    static PFN_vkGetInstanceProcAddr get_inst_proc_addr();
+};
+
+} // namespace cu
+
+#endif
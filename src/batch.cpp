@@ -0,0 +1,434 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "batch.hpp"
+
+#include "iec_ibyte.hpp"
+#include "log.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace cu {
+
+Batch::Batch(Device::ptr l_dev,
+             ComputePipeline::ptr l_pipel,
+             const std::vector<DescriptorSetLayout::ptr>& layts,
+             Bindings l_bnds,
+             VkExtent2D extent,
+             uint32_t slot_count)
+    : dev {l_dev},
+      pipel {l_pipel},
+      bnds {std::move(l_bnds)},
+      ext {extent},
+      // the command buffers are recorded once and resubmitted
+      trnsfr_pool {
+          std::make_shared<CommandPool>(l_dev, Device::transfer_queue, 0)
+      },
+      cmpte_pool {
+          std::make_shared<CommandPool>(l_dev, Device::compute_queue, 0)
+      },
+      slots(std::max<uint32_t>(slot_count, 1)),
+      upl {l_dev},
+      cmp {l_dev},
+      rdb {l_dev}
+{
+    using namespace vk;
+
+    if (ext.width == 0 || ext.height == 0) {
+        throw std::runtime_error("batch images need a nonzero size");
+    }
+
+    log.enter("Vulkan", "setting up a batch of " + std::to_string(ext.width)
+                        + "x" + std::to_string(ext.height) + " images, "
+                        + std::to_string(slots.size()) + " in flight");
+    log.brk();
+
+    // images touched by both queues are shared rather than passed between
+    // them, if they're in different families
+
+    const auto trnsfr_fam = dev->queue_ndx(Device::transfer_queue);
+    const auto cmpte_fam = dev->queue_ndx(Device::compute_queue);
+    const bool shared = trnsfr_fam != cmpte_fam;
+
+    auto image = [&](ImageUsageFlags usage) {
+        return std::make_unique<Image>(dev, Image::params {
+            .extent = {
+                .width  = ext.width,
+                .height = ext.height,
+                .depth  = 1,
+            },
+            .usage            = usage,
+            .format           = Format::r8g8b8a8_unorm,
+            .sharing_mode     = shared ? SharingMode::cncrrnt
+                                       : SharingMode::exclsv,
+            .queue_fam_ndcies = shared ? std::vector {trnsfr_fam, cmpte_fam}
+                                       : std::vector<uint32_t> {},
+        });
+    };
+
+    const VkDeviceSize img_sz = VkDeviceSize {ext.width} * ext.height * 4;
+
+    // The staging buffers all come out of the readback pool, which is a
+    // fixed size, so make sure they'll fit before making any of them rather
+    // than running out partway.
+
+    const VkDeviceSize staging_sz = img_sz * slots.size()
+                                    * (has_input() ? 2 : 1);
+    const auto avail = dev->available(Heap::Location::readback);
+
+    if (staging_sz > avail) {
+        // rounded so the one is always more than the other
+        const auto need_mib = (staging_sz + 1_MiB - 1) / 1_MiB;
+        const auto avail_mib = avail / 1_MiB;
+
+        throw std::runtime_error(
+            std::to_string(slots.size()) + " batch images of "
+            + std::to_string(ext.width) + "x" + std::to_string(ext.height)
+            + " in flight need " + std::to_string(need_mib) + " MiB of "
+            + "staging memory, but the readback pool only has "
+            + std::to_string(avail_mib) + " MiB free; use fewer slots or "
+            + "smaller images"
+        );
+    }
+
+    frm_dat = std::make_shared<Buffer>(dev, Buffer::params {
+        .size     = slots.size() * frame_data_stride,
+        .usage    = flgs(BufferUsageFlag::unfrm_buffer),
+        .location = Heap::Location::host,
+    });
+
+    for (uint32_t i = 0; i < slots.size(); ++i) {
+        auto& s = slots[i];
+
+        if (has_input()) {
+            s.input = image(flgs(ImageUsageFlag::strge)
+                            | flgs(ImageUsageFlag::trnsfr_dst));
+            s.input_v = std::make_unique<ImageView>(*s.input);
+            // the host pool is kept small, and these are frame-sized
+            s.upload = std::make_shared<Buffer>(dev, Buffer::params {
+                .size     = img_sz,
+                .usage    = flgs(BufferUsageFlag::trnsfr_src),
+                .location = Heap::Location::readback,
+            });
+            s.upl_cmdb = std::make_unique<CommandBuffer>(dev, trnsfr_pool);
+        }
+
+        s.output = image(flgs(ImageUsageFlag::strge)
+                         | flgs(ImageUsageFlag::trnsfr_src));
+        s.output_v = std::make_unique<ImageView>(*s.output);
+        s.download = std::make_shared<Buffer>(dev, Buffer::params {
+            .size     = img_sz,
+            .usage    = flgs(BufferUsageFlag::trnsfr_dst),
+            .location = Heap::Location::readback,
+        });
+
+        s.cmp_cmdb = std::make_unique<CommandBuffer>(dev, cmpte_pool);
+        s.rdb_cmdb = std::make_unique<CommandBuffer>(dev, trnsfr_pool);
+
+        s.descpl = std::make_unique<DescriptorPool>(dev, layts);
+        auto& wr = s.descpl->write();
+        wr.storage_image(bnds.set, bnds.output, 0, s.output_v.get())
+          .uniform_buffer(bnds.set,
+                          bnds.frame_data,
+                          0,
+                          frm_dat.get(),
+                          0,
+                          sizeof(frame_data),
+                          true);
+        if (has_input()) {
+            wr.storage_image(bnds.set, *bnds.input, 0, s.input_v.get());
+        }
+        wr.submit();
+
+        record(s, i);
+    }
+}
+
+Batch::~Batch() noexcept
+{
+    // everything submitted signals rdb last, but if a submission failed
+    // partway that may never come, so each stage is waited for separately
+
+    try {
+        if (has_input()) {
+            upl.wait_for(submitted);
+        }
+        cmp.wait_for(submitted);
+        rdb.wait_for(submitted);
+    } catch (...) {
+        // the device is gone, so there's nothing to wait for
+    }
+}
+
+void Batch::record(slot& s, uint32_t ndx)
+{
+    using namespace vk;
+
+    // The semaphore waits each stage starts with are at the stage the
+    // barriers below start from, so the barriers (and the layout changes in
+    // them) come after the waits. The semaphores carry memory from one queue
+    // to the next, so the barriers at the end of each stage only have to
+    // change layouts.
+
+    if (has_input()) {
+        // the input's last contents were read by the compute stage before
+        // this could start, and are about to be overwritten
+        s.upl_cmdb->record(0)
+            .barrier(*s.input,
+                     PipelineStageFlag::trnsfr,
+                     PipelineStageFlag::trnsfr,
+                     AccessFlag::none,
+                     AccessFlag::trnsfr_write,
+                     ImageLayout::undfnd,
+                     ImageLayout::trnsfr_dst_optml,
+                     ImageAspectFlag::color)
+            .copy(*s.upload, *s.input)
+            .end();
+    }
+
+    auto& cmdb = s.cmp_cmdb->record(0);
+
+    cmdb.bind(*pipel,
+              0,
+              {(*s.descpl)[bnds.set]},
+              {static_cast<uint32_t>(ndx * frame_data_stride)});
+
+    if (has_input()) {
+        cmdb.barrier(*s.input,
+                     PipelineStageFlag::cmpte_shader,
+                     PipelineStageFlag::cmpte_shader,
+                     AccessFlag::none,
+                     AccessFlag::shader_read,
+                     ImageLayout::trnsfr_dst_optml,
+                     ImageLayout::gnrl,
+                     ImageAspectFlag::color);
+    }
+
+    cmdb.barrier(*s.output,
+                 PipelineStageFlag::cmpte_shader,
+                 PipelineStageFlag::cmpte_shader,
+                 AccessFlag::none,
+                 AccessFlag::shader_write,
+                 ImageLayout::undfnd,
+                 ImageLayout::gnrl,
+                 ImageAspectFlag::color)
+        .dispatch_over(ext)
+        .barrier(*s.output,
+                 PipelineStageFlag::cmpte_shader,
+                 PipelineStageFlag::bottom_of_pipe,
+                 AccessFlag::shader_write,
+                 AccessFlag::none,
+                 ImageLayout::gnrl,
+                 ImageLayout::trnsfr_src_optml,
+                 ImageAspectFlag::color)
+        .end();
+
+    s.rdb_cmdb->record(0)
+        .barrier(*s.output,
+                 PipelineStageFlag::trnsfr,
+                 PipelineStageFlag::trnsfr,
+                 AccessFlag::none,
+                 AccessFlag::trnsfr_read,
+                 ImageLayout::trnsfr_src_optml,
+                 ImageLayout::trnsfr_src_optml,
+                 ImageAspectFlag::color)
+        .copy(*s.output, *s.download)
+        .barrier(PipelineStageFlag::trnsfr,
+                 PipelineStageFlag::host,
+                 AccessFlag::trnsfr_write,
+                 AccessFlag::host_read)
+        .end();
+}
+
+void Batch::submit(slot& s)
+{
+    CU_ZONE("Batch::submit");
+
+    const VkPipelineStageFlags trnsfr = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    const VkPipelineStageFlags cmpte = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    const uint64_t k = ++submitted;
+    // the last image to use this slot, if any; its results have already
+    // been collected, so that's all its download buffer is waiting on
+    const uint64_t prev = k > slots.size() ? k - slots.size() : 0;
+
+    if (has_input()) {
+        std::vector<Device::TimelinePoint> waits;
+        if (prev) {
+            waits.push_back({cmp.inner(), prev, trnsfr});
+        }
+
+        dev->submit_async(Device::transfer_queue,
+                          *s.upl_cmdb,
+                          waits,
+                          {{upl.inner(), k}});
+    }
+
+    std::vector<Device::TimelinePoint> waits;
+    if (has_input()) {
+        waits.push_back({upl.inner(), k, cmpte});
+    }
+    if (prev) {
+        waits.push_back({rdb.inner(), prev, cmpte});
+    }
+
+    dev->submit_async(Device::compute_queue,
+                      *s.cmp_cmdb,
+                      waits,
+                      {{cmp.inner(), k}});
+
+    dev->submit_async(Device::transfer_queue,
+                      *s.rdb_cmdb,
+                      {{cmp.inner(), k, trnsfr}},
+                      {{rdb.inner(), k}});
+}
+
+void Batch::collect(const callback_t& done)
+{
+    const uint64_t k = ++collected;
+    auto& s = slots[(k - 1) % slots.size()];
+
+    {
+        CU_ZONE("Batch::wait");
+
+        auto start = std::chrono::steady_clock::now();
+        rdb.wait_for(k);
+        metrics.record("batch.wait_ms",
+                       std::chrono::steady_clock::now() - start);
+    }
+
+    if (!done) {
+        return;
+    }
+
+    CU_ZONE("Batch::collect");
+
+    s.download->invalidate();
+
+    done(s.n, PixelView {
+        .width  = ext.width,
+        .height = ext.height,
+        .rgba   = static_cast<const uint8_t*>(s.download->mapped()),
+        .keep   = {},
+    });
+}
+
+Batch::Result Batch::run(uint64_t count,
+                         FrameClock clk,
+                         const source_t& src,
+                         const callback_t& done)
+{
+    using clock = std::chrono::steady_clock;
+
+    Result res;
+    const uint64_t first = submitted;
+
+    clk.restart();
+    const auto start = clock::now();
+
+    for (uint64_t n = 0; n < count; ++n) {
+        // read the input before waiting for a slot, so the two overlap
+
+        std::optional<Pixels> px;
+        if (has_input()) {
+            CU_ZONE("Batch::source");
+
+            px = src ? src(n) : test_pattern(ext, n);
+
+            if (px && (px->width != ext.width || px->height != ext.height)) {
+                log.enter("Batch", "skipping image " + std::to_string(n)
+                                   + ", which isn't "
+                                   + std::to_string(ext.width) + "x"
+                                   + std::to_string(ext.height));
+                log.brk();
+                px.reset();
+            }
+
+            if (!px) {
+                ++res.skipped;
+                metrics.count("batch.skipped");
+                continue;
+            }
+        }
+
+        // every slot is busy, so the oldest has to be finished with first
+
+        if (submitted - collected == slots.size()) {
+            collect(done);
+        }
+
+        const auto ndx = static_cast<uint32_t>(submitted % slots.size());
+        auto& s = slots[ndx];
+        s.n = n;
+
+        if (px) {
+            std::memcpy(s.upload->mapped(), px->rgba.data(), px->rgba.size());
+            s.upload->flush();
+        }
+
+        *frm_dat->mapped_as<frame_data>(ndx * frame_data_stride) = {
+            .time   = static_cast<float>(clk.next().count()),
+            .extent = {ext.width, ext.height},
+        };
+
+        submit(s);
+    }
+
+    while (collected < submitted) {
+        collect(done);
+    }
+
+    res.images = submitted - first;
+    res.elapsed = clock::now() - start;
+
+    metrics.count("batch.images", res.images);
+
+    return res;
+}
+
+Pixels Batch::test_pattern(VkExtent2D extent, uint64_t n)
+{
+    Pixels px {
+        .width  = extent.width,
+        .height = extent.height,
+        .rgba   = {},
+    };
+    px.rgba.resize(std::size_t {extent.width} * extent.height * 4);
+
+    // diagonal bands that move along a pixel each image, over a gradient
+    auto* p = px.rgba.data();
+    for (uint32_t y = 0; y < extent.height; ++y) {
+        for (uint32_t x = 0; x < extent.width; ++x) {
+            *p++ = static_cast<uint8_t>(x * 255 / extent.width);
+            *p++ = static_cast<uint8_t>(y * 255 / extent.height);
+            *p++ = static_cast<uint8_t>(((x + y + n) / 16) % 2 ? 255 : 0);
+            *p++ = 255;
+        }
+    }
+
+    return px;
+}
+
+} // namespace cu
@@ -0,0 +1,373 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "bench_report.hpp"
+#include "json_escape.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+
+#include <sys/resource.h>
+
+namespace cu {
+
+namespace {
+
+std::string num(double v)
+{
+    if (!std::isfinite(v)) {
+        return "null";
+    }
+
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.10g", v);
+    return buf;
+}
+
+std::string json_str(const std::string& s)
+{
+    return "\"" + json_escape(s) + "\"";
+}
+
+std::string csv_field(const std::string& s)
+{
+    if (s.find_first_of(",\"\n") == std::string::npos) {
+        return s;
+    }
+
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+
+    return out + "\"";
+}
+
+bool ends_with(const std::string& s, const std::string& suffix)
+{
+    return s.size() >= suffix.size()
+           && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+Metrics::Series series_of(const std::map<std::string, Metrics::Series>& snap,
+                          const std::string& name)
+{
+    if (auto s = snap.find(name); s != snap.end()) {
+        return s->second;
+    }
+
+    return {};
+}
+
+// in order of first appearance
+template<typename Key>
+std::vector<std::string> distinct(const std::vector<BenchReport::Row>& rows,
+                                  Key key)
+{
+    std::vector<std::string> out;
+
+    for (const auto& r : rows) {
+        const std::string& k = key(r);
+        if (std::find(out.begin(), out.end(), k) == out.end()) {
+            out.push_back(k);
+        }
+    }
+
+    return out;
+}
+
+} // namespace
+
+std::optional<BenchReport::Format>
+BenchReport::format_for(const std::filesystem::path& path)
+{
+    const auto ext = path.extension();
+
+    if (ext == ".json") {
+        return Format::json;
+    } else if (ext == ".csv") {
+        return Format::csv;
+    }
+
+    return std::nullopt;
+}
+
+void BenchReport::info(std::string key, std::string value)
+{
+    inf.emplace_back(std::move(key), std::move(value));
+}
+
+void BenchReport::warmed_up(const Metrics& m)
+{
+    setup = m.snapshot();
+}
+
+void BenchReport::frame(clock::duration d)
+{
+    frame_ms.push_back(std::chrono::duration<double, std::milli>(d).count());
+}
+
+void BenchReport::add(const std::string& section,
+                      const std::string& name,
+                      const std::string& stat,
+                      double value)
+{
+    rws.push_back({section, name, stat, value});
+}
+
+void BenchReport::finish(const FrameStats& fs, const Metrics& m)
+{
+    rws.clear();
+
+    // every measured frame is kept, so these percentiles are exact rather
+    // than to the nearest FrameStats bucket
+
+    if (!frame_ms.empty()) {
+        auto sorted = frame_ms;
+        std::sort(sorted.begin(), sorted.end());
+
+        const auto n = sorted.size();
+        auto at = [&sorted, n](double q) {
+            auto rank = static_cast<std::size_t>(std::ceil(q * n));
+            return sorted[std::clamp<std::size_t>(rank, 1, n) - 1];
+        };
+
+        const double total = std::accumulate(sorted.begin(), sorted.end(), 0.0);
+
+        add("frame_time_ms", "frame", "count", static_cast<double>(n));
+        add("frame_time_ms", "frame", "mean",  total / n);
+        add("frame_time_ms", "frame", "p50",   at(0.50));
+        add("frame_time_ms", "frame", "p90",   at(0.90));
+        add("frame_time_ms", "frame", "p95",   at(0.95));
+        add("frame_time_ms", "frame", "p99",   at(0.99));
+        add("frame_time_ms", "frame", "max",   sorted.back());
+
+        if (total > 0) {
+            add("frame_time_ms", "frame", "fps", 1000.0 * n / total);
+        }
+    }
+
+    for (std::size_t i = 0; i < FrameStats::phase_count; ++i) {
+        const auto p = static_cast<FrameStats::Phase>(i);
+        if (p == FrameStats::Phase::frame) {
+            continue;
+        }
+
+        const auto s = fs.summary(p);
+        if (s.count == 0) {
+            continue;
+        }
+
+        const bool on_gpu = p == FrameStats::Phase::gpu;
+        const std::string section = on_gpu ? "gpu_ms" : "cpu_phase_ms";
+        const std::string name = on_gpu ? "frame" : FrameStats::phase_name(p);
+
+        add(section, name, "mean", s.mean);
+        add(section, name, "p50",  s.p50);
+        add(section, name, "p95",  s.p95);
+        add(section, name, "p99",  s.p99);
+        add(section, name, "max",  s.max);
+    }
+
+    const auto snap = m.snapshot();
+
+    for (const auto& [name, s] : snap) {
+        if (!name.starts_with("gpu.")) {
+            continue;
+        }
+
+        auto rest = name.substr(4);
+        std::string section = "gpu";
+
+        if (ends_with(rest, "_ms")) {
+            rest.resize(rest.size() - 3);
+            section = "gpu_ms";
+        }
+
+        add(section, rest, "count", static_cast<double>(s.count));
+        add(section, rest, "mean",  s.mean());
+        add(section, rest, "min",   s.min);
+        add(section, rest, "max",   s.max);
+    }
+
+    // the Heap's series, from setup and from the measured frames
+
+    std::set<std::string> heap;
+    for (const auto& [name, _] : setup) {
+        if (name.starts_with("heap.")) {
+            heap.insert(name);
+        }
+    }
+    for (const auto& [name, _] : snap) {
+        if (name.starts_with("heap.")) {
+            heap.insert(name);
+        }
+    }
+
+    for (const auto& name : heap) {
+        if (ends_with(name, ".allocs") || ends_with(name, ".frees")) {
+            // counters, so the sum is how many
+            add("allocations", name, "setup", series_of(setup, name).sum);
+            add("allocations", name, "measured", series_of(snap, name).sum);
+        }
+    }
+
+    const std::string in_use = ".in_use_mib";
+
+    for (const auto& name : heap) {
+        if (ends_with(name, in_use)) {
+            add("memory",
+                name.substr(0, name.size() - in_use.size()),
+                "peak_mib",
+                std::max(series_of(setup, name).max,
+                         series_of(snap, name).max));
+        }
+    }
+
+    add("memory", "process", "peak_rss_mib", peak_rss_mib());
+}
+
+std::optional<double> BenchReport::get(const std::string& section,
+                                       const std::string& name,
+                                       const std::string& stat) const
+{
+    for (const auto& r : rws) {
+        if (r.section == section && r.name == name && r.stat == stat) {
+            return r.value;
+        }
+    }
+
+    return std::nullopt;
+}
+
+void BenchReport::write(std::ostream& out, Format f) const
+{
+    switch (f) {
+    case Format::json:
+        write_json(out);
+        break;
+    case Format::csv:
+        write_csv(out);
+        break;
+    }
+}
+
+void BenchReport::write(const std::filesystem::path& path) const
+{
+    auto f = format_for(path);
+    if (!f) {
+        throw std::runtime_error("can't tell what format to write "
+                                 + path.string() + " in (it should end in "
+                                 ".json or .csv)");
+    }
+
+    std::ofstream out {path, std::ios::trunc};
+    write(out, *f);
+    out.flush();
+
+    if (!out) {
+        throw std::runtime_error("failed to write " + path.string());
+    }
+}
+
+void BenchReport::write_json(std::ostream& out) const
+{
+    out << "{\n    \"info\": {";
+
+    for (std::size_t i = 0; i < inf.size(); ++i) {
+        out << (i ? "," : "") << "\n        "
+            << json_str(inf[i].first) << ": " << json_str(inf[i].second);
+    }
+
+    out << (inf.empty() ? "}" : "\n    }");
+
+    auto sections = distinct(rws, [](const Row& r) -> const std::string& {
+        return r.section;
+    });
+
+    for (const auto& sec : sections) {
+        std::vector<Row> in_sec;
+        std::copy_if(rws.begin(), rws.end(), std::back_inserter(in_sec),
+                     [&sec](const Row& r) { return r.section == sec; });
+
+        out << ",\n    " << json_str(sec) << ": {";
+
+        auto names = distinct(in_sec, [](const Row& r) -> const std::string& {
+            return r.name;
+        });
+
+        for (std::size_t i = 0; i < names.size(); ++i) {
+            out << (i ? "," : "") << "\n        " << json_str(names[i])
+                << ": {";
+
+            bool first = true;
+            for (const auto& r : in_sec) {
+                if (r.name == names[i]) {
+                    out << (first ? "" : ", ") << json_str(r.stat) << ": "
+                        << num(r.value);
+                    first = false;
+                }
+            }
+
+            out << "}";
+        }
+
+        out << "\n    }";
+    }
+
+    out << "\n}\n";
+}
+
+void BenchReport::write_csv(std::ostream& out) const
+{
+    out << "section,name,stat,value\n";
+
+    for (const auto& [key, value] : inf) {
+        out << "info," << csv_field(key) << ",," << csv_field(value) << "\n";
+    }
+
+    for (const auto& r : rws) {
+        out << csv_field(r.section) << "," << csv_field(r.name) << ","
+            << csv_field(r.stat) << "," << num(r.value) << "\n";
+    }
+}
+
+double BenchReport::peak_rss_mib()
+{
+    struct rusage ru {};
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        return 0;
+    }
+
+    // in KiB on Linux
+    return static_cast<double>(ru.ru_maxrss) / 1024;
+}
+
+} // namespace cu
@@ -42,6 +42,18 @@ BinData::BinData(BinData::stream_t& f, container_t::size_type size)
     }
 }
 
+BinData BinData::read_file(const std::filesystem::path& path)
+{
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f) {
+        throw std::runtime_error("unable to open " + path.string());
+    }
+
+    container_t::size_type sz = f.tellg();
+
+    return {f, sz};
+}
+
 BinData::BinData(const BinData& f)
     : dta {f.inner()}
 {}
@@ -0,0 +1,78 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "buffer.hpp"
+
+#include "vulkan.hpp"
+
+namespace cu {
+
+Buffer::Buffer(Device::ptr l_dev, const Buffer::params& ps)
+    : Deviced(l_dev, "buffer", "Buffer"),
+      sz  {ps.size},
+      usg {ps.usage},
+      loc {ps.location}
+{
+    VkBufferCreateInfo inf {
+        .sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext                 = NULL,
+        .flags                 = ps.flags,
+        .size                  = ps.size,
+        .usage                 = ps.usage,
+        .sharingMode           = v(ps.sharing_mode),
+        .queueFamilyIndexCount =
+            static_cast<uint32_t>(ps.queue_fam_ndcies.size()),
+        .pQueueFamilyIndices   = ps.queue_fam_ndcies.data(),
+    };
+
+    Vulkan::vk_try(create(dev->inner(), &inf, NULL, &nner),
+                   "creating " + descrptn());
+    log.indent();
+    log.enter("size", inf.size);
+    log.enter("usage", vk::buffer_usage_flags_cstrs(inf.usage));
+    if (inf.flags) {
+        log.enter("flags", vk::buffer_create_flags_cstrs(inf.flags));
+    }
+    log.enter("sharing mode", vk::shrng_mode_str(inf.sharingMode));
+    log.enter("location",
+              std::string(loc == Heap::Location::host     ? "host"
+                          : loc == Heap::Location::readback ? "readback"
+                          : "device"));
+    log.brk();
+
+    auto get_mem_reqs = reinterpret_cast<PFN_vkGetBufferMemoryRequirements>(
+        dev->get_proc_addr("vkGetBufferMemoryRequirements")
+    );
+
+    get_mem_reqs(dev->inner(), nner, &mem_reqs);
+    supported_types = {mem_reqs.memoryTypeBits};
+
+    mem = dev->alloc(*this);
+    mppd = dev->mapped(mem);
+}
+
+Buffer::~Buffer() noexcept
+{
+    dev->release(mem);
+    Deviced::dstrct();
+}
+
+} // namespace cu
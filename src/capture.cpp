@@ -0,0 +1,373 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "capture.hpp"
+
+#include "frame_convert.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace cu {
+
+Capture::Capture(CaptureConfig config)
+    : cfg {std::move(config)}
+{
+    if (cfg.every == 0) {
+        cfg.every = 1;
+    }
+
+    if (cfg.max_queued == 0) {
+        cfg.max_queued = 1;
+    }
+
+    if (cfg.fmt == CaptureConfig::ppm) {
+        std::error_code ec;
+        std::filesystem::create_directories(cfg.out, ec);
+        if (ec) {
+            throw std::runtime_error {
+                "couldn't create " + cfg.out.string() + ": " + ec.message()
+            };
+        }
+    } else {
+        // set before opening, or it's ignored
+        file_buf.resize(batch_bytes);
+        file.rdbuf()->pubsetbuf(file_buf.data(), file_buf.size());
+        file.open(cfg.out, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::runtime_error {"couldn't open " + cfg.out.string()};
+        }
+    }
+
+    auto thread_cnt = cfg.threads;
+    if (thread_cnt == 0) {
+        // leave a core for rendering and one for the writer
+        thread_cnt = std::max(3u, std::thread::hardware_concurrency()) - 2;
+    }
+
+    thrds.emplace_back();
+    thrds.back() = GuardedThread {std::thread {&Capture::write, this}};
+
+    for (unsigned i = 0; i < thread_cnt; ++i) {
+        thrds.emplace_back();
+        thrds.back() = GuardedThread {std::thread {&Capture::work, this}};
+    }
+}
+
+Capture::~Capture() noexcept
+{
+    try {
+        finish();
+    } catch (...) {
+    }
+}
+
+bool Capture::submit(uint64_t frame, Pixels px)
+{
+    return submit(frame, PixelView::of(std::move(px)));
+}
+
+bool Capture::submit(uint64_t frame, PixelView px)
+{
+    {
+        std::unique_lock<std::mutex> lk {mtx};
+
+        if (cfg.block) {
+            room_cv.wait(lk, [this] {
+                return stopping || error || queued < cfg.max_queued;
+            });
+        }
+
+        if (stopping || error || queued >= cfg.max_queued) {
+            ++n_dropped;
+            metrics.count("capture.dropped");
+            return false;
+        }
+
+        queue.push_back({next_seq++, frame, std::move(px)});
+        ++queued;
+    }
+    work_cv.notify_one();
+
+    return true;
+}
+
+void Capture::missed()
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    ++n_dropped;
+    metrics.count("capture.dropped");
+}
+
+void Capture::finish()
+{
+    {
+        std::lock_guard<std::mutex> lk {mtx};
+        if (finished) {
+            return;
+        }
+        stopping = true;
+        finished = true;
+    }
+    work_cv.notify_all();
+    write_cv.notify_all();
+    room_cv.notify_all();
+
+    for (auto& t : thrds) {
+        t.join();
+    }
+
+    if (file.is_open()) {
+        file.close();
+        if (!file && !error) {
+            error = std::make_exception_ptr(std::runtime_error {
+                "couldn't finish writing " + cfg.out.string()
+            });
+        }
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+uint64_t Capture::written() const
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    return n_written;
+}
+
+uint64_t Capture::dropped() const
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    return n_dropped;
+}
+
+Capture::converted Capture::prepare(job& j) const
+{
+    CU_ZONE("Capture::prepare");
+
+    const auto w = j.px.width;
+    const auto h = j.px.height;
+    const auto src = j.px.rgba;
+    const std::size_t n = std::size_t {w} * h;
+
+    converted c {j.frame, w, h, {}};
+
+    switch (cfg.fmt) {
+    case CaptureConfig::raw:
+        c.bytes.resize(n * 3);
+        convert::to_rgb(src, c.bytes.data(), n, cfg.bgra);
+        break;
+    case CaptureConfig::y4m: {
+        static constexpr char tag[] = "FRAME\n";
+        const std::size_t tag_sz = sizeof(tag) - 1;
+
+        c.bytes.resize(tag_sz + convert::yuv420_size(w, h));
+        std::copy(tag, tag + tag_sz, c.bytes.begin());
+        convert::to_yuv420(src, w, h, c.bytes.data() + tag_sz, cfg.bgra);
+        break;
+    }
+    case CaptureConfig::ppm: {
+        const auto hdr = "P6\n" + std::to_string(w) + " "
+                         + std::to_string(h) + "\n255\n";
+
+        c.bytes.resize(hdr.size() + n * 3);
+        std::copy(hdr.begin(), hdr.end(), c.bytes.begin());
+        convert::to_rgb(src, c.bytes.data() + hdr.size(), n, cfg.bgra);
+        break;
+    }
+    }
+
+    return c;
+}
+
+void Capture::write_frame(converted& c)
+{
+    if (cfg.fmt == CaptureConfig::ppm) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%06llu.ppm",
+                      static_cast<unsigned long long>(c.frame));
+
+        const auto path = cfg.out / name;
+        std::ofstream out {path, std::ios::binary | std::ios::trunc};
+        out.write(reinterpret_cast<const char*>(c.bytes.data()),
+                  static_cast<std::streamsize>(c.bytes.size()));
+        if (!out) {
+            throw std::runtime_error {"couldn't write " + path.string()};
+        }
+
+        return;
+    }
+
+    if (width == 0) {
+        width = c.width;
+        height = c.height;
+
+        if (cfg.fmt == CaptureConfig::y4m) {
+            file << "YUV4MPEG2 W" << width << " H" << height
+                 << " F" << cfg.fps << ":1 Ip A1:1 C420jpeg\n";
+        }
+    }
+
+    file.write(reinterpret_cast<const char*>(c.bytes.data()),
+               static_cast<std::streamsize>(c.bytes.size()));
+    if (!file) {
+        throw std::runtime_error {"couldn't write " + cfg.out.string()};
+    }
+}
+
+void Capture::work()
+{
+    trace.name_thread("capture convert");
+
+    for (;;) {
+        job j;
+
+        {
+            std::unique_lock<std::mutex> lk {mtx};
+            work_cv.wait(lk, [this] { return stopping || !queue.empty(); });
+
+            // unlike the pipeline compiler, finish what's queued first
+            if (queue.empty()) {
+                return;
+            }
+
+            j = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        converted c;
+        try {
+            c = prepare(j);
+        } catch (...) {
+            // written as nothing, so the writer doesn't wait for it
+            std::lock_guard<std::mutex> lk {mtx};
+            if (!error) {
+                error = std::current_exception();
+            }
+            c = {j.frame, 0, 0, {}};
+        }
+
+        metrics.record("capture.convert_ms",
+                       std::chrono::steady_clock::now() - start);
+
+        // let the pixels go (giving a readback slot back, say) before
+        // waiting on the lock
+        j.px = {};
+
+        {
+            std::lock_guard<std::mutex> lk {mtx};
+            done.emplace(j.seq, std::move(c));
+        }
+        write_cv.notify_one();
+    }
+}
+
+void Capture::write()
+{
+    trace.name_thread("capture write");
+
+    for (;;) {
+        std::vector<converted> batch;
+
+        {
+            std::unique_lock<std::mutex> lk {mtx};
+            write_cv.wait(lk, [this] {
+                return done.contains(next_write)
+                       || (stopping && next_write == next_seq);
+            });
+
+            if (!done.contains(next_write)) {
+                return;
+            }
+
+            // every frame that's ready in order, up to a batch's worth
+
+            std::size_t bytes = 0;
+            for (auto it = done.find(next_write);
+                 it != done.end() && it->first == next_write
+                     && bytes < batch_bytes;
+                 it = done.erase(it), ++next_write) {
+                bytes += it->second.bytes.size();
+                batch.push_back(std::move(it->second));
+            }
+        }
+
+        CU_ZONE("Capture::write");
+
+        uint64_t wrote = 0;
+        uint64_t skipped = 0;
+
+        for (auto& c : batch) {
+            if (c.bytes.empty()) {
+                continue;
+            }
+
+            // the single-file formats can't change size partway through
+            if (cfg.fmt != CaptureConfig::ppm && width != 0
+                && (c.width != width || c.height != height)) {
+                ++skipped;
+                continue;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            try {
+                write_frame(c);
+                ++wrote;
+            } catch (...) {
+                std::lock_guard<std::mutex> lk {mtx};
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+
+            metrics.record("capture.write_ms",
+                           std::chrono::steady_clock::now() - start);
+        }
+
+        if (wrote) {
+            metrics.count("capture.written", wrote);
+        }
+        if (skipped) {
+            metrics.count("capture.dropped", skipped);
+        }
+
+        {
+            std::lock_guard<std::mutex> lk {mtx};
+            queued -= batch.size();
+            n_written += wrote;
+            n_dropped += skipped;
+        }
+        room_cv.notify_all();
+    }
+}
+
+} // namespace cu
@@ -22,9 +22,14 @@
 #include "cli.hpp"
 
 #include "game.hpp"
+#include "bench_report.hpp"
 
 #include <getopt.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <iostream>
+#include <stdexcept>
 
 namespace cu {
 
@@ -34,7 +39,16 @@ namespace cu {
 
 bool CLI::minicomp() const
 {
-    return !compute_shdr_path.empty();
+    return !compute_shdr_path.empty() || bnch || btch;
+}
+
+std::filesystem::path CLI::comp_path() const
+{
+    if (compute_shdr_path.empty() && (bnch || btch)) {
+        return BenchConfig::default_shader();
+    }
+
+    return compute_shdr_path;
 }
 
 CLI::CLI(int argc, char** argv)
@@ -51,17 +65,129 @@ CLI::CLI(int argc, char** argv)
         "                                      (silent without --log)\n"
         "    -a, --async-log                   Log messages asynchronously\n"
         "    -m, --minicomp=COMPUTE_SHADER     Run COMPUTE_SHADER in minicomp mode\n"
+        "        --metrics                     Print a table of timings and\n"
+        "                                      counters, and frame time\n"
+        "                                      percentiles, on exit\n"
+        "        --present-mode=MODE           Present with MODE (immediate,\n"
+        "                                      mailbox, fifo or fifo-relaxed)\n"
+        "        --images=N                    Ask for N swapchain images\n"
+        "        --fps-cap=FPS                 Render at most FPS frames per\n"
+        "                                      second\n"
+        "        --trace=FILE                  Record a Chrome trace (for\n"
+        "                                      Perfetto) of what each thread\n"
+        "                                      and the GPU are doing, written\n"
+        "                                      to FILE on exit or when F12 is\n"
+        "                                      pressed\n"
+        "        --headless[=WxH]              Render without a window, into\n"
+        "                                      offscreen images of WxH\n"
+        "                                      (default 1280x720)\n"
+        "        --frames=N                    With --headless, stop after N\n"
+        "                                      frames (default 1)\n"
+        "        --readback=FILE               With --headless, write the\n"
+        "                                      last frame to FILE as a PPM\n"
+        "        --batch[=DIR]                 Run minicomp headless over the\n"
+        "                                      PPMs in DIR, or over generated\n"
+        "                                      frames, as fast as the GPU\n"
+        "                                      allows, and print the images\n"
+        "                                      per second; the shader reads\n"
+        "                                      each input as a storage image\n"
+        "                                      at binding 2, if at all\n"
+        "        --batch-frames=N              Without DIR, run N frames\n"
+        "                                      (default 100)\n"
+        "        --capture=PATH                Write frames to PATH as\n"
+        "                                      they're rendered, without\n"
+        "                                      waiting on the disk (frames\n"
+        "                                      that can't keep up are\n"
+        "                                      dropped)\n"
+        "        --capture-format=FORMAT       Write them as FORMAT: y4m,\n"
+        "                                      raw (RGB24, one file) or ppm\n"
+        "                                      (a directory of PPMs); by\n"
+        "                                      default from PATH's extension\n"
+        "        --capture-every=N             Capture every Nth frame\n"
+        "                                      (default 1)\n"
+        "        --bench                       Benchmark minicomp, with time\n"
+        "                                      advancing a fixed step each\n"
+        "                                      frame and logging off (the\n"
+        "                                      shader defaults to\n"
+        "                                      "
+        + std::string{BenchConfig::default_shader_rel} + " beside\n"
+        "                                      the executable)\n"
+        "        --bench-frames=N              Measure N frames (default 600)\n"
+        "        --bench-time=SECONDS          Measure for SECONDS instead\n"
+        "        --bench-warmup=N              Render N frames before\n"
+        "                                      measuring (default 60)\n"
+        "        --bench-size=WxH              Render at WxH\n"
+        "        --bench-out=FILE              Write the results to FILE, as\n"
+        "                                      JSON or CSV by its extension\n"
+        "                                      (default JSON to stdout)\n"
+        "        --clock=CLOCK                 Take the time handed to the\n"
+        "                                      minicomp shader from CLOCK:\n"
+        "                                      real, fixed (1/60 s a frame),\n"
+        "                                      fixed:SECONDS (that much a\n"
+        "                                      frame) or script:FILE (the\n"
+        "                                      times in FILE, in seconds, one\n"
+        "                                      a line)\n"
         "    -h, --help                        Print this message and exit\n";
 
+    // long-only options
+    enum {
+        metrics_opt = 256,
+        present_mode_opt,
+        images_opt,
+        fps_cap_opt,
+        trace_opt,
+        headless_opt,
+        frames_opt,
+        readback_opt,
+        bench_opt,
+        bench_frames_opt,
+        bench_time_opt,
+        bench_warmup_opt,
+        bench_size_opt,
+        bench_out_opt,
+        clock_opt,
+        capture_opt,
+        capture_format_opt,
+        capture_every_opt,
+        batch_opt,
+        batch_frames_opt,
+    };
+
     constexpr struct option long_options[] = {
-        {"log",       no_argument,       NULL, 'l'},
-        {"debug",     no_argument,       NULL, 'd'},
-        {"async-log", no_argument,       NULL, 'a'},
-        {"minicomp",  required_argument, NULL, 'm'},
-        {"help",      no_argument,       NULL, 'h'},
+        {"log",          no_argument,       NULL, 'l'},
+        {"debug",        no_argument,       NULL, 'd'},
+        {"async-log",    no_argument,       NULL, 'a'},
+        {"minicomp",     required_argument, NULL, 'm'},
+        {"metrics",      no_argument,       NULL, metrics_opt},
+        {"present-mode", required_argument, NULL, present_mode_opt},
+        {"images",       required_argument, NULL, images_opt},
+        {"fps-cap",      required_argument, NULL, fps_cap_opt},
+        {"trace",        required_argument, NULL, trace_opt},
+        {"headless",     optional_argument, NULL, headless_opt},
+        {"frames",       required_argument, NULL, frames_opt},
+        {"readback",     required_argument, NULL, readback_opt},
+        {"bench",        no_argument,       NULL, bench_opt},
+        {"bench-frames", required_argument, NULL, bench_frames_opt},
+        {"bench-time",   required_argument, NULL, bench_time_opt},
+        {"bench-warmup", required_argument, NULL, bench_warmup_opt},
+        {"bench-size",   required_argument, NULL, bench_size_opt},
+        {"bench-out",    required_argument, NULL, bench_out_opt},
+        {"clock",        required_argument, NULL, clock_opt},
+        {"capture",      required_argument, NULL, capture_opt},
+        {"capture-format", required_argument, NULL, capture_format_opt},
+        {"capture-every", required_argument, NULL, capture_every_opt},
+        {"batch",        optional_argument, NULL, batch_opt},
+        {"batch-frames", required_argument, NULL, batch_frames_opt},
+        {"help",         no_argument,       NULL, 'h'},
         {0, 0, 0, 0},
     };
 
+    auto bad_arg = [&] {
+        outpt = "\n***\n\n" + help_txt;
+        hlp = true;
+        stat = EINVAL;
+    };
+
     int opt;
     while ((opt = getopt_long(argc, argv, "ldam:h", long_options, nullptr))
             != -1) {
@@ -83,10 +209,193 @@ CLI::CLI(int argc, char** argv)
             compute_shdr_path = {std::string(optarg)};
             std::cout << compute_shdr_path;
             break;
+        case metrics_opt:
+            mtrcs = true;
+            break;
+        case present_mode_opt:
+            pres_cfg.mode = PresentConfig::mode_from_str(optarg);
+            if (!pres_cfg.mode) {
+                bad_arg();
+            }
+            break;
+        case images_opt:
+            try {
+                int n = std::stoi(optarg);
+                if (n < 1) {
+                    bad_arg();
+                } else {
+                    pres_cfg.img_count = n;
+                }
+            } catch (const std::exception&) {
+                bad_arg();
+            }
+            break;
+        case fps_cap_opt:
+            try {
+                fps_cp = std::stod(optarg);
+                if (!(*fps_cp > 0)) {
+                    bad_arg();
+                }
+            } catch (const std::exception&) {
+                bad_arg();
+            }
+            break;
+        case trace_opt:
+            trace_pth = std::filesystem::path {optarg};
+            break;
+        case headless_opt:
+            hdls = true;
+            if (optarg) {
+                if (auto ext = HeadlessConfig::extent_from_str(optarg)) {
+                    hdls_cfg.extent = *ext;
+                } else {
+                    bad_arg();
+                }
+            }
+            break;
+        case frames_opt:
+            try {
+                auto n = std::stoll(optarg);
+                if (n < 1) {
+                    bad_arg();
+                } else {
+                    hdls_cfg.frames = static_cast<uint64_t>(n);
+                }
+            } catch (const std::exception&) {
+                bad_arg();
+            }
+            break;
+        case readback_opt:
+            hdls_cfg.readback = std::filesystem::path {optarg};
+            break;
+        case bench_opt:
+            bnch = true;
+            break;
+        case bench_frames_opt:
+        case bench_warmup_opt:
+            bnch = true;
+            try {
+                auto n = std::stoll(optarg);
+                if (n < (opt == bench_frames_opt ? 1 : 0)) {
+                    bad_arg();
+                } else if (opt == bench_frames_opt) {
+                    bnch_cfg.frames = static_cast<uint64_t>(n);
+                } else {
+                    bnch_cfg.warmup = static_cast<uint64_t>(n);
+                }
+            } catch (const std::exception&) {
+                bad_arg();
+            }
+            break;
+        case bench_time_opt:
+            bnch = true;
+            try {
+                auto secs = std::stod(optarg);
+                if (!(secs > 0)) {
+                    bad_arg();
+                } else {
+                    bnch_cfg.duration = std::chrono::duration<double> {secs};
+                }
+            } catch (const std::exception&) {
+                bad_arg();
+            }
+            break;
+        case bench_size_opt:
+            bnch = true;
+            if (auto ext = HeadlessConfig::extent_from_str(optarg)) {
+                bnch_cfg.extent = *ext;
+            } else {
+                bad_arg();
+            }
+            break;
+        case bench_out_opt:
+            bnch = true;
+            bnch_cfg.output = std::filesystem::path {optarg};
+            if (!BenchReport::format_for(bnch_cfg.output)) {
+                bad_arg();
+            }
+            break;
+        case clock_opt:
+            try {
+                clk = FrameClock::from_str(optarg);
+                if (!clk) {
+                    bad_arg();
+                }
+            } catch (const std::exception& e) {
+                bad_arg();
+                outpt = e.what() + outpt;
+            }
+            break;
+        case capture_opt:
+            captr = true;
+            captr_cfg.out = std::filesystem::path {optarg};
+            break;
+        case capture_format_opt:
+            captr_fmt = CaptureConfig::format_from_str(optarg);
+            if (!captr_fmt) {
+                bad_arg();
+            }
+            break;
+        case capture_every_opt:
+            try {
+                auto n = std::stoll(optarg);
+                if (n < 1 || n > UINT32_MAX) {
+                    bad_arg();
+                } else {
+                    captr_cfg.every = static_cast<uint32_t>(n);
+                }
+            } catch (const std::exception&) {
+                bad_arg();
+            }
+            break;
+        case batch_opt:
+            btch = true;
+            if (optarg) {
+                btch_cfg.input = std::filesystem::path {optarg};
+            }
+            break;
+        case batch_frames_opt:
+            btch = true;
+            try {
+                auto n = std::stoll(optarg);
+                if (n < 1) {
+                    bad_arg();
+                } else {
+                    btch_cfg.frames = static_cast<uint64_t>(n);
+                }
+            } catch (const std::exception&) {
+                bad_arg();
+            }
+            break;
         default:
-            outpt = "\n***\n\n" + help_txt;
-            hlp = true;
-            stat = EINVAL;
+            bad_arg();
+        }
+    }
+
+    // a batch never has a window, and isn't a benchmark of frames
+
+    if (btch) {
+        if (bnch) {
+            bad_arg();
+        }
+
+        hdls = true;
+    }
+
+    // capturing while benchmarking would be measured too
+
+    if (captr) {
+        if (bnch) {
+            bad_arg();
+        }
+
+        captr_cfg.fmt = captr_fmt ? *captr_fmt
+                                  : CaptureConfig::format_for(captr_cfg.out);
+
+        if (fps_cp) {
+            captr_cfg.fps = static_cast<uint32_t>(
+                std::max(1.0, std::round(*fps_cp))
+            );
         }
     }
 }
@@ -22,12 +22,17 @@
 #include "command_buffer.hpp"
 #include "vulkan.hpp"
 
+#include <algorithm>
+
 // TODO: fancier command buffer log output
 
 namespace cu {
 
-CommandBuffer::CommandBuffer(Device::ptr dev, CommandPool::ptr cmd_pool)
-    : pool {cmd_pool},
+CommandBuffer::CommandBuffer(Device::ptr dev,
+                             CommandPool::ptr cmd_pool,
+                             vk::CommandBufferLevel level)
+    : lvl {level},
+      pool {cmd_pool},
       GET_VK_FN_PTR(alloc, AllocateCommandBuffers),
       GET_VK_FN_PTR(vk_begin, BeginCommandBuffer),
       GET_VK_FN_PTR(bind_pipel, CmdBindPipeline),
@@ -35,31 +40,59 @@ CommandBuffer::CommandBuffer(Device::ptr dev, CommandPool::ptr cmd_pool)
       GET_VK_FN_PTR(pipel_barr, CmdPipelineBarrier),
       GET_VK_FN_PTR(vk_dispatch, CmdDispatch),
       GET_VK_FN_PTR(copy_image, CmdCopyImage),
+      GET_VK_FN_PTR(copy_img_to_buff, CmdCopyImageToBuffer),
+      GET_VK_FN_PTR(copy_buff_to_img, CmdCopyBufferToImage),
       GET_VK_FN_PTR(push_consts, CmdPushConstants),
+      GET_VK_FN_PTR(exec_cmds, CmdExecuteCommands),
+      GET_VK_FN_PTR(reset_queries, CmdResetQueryPool),
+      GET_VK_FN_PTR(write_ts, CmdWriteTimestamp),
+      GET_VK_FN_PTR(begin_query, CmdBeginQuery),
+      GET_VK_FN_PTR(end_query, CmdEndQuery),
       GET_VK_FN_PTR(vk_end, EndCommandBuffer)
 {
     VkCommandBufferAllocateInfo inf {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
         .pNext = NULL,
         .commandPool = pool->inner(),
-        .level = v(vk::CommandBufferLevel::prmry),
+        .level = v(lvl),
         .commandBufferCount = 1,
     };
 
     Vulkan::vk_try(alloc(dev->inner(), &inf, &nner),
                    "allocating command buffer from " + pool->descrptn());
+    log.indent();
+    log.enter("level", vk::cmmnd_buffer_level_str(lvl));
     log.brk();
 }
 
-CommandBuffer& CommandBuffer::record()
+CommandBuffer& CommandBuffer::record(vk::CommandBufferUsageFlags flags)
 {
+    // Secondaries have to supply this even outside of a render pass. We only
+    // record compute work, so there's no render pass or framebuffer to
+    // inherit.
+    VkCommandBufferInheritanceInfo inher_inf = {
+        .sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext                = NULL,
+        .renderPass           = VK_NULL_HANDLE,
+        .subpass              = 0,
+        .framebuffer          = VK_NULL_HANDLE,
+        .occlusionQueryEnable = VK_FALSE,
+        .queryFlags           = 0,
+        .pipelineStatistics   = 0,
+    };
+
     VkCommandBufferBeginInfo inf = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext = NULL,
-        .flags = v(vk::CommandBufferUsageFlag::one_time_submit),
-        .pInheritanceInfo = NULL,
+        .flags = flags,
+        .pInheritanceInfo = lvl == vk::CommandBufferLevel::scndry ?
+                                &inher_inf : NULL,
     };
 
+    bound = nullptr;
+    prof = nullptr;
+    open_zones.clear();
+
     Vulkan::vk_try(vk_begin(nner, &inf),
                    "beginning command buffer from " + pool->descrptn());
     if (inf.flags) {
@@ -74,6 +107,7 @@ CommandBuffer& CommandBuffer::record()
 CommandBuffer& CommandBuffer::bind(ComputePipeline& p)
 {
     bind_pipel(nner, VK_PIPELINE_BIND_POINT_COMPUTE, p.inner());
+    bound = &p;
     log.enter("Vulkan", "binding compute pipeline to command buffer from "
               + pool->descrptn());
     log.brk();
@@ -84,6 +118,14 @@ CommandBuffer& CommandBuffer::bind(ComputePipeline& p)
 CommandBuffer& CommandBuffer::bind(ComputePipeline& p,
                                    uint32_t set_bndng_offset,
                                    std::vector<VkDescriptorSet> sets)
+{
+    return bind(p, set_bndng_offset, sets, {});
+}
+
+CommandBuffer& CommandBuffer::bind(ComputePipeline& p,
+                                   uint32_t set_bndng_offset,
+                                   std::vector<VkDescriptorSet> sets,
+                                   std::vector<uint32_t> dyn_offsets)
 {
     bind(p);
 
@@ -93,11 +135,17 @@ CommandBuffer& CommandBuffer::bind(ComputePipeline& p,
                    set_bndng_offset,
                    sets.size(),
                    sets.data(),
-                   0,
-                   NULL);
+                   dyn_offsets.size(),
+                   dyn_offsets.data());
 
     log.enter("Vulkan", "binding desc sets to command buffer from "
               + pool->descrptn());
+    if (!dyn_offsets.empty()) {
+        log.indent();
+        for (auto o : dyn_offsets) {
+            log.enter("dynamic offset", o);
+        }
+    }
     log.brk();
 
     return *this;
@@ -123,6 +171,26 @@ CommandBuffer& CommandBuffer::dispatch(uint32_t x, uint32_t y, uint32_t z)
     return *this;
 }
 
+CommandBuffer& CommandBuffer::dispatch_over(VkExtent3D extent)
+{
+    if (!bound) {
+        throw std::runtime_error("can't dispatch_over() without a bound "
+                                 "compute pipeline");
+    }
+
+    const auto lsz = bound->local_size();
+    auto groups = [](uint32_t n, uint32_t sz) { return (n + sz - 1) / sz; };
+
+    return dispatch(groups(extent.width, lsz.x),
+                    groups(extent.height, lsz.y),
+                    groups(extent.depth, lsz.z));
+}
+
+CommandBuffer& CommandBuffer::dispatch_over(VkExtent2D extent)
+{
+    return dispatch_over({extent.width, extent.height, 1});
+}
+
 CommandBuffer& CommandBuffer::dispatch(uint32_t x, uint32_t y)
 {
     return dispatch(x, y, 1);
@@ -180,8 +248,176 @@ CommandBuffer& CommandBuffer::barrier(Image&                 img,
     return *this;
 }
 
+CommandBuffer& CommandBuffer::barrier(vk::PipelineStageFlag src_stage,
+                                      vk::PipelineStageFlag dst_stage,
+                                      vk::AccessFlag        src_access,
+                                      vk::AccessFlag        dst_access)
+{
+    VkMemoryBarrier barr {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = NULL,
+        .srcAccessMask = flgs(src_access),
+        .dstAccessMask = flgs(dst_access),
+    };
+
+    pipel_barr(nner,
+               flgs(src_stage),
+               flgs(dst_stage),
+               0,
+               1, &barr,
+               0, NULL,
+               0, NULL);
+
+    log.enter("Vulkan", "recording memory barrier to command buffer from "
+              + pool->descrptn());
+    log.indent();
+    log.enter("source stage", vk::pplne_stage_flag_str(src_stage));
+    log.enter("dest. stage", vk::pplne_stage_flag_str(dst_stage));
+    log.enter("source access", vk::access_flag_str(src_access));
+    log.enter("dest. access", vk::access_flag_str(dst_access));
+    log.brk();
+
+    return *this;
+}
+
+CommandBuffer&
+CommandBuffer::execute(const std::vector<CommandBuffer*>& secondaries)
+{
+    if (lvl != vk::CommandBufferLevel::prmry) {
+        throw std::runtime_error("only primary command buffers can execute "
+                                 "other command buffers");
+    }
+
+    std::vector<VkCommandBuffer> inners;
+    inners.reserve(secondaries.size());
+    for (auto b : secondaries) {
+        if (b->level() != vk::CommandBufferLevel::scndry) {
+            throw std::runtime_error("only secondary command buffers can be "
+                                     "executed from a primary");
+        }
+
+        inners.push_back(*b->inner());
+    }
+
+    if (inners.empty()) {
+        return *this;
+    }
+
+    exec_cmds(nner, inners.size(), inners.data());
+
+    log.enter("Vulkan", "recording execution of secondary command buffers to "
+              "command buffer from " + pool->descrptn());
+    log.indent();
+    log.enter("count", inners.size());
+    log.brk();
+
+    return *this;
+}
+
+CommandBuffer& CommandBuffer::profile(GpuProfiler& p, uint32_t slot)
+{
+    p.begin_slot(slot);
+
+    if (!p.enabled()) {
+        return *this;
+    }
+
+    prof = &p;
+    prof_slot = slot;
+
+    reset_queries(nner,
+                  prof->queries().inner(),
+                  prof->slot_first(slot),
+                  prof->slot_size());
+
+    if (prof->counting()) {
+        reset_queries(nner,
+                      prof->invocation_queries().inner(),
+                      prof->invocation_slot_first(slot),
+                      prof->slot_size() / 2);
+    }
+
+    log.enter("Vulkan", "profiling command buffer from "
+              + pool->descrptn() + " in slot " + std::to_string(slot));
+    log.brk();
+
+    return *this;
+}
+
+CommandBuffer& CommandBuffer::begin_zone(std::string name,
+                                         bool count_invocations)
+{
+    if (!prof) {
+        return *this;
+    }
+
+    auto counts = [](const GpuProfiler::ZoneQueries& z) {
+        return z.invocations.has_value();
+    };
+
+    if (count_invocations
+        && std::any_of(open_zones.begin(), open_zones.end(), counts)) {
+        throw std::runtime_error("can't count invocations in zone " + name
+                                 + " inside another zone that counts them");
+    }
+
+    const auto qs = prof->add_zone(prof_slot,
+                                   std::move(name),
+                                   count_invocations);
+
+    write_ts(nner,
+             v(vk::PipelineStageFlag::top_of_pipe),
+             prof->queries().inner(),
+             qs.timestamp);
+
+    if (qs.invocations) {
+        begin_query(nner,
+                    prof->invocation_queries().inner(),
+                    *qs.invocations,
+                    0);
+    }
+
+    open_zones.push_back(qs);
+
+    return *this;
+}
+
+CommandBuffer& CommandBuffer::end_zone()
+{
+    if (!prof) {
+        return *this;
+    }
+
+    if (open_zones.empty()) {
+        throw std::runtime_error("end_zone() without a matching "
+                                 "begin_zone()");
+    }
+
+    const auto qs = open_zones.back();
+    open_zones.pop_back();
+
+    if (qs.invocations) {
+        end_query(nner, prof->invocation_queries().inner(), *qs.invocations);
+    }
+
+    // the end of a zone waits for everything before it to finish
+
+    write_ts(nner,
+             v(vk::PipelineStageFlag::bottom_of_pipe),
+             prof->queries().inner(),
+             qs.timestamp + 1);
+
+    return *this;
+}
+
 CommandBuffer& CommandBuffer::end()
 {
+    if (!open_zones.empty()) {
+        throw std::runtime_error("ending command buffer from "
+                                 + pool->descrptn()
+                                 + " with a GPU profiler zone still open");
+    }
+
     Vulkan::vk_try(vk_end(nner),
                    "ending command buffer from " + pool->descrptn());
     log.brk();
@@ -216,6 +452,74 @@ CommandBuffer& CommandBuffer::copy(Image& from, Image& to)
     return *this;
 }
 
+CommandBuffer& CommandBuffer::copy(Image& from, Buffer& to)
+{
+    const auto ext = from.extent();
+
+    if (to.size() < VkDeviceSize {ext.width} * ext.height * ext.depth * 4) {
+        throw std::runtime_error("buffer is too small to copy the image "
+                                 "into");
+    }
+
+    VkBufferImageCopy inf {
+        .bufferOffset      = 0,
+        .bufferRowLength   = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource {
+            .aspectMask = flgs(vk::ImageAspectFlag::color),
+            .layerCount = 1,
+        },
+        .imageOffset = {0, 0, 0},
+        .imageExtent = ext,
+    };
+
+    copy_img_to_buff(nner,
+                     from.inner(), v(vk::ImageLayout::trnsfr_src_optml),
+                     to.inner(),
+                     1, &inf);
+
+    log.enter("Vulkan",
+              "recording image-to-buffer copy to command buffer from "
+                  + pool->descrptn());
+    log.brk();
+
+    return *this;
+}
+
+CommandBuffer& CommandBuffer::copy(Buffer& from, Image& to)
+{
+    const auto ext = to.extent();
+
+    if (from.size() < VkDeviceSize {ext.width} * ext.height * ext.depth * 4) {
+        throw std::runtime_error("buffer is too small to fill the image "
+                                 "from");
+    }
+
+    VkBufferImageCopy inf {
+        .bufferOffset      = 0,
+        .bufferRowLength   = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource {
+            .aspectMask = flgs(vk::ImageAspectFlag::color),
+            .layerCount = 1,
+        },
+        .imageOffset = {0, 0, 0},
+        .imageExtent = ext,
+    };
+
+    copy_buff_to_img(nner,
+                     from.inner(),
+                     to.inner(), v(vk::ImageLayout::trnsfr_dst_optml),
+                     1, &inf);
+
+    log.enter("Vulkan",
+              "recording buffer-to-image copy to command buffer from "
+                  + pool->descrptn());
+    log.brk();
+
+    return *this;
+}
+
 CommandBuffer& CommandBuffer::push_constants(ComputePipeline& pipel,
                                              PCRange& pcs)
 {
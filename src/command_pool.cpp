@@ -24,7 +24,9 @@
 
 namespace cu {
 
-CommandPool::CommandPool(Device::ptr l_dev, Device::QueueFlavor qflav)
+CommandPool::CommandPool(Device::ptr l_dev,
+                         Device::QueueFlavor qflav,
+                         vk::CommandPoolCreateFlags flags)
     : Deviced(l_dev,
               "command pool (" + l_dev->qflav_str(qflav) + ")",
               "CommandPool"),
@@ -35,7 +37,7 @@ CommandPool::CommandPool(Device::ptr l_dev, Device::QueueFlavor qflav)
     VkCommandPoolCreateInfo inf = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .pNext = NULL,
-        .flags = v(vk::CommandPoolCreateFlag::trnsnt),
+        .flags = flags,
         .queueFamilyIndex = l_dev->queue_ndx(flv),
     };
 
@@ -22,17 +22,75 @@
 #include "compute_pipeline.hpp"
 #include "vulkan.hpp"
 #include "log.hpp"
+#include "metrics.hpp"
 
 namespace cu {
 
+void check_spec_consts(const SpirvReflection& refl, SCRange& spec)
+{
+    for (const auto& e : spec.entries()) {
+        for (const auto& sc : refl.spec_constants()) {
+            if (sc.spec_id == e.constantID && sc.size != e.size) {
+                throw std::runtime_error(
+                    "specialization constant " + std::to_string(e.constantID)
+                    + (sc.name.empty() ? "" : " (" + sc.name + ")")
+                    + " is " + std::to_string(sc.size) + " bytes, but was "
+                    "given " + std::to_string(e.size)
+                );
+            }
+        }
+
+        if (e.offset + e.size > spec.size()) {
+            throw std::runtime_error("specialization constant "
+                                     + std::to_string(e.constantID)
+                                     + " lies outside its data");
+        }
+    }
+}
+
+ComputePipeline::LocalSize
+specialized_local_size(const SpirvReflection& refl, SCRange* spec)
+{
+    auto lcl_sz = refl.local_size();
+
+    if (spec) {
+        auto ids = refl.local_size_spec_ids();
+        uint32_t* axes[3] = {&lcl_sz.x, &lcl_sz.y, &lcl_sz.z};
+
+        for (std::size_t a = 0; a < 3; ++a) {
+            if (ids.at(a)) {
+                *axes[a] = spec->u32(*ids.at(a)).value_or(*axes[a]);
+            }
+        }
+    }
+
+    return lcl_sz;
+}
+
 ComputePipeline::ComputePipeline(Device::ptr l_dev,
                                  ShaderModule::ptr shader,
                                  PipelineLayout::ptr pipel_layt,
+                                 SCRange* spec,
+                                 std::optional<LocalSize> local_sz,
                                  vk::PipelineCreateFlags flags)
     : Deviced(l_dev, "compute pipeline", "ComputePipelines", "Pipeline"),
       shdr {shader},
-      pipelt {pipel_layt}
+      pipelt {pipel_layt},
+      lcl_sz {local_sz.value_or(
+          specialized_local_size(*shader->reflection(), spec)
+      )}
 {
+    if (lcl_sz.x == 0 || lcl_sz.y == 0 || lcl_sz.z == 0) {
+        throw std::runtime_error("compute pipeline local size must be nonzero "
+                                 "on every axis");
+    }
+
+    VkSpecializationInfo spec_inf = {};
+    if (spec) {
+        check_spec_consts(*shdr->reflection(), *spec);
+        spec_inf = spec->info();
+    }
+
     VkPipelineShaderStageCreateInfo shdr_stg_inf = {
         .sType               
             = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -41,27 +99,59 @@ ComputePipeline::ComputePipeline(Device::ptr l_dev,
         .stage               = v(vk::ShaderStageFlag::cmpte),
         .module              = shdr->inner(),
         .pName               = "main",
-        // TODO: specialization constants
+        .pSpecializationInfo = spec ? &spec_inf : NULL,
+    };
+
+    VkPipelineCreationFeedback pipel_fb = {};
+    VkPipelineCreationFeedback stage_fb = {};
+
+    VkPipelineCreationFeedbackCreateInfo fb_inf = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+        .pNext = NULL,
+        .pPipelineCreationFeedback          = &pipel_fb,
+        .pipelineStageCreationFeedbackCount = 1,
+        .pPipelineStageCreationFeedbacks    = &stage_fb,
     };
 
     VkComputePipelineCreateInfo create_inf = {
         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-        .pNext = NULL, // i think you can get pipeline creation feedback for
-                       // profiling here
+        .pNext = &fb_inf,
         .flags = flags,
         .stage = shdr_stg_inf,
         .layout = pipelt->inner(),
         // pipeline derivatives untouched
     };
 
+    auto start = std::chrono::steady_clock::now();
+
     Vulkan::vk_try(create(dev->inner(),
-                                      VK_NULL_HANDLE, // TODO: pipeline cache
+                                      dev->pipeline_cache(),
                                       1,
                                       &create_inf,
                                       NULL,
                                       &nner),
                    "create compute pipeline");
 
+    auto host_dur = std::chrono::steady_clock::now() - start;
+
+    feedback.valid = pipel_fb.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT;
+    if (feedback.valid) {
+        feedback.cache_hit =
+            pipel_fb.flags
+            & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT;
+        feedback.duration = std::chrono::nanoseconds {pipel_fb.duration};
+    } else {
+        feedback.duration =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(host_dur);
+    }
+
+    const std::string metric = "pipeline." + shader->name();
+    metrics.record(metric + ".create_ms", feedback.duration);
+    if (feedback.valid) {
+        metrics.count(feedback.cache_hit ? "pipeline_cache.hit"
+                                         : "pipeline_cache.miss");
+    }
+
     log.indent();
 
     auto flgs_cstrs = vk::pplne_create_flags_cstrs(flags);
@@ -70,6 +160,20 @@ ComputePipeline::ComputePipeline(Device::ptr l_dev,
     }
 
     log.enter("shader", shader->name());
+    if (spec) {
+        log.enter("specialization constants", spec->entries().size());
+    }
+    log.enter("local size", std::to_string(lcl_sz.x) + "x"
+                            + std::to_string(lcl_sz.y) + "x"
+                            + std::to_string(lcl_sz.z));
+    log.enter("creation time",
+              std::to_string(std::chrono::duration<double, std::milli>(
+                  feedback.duration
+              ).count()) + " ms" + (feedback.valid ? "" : " (host-measured)"));
+    log.enter("pipeline cache",
+              std::string(!feedback.valid     ? "unknown"
+                          : feedback.cache_hit ? "hit"
+                                               : "miss"));
     pipelt->log_attrs();
 }
 
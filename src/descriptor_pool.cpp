@@ -216,10 +216,59 @@ DescriptorPool::WriteCopyOps::storage_image(std::string desc_name,
     return *this;
 }
 
+DescriptorPool::WriteCopyOps&
+DescriptorPool::WriteCopyOps::uniform_buffer(std::string desc_name,
+                                             uint32_t binding_ndx,
+                                             uint32_t offset,
+                                             Buffer* b,
+                                             VkDeviceSize buff_offset,
+                                             VkDeviceSize range,
+                                             bool dynamic)
+{
+    if (!(b->usage() & flgs(vk::BufferUsageFlag::unfrm_buffer))) {
+        throw std::runtime_error("uniform buffers must have uniform buffer "
+                                 "usage");
+    }
+
+    buff_infs.push_back({
+        .buffer = b->inner(),
+        .offset = buff_offset,
+        .range  = range,
+    });
+
+    const auto type = dynamic ? vk::DescriptorType::unfrm_buffer_dynmc
+                              : vk::DescriptorType::unfrm_buffer;
+
+    writes.push_back({
+        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext           = NULL,
+        .dstSet          = pool[desc_name],
+        .dstBinding      = binding_ndx,
+        .dstArrayElement = offset,
+        .descriptorCount = 1,
+        .descriptorType  = v(type),
+        .pBufferInfo     = &buff_infs.back(),
+    });
+
+    std::string log_out = "descriptor pool: adding uniform buffer write";
+    log.enter("Vulkan", log_out);
+    log.indent();
+    log.enter("name", desc_name);
+    log.enter("binding", binding_ndx);
+    log.enter("offset", offset);
+    log.enter("buffer offset", buff_offset);
+    log.enter("range", range);
+    log.enter("dynamic", static_cast<int>(dynamic));
+    log.brk();
+
+    return *this;
+}
+
 void DescriptorPool::WriteCopyOps::clear()
 {
     writes = {};
     img_infs = {};
+    buff_infs = {};
     copies = {};
 }
 
@@ -27,11 +27,14 @@
 #include "vulkan.hpp"
 #include "command_buffer.hpp"
 #include "fence.hpp"
+#include "trace.hpp"
 
 #include <iostream>
 #include <functional>
 #include <algorithm>
+#include <array>
 #include <set>
+#include <utility>
 
 namespace cu {
 
@@ -53,6 +56,68 @@ uint32_t pick_queue_ndx(PhysDevice& phys_dev,
     return ndx;
 }
 
+uint32_t Device::timestamp_bits(QueueFlavor f) const
+{
+    const auto ndx = std::get<uint32_t>(queue_map.at(f));
+
+    for (const auto& fam : phys_dev.queue_families) {
+        if (fam.index() == ndx) {
+            return fam.timestamp_bits();
+        }
+    }
+
+    return 0;
+}
+
+// The extension to correlate the GPU's timestamps with the steady clock
+// through, if any. Only Linux is handled, where the steady clock is
+// CLOCK_MONOTONIC. The KHR extension is preferred if the headers know about
+// it; the EXT one is the same thing under an older name.
+const char* calibration_ext(PhysDevice& phys_dev, Instance::ptr inst)
+{
+#ifdef __linux__
+    std::vector<std::pair<const char*, const char*>> candidates;
+
+#ifdef VK_KHR_CALIBRATED_TIMESTAMPS_EXTENSION_NAME
+    candidates.push_back({VK_KHR_CALIBRATED_TIMESTAMPS_EXTENSION_NAME,
+                          "vkGetPhysicalDeviceCalibrateableTimeDomainsKHR"});
+#endif
+    candidates.push_back({VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME,
+                          "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"});
+
+    for (auto [ext, fn_name] : candidates) {
+        if (!phys_dev.supports(ext)) {
+            continue;
+        }
+
+        using get_domains_fn =
+            PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT;
+        auto get_domains =
+            reinterpret_cast<get_domains_fn>(inst->get_proc_addr(fn_name));
+
+        uint32_t cnt = 0;
+        Vulkan::vk_try(get_domains(phys_dev.inner(), &cnt, NULL),
+                       "getting calibrateable time domain count");
+        std::vector<VkTimeDomainEXT> domains(cnt);
+        Vulkan::vk_try(get_domains(phys_dev.inner(), &cnt, domains.data()),
+                       "getting calibrateable time domains");
+        log.brk();
+
+        auto has = [&domains](VkTimeDomainEXT d) {
+            return std::find(domains.begin(), domains.end(), d)
+                   != domains.end();
+        };
+
+        if (has(VK_TIME_DOMAIN_DEVICE_EXT)
+            && has(VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT)) {
+            return ext;
+        }
+    }
+#endif
+
+    return nullptr;
+}
+
 #define GET_QUEUE_DAT(name) \
     {\
         name##_queue,\
@@ -62,7 +127,7 @@ uint32_t pick_queue_ndx(PhysDevice& phys_dev,
         }\
     }
 
-Device::Device(PhysDevice physi_dev, Instance::ptr inst)
+Device::Device(PhysDevice physi_dev, Instance::ptr inst, bool presents)
     : phys_dev {physi_dev},
       GET_VK_FN_PTR_INST(create_dev, CreateDevice),
       GET_VK_FN_PTR_INST(get_dev_proc_addr, GetDeviceProcAddr),
@@ -73,6 +138,8 @@ Device::Device(PhysDevice physi_dev, Instance::ptr inst)
         GET_QUEUE_DAT(transfer),
       }
 {
+    CU_ZONE("Device::Device");
+
     std::set<uint32_t> indices_to_create;
     for (const auto& [_, t] : queue_map) {
         indices_to_create.insert(std::get<uint32_t>(t));
@@ -91,13 +158,18 @@ Device::Device(PhysDevice physi_dev, Instance::ptr inst)
         });
     }
 
-    const char* const ext_names[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    // a headless device never presents, and the driver may not even offer
+    // the swapchain extension (e.g. lavapipe without a display)
+
+    std::vector<const char*> ext_names;
+
+    if (presents) {
+        ext_names.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 
     for (auto&& n : ext_names) {
         std::string ext {n};
-        if (std::find(begin(phys_dev.extensions),
-                      end(phys_dev.extensions),
-                      ext) == std::end(phys_dev.extensions)) {
+        if (!phys_dev.supports(ext)) {
             throw std::runtime_error("device extension "
                                      + ext
                                      + " is not available!");
@@ -111,6 +183,72 @@ Device::Device(PhysDevice physi_dev, Instance::ptr inst)
     maint4_ftrs.pNext = &timel_sem_ftrs;
     dev_ftrs.pNext = &maint4_ftrs;
 
+    // present ids and waiting on them are only good for measuring latency,
+    // so they're turned on if they're there and otherwise done without
+
+    VkPhysicalDevicePresentIdFeaturesKHR pres_id_ftrs = phys_dev.present_id;
+    VkPhysicalDevicePresentWaitFeaturesKHR pres_wait_ftrs
+        = phys_dev.present_wait;
+
+    pres_wait = presents
+                && phys_dev.supports(VK_KHR_PRESENT_ID_EXTENSION_NAME)
+                && phys_dev.supports(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)
+                && pres_id_ftrs.presentId
+                && pres_wait_ftrs.presentWait;
+
+    void* ftrs_tail = NULL;
+
+    if (pres_wait) {
+        ext_names.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+        ext_names.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+        pres_wait_ftrs.pNext = ftrs_tail;
+        pres_id_ftrs.pNext = &pres_wait_ftrs;
+        ftrs_tail = &pres_id_ftrs;
+    }
+
+    log.enter("Vulkan: present wait",
+              std::string(pres_wait ? "enabled" : "unavailable"));
+    log.brk();
+
+    // present fences say when the presentation engine is done with a
+    // swapchain's images, so a retired one can be destroyed without stalling
+    // (see Swapchain::collect_retired()); the instance has to have enabled
+    // VK_EXT_surface_maintenance1 for them
+
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT swch_maint1_ftrs
+        = phys_dev.swch_maint1;
+
+    pres_fnces = presents
+                 && inst->enabled(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME)
+                 && phys_dev.supports(
+                        VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME
+                    )
+                 && swch_maint1_ftrs.swapchainMaintenance1;
+
+    if (pres_fnces) {
+        ext_names.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+        swch_maint1_ftrs.pNext = ftrs_tail;
+        ftrs_tail = &swch_maint1_ftrs;
+    }
+
+    timel_sem_ftrs.pNext = ftrs_tail;
+
+    log.enter("Vulkan: present fences",
+              std::string(pres_fnces ? "enabled" : "unavailable"));
+    log.brk();
+
+    // calibrated timestamps are likewise only for profiling
+
+    const char* calib_ext = calibration_ext(phys_dev, inst);
+
+    if (calib_ext) {
+        ext_names.push_back(calib_ext);
+    }
+
+    log.enter("Vulkan: calibrated timestamps",
+              std::string(calib_ext ? calib_ext : "unavailable"));
+    log.brk();
+
     VkDeviceCreateInfo dev_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pNext = &dev_ftrs,
@@ -119,8 +257,8 @@ Device::Device(PhysDevice physi_dev, Instance::ptr inst)
         .pQueueCreateInfos = queue_infos.data(),
         .enabledLayerCount = 0, // deprecated + ignored
         .ppEnabledLayerNames = NULL, // deprecated + ignored
-        .enabledExtensionCount = 1,
-        .ppEnabledExtensionNames = ext_names,
+        .enabledExtensionCount = static_cast<uint32_t>(ext_names.size()),
+        .ppEnabledExtensionNames = ext_names.data(),
         .pEnabledFeatures = NULL,
     };
 
@@ -137,7 +275,24 @@ Device::Device(PhysDevice physi_dev, Instance::ptr inst)
     GET_VK_FN_PTR_INNER(get_dev_queue, GetDeviceQueue);
     GET_VK_FN_PTR_INNER(queue_submit, QueueSubmit);
     GET_VK_FN_PTR_INNER(destroy_dev, DestroyDevice);
-    GET_VK_FN_PTR_INNER(queue_present, QueuePresentKHR);
+    GET_VK_FN_PTR_INNER(queue_wait_idle, QueueWaitIdle);
+
+    if (presents) {
+        GET_VK_FN_PTR_INNER(queue_present, QueuePresentKHR);
+    }
+
+    if (pres_wait) {
+        GET_VK_FN_PTR_INNER(wait_for_pres, WaitForPresentKHR);
+    }
+
+    if (calib_ext) {
+        get_calib_ts = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+            get_proc_addr(std::string {calib_ext}
+                          == VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME
+                              ? "vkGetCalibratedTimestampsEXT"
+                              : "vkGetCalibratedTimestampsKHR")
+        );
+    }
 
     for (const auto& [_, t] : queue_map) {
         get_dev_queue(dev,
@@ -153,10 +308,12 @@ Device::Device(PhysDevice physi_dev, Instance::ptr inst)
     log.brk();
 
     heap.construct(*this, phys_dev);
+    pl_cache.construct(*this, phys_dev);
 }
 
 Device::~Device() noexcept
 {
+    pl_cache.free_self(*this);
     log.attempt("Vulkan", "destroying logical device");
     heap.free_self(*this);
     destroy_dev(dev, NULL);
@@ -194,6 +351,12 @@ VkQueue Device::queue(QueueFlavor f)
 }
 
 void Device::submit(QueueFlavor f, CommandBuffer& buff, Fence& fnce)
+{
+    submit_async(f, buff, fnce);
+    fnce.wait();
+}
+
+void Device::submit_async(QueueFlavor f, CommandBuffer& buff, Fence& fnce)
 {
     VkSubmitInfo inf {
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
@@ -210,16 +373,89 @@ void Device::submit(QueueFlavor f, CommandBuffer& buff, Fence& fnce)
     Vulkan::vk_try(queue_submit(queue(f), 1, &inf, fnce.inner()),
                    "submitting to " + qflav_str(f) + " queue");
     log.brk();
+}
 
-    fnce.wait();
+void Device::submit_async(QueueFlavor f,
+                          CommandBuffer& buff,
+                          const std::vector<TimelinePoint>& waits,
+                          const std::vector<TimelinePoint>& signals)
+{
+    std::vector<VkSemaphore> wait_sems;
+    std::vector<uint64_t> wait_vals;
+    std::vector<VkPipelineStageFlags> wait_stages;
+    for (const auto& w : waits) {
+        wait_sems.push_back(w.sem);
+        wait_vals.push_back(w.val);
+        wait_stages.push_back(w.stage);
+    }
+
+    std::vector<VkSemaphore> sig_sems;
+    std::vector<uint64_t> sig_vals;
+    for (const auto& s : signals) {
+        sig_sems.push_back(s.sem);
+        sig_vals.push_back(s.val);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timel_inf {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = NULL,
+        .waitSemaphoreValueCount = static_cast<uint32_t>(wait_vals.size()),
+        .pWaitSemaphoreValues = wait_vals.data(),
+        .signalSemaphoreValueCount = static_cast<uint32_t>(sig_vals.size()),
+        .pSignalSemaphoreValues = sig_vals.data(),
+    };
+
+    VkSubmitInfo inf {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timel_inf,
+        .waitSemaphoreCount = static_cast<uint32_t>(wait_sems.size()),
+        .pWaitSemaphores = wait_sems.data(),
+        .pWaitDstStageMask = wait_stages.data(),
+        .commandBufferCount = 1,
+        .pCommandBuffers = buff.inner(),
+        .signalSemaphoreCount = static_cast<uint32_t>(sig_sems.size()),
+        .pSignalSemaphores = sig_sems.data(),
+    };
+
+    Vulkan::vk_try(queue_submit(queue(f), 1, &inf, VK_NULL_HANDLE),
+                   "submitting to " + qflav_str(f) + " queue");
+    log.brk();
 }
 
-bool Device::present(Swapchain& swch)
+bool Device::present(Swapchain& swch, uint64_t present_id)
 {
     // TODO: check for need to transfer image to present queue
 
+    VkPresentIdKHR pres_id {
+        .sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext          = NULL,
+        .swapchainCount = 1,
+        .pPresentIds    = &present_id,
+    };
+
+    VkFence pres_fnce = pres_fnces ? swch.present_fence() : VK_NULL_HANDLE;
+
+    VkSwapchainPresentFenceInfoEXT fnce_inf {
+        .sType          = VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT,
+        .pNext          = NULL,
+        .swapchainCount = 1,
+        .pFences        = &pres_fnce,
+    };
+
+    const void* next = NULL;
+
+    if (pres_fnces) {
+        next = &fnce_inf;
+    }
+
+    if (pres_wait && present_id != 0) {
+        pres_id.pNext = next;
+        next = &pres_id;
+    }
+
     VkPresentInfoKHR inf {
         .sType          = v(vk::StructureType::prsnt_info),
+        .pNext          = next,
         .swapchainCount = 1,
         .pSwapchains    = swch.inner(),
         .pImageIndices  = swch.ndx(),
@@ -238,14 +474,91 @@ bool Device::present(Swapchain& swch)
     return true;
 }
 
+bool Device::presented(Swapchain& swch, uint64_t present_id)
+{
+    if (!pres_wait) {
+        return false;
+    }
+
+    VkResult res = wait_for_pres(dev, *swch.inner(), present_id, 0);
+
+    if (res == VK_TIMEOUT || res == VK_ERROR_OUT_OF_DATE_KHR) {
+        return false;
+    }
+
+    Vulkan::vk_try(res, "checking whether present "
+                        + std::to_string(present_id)
+                        + " is on screen");
+    log.brk();
+
+    return true;
+}
+
+void Device::wait_idle(QueueFlavor f)
+{
+    Vulkan::vk_try(queue_wait_idle(queue(f)),
+                   "waiting for " + qflav_str(f) + " queue to go idle");
+    log.brk();
+}
+
 Heap::handle_t Device::alloc(Image& img)
 {
     return heap.alloc_on_dev(*this, img);
 }
 
+Heap::handle_t Device::alloc(Buffer& buff)
+{
+    return heap.alloc_on_dev(*this, buff);
+}
+
+void* Device::mapped(Heap::handle_t h)
+{
+    return heap.mapped(h);
+}
+
 void Device::release(Heap::handle_t h)
 {
     heap.release(h);
 }
 
+std::optional<Device::ClockSample> Device::sample_clocks()
+{
+    if (!get_calib_ts) {
+        return std::nullopt;
+    }
+
+    const std::array<VkCalibratedTimestampInfoEXT, 2> infs {{
+        {
+            .sType      = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+            .pNext      = NULL,
+            .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT,
+        },
+        {
+            .sType      = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+            .pNext      = NULL,
+            .timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT,
+        },
+    }};
+
+    std::array<uint64_t, 2> ts;
+    uint64_t max_dev;
+
+    Vulkan::vk_try(get_calib_ts(dev, infs.size(), infs.data(), ts.data(),
+                                &max_dev),
+                   "getting calibrated timestamps");
+    log.brk();
+
+    // CLOCK_MONOTONIC is the steady clock's epoch (see calibration_ext())
+
+    return ClockSample {
+        .gpu       = ts[0],
+        .cpu       = std::chrono::steady_clock::time_point {
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::nanoseconds {ts[1]}
+            )
+        },
+        .deviation = std::chrono::nanoseconds {max_dev},
+    };
+}
+
 } // namespace cu
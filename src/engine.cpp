@@ -22,9 +22,20 @@
 #include "engine.hpp"
 
 #include "log.hpp"
+#include "frame_stats.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "bench_report.hpp"
+#include "pixels.hpp"
+#include "capture.hpp"
 
+#include <algorithm>
 #include <chrono>
-#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace cu {
 
@@ -39,7 +50,11 @@ std::vector<const char*> Engine::layers()
 
 std::vector<const char*> Engine::extensions()
 {
-    auto exts = sdl.get_req_vulk_exts();
+    std::vector<const char*> exts;
+
+    if (sdl) {
+        exts = sdl->get_req_vulk_exts();
+    }
 
     if (dbg) {
         exts.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -48,14 +63,63 @@ std::vector<const char*> Engine::extensions()
     return exts;
 }
 
-Engine::Engine(bool debug)
+Engine::Engine(bool debug,
+               PresentConfig pres_cfg,
+               std::optional<double> fps_cap,
+               std::optional<HeadlessConfig> headless,
+               std::optional<BenchConfig> bench,
+               std::optional<FrameClock> clock,
+               std::optional<CaptureConfig> capture,
+               std::optional<BatchConfig> batch)
     :dbg(debug),
-     sdl{},
-     vulk{extensions(),
-          layers(),
-          sdl,
-          debug}
-{}
+     hdls{headless},
+     bnch{bench},
+     clk{clock},
+     captr{capture},
+     btch{batch}
+{
+    if (btch && !hdls) {
+        throw std::runtime_error("batches can only be run headless");
+    }
+
+    if (bnch && !clk) {
+        clk = FrameClock::fixed(bnch->time_step);
+    }
+
+    // frames are copied out of the swapchain images to capture them
+    if (captr && !hdls) {
+        pres_cfg.readable = true;
+    }
+
+    std::optional<WinSize> win_size;
+
+    if (bnch && bnch->extent) {
+        if (hdls) {
+            hdls->extent = *bnch->extent;
+        } else {
+            win_size = WinSize {static_cast<int>(bnch->extent->width),
+                                static_cast<int>(bnch->extent->height)};
+        }
+    }
+
+    if (hdls) {
+        vulk = std::make_unique<Vulkan>(hdls->extent,
+                                        extensions(),
+                                        layers(),
+                                        debug);
+    } else {
+        sdl.emplace(win_size);
+        vulk = std::make_unique<Vulkan>(extensions(),
+                                        layers(),
+                                        *sdl,
+                                        debug,
+                                        pres_cfg);
+    }
+
+    if (fps_cap) {
+        limiter.emplace(*fps_cap);
+    }
+}
 
 void Engine::mode(Mode new_mode)
 {
@@ -64,46 +128,359 @@ void Engine::mode(Mode new_mode)
     log.brk();
 }
 
-void Engine::add_shader(std::string name, BinData f)
+void Engine::add_shader(std::string name,
+                        BinData f,
+                        std::filesystem::path source)
 {
-    vulk.add_shader(name, f);
+    vulk->add_shader(name, f, source);
 }
 
 void Engine::minicomp_mode(std::filesystem::path comp_spv_path)
 {
     mode(minicomp);
-    std::ifstream comp_spv_f(comp_spv_path, std::ios::binary | std::ios::ate);
-    BinData::container_t::size_type comp_spv_sz;
-    if (comp_spv_f) {
-        comp_spv_sz = comp_spv_f.tellg();
+
+    add_shader(mode_str(), BinData::read_file(comp_spv_path), comp_spv_path);
+
+    // a batch brings its own images, so none of the setup for rendering
+    // frames is needed
+    if (btch) {
+        minicomp_batch();
+        return;
+    }
+
+    vulk->minicomp_setup();
+
+    if (clk) {
+        vulk->minicomp_clock(*clk);
+    }
+
+    if (bnch) {
+        minicomp_bench(comp_spv_path);
+    } else if (hdls) {
+        minicomp_headless();
     } else {
-        throw std::runtime_error("unable to open compiled shader at "
-                                 + comp_spv_path.string());
+        minicomp_loop();
     }
+}
 
-    add_shader(mode_str(), {comp_spv_f, comp_spv_sz});
-    vulk.minicomp_setup();
+void Engine::minicomp_loop()
+{
+    using clock = std::chrono::steady_clock;
+
+    std::optional<clock::time_point> last_start;
+    auto last_report = clock::now();
+
+    std::optional<Capture> capt;
+    if (captr) {
+        auto cfg = *captr;
+        cfg.bgra = vulk->read_back_bgra();
+        capt.emplace(cfg);
+    }
+
+    uint64_t frame = 0;
 
     bool quit = false;
     while (!quit) {
-        auto start = std::chrono::steady_clock::now();
-        sdl.poll();
+        // wait before polling rather than after rendering, so any input that
+        // comes in meanwhile still makes it into this frame
+
+        if (limiter) {
+            limiter->wait();
+        }
+
+        auto start = clock::now();
+        if (last_start) {
+            frame_stats.record(FrameStats::Phase::frame, start - *last_start);
+        }
+        last_start = start;
+
+        sdl->poll();
+        auto polled = clock::now();
+        frame_stats.record(FrameStats::Phase::poll, polled - start);
+        trace.complete("poll", start, polled);
 
-        if (sdl.quit()) {
+        if (sdl->quit()) {
             break;
         }
 
+        if (sdl->trace_requested() && trace.enabled()) {
+            try {
+                auto n = trace.dump();
+                log.enter("Engine", "wrote " + std::to_string(n)
+                                    + " trace events");
+            } catch (const std::exception& e) {
+                log.enter("Engine", std::string {e.what()});
+            }
+            log.brk();
+        }
+
+        if (sdl->resized()) {
+            vulk->window_resized();
+        }
+
+        if (capt) {
+            capture_frame(*capt, frame++);
+        }
+
         // render
-        vulk.minicomp_frame();
-        auto end = std::chrono::steady_clock::now();
+        vulk->minicomp_frame(sdl->input_time());
+
+        if (start - last_report >= stats_interval) {
+            log.enter("Engine: frame stats\n" + frame_stats.report());
+            log.brk();
+            last_report = start;
+        }
+    }
+
+    log.enter("Engine: frame stats at exit\n" + frame_stats.report());
+    log.brk();
+
+    if (capt) {
+        finish_capture(*capt);
+    }
+}
+
+void Engine::capture_frame(Capture& capt, uint64_t frame)
+{
+    if (!capt.wanted(frame)) {
+        return;
+    }
+
+    // the copy is handed over from a later frame, and only queued then;
+    // Capture's threads read it straight out of the staging buffer
+
+    bool started = vulk->read_back_next_frame(
+        [&capt, frame](PixelView px) {
+            capt.submit(frame, std::move(px));
+        }
+    );
+
+    if (!started) {
+        capt.missed();
+    }
+}
+
+void Engine::finish_capture(Capture& capt)
+{
+    vulk->flush_read_backs();
+    capt.finish();
+
+    log.enter("Engine", "captured " + std::to_string(capt.written())
+                        + " frames to " + captr->out.string() + " ("
+                        + std::to_string(capt.dropped()) + " dropped)");
+    log.brk();
+}
+
+void Engine::minicomp_headless()
+{
+    using clock = std::chrono::steady_clock;
+
+    std::optional<clock::time_point> last_start;
+
+    std::optional<Capture> capt;
+    if (captr) {
+        auto cfg = *captr;
+        cfg.bgra = vulk->read_back_bgra();
+        capt.emplace(cfg);
+    }
 
-        std::chrono::duration<double> dur = end - start;
+    for (uint64_t i = 0; i < hdls->frames; ++i) {
+        if (limiter) {
+            limiter->wait();
+        }
 
-        log.enter("Engine", "** END OF FRAME ** ("
-                  + std::to_string(dur.count())
-                  + " s.)");
+        auto start = clock::now();
+        if (last_start) {
+            frame_stats.record(FrameStats::Phase::frame, start - *last_start);
+        }
+        last_start = start;
+
+        if (capt) {
+            capture_frame(*capt, i);
+        }
+
+        vulk->minicomp_frame();
+    }
+
+    log.enter("Engine: frame stats at exit\n" + frame_stats.report());
+    log.brk();
+
+    if (capt) {
+        finish_capture(*capt);
+    }
+
+    if (!hdls->readback.empty()) {
+        write_ppm(hdls->readback, vulk->read_back_frame());
+
+        log.enter("Engine", "wrote the last frame to "
+                            + hdls->readback.string());
         log.brk();
     }
 }
 
+void Engine::minicomp_batch()
+{
+    std::vector<std::filesystem::path> inputs;
+
+    if (!btch->input.empty()) {
+        namespace fs = std::filesystem;
+
+        for (const auto& e : fs::directory_iterator {btch->input}) {
+            if (e.is_regular_file() && e.path().extension() == ".ppm") {
+                inputs.push_back(e.path());
+            }
+        }
+
+        if (inputs.empty()) {
+            throw std::runtime_error("no PPMs in " + btch->input.string());
+        }
+
+        std::sort(inputs.begin(), inputs.end());
+    }
+
+    // the first input sets the size; any others that don't match it are
+    // skipped
+
+    VkExtent2D extent = hdls->extent;
+    if (!inputs.empty()) {
+        const auto first = read_ppm(inputs.front());
+        extent = {first.width, first.height};
+    }
+
+    Batch::source_t src;
+    if (!inputs.empty()) {
+        src = [&inputs](uint64_t n) -> std::optional<Pixels> {
+            try {
+                return read_ppm(inputs[n]);
+            } catch (const std::exception& e) {
+                log.enter("Engine", std::string {e.what()});
+                log.brk();
+                return std::nullopt;
+            }
+        };
+    }
+
+    // every output is kept, however long the disk takes; the time spent
+    // waiting on it counts against the throughput
+
+    std::optional<Capture> capt;
+    if (captr) {
+        auto cfg = *captr;
+        cfg.block = true;
+        capt.emplace(cfg);
+    }
+
+    Batch::callback_t done;
+    if (capt) {
+        // the view is only good until this returns
+        done = [&capt](uint64_t n, const PixelView& px) {
+            if (capt->wanted(n)) {
+                capt->submit(n, px.copy());
+            }
+        };
+    }
+
+    const uint64_t count = inputs.empty() ? btch->frames : inputs.size();
+
+    auto res = vulk->minicomp_batch(
+        extent,
+        count,
+        btch->slots,
+        clk ? *clk : FrameClock::fixed(FrameClock::default_step),
+        src,
+        done
+    );
+
+    if (capt) {
+        capt->finish();
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "batch: " << res.images << " images ("
+        << extent.width << "x" << extent.height << ") in "
+        << std::setprecision(3) << res.elapsed.count() << " s, "
+        << std::setprecision(1) << res.per_sec() << " images/s";
+    if (res.skipped) {
+        out << ", " << res.skipped << " skipped";
+    }
+
+    std::cout << out.str() << "\n";
+    log.enter("Engine", out.str());
+    log.brk();
+}
+
+void Engine::minicomp_bench(const std::filesystem::path& comp_spv_path)
+{
+    using clock = std::chrono::steady_clock;
+
+    BenchReport rep;
+    rep.info("shader", comp_spv_path.string());
+    rep.info("mode", hdls ? "headless" : "windowed");
+    for (auto& [key, value] : vulk->describe()) {
+        rep.info(key, value);
+    }
+    rep.info("clock", clk->str());
+
+    // false if the window was closed
+
+    auto frame = [this] {
+        if (limiter) {
+            limiter->wait();
+        }
+
+        if (sdl) {
+            sdl->poll();
+            if (sdl->quit()) {
+                return false;
+            }
+
+            if (sdl->resized()) {
+                vulk->window_resized();
+            }
+        }
+
+        vulk->minicomp_frame();
+        return true;
+    };
+
+    for (uint64_t i = 0; i < bnch->warmup; ++i) {
+        if (!frame()) {
+            return;
+        }
+    }
+
+    // setup and warmup are left out of everything but the allocation counts
+    // and peak memory
+
+    rep.warmed_up(metrics);
+    metrics.clear();
+    frame_stats.clear();
+
+    const auto begin = clock::now();
+    uint64_t measured = 0;
+
+    while (bnch->duration ? clock::now() - begin < *bnch->duration
+                          : measured < bnch->frames) {
+        auto start = clock::now();
+        if (!frame()) {
+            break;
+        }
+        auto end = clock::now();
+
+        frame_stats.record(FrameStats::Phase::frame, end - start);
+        rep.frame(end - start);
+        ++measured;
+    }
+
+    rep.finish(frame_stats, metrics);
+
+    if (bnch->output.empty()) {
+        rep.write(std::cout, BenchReport::Format::json);
+    } else {
+        rep.write(bnch->output);
+        std::cerr << "wrote benchmark results to " << bnch->output << "\n";
+    }
+}
+
 } // namespace cu
@@ -32,7 +32,8 @@ Fence::Fence(Device::ptr l_dev, bool signaled)
               dev->get_proc_addr("vkWaitForFences")
           )
       },
-      GET_VK_FN_PTR(vk_reset, ResetFences)
+      GET_VK_FN_PTR(vk_reset, ResetFences),
+      GET_VK_FN_PTR(vk_status, GetFenceStatus)
 {
     vk::FenceCreateFlags flags = 0;
     if (signaled) flags = flgs(vk::FenceCreateFlag::sgnld);
@@ -72,4 +73,18 @@ void Fence::reset()
     log.brk();
 }
 
+bool Fence::signaled()
+{
+    auto res = vk_status(dev->inner(), nner);
+    if (res == VK_SUCCESS) {
+        return true;
+    } else if (res == VK_NOT_READY) {
+        return false;
+    }
+
+    // e.g. the device was lost
+    Vulkan::vk_try(res, "getting fence status");
+    return false;
+}
+
 } // namespace cu
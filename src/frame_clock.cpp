@@ -0,0 +1,166 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "frame_clock.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace cu {
+
+FrameClock FrameClock::fixed(seconds step)
+{
+    FrameClock c;
+    c.mde = Mode::fixed;
+    c.step = step;
+    return c;
+}
+
+FrameClock FrameClock::scripted(std::vector<seconds> times)
+{
+    if (times.empty()) {
+        throw std::runtime_error("a scripted clock needs at least one time");
+    }
+
+    FrameClock c;
+    c.mde = Mode::scripted;
+    c.script = std::move(times);
+    return c;
+}
+
+FrameClock FrameClock::read_script(const std::filesystem::path& path)
+{
+    std::ifstream f {path};
+    if (!f) {
+        throw std::runtime_error("couldn't open clock script "
+                                 + path.string());
+    }
+
+    std::vector<seconds> times;
+    std::string line;
+    for (int n = 1; std::getline(f, line); ++n) {
+        line = line.substr(0, line.find('#'));
+
+        const auto first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            continue;
+        }
+
+        std::size_t end = 0;
+        double t = 0;
+        try {
+            t = std::stod(line.substr(first), &end);
+        } catch (const std::exception&) {
+            end = 0;
+        }
+
+        const auto rest = line.find_first_not_of(" \t\r", first + end);
+        if (end == 0 || rest != std::string::npos) {
+            throw std::runtime_error(path.string() + ":" + std::to_string(n)
+                                     + ": expected a time in seconds");
+        }
+
+        times.push_back(seconds {t});
+    }
+
+    if (times.empty()) {
+        throw std::runtime_error("clock script " + path.string()
+                                 + " has no times in it");
+    }
+
+    auto c = scripted(std::move(times));
+    c.script_src = path.string();
+    return c;
+}
+
+std::optional<FrameClock> FrameClock::from_str(const std::string& s)
+{
+    if (s == "real") {
+        return FrameClock {};
+    } else if (s == "fixed") {
+        return fixed(default_step);
+    } else if (s.starts_with("fixed:")) {
+        try {
+            std::size_t end;
+            const auto secs = std::stod(s.substr(6), &end);
+            if (end != s.size() - 6 || !(secs > 0)) {
+                return std::nullopt;
+            }
+
+            return fixed(seconds {secs});
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    } else if (s.starts_with("script:") && s.size() > 7) {
+        return read_script(s.substr(7));
+    }
+
+    return std::nullopt;
+}
+
+FrameClock::seconds FrameClock::next(clock::time_point now)
+{
+    const auto n = frms++;
+
+    switch (mde) {
+    case Mode::fixed:
+        return step * n;
+    case Mode::scripted:
+        if (n < script.size()) {
+            return script[n];
+        } else if (script.size() == 1) {
+            return script.back();
+        } else {
+            const auto last = script.size() - 1;
+            const auto pace = script[last] - script[last - 1];
+            return script[last] + pace * (n - last);
+        }
+    case Mode::real:
+    default:
+        return now - start;
+    }
+}
+
+void FrameClock::restart(clock::time_point now)
+{
+    start = now;
+    frms = 0;
+}
+
+std::string FrameClock::str() const
+{
+    switch (mde) {
+    case Mode::fixed: {
+        char buf[48];
+        std::snprintf(buf, sizeof(buf), "fixed %.3f ms", step.count() * 1e3);
+        return buf;
+    }
+    case Mode::scripted:
+        return "scripted (" + std::to_string(script.size()) + " times"
+               + (script_src.empty() ? "" : " from " + script_src) + ")";
+    case Mode::real:
+    default:
+        return "real";
+    }
+}
+
+} // namespace cu
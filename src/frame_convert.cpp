@@ -0,0 +1,194 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "frame_convert.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#endif
+
+namespace cu {
+
+namespace convert {
+
+namespace {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Built for SSSE3 whatever the rest of the build targets, and only called
+// once the CPU is known to have it. Returns how many pixels it did; the rest
+// are left for the scalar loop.
+__attribute__((target("ssse3")))
+std::size_t to_rgb_ssse3(const uint8_t* src,
+                         uint8_t* dst,
+                         std::size_t pixels,
+                         bool bgra)
+{
+    // Four pixels at a time: one shuffle packs 16 bytes into 12, and the
+    // 16-byte store's last four bytes are overwritten by the next one. Stop
+    // while there's room past the end for that.
+
+    const __m128i mask = bgra
+        ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                        -1, -1, -1, -1)
+        : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14,
+                        -1, -1, -1, -1);
+
+    std::size_t i = 0;
+    for (; i + 8 <= pixels; i += 4) {
+        const __m128i px = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(src + i * 4)
+        );
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3),
+                         _mm_shuffle_epi8(px, mask));
+    }
+
+    return i;
+}
+
+#endif
+
+void to_rgb_from(std::size_t i,
+                 const uint8_t* src,
+                 uint8_t* dst,
+                 std::size_t pixels,
+                 bool bgra)
+{
+    const std::size_t r = bgra ? 2 : 0;
+    const std::size_t b = bgra ? 0 : 2;
+
+    for (; i < pixels; ++i) {
+        dst[i * 3]     = src[i * 4 + r];
+        dst[i * 3 + 1] = src[i * 4 + 1];
+        dst[i * 3 + 2] = src[i * 4 + b];
+    }
+}
+
+} // namespace
+
+bool simd()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+    return ssse3;
+#else
+    return false;
+#endif
+}
+
+void to_rgb(const uint8_t* src, uint8_t* dst, std::size_t pixels, bool bgra)
+{
+    std::size_t i = 0;
+
+#if defined(__x86_64__) || defined(__i386__)
+    if (simd()) {
+        i = to_rgb_ssse3(src, dst, pixels, bgra);
+    }
+#endif
+
+    to_rgb_from(i, src, dst, pixels, bgra);
+}
+
+void to_rgb_scalar(const uint8_t* src,
+                   uint8_t* dst,
+                   std::size_t pixels,
+                   bool bgra)
+{
+    to_rgb_from(0, src, dst, pixels, bgra);
+}
+
+namespace {
+
+// BT.601, limited range, in 8.8 fixed point
+
+inline uint8_t luma(int r, int g, int b)
+{
+    return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+inline uint8_t chroma_u(int r, int g, int b)
+{
+    return static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8)
+                                + 128);
+}
+
+inline uint8_t chroma_v(int r, int g, int b)
+{
+    return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8)
+                                + 128);
+}
+
+} // namespace
+
+void to_yuv420(const uint8_t* src,
+               uint32_t width,
+               uint32_t height,
+               uint8_t* dst,
+               bool bgra)
+{
+    const std::size_t r = bgra ? 2 : 0;
+    const std::size_t b = bgra ? 0 : 2;
+
+    const std::size_t cw = (width + 1) / 2;
+    const std::size_t ch = (height + 1) / 2;
+
+    uint8_t* __restrict ys = dst;
+    uint8_t* __restrict us = dst + std::size_t {width} * height;
+    uint8_t* __restrict vs = us + cw * ch;
+
+    for (std::size_t y = 0; y < height; ++y) {
+        const uint8_t* __restrict row = src + y * width * 4;
+        uint8_t* __restrict out = ys + y * width;
+
+        for (std::size_t x = 0; x < width; ++x) {
+            out[x] = luma(row[x * 4 + r], row[x * 4 + 1], row[x * 4 + b]);
+        }
+    }
+
+    for (std::size_t cy = 0; cy < ch; ++cy) {
+        // the last row and column are repeated for odd sizes
+        const std::size_t y0 = cy * 2;
+        const std::size_t y1 = y0 + 1 < height ? y0 + 1 : y0;
+        const uint8_t* row0 = src + y0 * width * 4;
+        const uint8_t* row1 = src + y1 * width * 4;
+
+        for (std::size_t cx = 0; cx < cw; ++cx) {
+            const std::size_t x0 = cx * 2 * 4;
+            const std::size_t x1 = cx * 2 + 1 < width ? x0 + 4 : x0;
+
+            auto avg = [&](std::size_t c) {
+                return (row0[x0 + c] + row0[x1 + c]
+                        + row1[x0 + c] + row1[x1 + c] + 2) / 4;
+            };
+
+            const int rr = avg(r);
+            const int gg = avg(1);
+            const int bb = avg(b);
+
+            us[cy * cw + cx] = chroma_u(rr, gg, bb);
+            vs[cy * cw + cx] = chroma_v(rr, gg, bb);
+        }
+    }
+}
+
+} // namespace convert
+
+} // namespace cu
@@ -0,0 +1,82 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "frame_limiter.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace cu {
+
+FrameLimiter::FrameLimiter(double fps)
+{
+    if (!(fps > 0)) {
+        throw std::runtime_error("frame rate cap must be positive");
+    }
+
+    perd = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double> {1.0 / fps}
+    );
+}
+
+void FrameLimiter::wait()
+{
+    auto now = clock::now();
+
+    if (!started) {
+        started = true;
+        next = now + perd;
+        return;
+    }
+
+    if (now - next > perd) {
+        next = now + perd;
+        return;
+    }
+
+    // sleep up to the margin, then see how late the wakeup was; if it ate
+    // into the margin, widen it, and otherwise let it creep back down
+
+    auto wake_at = next - mrgn;
+    if (now < wake_at) {
+        std::this_thread::sleep_until(wake_at);
+
+        auto late = clock::now() - wake_at;
+        if (late * 2 > mrgn) {
+            mrgn = late * 2;
+        } else {
+            mrgn -= mrgn / 32;
+        }
+
+        mrgn = std::min<clock::duration>(std::max<clock::duration>(mrgn,
+                                                                   min_margin),
+                                         perd);
+    }
+
+    while (clock::now() < next) {
+        std::this_thread::yield();
+    }
+
+    next += perd;
+}
+
+} // namespace cu
@@ -0,0 +1,204 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "frame_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace cu {
+
+FrameStats frame_stats;
+
+void FrameStats::record(Phase p, clock::duration d) noexcept
+{
+    auto& s = of(p);
+
+    const auto ns = static_cast<uint64_t>(
+        std::max<int64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(),
+            0
+        )
+    );
+
+    // the ring slot this sample goes in; once the ring has filled up, that
+    // slot's old sample has to come out of the histogram first
+
+    const auto n = s.written.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = s.ring[n % window];
+
+    if (n >= window) {
+        auto old = slot.load(std::memory_order_relaxed);
+        s.hist[bucket(old)].fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    slot.store(ns, std::memory_order_relaxed);
+    s.hist[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::size_t FrameStats::held(const series& s)
+{
+    return std::min<uint64_t>(s.written.load(std::memory_order_relaxed),
+                              window);
+}
+
+double FrameStats::quantile(const series& s, double q)
+{
+    uint64_t total = 0;
+    for (const auto& h : s.hist) {
+        total += h.load(std::memory_order_relaxed);
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    const auto rank = std::max<uint64_t>(
+        static_cast<uint64_t>(std::ceil(q * total)), 1
+    );
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < bucket_count; ++b) {
+        seen += s.hist[b].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // the middle of the bucket
+            const auto lo = bucket_floor(b);
+            const auto hi = b + 1 < bucket_count ? bucket_floor(b + 1) : lo;
+            return lo + (hi - lo) / 2.0;
+        }
+    }
+
+    return bucket_floor(bucket_count - 1);
+}
+
+FrameStats::Summary FrameStats::summary(Phase p) const
+{
+    const auto& s = of(p);
+    const auto cnt = held(s);
+
+    if (cnt == 0) {
+        return {};
+    }
+
+    uint64_t sum = 0;
+    uint64_t mx  = 0;
+    for (std::size_t i = 0; i < cnt; ++i) {
+        auto ns = s.ring[i].load(std::memory_order_relaxed);
+        sum += ns;
+        mx = std::max(mx, ns);
+    }
+
+    constexpr double ns_per_ms = 1e6;
+
+    // a percentile from the middle of a bucket can come out past the largest
+    // sample actually in it
+
+    auto pct = [&](double q) {
+        return std::min<double>(quantile(s, q), mx) / ns_per_ms;
+    };
+
+    return {
+        .count = cnt,
+        .mean  = static_cast<double>(sum) / cnt / ns_per_ms,
+        .p50   = pct(0.50),
+        .p95   = pct(0.95),
+        .p99   = pct(0.99),
+        .max   = mx / ns_per_ms,
+    };
+}
+
+double FrameStats::fps() const
+{
+    auto s = summary(Phase::frame);
+    return s.mean > 0 ? 1000.0 / s.mean : 0;
+}
+
+std::size_t FrameStats::hitches() const
+{
+    const auto& s = of(Phase::frame);
+    const auto cnt = held(s);
+    const double limit = hitch_factor * quantile(s, 0.5);
+
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < cnt; ++i) {
+        if (s.ring[i].load(std::memory_order_relaxed) > limit) {
+            ++n;
+        }
+    }
+
+    return n;
+}
+
+std::string FrameStats::report() const
+{
+    std::string out;
+    char buf[160];
+
+    for (std::size_t i = 0; i < phase_count; ++i) {
+        const auto p = static_cast<Phase>(i);
+        const auto s = summary(p);
+
+        if (s.count == 0) {
+            continue;
+        }
+
+        if (out.empty()) {
+            std::snprintf(buf, sizeof(buf),
+                          "%-10s %10s %10s %10s %10s %10s\n",
+                          "phase (ms)", "mean", "p50", "p95", "p99", "max");
+            out += buf;
+        }
+
+        std::snprintf(buf, sizeof(buf),
+                      "%-10s %10.4g %10.4g %10.4g %10.4g %10.4g\n",
+                      phase_name(p), s.mean, s.p50, s.p95, s.p99, s.max);
+        out += buf;
+    }
+
+    if (summary(Phase::frame).count > 0) {
+        std::snprintf(buf, sizeof(buf),
+                      "%.1f fps, %zu hitches over the last %zu of %llu "
+                      "frames\n",
+                      fps(),
+                      hitches(),
+                      held(of(Phase::frame)),
+                      static_cast<unsigned long long>(total_frames()));
+        out += buf;
+    }
+
+    return out;
+}
+
+void FrameStats::clear() noexcept
+{
+    for (auto& s : phases) {
+        s.written.store(0);
+        for (auto& r : s.ring) {
+            r.store(0);
+        }
+        for (auto& h : s.hist) {
+            h.store(0);
+        }
+    }
+}
+
+} // namespace cu
@@ -0,0 +1,276 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "gpu_profiler.hpp"
+
+#include "log.hpp"
+#include "metrics.hpp"
+#include "frame_stats.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace cu {
+
+GpuProfiler::GpuProfiler(Device::ptr l_dev,
+                         Device::QueueFlavor q_flav,
+                         uint32_t slots,
+                         uint32_t max_zones)
+    : dev {l_dev},
+      max_zns {max_zones},
+      ns_per_tick {l_dev->timestamp_period()},
+      track_name {"GPU (" + Device::qflav_str(q_flav) + " queue)"},
+      slts(slots)
+{
+    const auto bits = dev->timestamp_bits(q_flav);
+
+    if (bits == 0) {
+        log.enter("Vulkan: " + Device::qflav_str(q_flav)
+                  + " queue doesn't support timestamps; GPU profiling is off");
+        log.brk();
+        return;
+    }
+
+    ts_mask = bits >= 64 ? ~uint64_t {0} : (uint64_t {1} << bits) - 1;
+
+    pool = std::make_shared<QueryPool>(dev,
+                                       vk::QueryType::tmstmp,
+                                       slots * slot_size());
+
+    if (dev->pipeline_statistics()) {
+        stat_pool = std::make_shared<QueryPool>(
+            dev,
+            vk::QueryType::pplne_sttstcs,
+            slots * max_zns,
+            flgs(vk::QueryPipelineStatisticFlag::cmpte_shader_invctns)
+        );
+    } else {
+        log.enter("Vulkan: pipeline statistics queries are unsupported; GPU "
+                  "profiler zones won't count invocations");
+        log.brk();
+    }
+}
+
+void GpuProfiler::begin_slot(uint32_t slot)
+{
+    auto& s = slts.at(slot);
+    s.zones.clear();
+    s.pending = false;
+}
+
+GpuProfiler::ZoneQueries GpuProfiler::add_zone(uint32_t slot,
+                                               std::string name,
+                                               bool count_invocations)
+{
+    auto& s = slts.at(slot);
+
+    if (s.zones.size() >= max_zns) {
+        throw std::runtime_error("GPU profiler slot "
+                                 + std::to_string(slot)
+                                 + " has no room for zone "
+                                 + name);
+    }
+
+    const auto z = static_cast<uint32_t>(s.zones.size());
+    const bool counted = count_invocations && counting();
+
+    s.zones.push_back({
+        .name               = name,
+        .time_metric        = "gpu." + name + "_ms",
+        .invocations_metric = counted ? "gpu." + name + ".invocations" : "",
+        .counted            = counted,
+    });
+
+    ZoneQueries qs {
+        .timestamp = slot_first(slot) + 2 * z,
+    };
+
+    if (counted) {
+        qs.invocations = invocation_slot_first(slot) + z;
+    }
+
+    return qs;
+}
+
+void GpuProfiler::submitted(uint32_t slot)
+{
+    auto& s = slts.at(slot);
+    s.pending = !s.zones.empty();
+    s.submit_time = clock::now();
+}
+
+std::optional<GpuProfiler::clock::time_point>
+GpuProfiler::to_cpu_time(uint64_t t) const
+{
+    if (!calib) {
+        return std::nullopt;
+    }
+
+    // the timestamp can be from before the calibration as well as after, so
+    // the difference is taken modulo the valid bits and then sign-extended
+
+    const uint64_t diff = (t - calib->gpu) & ts_mask;
+    int64_t d = static_cast<int64_t>(diff);
+
+    if (ts_mask != ~uint64_t {0} && diff > (ts_mask >> 1)) {
+        d = -static_cast<int64_t>((ts_mask - diff) + 1);
+    }
+
+    return calib->cpu
+           + std::chrono::duration_cast<clock::duration>(
+               std::chrono::duration<double, std::nano> {d * ns_per_tick}
+           );
+}
+
+void GpuProfiler::recalibrate()
+{
+    if (!dev->calibrated_timestamps()
+        || (calib && clock::now() - calib->cpu < calibration_interval)) {
+        return;
+    }
+
+    calib = dev->sample_clocks();
+
+    if (calib) {
+        metrics.record("gpu.calibration_deviation_us",
+                       calib->deviation.count() / 1e3);
+    }
+}
+
+void GpuProfiler::collect()
+{
+    if (!enabled()) {
+        return;
+    }
+
+    recalibrate();
+
+    // oldest submission first, so each slot's idle time is measured from
+    // the one the GPU actually ran before it
+
+    std::vector<uint32_t> order;
+    for (uint32_t slot = 0; slot < slots(); ++slot) {
+        if (slts[slot].pending) {
+            order.push_back(slot);
+        }
+    }
+
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return slts[a].submit_time < slts[b].submit_time;
+    });
+
+    std::vector<uint64_t> stat;
+
+    for (auto slot : order) {
+        auto& s = slts[slot];
+
+        const auto n = static_cast<uint32_t>(s.zones.size());
+        if (!pool->results(slot_first(slot), 2 * n, ticks)) {
+            continue;
+        }
+
+        // only the zones that counted ever had their statistics queries
+        // begun, so the others' would never become available
+
+        invocs.assign(n, 0);
+        bool all_in = true;
+
+        for (uint32_t z = 0; z < n && all_in; ++z) {
+            if (s.zones[z].counted) {
+                all_in = stat_pool->results(invocation_slot_first(slot) + z,
+                                            1,
+                                            stat);
+                if (all_in) {
+                    invocs[z] = stat.at(0);
+                }
+            }
+        }
+
+        if (!all_in) {
+            continue;
+        }
+
+        // everything is measured from the start of the first zone, which
+        // was recorded first; differences are taken modulo the valid bits,
+        // so a counter that wrapped around in the meantime still comes out
+        // right
+
+        auto since_first = [this](uint64_t t) {
+            return static_cast<double>((t - ticks[0]) & ts_mask) * ns_per_tick;
+        };
+
+        double span = 0;
+
+        for (uint32_t z = 0; z < n; ++z) {
+            const auto start = since_first(ticks[2 * z]);
+            const auto end   = since_first(ticks[2 * z + 1]);
+
+            const auto& zn = s.zones[z];
+
+            metrics.record(zn.time_metric, (end - start) / 1e6);
+            span = std::max(span, end);
+
+            if (zn.counted) {
+                metrics.record(zn.invocations_metric,
+                               static_cast<double>(invocs[z]));
+            }
+
+            if (trace.enabled()) {
+                auto cpu_start = to_cpu_time(ticks[2 * z]);
+                auto cpu_end   = to_cpu_time(ticks[2 * z + 1]);
+
+                if (cpu_start && cpu_end) {
+                    trace.complete(trace.track(track_name),
+                                   trace.intern(zn.name),
+                                   *cpu_start,
+                                   *cpu_end);
+                }
+            }
+        }
+
+        const auto span_dur =
+            std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<double, std::nano> {span}
+            );
+
+        frame_stats.record(FrameStats::Phase::gpu, span_dur);
+
+        if (auto start = to_cpu_time(ticks[0])) {
+            metrics.record("gpu.submit_to_start_ms",
+                           std::max(*start - s.submit_time,
+                                    clock::duration::zero()));
+
+            if (last_end) {
+                metrics.record("gpu.idle_ms",
+                               std::max(*start - *last_end,
+                                        clock::duration::zero()));
+            }
+
+            last_end = std::max(last_end.value_or(*start), *start + span_dur);
+        }
+
+        s.pending = false;
+    }
+}
+
+} // namespace cu
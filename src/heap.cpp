@@ -22,19 +22,46 @@
 #include "heap.hpp"
 #include "iec_ibyte.hpp"
 #include "vulkan.hpp"
+#include "buffer.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+
+#include <algorithm>
 
 namespace cu {
 
 void Heap::construct(Device& dev, PhysDevice ph_dev)
 {
+    CU_ZONE("Heap::construct");
+
     largest_dev_heap = ph_dev.largest_dev_local_heap();
 
     main_pool = Pool (
+        "main pool",
         largest_dev_heap.size() > 1_GiB ?
             256_MiB : largest_dev_heap.size() / 8,
         largest_dev_heap.optimal_type()
     );
 
+    // This only needs to hold small, frequently-rewritten buffers. Keep it
+    // modest, as on some discrete cards the host-visible device-local heap is
+    // only 256 MiB in total.
+    host_pool = Pool (
+        "host pool",
+        16_MiB,
+        ph_dev.host_visible_type(),
+        host_bit
+    );
+
+    // Big enough for a pair of 4K RGBA8 frames. Memory for it is only
+    // allocated once a buffer asks for it (see alloc_on_dev()).
+    readback_pool = Pool (
+        "readback pool",
+        128_MiB,
+        ph_dev.readback_type(),
+        readback_bit
+    );
+
     alloc_mem = reinterpret_cast<PFN_vkAllocateMemory>(
         dev.get_proc_addr("vkAllocateMemory")
     );
@@ -43,41 +70,92 @@ void Heap::construct(Device& dev, PhysDevice ph_dev)
         dev.get_proc_addr("vkFreeMemory")
     );
 
+    map_mem = reinterpret_cast<PFN_vkMapMemory>(
+        dev.get_proc_addr("vkMapMemory")
+    );
+
+    invalidate_ranges = reinterpret_cast<PFN_vkInvalidateMappedMemoryRanges>(
+        dev.get_proc_addr("vkInvalidateMappedMemoryRanges")
+    );
+
+    flush_ranges = reinterpret_cast<PFN_vkFlushMappedMemoryRanges>(
+        dev.get_proc_addr("vkFlushMappedMemoryRanges")
+    );
+
     bind_img_mem = reinterpret_cast<PFN_vkBindImageMemory>(
         dev.get_proc_addr("vkBindImageMemory")
     );
 
-    VkMemoryAllocateInfo main_pool_alloc_inf {
+    bind_buff_mem = reinterpret_cast<PFN_vkBindBufferMemory>(
+        dev.get_proc_addr("vkBindBufferMemory")
+    );
+
+    alloc_pool(dev, main_pool);
+    alloc_pool(dev, host_pool);
+    map_pool(dev, host_pool);
+}
+
+void Heap::map_pool(Device& dev, Pool& pool)
+{
+    Vulkan::vk_try(map_mem(dev.inner(),
+                           pool.nner,
+                           0,
+                           VK_WHOLE_SIZE,
+                           0,
+                           &pool.mapped),
+                   "mapping " + pool.name + " memory");
+    log.brk();
+}
+
+void Heap::alloc_pool(Device& dev, Pool& pool)
+{
+    VkMemoryAllocateInfo alloc_inf {
         .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
         .pNext           = NULL,
-        .allocationSize  = main_pool.sz,
-        .memoryTypeIndex = main_pool.type.ndx(),
+        .allocationSize  = pool.sz,
+        .memoryTypeIndex = pool.type.ndx(),
     };
 
     Vulkan::vk_try(alloc_mem(dev.inner(),
-                             &main_pool_alloc_inf,
+                             &alloc_inf,
                              NULL,
-                             &main_pool.nner),
-                   "allocating main pool memory");
+                             &pool.nner),
+                   "allocating " + pool.name + " memory");
     log.indent();
-    log.enter("heap", largest_dev_heap.ndx());
-    log.enter("type", main_pool.type.ndx());
-    log.enter("amount", main_pool.sz);
+    log.enter("heap", pool.type.heap_ndx());
+    log.enter("type", pool.type.ndx());
+    log.enter("amount", pool.sz);
     log.brk();
 }
 
 void Heap::free_self(Device& dev) noexcept
 {
-    log.attempt("Vulkan", "freeing main pool");
-    free_mem(dev.inner(), main_pool.nner, NULL);
-    log.finish();
-    log.brk();
+    // vkFreeMemory unmaps the mapped pools implicitly
+    for (auto pool : {&main_pool, &host_pool, &readback_pool}) {
+        if (pool->nner == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        log.attempt("Vulkan", "freeing " + pool->name);
+        free_mem(dev.inner(), pool->nner, NULL);
+        log.finish();
+        log.brk();
+    }
 }
 
-Heap::Pool::Pool(VkDeviceSize size, MemoryType mem_type)
-    : sz {size},
-      type {mem_type}
+Heap::Pool::Pool(std::string pool_name,
+                 VkDeviceSize size,
+                 MemoryType mem_type,
+                 handle_t handle_tag)
+    : name {pool_name},
+      sz {size},
+      type {mem_type},
+      tag {handle_tag},
+      next_handle {handle_tag | (null_handle + 1)},
+      metric {"heap." + pool_name}
 {
+    std::replace(metric.begin(), metric.end(), ' ', '_');
+
     blocks = new Block { .front = true };
     blocks->nxt = new Block { .sz = sz, .offset = 0 };
     blocks->prv = blocks->nxt;
@@ -88,25 +166,34 @@ Heap::Pool::Pool(VkDeviceSize size, MemoryType mem_type)
 }
 
 Heap::Pool::Pool(Heap::Pool&& other)
-    : nner        {other.nner},
-      sz          {other.sz},
-      type        {other.type},
-      blocks      {other.blocks},
-      next_handle {other.next_handle}
+    : name           {other.name},
+      nner           {other.nner},
+      sz             {other.sz},
+      type           {other.type},
+      blocks         {other.blocks},
+      tag            {other.tag},
+      next_handle    {other.next_handle},
+      mapped         {other.mapped},
+      should_destroy {other.should_destroy},
+      in_use         {other.in_use},
+      metric         {other.metric}
 {
     other.should_destroy = false;
 }
 
 Heap::Pool& Heap::Pool::operator=(Heap::Pool&& other)
 {
+    std::swap(name, other.name);
     std::swap(nner, other.nner);
     std::swap(sz, other.sz);
     std::swap(type, other.type);
-    blocks = other.blocks;
-    other.blocks = nullptr;
+    std::swap(blocks, other.blocks);
+    std::swap(tag, other.tag);
     std::swap(next_handle, other.next_handle);
-
-    other.should_destroy = false;
+    std::swap(mapped, other.mapped);
+    std::swap(should_destroy, other.should_destroy);
+    std::swap(in_use, other.in_use);
+    std::swap(metric, other.metric);
 
     return *this;
 }
@@ -188,20 +275,21 @@ Heap::Block* Heap::Pool::reserve_space(VkDeviceSize sz, VkDeviceSize alignment)
 
             end = start + sz;
 
-            return b->sz > sz && b->end() > end;
+            return b->end() >= end;
         } else {
             return false;
         }
     };
 
-    log.attempt("Vulkan", "finding free block in main pool");
+    log.attempt("Vulkan", "finding free block in " + name);
     Block* free_b = blocks->nxt;
-    for (; !free_b->front && find_free(free_b); free_b = free_b->nxt) {
-        if (free_b->front) {
-            throw std::runtime_error("no space left in main pool "
-                                     "(PLACEHOLDER: reserve more memory)");
-            log.finish();
-        }
+    while (!free_b->front && !find_free(free_b)) {
+        free_b = free_b->nxt;
+    }
+
+    if (free_b->front) {
+        throw std::runtime_error("no space left in " + name
+                                 + " (PLACEHOLDER: reserve more memory)");
     }
 
     log.indent();
@@ -213,8 +301,8 @@ Heap::Block* Heap::Pool::reserve_space(VkDeviceSize sz, VkDeviceSize alignment)
         .avail  = false,
     };
 
-    if (next_handle == null_handle) {
-        next_handle = 1;
+    if ((next_handle & ~tag) == null_handle) {
+        next_handle = tag | (null_handle + 1);
     }
 
     if (free_b->offset < start) {
@@ -267,6 +355,10 @@ Heap::Block* Heap::Pool::reserve_space(VkDeviceSize sz, VkDeviceSize alignment)
 
     log.brk();
 
+    in_use += reserved->sz;
+    metrics.count(metric + ".allocs");
+    note_usage();
+
     return reserved;
 }
 
@@ -288,21 +380,183 @@ Heap::handle_t Heap::alloc_on_dev(Device& dev, Image& img)
     return block->handle;
 }
 
+Heap::handle_t Heap::alloc_on_dev(Device& dev, Buffer& buff)
+{
+    Pool& pool = pool_for(buff.location());
+
+    if (pool.nner == VK_NULL_HANDLE) {
+        alloc_pool(dev, pool);
+        map_pool(dev, pool);
+    }
+
+    if (!buff.mem_type_supported(pool.type)) {
+        throw std::runtime_error(pool.name + " memory does not support this "
+                                 "type of buffer");
+    }
+
+    auto block = pool.reserve_space(buff.mem_size(), buff.alignment());
+    Vulkan::vk_try(bind_buff_mem(dev.inner(),
+                                 buff.inner(),
+                                 pool.nner,
+                                 block->offset),
+                   "binding buffer to memory");
+    log.brk();
+
+    return block->handle;
+}
+
+VkDeviceSize Heap::available(Location loc)
+{
+    const auto& pool = pool_for(loc);
+    return pool.sz - pool.in_use;
+}
+
+Heap::Pool& Heap::pool_for(handle_t h)
+{
+    if (h & host_bit) {
+        return host_pool;
+    } else if (h & readback_bit) {
+        return readback_pool;
+    }
+
+    return main_pool;
+}
+
+Heap::Pool& Heap::pool_for(Location loc)
+{
+    switch (loc) {
+    case Location::host:
+        return host_pool;
+    case Location::readback:
+        return readback_pool;
+    case Location::device:
+    default:
+        return main_pool;
+    }
+}
+
+Heap::Block* Heap::Pool::find(Heap::handle_t h)
+{
+    Block* p = blocks->nxt;
+    for (; !p->front && p->handle != h; p = p->nxt);
+
+    return p->front ? nullptr : p;
+}
+
+void* Heap::mapped(handle_t h)
+{
+    if (h == null_handle) {
+        return nullptr;
+    }
+
+    Pool& pool = pool_for(h);
+    if (!pool.mapped) {
+        return nullptr;
+    }
+
+    Block* b = pool.find(h);
+    if (!b) {
+        return nullptr;
+    }
+
+    return static_cast<char*>(pool.mapped) + b->offset;
+}
+
 void Heap::Pool::release(Heap::handle_t h)
 {
     if (h == null_handle) {
         return;
     }
 
-    Block* p = blocks->nxt;
-    for (; !p->front && p->handle != h; p = p->nxt);
+    Block* p = find(h);
+    if (!p) {
+        return;
+    }
+
+    // hand the space back, merging with free neighbors so the pool doesn't
+    // splinter into pieces too small to reuse
+
+    p->avail = true;
+    p->handle = null_handle;
+
+    in_use -= p->sz;
+    metrics.count(metric + ".frees");
+    note_usage();
+
+    if (!p->nxt->front && p->nxt->avail) {
+        p->sz += p->nxt->sz;
+        p->nxt->erase();
+    }
+
+    if (!p->prv->front && p->prv->avail) {
+        p->prv->sz += p->sz;
+        p->erase();
+    }
+}
+
+void Heap::invalidate(Device& dev, handle_t h)
+{
+    if (h == null_handle) {
+        return;
+    }
+
+    Pool& pool = pool_for(h);
+    if (!pool.mapped || pool.type.host_coherent()) {
+        return;
+    }
+
+    // the whole pool, which saves rounding the block out to
+    // nonCoherentAtomSize and costs nothing extra on the devices that
+    // actually need this
+
+    VkMappedMemoryRange range {
+        .sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .pNext  = NULL,
+        .memory = pool.nner,
+        .offset = 0,
+        .size   = VK_WHOLE_SIZE,
+    };
+
+    Vulkan::vk_try(invalidate_ranges(dev.inner(), 1, &range),
+                   "invalidating " + pool.name + " memory");
+    log.brk();
+}
+
+void Heap::flush(Device& dev, handle_t h)
+{
+    if (h == null_handle) {
+        return;
+    }
+
+    Pool& pool = pool_for(h);
+    if (!pool.mapped || pool.type.host_coherent()) {
+        return;
+    }
 
-    if (!p->front) p->erase();
+    // the whole pool, as with invalidate()
+
+    VkMappedMemoryRange range {
+        .sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .pNext  = NULL,
+        .memory = pool.nner,
+        .offset = 0,
+        .size   = VK_WHOLE_SIZE,
+    };
+
+    Vulkan::vk_try(flush_ranges(dev.inner(), 1, &range),
+                   "flushing " + pool.name + " memory");
+    log.brk();
+}
+
+void Heap::Pool::note_usage() const
+{
+    metrics.record(metric + ".in_use_mib",
+                   static_cast<double>(in_use) / 1_MiB);
 }
 
 void Heap::release(handle_t h)
 {
-    main_pool.release(h);
+    pool_for(h).release(h);
 }
 
 } // namespace cu
@@ -86,7 +86,7 @@ Image::Image(Device::ptr l_dev, const Image::params& ps)
     get_mem_reqs(_dev->inner(), _img, &mem_reqs);
     supported_types = {mem_reqs.memoryTypeBits};
 
-    _dev->alloc(*this);
+    mem = _dev->alloc(*this);
 }
 
 Image::Image(VkImage existing,
@@ -26,6 +26,7 @@
 #include "vulkan.hpp"
 #include "sdl.hpp"
 #include "game.hpp"
+#include "trace.hpp"
 
 #include <vulkan/vulkan_core.h>
 
@@ -81,8 +82,9 @@ void Instance::check_avail_layers(const std::vector<const char*>& layers)
     }
 }
 
-void Instance::check_avail_exts(const std::vector<const char*>& exts,
-                                const std::vector<const char*>& layers)
+std::vector<std::string>
+Instance::check_avail_exts(const std::vector<const char*>& exts,
+                           const std::vector<const char*>& layers)
 {
     std::vector<std::string> avail_exts;
 
@@ -124,11 +126,15 @@ void Instance::check_avail_exts(const std::vector<const char*>& exts,
             throw std::runtime_error("extension " + ext + " not available!");
         }
     }
+
+    return avail_exts;
 }
 
 Instance::Instance(std::vector<const char*> exts,
-                   std::vector<const char*> layers)
-    :get_inst_proc_addr{SDL::get_get_inst_proc_addr()},
+                   std::vector<const char*> layers,
+                   PFN_vkGetInstanceProcAddr gipa,
+                   std::vector<const char*> opt_exts)
+    :get_inst_proc_addr{gipa ? gipa : SDL::get_get_inst_proc_addr()},
      enum_inst_layer_props {
          reinterpret_cast<PFN_vkEnumerateInstanceLayerProperties>(
              get_inst_proc_addr(NULL, "vkEnumerateInstanceLayerProperties")
@@ -145,13 +151,32 @@ Instance::Instance(std::vector<const char*> exts,
          )
      }
 {
+    CU_ZONE("Instance::Instance");
+
     // TODO: replace with `expects` when e.g. debian stable moves
     // to gcc 10 (i.e. contracts become available)
     check_under_uint32(exts, "extensions");
     check_under_uint32(layers, "layers");
 
     check_avail_layers(layers);
-    check_avail_exts(exts, layers);
+    const auto avail_exts = check_avail_exts(exts, layers);
+
+    const bool opt_avail = std::all_of(
+        opt_exts.begin(),
+        opt_exts.end(),
+        [&avail_exts](const char* e) {
+            return std::find(avail_exts.begin(), avail_exts.end(),
+                             std::string{e})
+                   != avail_exts.end();
+        }
+    );
+
+    if (opt_avail) {
+        exts.insert(exts.end(), opt_exts.begin(), opt_exts.end());
+        check_under_uint32(exts, "extensions");
+    }
+
+    enabled_exts.assign(exts.begin(), exts.end());
 
     VkApplicationInfo app_info = {
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -209,4 +234,10 @@ PFN_vkVoidFunction Instance::get_proc_addr(const char* name)
     return fn;
 }
 
+bool Instance::enabled(const std::string& ext) const
+{
+    return std::find(enabled_exts.begin(), enabled_exts.end(), ext)
+           != enabled_exts.end();
+}
+
 } // namespace cu
@@ -32,6 +32,8 @@ namespace cu {
 // global log
 Log log;
 
+thread_local std::string::size_type Log::indent_amt = 0;
+
 void indent_str(std::string& str,
                 std::string::size_type indent_amt,
                 bool start_indent,
@@ -223,6 +225,7 @@ void Log::enter_async(std::string entry, bool newline) noexcept
 void Log::write_entry(std::string entry) noexcept
 {
     try {
+        std::lock_guard<std::mutex> lk {write_mutex};
         std::cout << entry << std::flush;
     } catch(...) {
         safe_err("write log message due to stream state");
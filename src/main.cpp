@@ -22,6 +22,9 @@
 #include "engine.hpp"
 #include "log.hpp"
 #include "cli.hpp"
+#include "metrics.hpp"
+#include "frame_stats.hpp"
+#include "trace.hpp"
 
 #include <string>
 #include <iostream>
@@ -43,10 +46,44 @@ int main(int argc, char** argv)
         cu::log.async_on();
     }
 
-    cu::Engine e {cli.debug()};
+    // started before anything else, so startup is in the trace too
 
-    if (cli.minicomp()) {
-        e.minicomp_mode(cli.comp_path());
+    if (cli.trace_path()) {
+        cu::trace.name_thread("main");
+        cu::trace.start(*cli.trace_path());
+    }
+
+    {
+        cu::Engine e {cli.debug(),
+                      cli.present_config(),
+                      cli.fps_cap(),
+                      cli.headless(),
+                      cli.bench(),
+                      cli.clock(),
+                      cli.capture(),
+                      cli.batch()};
+
+        if (cli.minicomp()) {
+            e.minicomp_mode(cli.comp_path());
+        }
+    }
+
+    if (cli.trace_path()) {
+        try {
+            auto n = cu::trace.dump();
+            std::cerr << "wrote " << n << " trace events to "
+                      << *cli.trace_path() << "\n";
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+        }
+    }
+
+    if (cli.metrics()) {
+        std::cout << cu::metrics.report();
+
+        if (cu::frame_stats.total_frames() > 0) {
+            std::cout << "\n" << cu::frame_stats.report();
+        }
     }
 
     return 0;
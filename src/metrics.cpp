@@ -0,0 +1,118 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "metrics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace cu {
+
+Metrics metrics;
+
+void Metrics::record(const std::string& name, double value) noexcept
+{
+    try {
+        std::lock_guard<std::mutex> lk {mtx};
+        auto& s = series[name];
+
+        if (s.count == 0) {
+            s.min = value;
+            s.max = value;
+        } else {
+            s.min = std::min(s.min, value);
+            s.max = std::max(s.max, value);
+        }
+
+        ++s.count;
+        s.sum  += value;
+        s.last  = value;
+    } catch (...) {
+        // metrics are never worth taking the program down over
+    }
+}
+
+std::map<std::string, Metrics::Series> Metrics::snapshot() const
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    return series;
+}
+
+Metrics::Series Metrics::get(const std::string& name) const
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    if (auto s = series.find(name); s != series.end()) {
+        return s->second;
+    }
+
+    return {};
+}
+
+std::string Metrics::report() const
+{
+    auto snap = snapshot();
+
+    std::string::size_type name_w = 6;
+    for (const auto& [name, _] : snap) {
+        name_w = std::max(name_w, name.size());
+    }
+
+    auto row = [name_w](const std::string& name,
+                        const char* cnt,
+                        const char* sum,
+                        const char* mean,
+                        const char* min,
+                        const char* max)
+    {
+        char buf[160];
+        std::snprintf(buf, sizeof(buf), "%10s %12s %12s %12s %12s\n",
+                      cnt, sum, mean, min, max);
+        return name + std::string(name_w - name.size() + 2, ' ') + buf;
+    };
+
+    std::string out = row("metric", "count", "sum", "mean", "min", "max");
+
+    for (const auto& [name, s] : snap) {
+        auto num = [](double d)
+        {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.4g", d);
+            return std::string {buf};
+        };
+
+        out += row(name,
+                   std::to_string(s.count).c_str(),
+                   num(s.sum).c_str(),
+                   num(s.mean()).c_str(),
+                   num(s.min).c_str(),
+                   num(s.max).c_str());
+    }
+
+    return out;
+}
+
+void Metrics::clear() noexcept
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    series.clear();
+}
+
+} // namespace cu
@@ -0,0 +1,77 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "offscreen.hpp"
+
+#include "log.hpp"
+
+#include <stdexcept>
+#include <string>
+
+namespace cu {
+
+Offscreen::Offscreen(Device::ptr l_dev, VkExtent2D ext, uint32_t count)
+    : extent {ext},
+      current_ndx {count - 1}
+{
+    using namespace vk;
+
+    if (count == 0 || ext.width == 0 || ext.height == 0) {
+        throw std::runtime_error("offscreen targets need at least one image "
+                                 "and a nonzero size");
+    }
+
+    log.enter("Vulkan", "creating " + std::to_string(count)
+                        + " offscreen images ("
+                        + std::to_string(ext.width) + "x"
+                        + std::to_string(ext.height) + ")");
+    log.brk();
+
+    // the views refer to the images, so the images mustn't move once any
+    // have been made
+    imgs.reserve(count);
+    views.reserve(count);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        imgs.push_back(Image {l_dev, {
+            .extent = {
+                .width  = ext.width,
+                .height = ext.height,
+                .depth  = 1,
+            },
+            .usage  = flgs(ImageUsageFlag::strge)
+                      | flgs(ImageUsageFlag::trnsfr_src),
+            .format = Format::r8g8b8a8_unorm,
+        }});
+    }
+
+    for (auto& img : imgs) {
+        views.push_back(ImageView {img});
+    }
+}
+
+uint32_t Offscreen::next()
+{
+    current_ndx = (current_ndx + 1) % img_count();
+    return current_ndx;
+}
+
+} // namespace cu
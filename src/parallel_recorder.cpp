@@ -0,0 +1,170 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "parallel_recorder.hpp"
+
+#include "vulkan.hpp"
+
+#include <algorithm>
+
+namespace cu {
+
+ParallelRecorder::ParallelRecorder(Device::ptr l_dev,
+                                   Device::QueueFlavor q_flav,
+                                   unsigned thread_cnt)
+    : dev {l_dev}
+{
+    if (thread_cnt == 0) {
+        thread_cnt = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    log.enter("Vulkan", "starting parallel recorder with "
+                        + std::to_string(thread_cnt) + " threads");
+    log.brk();
+
+    workers.reserve(thread_cnt);
+    for (unsigned i = 0; i < thread_cnt; ++i) {
+        workers.push_back({
+            .pool = std::make_shared<CommandPool>(dev, q_flav),
+        });
+    }
+
+    for (unsigned i = 0; i < thread_cnt; ++i) {
+        thrds.emplace_back();
+        thrds.back() = GuardedThread {
+            std::thread {&ParallelRecorder::work, this, i}
+        };
+    }
+}
+
+ParallelRecorder::~ParallelRecorder() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lk {mtx};
+        stopping = true;
+    }
+    work_cv.notify_all();
+
+    for (auto& t : thrds) {
+        t.join();
+    }
+
+    for (auto& w : workers) {
+        for (auto b : w.buffs) {
+            delete b;
+        }
+    }
+}
+
+std::vector<CommandBuffer*>
+ParallelRecorder::record(const std::vector<job_t>& new_jobs,
+                         vk::CommandBufferUsageFlags flags)
+{
+    std::vector<CommandBuffer*> secondaries(new_jobs.size(), nullptr);
+
+    {
+        std::lock_guard<std::mutex> lk {mtx};
+        jobs = &new_jobs;
+        out = &secondaries;
+        usage = flags;
+        err = nullptr;
+        pending = workers.size();
+        ++batch;
+    }
+    work_cv.notify_all();
+
+    std::exception_ptr e;
+    {
+        std::unique_lock<std::mutex> lk {mtx};
+        done_cv.wait(lk, [this] { return pending == 0; });
+        jobs = nullptr;
+        out = nullptr;
+        e = err;
+    }
+
+    if (e) {
+        std::rethrow_exception(e);
+    }
+
+    return secondaries;
+}
+
+void ParallelRecorder::work(unsigned ndx)
+{
+    Worker& w = workers.at(ndx);
+    const std::size_t stride = workers.size();
+    uint64_t seen = 0;
+
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk {mtx};
+            work_cv.wait(lk, [this, seen] {
+                return stopping || batch != seen;
+            });
+
+            if (stopping) {
+                return;
+            }
+
+            seen = batch;
+        }
+
+        // jobs and out don't change until every worker has checked in below,
+        // so they can be read here without the lock; each worker only
+        // writes to its own slots in out
+
+        try {
+            w.pool->reset();
+
+            std::size_t k = 0;
+            for (std::size_t j = ndx; j < jobs->size(); j += stride, ++k) {
+                if (k == w.buffs.size()) {
+                    w.buffs.push_back(
+                        new CommandBuffer {dev,
+                                           w.pool,
+                                           vk::CommandBufferLevel::scndry}
+                    );
+                }
+
+                CommandBuffer& b = *w.buffs.at(k);
+                b.record(usage);
+                jobs->at(j)(b);
+                b.end();
+
+                out->at(j) = &b;
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lk {mtx};
+            if (!err) {
+                err = std::current_exception();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lk {mtx};
+            if (--pending == 0) {
+                done_cv.notify_one();
+            }
+        }
+    }
+}
+
+} // namespace cu
@@ -24,6 +24,8 @@
 
 #include "log.hpp"
 
+#include <algorithm>
+
 namespace cu {
 
 VkDeviceSize calc_total_mem(const VkPhysicalDeviceMemoryProperties& mem_props)
@@ -96,9 +98,15 @@ PhysDevice::PhysDevice(VkPhysicalDevice                     device,
       raw_vk_driver_ver      {device_props.props.properties.driverVersion},
       vk_vend_id             {device_props.props.properties.vendorID},
       vk_vend_dev_id         {device_props.props.properties.deviceID},
+      pipeline_cache_uuid    {std::to_array(
+          device_props.props.properties.pipelineCacheUUID
+      )},
       max_timel_sem_val_diff {
           device_props.timel_props.maxTimelineSemaphoreValueDifference
       },
+      timestamp_period       {
+          device_props.props.properties.limits.timestampPeriod
+      },
       mem                    {calc_total_mem(vk_memory_props)},
       extensions             {extensions_supported},
       get_phys_dev_ftrs {
@@ -109,8 +117,7 @@ PhysDevice::PhysDevice(VkPhysicalDevice                     device,
 {
     get_queue_fams(vk_queue_props, inst);
     populate_mem_props(vk_memory_props);
-    maintenance4.pNext = &timel_sem;
-    features.pNext = &maintenance4;
+    fix_pnext_chain();
     get_phys_dev_ftrs(dev, &features);
 
     if (!timel_sem.timelineSemaphore) {
@@ -143,10 +150,36 @@ PhysDevice::PhysDevice(VkPhysicalDevice                     device,
 
 void PhysDevice::fix_pnext_chain()
 {
+    // structures for extensions the device doesn't support are left out
+
+    void* tail = nullptr;
+
+    if (supports(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        present_wait.pNext = tail;
+        tail = &present_wait;
+    }
+
+    if (supports(VK_KHR_PRESENT_ID_EXTENSION_NAME)) {
+        present_id.pNext = tail;
+        tail = &present_id;
+    }
+
+    if (supports(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME)) {
+        swch_maint1.pNext = tail;
+        tail = &swch_maint1;
+    }
+
+    timel_sem.pNext    = tail;
     maintenance4.pNext = &timel_sem;
     features.pNext     = &maintenance4;
 }
 
+bool PhysDevice::supports(const std::string& ext) const
+{
+    return std::find(extensions.begin(), extensions.end(), ext)
+           != extensions.end();
+}
+
 PhysDevice::PhysDevice(const PhysDevice& other)
     : dev                    {other.dev},
       name                   {other.name},
@@ -154,8 +187,10 @@ PhysDevice::PhysDevice(const PhysDevice& other)
       raw_vk_ver             {other.raw_vk_ver},
       raw_vk_driver_ver      {other.raw_vk_driver_ver},
       vk_vend_id             {other.vk_vend_id},
-      vk_vend_dev_id         {other.vk_vend_id},
+      vk_vend_dev_id         {other.vk_vend_dev_id},
+      pipeline_cache_uuid    {other.pipeline_cache_uuid},
       max_timel_sem_val_diff {other.max_timel_sem_val_diff},
+      timestamp_period       {other.timestamp_period},
       mem                    {other.mem},
       mem_types              {other.mem_types},
       mem_heaps              {other.mem_heaps},
@@ -164,7 +199,10 @@ PhysDevice::PhysDevice(const PhysDevice& other)
       get_phys_dev_ftrs      {other.get_phys_dev_ftrs},
       timel_sem              {other.timel_sem},
       maintenance4           {other.maintenance4},
-      features               {other.features}
+      features               {other.features},
+      present_id             {other.present_id},
+      present_wait           {other.present_wait},
+      swch_maint1            {other.swch_maint1}
 {
     fix_pnext_chain();
 }
@@ -183,8 +221,10 @@ PhysDevice::PhysDevice(PhysDevice&& other)
       raw_vk_ver             {other.raw_vk_ver},
       raw_vk_driver_ver      {other.raw_vk_driver_ver},
       vk_vend_id             {other.vk_vend_id},
-      vk_vend_dev_id         {other.vk_vend_id},
+      vk_vend_dev_id         {other.vk_vend_dev_id},
+      pipeline_cache_uuid    {other.pipeline_cache_uuid},
       max_timel_sem_val_diff {other.max_timel_sem_val_diff},
+      timestamp_period       {other.timestamp_period},
       mem                    {other.mem},
       mem_types              {other.mem_types},
       mem_heaps              {other.mem_heaps},
@@ -193,7 +233,10 @@ PhysDevice::PhysDevice(PhysDevice&& other)
       get_phys_dev_ftrs      {other.get_phys_dev_ftrs},
       timel_sem              {other.timel_sem},
       maintenance4           {other.maintenance4},
-      features               {other.features}
+      features               {other.features},
+      present_id             {other.present_id},
+      present_wait           {other.present_wait},
+      swch_maint1            {other.swch_maint1}
 {
     fix_pnext_chain();
 
@@ -207,6 +250,9 @@ PhysDevice::PhysDevice(PhysDevice&& other)
     other.timel_sem = {};
     other.maintenance4 = {};
     other.features = {};
+    other.present_id = {};
+    other.present_wait = {};
+    other.swch_maint1 = {};
 }
 
 PhysDevice& PhysDevice::operator=(PhysDevice&& other)
@@ -318,6 +364,49 @@ PhysicalHeap PhysDevice::largest_dev_local_heap() const
     return mem_heaps.at(out_ndx);
 }
 
+MemoryType PhysDevice::host_visible_type() const
+{
+    const MemoryType* out = nullptr;
+
+    for (const auto& type : mem_types) {
+        if (type.host_visible() && type.host_coherent()) {
+            if (!out || (!out->device_local() && type.device_local())) {
+                out = &type;
+            }
+        }
+    }
+
+    if (!out) {
+        throw std::runtime_error("no host-visible, host-coherent memory "
+                                 "types found");
+    }
+
+    return *out;
+}
+
+MemoryType PhysDevice::readback_type() const
+{
+    const MemoryType* out = nullptr;
+
+    auto score = [](const MemoryType& t) {
+        return (t.host_coherent() ? 2 : 0) + (t.device_local() ? 0 : 1);
+    };
+
+    for (const auto& type : mem_types) {
+        if (type.host_visible() && type.host_cached()) {
+            if (!out || score(type) > score(*out)) {
+                out = &type;
+            }
+        }
+    }
+
+    if (!out) {
+        return host_visible_type();
+    }
+
+    return *out;
+}
+
 bool PhysDevice::graphics()
 {
     bool out = false;
@@ -24,6 +24,7 @@
 #include "log.hpp"
 
 #include "vulkan.hpp"
+#include "trace.hpp"
 
 #include <stdexcept>
 #include <iostream>
@@ -33,6 +34,8 @@ namespace cu {
 
 std::vector<VkPhysicalDevice> PhysDevices::enumerate_devs(Instance::ptr inst)
 {
+    CU_ZONE("PhysDevices::enumerate_devs");
+
     uint32_t dev_cnt;
     Vulkan::vk_try(enum_phys_devs(inst->inner(), &dev_cnt, NULL),
                    "getting physical device count");
@@ -136,6 +139,8 @@ std::vector<std::string> PhysDevices::get_dev_exts(VkPhysicalDevice dev)
 
 void PhysDevices::fill_devs(std::vector<PhysDevice>& devs, bool compute_only)
 {
+    CU_ZONE("PhysDevices::fill_devs");
+
     for (auto potential_dev : potential_devs) {
         auto q_family_props = get_queue_fam_props(potential_dev);
 
@@ -163,6 +168,8 @@ void PhysDevices::fill_devs(std::vector<PhysDevice>& devs, bool compute_only)
 
 void PhysDevices::fill_devs(std::vector<PhysDevice>& devs, Surface& surf)
 {
+    CU_ZONE("PhysDevices::fill_devs");
+
     for (auto potential_dev : potential_devs) {
         auto q_family_props = get_queue_fam_props(potential_dev);
 
@@ -0,0 +1,245 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "pipeline_cache.hpp"
+
+#include "vulkan.hpp"
+#include "log.hpp"
+#include "fnv1a.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+namespace cu {
+
+std::filesystem::path PipelineCache::default_path()
+{
+    std::filesystem::path base;
+
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+        base = xdg;
+    } else if (const char* home = std::getenv("HOME"); home && *home) {
+        base = std::filesystem::path {home} / ".cache";
+    } else {
+        return {};
+    }
+
+    return base / "crypt_underworld" / "pipeline_cache.bin";
+}
+
+void PipelineCache::construct(Device& dev,
+                              const PhysDevice& ph_dev,
+                              std::filesystem::path file_path)
+{
+    path = file_path;
+
+    expected_hdr = {
+        .magic          = file_magic,
+        .version        = file_version,
+        .vendor_id      = ph_dev.vk_vend_id,
+        .device_id      = ph_dev.vk_vend_dev_id,
+        .driver_version = ph_dev.raw_vk_driver_ver,
+    };
+    std::memcpy(expected_hdr.uuid,
+                ph_dev.pipeline_cache_uuid.data(),
+                VK_UUID_SIZE);
+
+    create_cache = reinterpret_cast<PFN_vkCreatePipelineCache>(
+        dev.get_proc_addr("vkCreatePipelineCache")
+    );
+
+    destroy_cache = reinterpret_cast<PFN_vkDestroyPipelineCache>(
+        dev.get_proc_addr("vkDestroyPipelineCache")
+    );
+
+    get_cache_data = reinterpret_cast<PFN_vkGetPipelineCacheData>(
+        dev.get_proc_addr("vkGetPipelineCacheData")
+    );
+
+    auto initial = load();
+    saved_hash = fnv1a(initial.data(), initial.size());
+    loaded_sz = initial.size();
+
+    VkPipelineCacheCreateInfo inf = {
+        .sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .pNext           = NULL,
+        .flags           = 0,
+        .initialDataSize = initial.size(),
+        .pInitialData    = initial.empty() ? NULL : initial.data(),
+    };
+
+    Vulkan::vk_try(create_cache(dev.inner(), &inf, NULL, &nner),
+                   "create pipeline cache");
+    log.indent();
+    log.enter("file", path.empty() ? "(none)" : path.string());
+    log.enter("initial size", initial.size());
+    log.brk();
+
+    last_save = std::chrono::steady_clock::now();
+}
+
+std::vector<char> PipelineCache::load() const
+{
+    if (path.empty()) {
+        return {};
+    }
+
+    std::ifstream f {path, std::ios::binary};
+    if (!f) {
+        log.enter("PipelineCache", "no cache at " + path.string()
+                                   + "; starting cold");
+        log.brk();
+        return {};
+    }
+
+    FileHeader hdr;
+    f.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+
+    auto discard = [this](std::string why) -> std::vector<char>
+    {
+        log.enter("PipelineCache", "ignoring " + path.string() + " (" + why
+                                   + ")");
+        log.brk();
+        return {};
+    };
+
+    if (!f) {
+        return discard("truncated header");
+    }
+
+    if (hdr.magic != expected_hdr.magic
+        || hdr.version != expected_hdr.version) {
+        return discard("not a pipeline cache file, or an old one");
+    }
+
+    if (hdr.vendor_id != expected_hdr.vendor_id
+        || hdr.device_id != expected_hdr.device_id
+        || hdr.driver_version != expected_hdr.driver_version
+        || std::memcmp(hdr.uuid, expected_hdr.uuid, VK_UUID_SIZE) != 0) {
+        return discard("written for a different device or driver");
+    }
+
+    // the size is checked against what's actually left in the file before
+    // anything that big is allocated, since it could be anything
+
+    std::error_code ec;
+    const auto file_sz = std::filesystem::file_size(path, ec);
+
+    if (ec || file_sz - sizeof(hdr) != hdr.data_size) {
+        return discard("corrupt data");
+    }
+
+    std::vector<char> data(hdr.data_size);
+    f.read(data.data(), static_cast<std::streamsize>(data.size()));
+
+    if (!f || fnv1a(data.data(), data.size()) != hdr.data_hash) {
+        return discard("corrupt data");
+    }
+
+    return data;
+}
+
+void PipelineCache::save(Device& dev) noexcept
+{
+    std::lock_guard<std::mutex> lk {save_mtx};
+
+    last_save = std::chrono::steady_clock::now();
+
+    if (path.empty() || nner == VK_NULL_HANDLE) {
+        return;
+    }
+
+    try {
+        std::size_t sz = 0;
+        Vulkan::vk_try(get_cache_data(dev.inner(), nner, &sz, NULL),
+                       "get pipeline cache size");
+        log.brk();
+
+        std::vector<char> data(sz);
+        Vulkan::vk_try(get_cache_data(dev.inner(), nner, &sz, data.data()),
+                       "get pipeline cache data");
+        log.brk();
+        data.resize(sz);
+
+        FileHeader hdr = expected_hdr;
+        hdr.data_size = data.size();
+        hdr.data_hash = fnv1a(data.data(), data.size());
+
+        if (hdr.data_hash == saved_hash) {
+            return;
+        }
+
+        std::filesystem::create_directories(path.parent_path());
+
+        auto tmp = path;
+        tmp += ".tmp." + std::to_string(getpid());
+
+        {
+            std::ofstream f {tmp, std::ios::binary | std::ios::trunc};
+            f.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+            f.write(data.data(), static_cast<std::streamsize>(data.size()));
+            f.flush();
+
+            if (!f) {
+                std::filesystem::remove(tmp);
+                throw std::runtime_error("unable to write " + tmp.string());
+            }
+        }
+
+        std::filesystem::rename(tmp, path);
+        saved_hash = hdr.data_hash;
+
+        log.enter("PipelineCache", "saved " + std::to_string(data.size())
+                                   + " bytes to " + path.string());
+        log.brk();
+    } catch (const std::exception& e) {
+        log.enter("PipelineCache", std::string("WARNING: couldn't save: ")
+                                   + e.what());
+        log.brk();
+    }
+}
+
+void PipelineCache::maybe_save(Device& dev) noexcept
+{
+    {
+        std::lock_guard<std::mutex> lk {save_mtx};
+        if (std::chrono::steady_clock::now() - last_save < save_interval) {
+            return;
+        }
+    }
+
+    save(dev);
+}
+
+void PipelineCache::free_self(Device& dev) noexcept
+{
+    save(dev);
+
+    log.attempt("Vulkan", "destroying pipeline cache");
+    destroy_cache(dev.inner(), nner, NULL);
+    nner = VK_NULL_HANDLE;
+    log.finish();
+    log.brk();
+}
+
+} // namespace cu
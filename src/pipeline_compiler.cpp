@@ -0,0 +1,168 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "pipeline_compiler.hpp"
+
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace cu {
+
+PipelineCompiler::PipelineCompiler(Device::ptr l_dev, unsigned thread_cnt)
+    : dev {l_dev}
+{
+    if (thread_cnt == 0) {
+        thread_cnt = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    }
+
+    log.enter("Vulkan", "starting pipeline compiler with "
+                        + std::to_string(thread_cnt) + " threads");
+    log.brk();
+
+    for (unsigned i = 0; i < thread_cnt; ++i) {
+        thrds.emplace_back();
+        thrds.back() = GuardedThread {
+            std::thread {&PipelineCompiler::work, this}
+        };
+    }
+}
+
+PipelineCompiler::~PipelineCompiler() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lk {mtx};
+        stopping = true;
+    }
+    work_cv.notify_all();
+
+    for (auto& t : thrds) {
+        t.join();
+    }
+
+    // anything left in the queue is destroyed along with it, which breaks
+    // its promise
+}
+
+template<typename T>
+PipelineCompiler::handle_t<T>
+PipelineCompiler::enqueue(std::function<T()> job)
+{
+    auto prom = std::make_shared<std::promise<T>>();
+    handle_t<T> h = prom->get_future().share();
+
+    {
+        std::lock_guard<std::mutex> lk {mtx};
+        queue.emplace_back([prom, job = std::move(job)]
+        {
+            try {
+                prom->set_value(job());
+            } catch (...) {
+                prom->set_exception(std::current_exception());
+            }
+        });
+    }
+    work_cv.notify_one();
+
+    return h;
+}
+
+PipelineCompiler::handle_t<ShaderModule::ptr>
+PipelineCompiler::shader(std::string name, BinData bin)
+{
+    return enqueue<ShaderModule::ptr>([this, name, bin]
+    {
+        CU_ZONE("PipelineCompiler::shader");
+
+        auto start = std::chrono::steady_clock::now();
+        auto shdr = std::make_shared<ShaderModule>(dev, name, bin);
+        metrics.record("shader." + name + ".create_ms",
+                       std::chrono::steady_clock::now() - start);
+
+        return shdr;
+    });
+}
+
+PipelineCompiler::handle_t<ComputePipeline::ptr>
+PipelineCompiler::compute(handle_t<ShaderModule::ptr> shdr, ComputeDesc desc)
+{
+    return enqueue<ComputePipeline::ptr>([this, shdr, desc]
+    {
+        CU_ZONE("PipelineCompiler::compute");
+
+        // shdr was queued before this, so it's either done or being built
+        // by another worker; this can't wait on something stuck behind it
+        return std::make_shared<ComputePipeline>(dev,
+                                                 shdr.get(),
+                                                 desc.layout,
+                                                 desc.spec.get(),
+                                                 desc.local_sz,
+                                                 desc.flags);
+    });
+}
+
+PipelineCompiler::handle_t<ComputePipeline::ptr>
+PipelineCompiler::compute(ShaderModule::ptr shdr, ComputeDesc desc)
+{
+    std::promise<ShaderModule::ptr> p;
+    p.set_value(shdr);
+
+    return compute(p.get_future().share(), desc);
+}
+
+std::size_t PipelineCompiler::pending() const
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    return queue.size() + in_flight;
+}
+
+void PipelineCompiler::work()
+{
+    trace.name_thread("pipeline compiler");
+
+    for (;;) {
+        std::packaged_task<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lk {mtx};
+            work_cv.wait(lk, [this] { return stopping || !queue.empty(); });
+
+            if (stopping) {
+                return;
+            }
+
+            task = std::move(queue.front());
+            queue.pop_front();
+            ++in_flight;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lk {mtx};
+            --in_flight;
+        }
+    }
+}
+
+} // namespace cu
@@ -23,33 +23,13 @@
 
 #include "vulkan.hpp"
 #include "log.hpp"
+#include "fnv1a.hpp"
 
 #include <algorithm>
 #include <array>
 
 namespace cu {
 
-PipelineLayout::PipelineLayout(Device::ptr l_dev,
-                               std::vector<VkDescriptorSetLayout> layts,
-                               std::vector<const VkPushConstantRange*> pcrs)
-    : Deviced(l_dev, "pipeline layout", "PipelineLayout")
-{
-    VkPipelineLayoutCreateInfo inf = {
-        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-        .pNext                  = NULL,
-        .flags                  = 0,
-        .setLayoutCount         = static_cast<uint32_t>(layts.size()),
-        .pSetLayouts            = layts.data(),
-        .pushConstantRangeCount = static_cast<uint32_t>(pcrs.size()),
-        .pPushConstantRanges    = pcrs.empty() ? NULL : *pcrs.data(),
-    };
-
-    Vulkan::vk_try(create(dev->inner(), &inf, NULL, &nner),
-                   "create " + descrptn());
-
-    log_attrs();
-}
-
 std::vector<VkDescriptorSetLayout>
 prep_descs(std::vector<DescriptorSetLayout::ptr> dscr_layts)
 {
@@ -98,7 +78,7 @@ void check_overlapping_pc_stages(const std::vector<PCRange*>& push_consts)
     }
 }
 
-std::vector<const VkPushConstantRange*>
+std::vector<VkPushConstantRange>
 prep_pcs(std::vector<PCRange*> push_consts)
 {
     if (push_consts.size() > UINT32_MAX) {
@@ -107,31 +87,127 @@ prep_pcs(std::vector<PCRange*> push_consts)
 
     check_overlapping_pc_stages(push_consts);
 
-    std::vector<const VkPushConstantRange*> pcrs(push_consts.size());
+    std::vector<VkPushConstantRange> pcrs(push_consts.size());
     std::transform(push_consts.cbegin(), push_consts.cend(), pcrs.begin(),
-                   [](auto pc) { return &(pc->range()); });
+                   [](auto pc) { return pc->range(); });
 
     return pcrs;
 }
 
+std::vector<DescriptorSetLayout::ptr>
+reflect_descs(Device::ptr l_dev,
+              const SpirvReflection& refl,
+              const std::string& name_prefix)
+{
+    std::vector<DescriptorSetLayout::ptr> layts;
+
+    for (uint32_t set = 0; set < refl.set_count(); ++set) {
+        std::vector<DescriptorSetLayoutBinding> bndgs;
+
+        for (const auto& b : refl.bindings(set)) {
+            bndgs.push_back(DescriptorSetLayoutBinding ({
+                .binding_ndx   = b.binding,
+                .type          = b.type,
+                .count         = b.count,
+                .shader_stages = refl.stages(),
+            }));
+        }
+
+        layts.push_back(std::make_shared<DescriptorSetLayout>(
+            l_dev,
+            name_prefix + " set " + std::to_string(set),
+            bndgs
+        ));
+    }
+
+    return layts;
+}
+
+std::vector<VkPushConstantRange> reflect_pcs(const SpirvReflection& refl)
+{
+    if (!refl.push_constants()) {
+        return {};
+    }
+
+    return {{
+        .stageFlags = refl.stages(),
+        .offset     = refl.push_constants()->offset,
+        .size       = refl.push_constants()->size,
+    }};
+}
+
+uint64_t layout_hash(const std::vector<DescriptorSetLayout::ptr>& dscr_layts,
+                     const std::vector<VkPushConstantRange>& pcrs)
+{
+    std::vector<uint32_t> words;
+
+    for (const auto& l : dscr_layts) {
+        words.push_back(static_cast<uint32_t>(l->bindings().size()));
+
+        for (const auto& b : l->innerbindings()) {
+            words.push_back(b.binding);
+            words.push_back(static_cast<uint32_t>(b.descriptorType));
+            words.push_back(b.descriptorCount);
+            words.push_back(b.stageFlags);
+        }
+    }
+
+    for (const auto& r : pcrs) {
+        words.push_back(r.stageFlags);
+        words.push_back(r.offset);
+        words.push_back(r.size);
+    }
+
+    return fnv1a(words.data(), words.size() * sizeof(uint32_t));
+}
+
 PipelineLayout::PipelineLayout(Device::ptr l_dev,
-                       std::vector<DescriptorSetLayout::ptr> dscrpt_set_layouts)
-    : PipelineLayout::PipelineLayout(l_dev,
-                                     prep_descs(dscrpt_set_layouts),
-                                     {})
+                       std::vector<DescriptorSetLayout::ptr> dscrpt_set_layouts,
+                       std::vector<VkPushConstantRange> pcrs)
+    : Deviced(l_dev, "pipeline layout", "PipelineLayout"),
+      dscr_layts {dscrpt_set_layouts},
+      hsh {layout_hash(dscr_layts, pcrs)}
 {
-      dscr_layts = dscrpt_set_layouts;
+    auto layts = prep_descs(dscr_layts);
+
+    VkPipelineLayoutCreateInfo inf = {
+        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext                  = NULL,
+        .flags                  = 0,
+        .setLayoutCount         = static_cast<uint32_t>(layts.size()),
+        .pSetLayouts            = layts.data(),
+        .pushConstantRangeCount = static_cast<uint32_t>(pcrs.size()),
+        .pPushConstantRanges    = pcrs.empty() ? NULL : pcrs.data(),
+    };
+
+    Vulkan::vk_try(create(dev->inner(), &inf, NULL, &nner),
+                   "create " + descrptn());
+
+    log_attrs();
 }
 
+PipelineLayout::PipelineLayout(Device::ptr l_dev,
+                       std::vector<DescriptorSetLayout::ptr> dscrpt_set_layouts)
+    : PipelineLayout::PipelineLayout(l_dev,
+                                     dscrpt_set_layouts,
+                                     std::vector<VkPushConstantRange> {})
+{}
+
 PipelineLayout::PipelineLayout(Device::ptr l_dev,
                        std::vector<DescriptorSetLayout::ptr> dscrpt_set_layouts,
                        std::vector<PCRange*> push_consts)
     : PipelineLayout::PipelineLayout(l_dev,
-                                     prep_descs(dscrpt_set_layouts),
+                                     dscrpt_set_layouts,
                                      prep_pcs(push_consts))
-{
-      dscr_layts = dscrpt_set_layouts;
-}
+{}
+
+PipelineLayout::PipelineLayout(Device::ptr l_dev,
+                               const SpirvReflection& refl,
+                               std::string name_prefix)
+    : PipelineLayout::PipelineLayout(l_dev,
+                                     reflect_descs(l_dev, refl, name_prefix),
+                                     reflect_pcs(refl))
+{}
 
 void PipelineLayout::log_attrs(unsigned indent) const
 {
@@ -0,0 +1,168 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "pipeline_registry.hpp"
+
+#include "fnv1a.hpp"
+#include "metrics.hpp"
+
+#include <stdexcept>
+#include <type_traits>
+
+namespace cu {
+
+namespace {
+
+template<typename T>
+void append(std::string& key, const T& val)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    key.append(reinterpret_cast<const char*>(&val), sizeof(val));
+}
+
+// Everything that goes into a compute pipeline, flattened into a string of
+// bytes. The shader is there by its id, which is exact; the layout is only
+// there by its hash, so two layouts could in principle be mistaken for each
+// other.
+std::string pipeline_key(uint64_t shdr_id,
+                         PipelineCompiler::ComputeDesc& desc)
+{
+    std::string key;
+
+    append(key, shdr_id);
+    append(key, desc.layout->hash());
+    append(key, desc.flags);
+
+    append(key, desc.local_sz.has_value());
+    if (desc.local_sz) {
+        append(key, *desc.local_sz);
+    }
+
+    if (desc.spec) {
+        for (const auto& e : desc.spec->entries()) {
+            append(key, e.constantID);
+            append(key, e.offset);
+            append(key, e.size);
+        }
+        key.append(static_cast<const char*>(desc.spec->values_voidp()),
+                   desc.spec->size());
+    }
+
+    return key;
+}
+
+// A build that threw isn't worth handing out again; it may well have been
+// something transient, like running out of memory.
+template<typename T>
+bool failed(const PipelineCompiler::handle_t<T>& h)
+{
+    if (!PipelineCompiler::ready(h)) {
+        return false;
+    }
+
+    try {
+        h.get();
+    } catch (...) {
+        return true;
+    }
+
+    return false;
+}
+
+} // namespace
+
+PipelineRegistry::PipelineRegistry(PipelineCompiler& compiler,
+                                   std::size_t shader_cap,
+                                   std::size_t pipeline_cap)
+    : cmplr {compiler},
+      shdrs {shader_cap},
+      pipels {pipeline_cap}
+{}
+
+PipelineRegistry::Shader PipelineRegistry::shader(std::string name,
+                                                  BinData bin)
+{
+    const uint64_t h = fnv1a(bin.data(), bin.size());
+
+    std::lock_guard<std::mutex> lk {mtx};
+
+    // a different shader with the same hash just takes the entry over
+
+    if (auto found = shdrs.find(h);
+        found && found->bin->dta == bin.dta && !failed(found->module)) {
+        metrics.count("registry.shader.hit");
+        return *found;
+    }
+
+    metrics.count("registry.shader.miss");
+
+    auto held = std::make_shared<const BinData>(std::move(bin));
+
+    return shdrs.insert(h, {
+        .hash   = h,
+        .id     = next_id++,
+        .bin    = held,
+        .module = cmplr.shader(std::move(name), *held),
+    });
+}
+
+PipelineCompiler::handle_t<ComputePipeline::ptr>
+PipelineRegistry::compute(const Shader& shdr,
+                          PipelineCompiler::ComputeDesc desc)
+{
+    if (!desc.layout) {
+        throw std::runtime_error("a compute pipeline needs a layout");
+    }
+
+    auto key = pipeline_key(shdr.id, desc);
+
+    std::lock_guard<std::mutex> lk {mtx};
+
+    if (auto found = pipels.find(key); found && !failed(*found)) {
+        metrics.count("registry.pipeline.hit");
+        return *found;
+    }
+
+    metrics.count("registry.pipeline.miss");
+
+    return pipels.insert(key, cmplr.compute(shdr.module, std::move(desc)));
+}
+
+std::size_t PipelineRegistry::shader_count() const
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    return shdrs.size();
+}
+
+std::size_t PipelineRegistry::pipeline_count() const
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    return pipels.size();
+}
+
+void PipelineRegistry::clear()
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    shdrs.clear();
+    pipels.clear();
+}
+
+} // namespace cu
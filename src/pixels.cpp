@@ -0,0 +1,190 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "pixels.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace cu {
+
+PixelView PixelView::of(Pixels px)
+{
+    auto held = std::make_shared<const Pixels>(std::move(px));
+    return {held->width, held->height, held->rgba.data(), held};
+}
+
+Pixels PixelView::copy() const
+{
+    const std::size_t sz = std::size_t {width} * height * 4;
+    return {width, height, std::vector<uint8_t>(rgba, rgba + sz)};
+}
+
+void write_ppm(const std::filesystem::path& path, const Pixels& px)
+{
+    std::ofstream f {path, std::ios::binary | std::ios::trunc};
+
+    f << "P6\n" << px.width << " " << px.height << "\n255\n";
+
+    std::vector<char> row(std::size_t {px.width} * 3);
+
+    for (uint32_t y = 0; y < px.height; ++y) {
+        const auto* src = px.rgba.data() + std::size_t {y} * px.width * 4;
+
+        for (uint32_t x = 0; x < px.width; ++x) {
+            row[x * 3]     = static_cast<char>(src[x * 4]);
+            row[x * 3 + 1] = static_cast<char>(src[x * 4 + 1]);
+            row[x * 3 + 2] = static_cast<char>(src[x * 4 + 2]);
+        }
+
+        f.write(row.data(), static_cast<std::streamsize>(row.size()));
+    }
+
+    f.flush();
+
+    if (!f) {
+        throw std::runtime_error("failed to write " + path.string());
+    }
+}
+
+Pixels read_ppm(const std::filesystem::path& path)
+{
+    std::ifstream f {path, std::ios::binary};
+    if (!f) {
+        throw std::runtime_error("couldn't open " + path.string());
+    }
+
+    auto fail = [&path]() -> Pixels {
+        throw std::runtime_error(path.string() + " isn't an 8-bit binary PPM");
+    };
+
+    // the header is whitespace-separated and may have comments in it
+
+    auto field = [&f]() -> std::string {
+        std::string s;
+        int c;
+
+        while ((c = f.get()) != EOF) {
+            if (c == '#') {
+                while ((c = f.get()) != EOF && c != '\n');
+            } else if (!std::isspace(c)) {
+                break;
+            }
+        }
+
+        while (c != EOF && !std::isspace(c)) {
+            s += static_cast<char>(c);
+            c = f.get();
+        }
+
+        return s;
+    };
+
+    if (field() != "P6") {
+        return fail();
+    }
+
+    unsigned long w = 0;
+    unsigned long h = 0;
+    unsigned long maxval = 0;
+    try {
+        w = std::stoul(field());
+        h = std::stoul(field());
+        maxval = std::stoul(field());
+    } catch (const std::exception&) {
+        return fail();
+    }
+
+    if (w == 0 || h == 0 || w > UINT32_MAX || h > UINT32_MAX
+        || maxval != 255) {
+        return fail();
+    }
+
+    Pixels px {
+        .width  = static_cast<uint32_t>(w),
+        .height = static_cast<uint32_t>(h),
+        .rgba   = {},
+    };
+    px.rgba.resize(std::size_t {px.width} * px.height * 4);
+
+    std::vector<char> row(std::size_t {px.width} * 3);
+
+    for (uint32_t y = 0; y < px.height; ++y) {
+        if (!f.read(row.data(), static_cast<std::streamsize>(row.size()))) {
+            return fail();
+        }
+
+        auto* dst = px.rgba.data() + std::size_t {y} * px.width * 4;
+
+        for (uint32_t x = 0; x < px.width; ++x) {
+            dst[x * 4]     = static_cast<uint8_t>(row[x * 3]);
+            dst[x * 4 + 1] = static_cast<uint8_t>(row[x * 3 + 1]);
+            dst[x * 4 + 2] = static_cast<uint8_t>(row[x * 3 + 2]);
+            dst[x * 4 + 3] = 255;
+        }
+    }
+
+    return px;
+}
+
+PixelDiff compare(const Pixels& a, const Pixels& b, uint8_t tolerance)
+{
+    if (a.width != b.width || a.height != b.height
+        || a.rgba.size() != b.rgba.size()) {
+        throw std::runtime_error(
+            "can't compare a " + std::to_string(a.width) + "x"
+            + std::to_string(a.height) + " image with a "
+            + std::to_string(b.width) + "x" + std::to_string(b.height) + " one"
+        );
+    }
+
+    PixelDiff d;
+    uint64_t total = 0;
+
+    for (std::size_t i = 0; i + 3 < a.rgba.size(); i += 4) {
+        bool over = false;
+
+        for (std::size_t c = 0; c < 3; ++c) {
+            const auto diff = static_cast<uint8_t>(
+                std::abs(int {a.rgba[i + c]} - int {b.rgba[i + c]})
+            );
+
+            total += diff;
+            d.max = std::max(d.max, diff);
+            over = over || diff > tolerance;
+        }
+
+        if (over) {
+            ++d.over;
+        }
+    }
+
+    const auto channels = a.rgba.size() / 4 * 3;
+    d.mean = channels ? static_cast<double>(total) / channels : 0;
+
+    return d;
+}
+
+} // namespace cu
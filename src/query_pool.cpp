@@ -0,0 +1,90 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "query_pool.hpp"
+#include "vulkan.hpp"
+
+#include <bit>
+
+namespace cu {
+
+QueryPool::QueryPool(Device::ptr l_dev,
+                     vk::QueryType type,
+                     uint32_t count,
+                     vk::QueryPipelineStatisticFlags stats)
+    : Deviced(l_dev, vk::query_type_str(type) + " query pool", "QueryPool"),
+      typ {type},
+      cnt {count},
+      vals_per {
+          type == vk::QueryType::pplne_sttstcs
+              ? static_cast<uint32_t>(std::popcount(stats))
+              : 1
+      },
+      GET_VK_FN_PTR(get_results, GetQueryPoolResults)
+{
+    VkQueryPoolCreateInfo inf = {
+        .sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext              = NULL,
+        .flags              = 0,
+        .queryType          = v(type),
+        .queryCount         = count,
+        .pipelineStatistics = type == vk::QueryType::pplne_sttstcs ? stats : 0,
+    };
+
+    Vulkan::vk_try(create(dev->inner(), &inf, NULL, &nner),
+                   "creating " + descrptn());
+    log.indent();
+    log.enter("query count", count);
+    if (inf.pipelineStatistics) {
+        log.enter("statistics",
+                  vk::query_pplne_sttstc_flags_cstrs(inf.pipelineStatistics));
+    }
+    log.brk();
+}
+
+bool QueryPool::results(uint32_t first,
+                        uint32_t count,
+                        std::vector<uint64_t>& out)
+{
+    out.resize(static_cast<std::size_t>(count) * vals_per);
+
+    const VkDeviceSize stride = vals_per * sizeof(uint64_t);
+
+    VkResult res = get_results(dev->inner(),
+                               nner,
+                               first,
+                               count,
+                               out.size() * sizeof(uint64_t),
+                               out.data(),
+                               stride,
+                               VK_QUERY_RESULT_64_BIT);
+
+    if (res == VK_NOT_READY) {
+        return false;
+    }
+
+    Vulkan::vk_try(res, "getting results from " + descrptn());
+    log.brk();
+
+    return true;
+}
+
+} // namespace cu
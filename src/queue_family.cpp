@@ -43,6 +43,8 @@ QueueFamily::QueueFamily(VkQueueFamilyProperties& q_family_props,
     queue_cnt = q_family_props.queueCount;
 
     flags = q_family_props.queueFlags;
+
+    ts_bits = q_family_props.timestampValidBits;
 }
 
 void QueueFamily::query_present(VkPhysicalDevice dev, Surface& surf)
@@ -0,0 +1,265 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "readback.hpp"
+
+#include "metrics.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace cu {
+
+Readback::Readback(Device::ptr l_dev,
+                   uint32_t slot_count,
+                   Device::QueueFlavor q_flav)
+    : dev {l_dev},
+      flav {q_flav},
+      pool {
+          std::make_shared<CommandPool>(
+              l_dev,
+              q_flav,
+              flgs(vk::CommandPoolCreateFlag::reset_cmmnd_buffer)
+          )
+      },
+      slots(std::max<uint32_t>(slot_count, 1))
+{
+    for (auto& s : slots) {
+        cmdbs.push_back(std::make_unique<CommandBuffer>(dev, pool));
+        s.cmdb = cmdbs.back().get();
+        s.fnce = std::make_unique<Fence>(dev);
+        s.viewed = std::make_shared<std::atomic<bool>>(false);
+    }
+}
+
+Readback::~Readback() noexcept
+{
+    for (auto& s : slots) {
+        if (s.busy) {
+            try {
+                s.fnce->wait();
+            } catch (...) {
+                // the device is gone, so there's nothing to wait for
+            }
+        }
+    }
+}
+
+bool Readback::request(Image& img, callback_t done)
+{
+    if (!done) {
+        return request_view(img, nullptr);
+    }
+
+    // copied out straight away, so the slot is free again as soon as the
+    // callback returns
+    return request_view(img, [done = std::move(done)](PixelView v) {
+        done(v.copy());
+    });
+}
+
+bool Readback::request_view(Image& img,
+                            view_callback_t done,
+                            vk::ImageLayout layout)
+{
+    using namespace vk;
+
+    CU_ZONE("Readback::request");
+
+    slot* free = nullptr;
+    for (auto& s : slots) {
+        if (!s.busy && !s.viewed->load(std::memory_order_acquire)) {
+            free = &s;
+            break;
+        }
+    }
+
+    if (!free) {
+        metrics.count("readback.dropped");
+        return false;
+    }
+
+    const auto ext = img.extent();
+    const VkDeviceSize sz = VkDeviceSize {ext.width} * ext.height
+                            * ext.depth * 4;
+
+    // staging buffers are kept for as long as the images fit in them
+
+    if (!free->staging || free->staging->size() < sz) {
+        free->staging.reset();
+        free->staging = std::make_shared<Buffer>(dev, Buffer::params {
+            .size     = sz,
+            .usage    = flgs(BufferUsageFlag::trnsfr_dst),
+            .location = Heap::Location::readback,
+        });
+    }
+
+    // The first barrier waits for whatever wrote the image, in an earlier
+    // submission (a compute shader, unless it's in some other layout, in
+    // which case it could have been anything); the last keeps later compute
+    // work from writing to it before the copy has read it.
+
+    const bool moved = layout != ImageLayout::trnsfr_src_optml;
+
+    auto& cmdb = free->cmdb->record()
+        .barrier(img,
+                 moved ? PipelineStageFlag::all_cmmnds
+                       : PipelineStageFlag::cmpte_shader,
+                 PipelineStageFlag::trnsfr,
+                 moved ? AccessFlag::memory_write : AccessFlag::shader_write,
+                 AccessFlag::trnsfr_read,
+                 layout,
+                 ImageLayout::trnsfr_src_optml,
+                 ImageAspectFlag::color)
+        .copy(img, *free->staging)
+        .barrier(PipelineStageFlag::trnsfr,
+                 PipelineStageFlag::host,
+                 AccessFlag::trnsfr_write,
+                 AccessFlag::host_read);
+
+    if (moved) {
+        cmdb.barrier(img,
+                     PipelineStageFlag::trnsfr,
+                     PipelineStageFlag::bottom_of_pipe,
+                     AccessFlag::none,
+                     AccessFlag::none,
+                     ImageLayout::trnsfr_src_optml,
+                     layout,
+                     ImageAspectFlag::color);
+    }
+
+    cmdb.barrier(PipelineStageFlag::trnsfr,
+                 PipelineStageFlag::cmpte_shader,
+                 AccessFlag::none,
+                 AccessFlag::none)
+        .end();
+
+    dev->submit_async(flav, *free->cmdb, *free->fnce);
+
+    free->done = std::move(done);
+    free->extent = ext;
+    free->seq = next_seq++;
+    free->busy = true;
+
+    return true;
+}
+
+Readback::slot* Readback::oldest_done(bool wait)
+{
+    slot* oldest = nullptr;
+    for (auto& s : slots) {
+        if (s.busy && (!oldest || s.seq < oldest->seq)) {
+            oldest = &s;
+        }
+    }
+
+    if (!oldest) {
+        return nullptr;
+    }
+
+    // copies finish in the order they were submitted, so if the oldest
+    // hasn't, none of the rest have either
+
+    if (wait) {
+        oldest->fnce->wait();
+    } else if (oldest->fnce->signaled()) {
+        oldest->fnce->reset();
+    } else {
+        return nullptr;
+    }
+
+    return oldest;
+}
+
+void Readback::hand_over(slot& s)
+{
+    CU_ZONE("Readback::hand_over");
+
+    s.staging->invalidate();
+
+    auto done = std::move(s.done);
+    s.done = nullptr;
+    s.busy = false;
+
+    if (!done) {
+        return;
+    }
+
+    // The view keeps the buffer alive too, so it stays good even if it
+    // outlives us. It's marked before the callback, so the slot isn't reused
+    // while the view is out, but the callback can still ask for another copy
+    // in a different one.
+
+    s.viewed->store(true, std::memory_order_relaxed);
+
+    PixelView v {
+        .width  = s.extent.width,
+        .height = s.extent.height * s.extent.depth,
+        .rgba   = static_cast<const uint8_t*>(s.staging->mapped()),
+        .keep   = std::shared_ptr<const void> {
+            s.staging->mapped(),
+            [buf = s.staging, viewed = s.viewed](const void*) {
+                viewed->store(false, std::memory_order_release);
+            }
+        },
+    };
+
+    done(std::move(v));
+}
+
+std::size_t Readback::poll()
+{
+    std::size_t n = 0;
+
+    while (auto* s = oldest_done(false)) {
+        hand_over(*s);
+        ++n;
+    }
+
+    return n;
+}
+
+void Readback::flush()
+{
+    while (auto* s = oldest_done(true)) {
+        hand_over(*s);
+    }
+}
+
+bool Readback::ready() const
+{
+    return std::any_of(slots.begin(), slots.end(), [](const slot& s) {
+        return !s.busy && !s.viewed->load(std::memory_order_acquire);
+    });
+}
+
+uint32_t Readback::in_flight() const
+{
+    uint32_t n = 0;
+    for (const auto& s : slots) {
+        n += s.busy;
+    }
+
+    return n;
+}
+
+} // namespace cu
@@ -25,9 +25,12 @@
 
 #include "instance.hpp"
 #include "game.hpp"
+#include "trace.hpp"
 
+#include <algorithm>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 namespace cu {
 
@@ -62,7 +65,7 @@ void SDL::sdl_throw(std::string oper)
     throw std::runtime_error(ss.str());
 }
 
-SDL_Window* create_window()
+SDL_Window* create_window(std::optional<WinSize> size)
 {
     SDL_Rect disp_bounds;
     SDL::sdl_try(SDL_GetDisplayBounds(0, &disp_bounds),
@@ -96,7 +99,14 @@ SDL_Window* create_window()
     int height;
     width = height = win_size;
 
-    auto flags = SDL_WINDOW_VULKAN | SDL_WINDOW_ALLOW_HIGHDPI;
+    if (size) {
+        width = size->width;
+        height = size->height;
+    }
+
+    auto flags = SDL_WINDOW_VULKAN
+                 | SDL_WINDOW_ALLOW_HIGHDPI
+                 | SDL_WINDOW_RESIZABLE;
     SDL::sdl_try(win = SDL_CreateWindow(title.c_str(),
                                         x_pos,
                                         y_pos,
@@ -122,15 +132,17 @@ SDL_Window* create_window()
     return win;
 }
 
-SDL::SDL()
+SDL::SDL(std::optional<WinSize> win_size)
 {
+    CU_ZONE("SDL::SDL");
+
     sdl_try(SDL_Init(SDL_INIT_VIDEO), "initializing SDL");
     log.brk();
 
     sdl_try(SDL_Vulkan_LoadLibrary(NULL), "loading Vulkan lib");
     log.brk();
 
-    win = create_window();
+    win = create_window(win_size);
 }
 
 SDL::~SDL() noexcept
@@ -204,14 +216,43 @@ PFN_vkGetInstanceProcAddr SDL::get_get_inst_proc_addr()
 
 void SDL::poll()
 {
+    // SDL timestamps events in SDL_GetTicks() milliseconds; to compare them
+    // with the steady clock, work out how long ago each one was
+
+    auto now   = std::chrono::steady_clock::now();
+    auto ticks = SDL_GetTicks();
+
     SDL_Event e;
     while (SDL_PollEvent(&e)) {
         switch (e.type) {
+        case SDL_KEYDOWN:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEMOTION:
+        {
+            auto t = now - std::chrono::milliseconds {
+                ticks - std::min(ticks, e.common.timestamp)
+            };
+            if (!first_input || t < *first_input) {
+                first_input = t;
+            }
+
+            if (e.type == SDL_KEYDOWN
+                && e.key.keysym.sym == SDLK_F12
+                && !e.key.repeat) {
+                dump_trace = true;
+            }
+            break;
+        }
         case SDL_QUIT:
             should_quit = true;
             log.enter("SDL", std::string("quit event received"));
             log.brk();
             break;
+        case SDL_WINDOWEVENT:
+            if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+                was_resized = true;
+            }
+            break;
         default:
             break;
         };
@@ -223,4 +264,19 @@ bool SDL::quit() const
     return should_quit;
 }
 
+bool SDL::resized()
+{
+    return std::exchange(was_resized, false);
+}
+
+bool SDL::trace_requested()
+{
+    return std::exchange(dump_trace, false);
+}
+
+std::optional<std::chrono::steady_clock::time_point> SDL::input_time()
+{
+    return std::exchange(first_input, std::nullopt);
+}
+
 } // namespace cu
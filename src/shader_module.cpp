@@ -34,7 +34,8 @@ ShaderModule::ShaderModule(Device::ptr l_dev,
     : Deviced(l_dev,
               "shader module '" + name + "'",
               "ShaderModule"),
-      nme {name}
+      nme {name},
+      refl {SpirvReflection::reflect(bin, sz)}
 {
     VkShaderModuleCreateInfo create_info {
         .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -59,8 +60,11 @@ ShaderModule::ShaderModule(Device::ptr l_dev,
 
 ShaderModule::ShaderModule(ShaderModule&& s)
     : Deviced(s.dev, s.descrptn(), s.create_fn_suffix(), s.destroy_fn_suffix()),
-      free_inner {true}
+      free_inner {s.free_inner},
+      nme {std::move(s.nme)},
+      refl {std::move(s.refl)}
 {
+    nner = s.nner;
     s.nner = nullptr;
     s.free_inner = false;
     s.dev = nullptr;
@@ -0,0 +1,168 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "shader_watcher.hpp"
+
+#include <chrono>
+#include <climits>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace cu {
+
+#ifdef __linux__
+
+const bool ShaderWatcher::supported = true;
+
+ShaderWatcher::ShaderWatcher(callback_t on_change)
+    : cb {on_change},
+      fd {inotify_init1(IN_NONBLOCK | IN_CLOEXEC)}
+{
+    if (fd < 0) {
+        throw std::runtime_error("could not initialize inotify");
+    }
+
+    thrd.t = std::thread {&ShaderWatcher::run, this};
+}
+
+ShaderWatcher::~ShaderWatcher() noexcept
+{
+    stopping = true;
+    thrd.join();
+    close(fd);
+}
+
+void ShaderWatcher::watch(std::filesystem::path file)
+{
+    auto dir = std::filesystem::absolute(file).parent_path();
+
+    std::lock_guard<std::mutex> lk {mtx};
+
+    if (!files.try_emplace(std::filesystem::absolute(file), file).second) {
+        return;
+    }
+
+    int wd = inotify_add_watch(fd,
+                               dir.c_str(),
+                               IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        throw std::runtime_error("could not watch " + dir.string());
+    }
+
+    dirs[wd] = dir;
+
+    log.enter("ShaderWatcher", "watching " + file.string());
+    log.brk();
+}
+
+void ShaderWatcher::run() noexcept
+{
+    using namespace std::chrono;
+
+    // events carry a variable-length name after them, so this has to be big
+    // enough for at least one event with a NAME_MAX name
+    alignas(inotify_event) char buf[sizeof(inotify_event) + NAME_MAX + 1];
+
+    std::set<std::filesystem::path> changed;
+    steady_clock::time_point last_event;
+
+    pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+
+    while (!stopping) {
+        // wake up regularly to check whether we should stop, and to notice
+        // when a burst of changes has settled
+        int ready = poll(&pfd, 1, 20);
+
+        if (ready > 0) {
+            ssize_t len;
+            while ((len = read(fd, buf, sizeof(buf))) > 0) {
+                for (char* p = buf; p < buf + len;) {
+                    auto ev = reinterpret_cast<const inotify_event*>(p);
+                    p += sizeof(inotify_event) + ev->len;
+
+                    if (ev->len == 0) {
+                        continue;
+                    }
+
+                    std::lock_guard<std::mutex> lk {mtx};
+                    auto dir = dirs.find(ev->wd);
+                    if (dir == dirs.end()) {
+                        continue;
+                    }
+
+                    auto f = files.find(dir->second / ev->name);
+                    if (f != files.end()) {
+                        changed.insert(f->second);
+                        last_event = steady_clock::now();
+                    }
+                }
+            }
+        }
+
+        if (!changed.empty()
+            && steady_clock::now() - last_event >= settle_time) {
+            for (const auto& path : changed) {
+                try {
+                    cb(path);
+                } catch (const std::exception& e) {
+                    log.enter("ShaderWatcher",
+                              "reloading " + path.string() + " failed: "
+                              + e.what());
+                    log.brk();
+                }
+            }
+
+            changed.clear();
+        }
+    }
+}
+
+#else
+
+const bool ShaderWatcher::supported = false;
+
+ShaderWatcher::ShaderWatcher(callback_t on_change)
+    : cb {on_change}
+{}
+
+ShaderWatcher::~ShaderWatcher() noexcept
+{}
+
+void ShaderWatcher::watch(std::filesystem::path file)
+{
+    log.enter("ShaderWatcher", "can't watch " + file.string()
+                               + " (not supported on this platform)");
+    log.brk();
+}
+
+void ShaderWatcher::run() noexcept
+{}
+
+#endif
+
+} // namespace cu
@@ -0,0 +1,739 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "spirv_reflection.hpp"
+
+#include "fnv1a.hpp"
+#include "lru_cache.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace cu {
+
+namespace {
+
+// The handful of SPIR-V enumerants we care about; see the SPIR-V
+// specification, section 3 ("Binary Form").
+
+constexpr uint32_t spv_magic = 0x07230203;
+constexpr std::size_t spv_header_words = 5;
+
+enum Op : uint32_t {
+    op_name                    = 5,
+    op_entry_point             = 15,
+    op_execution_mode          = 16,
+    op_type_bool               = 20,
+    op_type_int                = 21,
+    op_type_float              = 22,
+    op_type_vector             = 23,
+    op_type_matrix             = 24,
+    op_type_image              = 25,
+    op_type_sampler            = 26,
+    op_type_sampled_image      = 27,
+    op_type_array              = 28,
+    op_type_runtime_array      = 29,
+    op_type_struct             = 30,
+    op_type_pointer            = 32,
+    op_constant_true           = 41,
+    op_constant_false          = 42,
+    op_constant                = 43,
+    op_constant_composite      = 44,
+    op_spec_constant_true      = 48,
+    op_spec_constant_false     = 49,
+    op_spec_constant           = 50,
+    op_spec_constant_composite = 51,
+    op_variable                = 59,
+    op_decorate                = 71,
+    op_member_decorate         = 72,
+    op_execution_mode_id       = 331,
+};
+
+enum Decoration : uint32_t {
+    dec_spec_id        = 1,
+    dec_block          = 2,
+    dec_buffer_block   = 3,
+    dec_array_stride   = 6,
+    dec_matrix_stride  = 7,
+    dec_built_in       = 11,
+    dec_binding        = 33,
+    dec_descriptor_set = 34,
+    dec_offset         = 35,
+};
+
+enum StorageClass : uint32_t {
+    sc_uniform_constant = 0,
+    sc_uniform          = 2,
+    sc_push_constant    = 9,
+    sc_storage_buffer   = 12,
+};
+
+constexpr uint32_t builtin_workgroup_size = 25;
+constexpr uint32_t mode_local_size        = 17;
+constexpr uint32_t mode_local_size_id     = 38;
+constexpr uint32_t dim_buffer             = 5;
+constexpr uint32_t dim_subpass_data       = 6;
+
+struct Decorations {
+    std::optional<uint32_t> set;
+    std::optional<uint32_t> binding;
+    std::optional<uint32_t> spec_id;
+    std::optional<uint32_t> built_in;
+    std::optional<uint32_t> array_stride;
+    bool block        = false;
+    bool buffer_block = false;
+};
+
+struct MemberDecorations {
+    std::optional<uint32_t> offset;
+    std::optional<uint32_t> matrix_stride;
+};
+
+struct Type {
+    uint32_t op;
+    // everything after the result ID
+    std::vector<uint32_t> ops;
+};
+
+struct Constant {
+    uint32_t type;
+    uint32_t value;
+    bool     spec;
+};
+
+struct Variable {
+    uint32_t id;
+    uint32_t type;
+    uint32_t storage_class;
+};
+
+// The bits of the module we need, indexed by result ID.
+struct Module {
+    std::unordered_map<uint32_t, std::string> names;
+    std::unordered_map<uint32_t, Decorations> decos;
+    std::unordered_map<uint32_t, std::vector<MemberDecorations>> member_decos;
+    std::unordered_map<uint32_t, Type> types;
+    std::unordered_map<uint32_t, Constant> consts;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> composites;
+    std::vector<Variable> vars;
+    std::optional<uint32_t> exec_model;
+    std::optional<uint32_t> entry_point;
+    std::optional<SpirvReflection::LocalSize> local_size;
+    std::optional<std::array<uint32_t, 3>> local_size_ids;
+
+    const Type& type(uint32_t id) const
+    {
+        auto t = types.find(id);
+        if (t == types.end()) {
+            throw std::runtime_error("SPIR-V reflection: reference to "
+                                     "unknown type %" + std::to_string(id));
+        }
+
+        return t->second;
+    }
+
+    const Constant& constant(uint32_t id) const
+    {
+        auto c = consts.find(id);
+        if (c == consts.end()) {
+            throw std::runtime_error("SPIR-V reflection: expected %"
+                                     + std::to_string(id)
+                                     + " to be a scalar constant");
+        }
+
+        return c->second;
+    }
+
+    std::string name(uint32_t id) const
+    {
+        auto n = names.find(id);
+        return n == names.end() ? "" : n->second;
+    }
+
+    std::optional<uint32_t> spec_id(uint32_t id) const
+    {
+        auto c = consts.find(id);
+        auto d = decos.find(id);
+        if (c == consts.end() || !c->second.spec || d == decos.end()) {
+            return std::nullopt;
+        }
+
+        return d->second.spec_id;
+    }
+
+    uint32_t size_of(uint32_t id,
+                     std::optional<uint32_t> matrix_stride = std::nullopt) const;
+};
+
+// The fewest words each instruction we read can have, counting the one with
+// the opcode in it, so everything indexed below is sure to be there. Ones we
+// skip can be any length.
+std::size_t min_words(uint32_t op)
+{
+    switch (op) {
+    case op_type_bool:
+    case op_type_sampler:
+    case op_type_struct:
+        return 2;
+    case op_name:
+    case op_execution_mode:
+    case op_execution_mode_id:
+    case op_type_float:
+    case op_type_sampled_image:
+    case op_type_runtime_array:
+    case op_constant_true:
+    case op_constant_false:
+    case op_spec_constant_true:
+    case op_spec_constant_false:
+    case op_constant_composite:
+    case op_spec_constant_composite:
+    case op_decorate:
+        return 3;
+    case op_entry_point:
+    case op_type_int:
+    case op_type_vector:
+    case op_type_matrix:
+    case op_type_array:
+    case op_type_pointer:
+    case op_constant:
+    case op_spec_constant:
+    case op_variable:
+    case op_member_decorate:
+        return 4;
+    case op_type_image:
+        return 9;
+    default:
+        return 1;
+    }
+}
+
+std::string read_string(const uint32_t* words, std::size_t word_cnt)
+{
+    std::string out;
+    for (std::size_t i = 0; i < word_cnt; ++i) {
+        for (unsigned b = 0; b < 4; ++b) {
+            char c = static_cast<char>((words[i] >> (b * 8)) & 0xff);
+            if (c == '\0') {
+                return out;
+            }
+            out.push_back(c);
+        }
+    }
+
+    return out;
+}
+
+uint32_t Module::size_of(uint32_t id,
+                         std::optional<uint32_t> matrix_stride) const
+{
+    const Type& t = type(id);
+
+    switch (t.op) {
+    case op_type_bool:
+        return 4;
+    case op_type_int:
+    case op_type_float:
+        return t.ops.at(0) / 8;
+    case op_type_vector:
+        return t.ops.at(1) * size_of(t.ops.at(0));
+    case op_type_matrix:
+        return t.ops.at(1) * matrix_stride.value_or(size_of(t.ops.at(0)));
+    case op_type_array: {
+        uint32_t len = constant(t.ops.at(1)).value;
+        auto d = decos.find(id);
+        if (d != decos.end() && d->second.array_stride) {
+            return len * *d->second.array_stride;
+        }
+        return len * size_of(t.ops.at(0));
+    }
+    case op_type_runtime_array:
+        return 0;
+    case op_type_struct: {
+        auto md = member_decos.find(id);
+        uint32_t sz = 0;
+        for (std::size_t i = 0; i < t.ops.size(); ++i) {
+            MemberDecorations m;
+            if (md != member_decos.end() && i < md->second.size()) {
+                m = md->second.at(i);
+            }
+
+            uint32_t end = m.offset.value_or(sz)
+                           + size_of(t.ops.at(i), m.matrix_stride);
+            sz = std::max(sz, end);
+        }
+        return sz;
+    }
+    default:
+        throw std::runtime_error("SPIR-V reflection: can't work out the size "
+                                 "of type %" + std::to_string(id));
+    }
+}
+
+vk::ShaderStageFlags exec_model_stage(uint32_t model)
+{
+    using enum vk::ShaderStageFlag;
+
+    switch (model) {
+    case 0:
+        return flgs(vertex);
+    case 1:
+        return flgs(tsslltn_cntrl);
+    case 2:
+        return flgs(tsslltn_evltn);
+    case 3:
+        return flgs(gmtry);
+    case 4:
+        return flgs(frgmnt);
+    case 5:
+        return flgs(cmpte);
+    default:
+        throw std::runtime_error("SPIR-V reflection: unsupported execution "
+                                 "model " + std::to_string(model));
+    }
+}
+
+vk::DescriptorType descriptor_type(const Type& t,
+                                   const Decorations& d,
+                                   uint32_t storage_class)
+{
+    using enum vk::DescriptorType;
+
+    if (storage_class == sc_storage_buffer) {
+        return strge_buffer;
+    }
+
+    if (storage_class == sc_uniform) {
+        if (d.buffer_block) {
+            return strge_buffer;
+        }
+        return unfrm_buffer;
+    }
+
+    switch (t.op) {
+    case op_type_sampler:
+        return smplr;
+    case op_type_sampled_image:
+        return cmbnd_img_smplr;
+    case op_type_image: {
+        const uint32_t dim     = t.ops.at(1);
+        const uint32_t sampled = t.ops.at(5);
+
+        if (dim == dim_subpass_data) {
+            return input_attchmt;
+        } else if (dim == dim_buffer) {
+            return sampled == 2 ? strge_texel_buffer : unfrm_texel_buffer;
+        } else {
+            return sampled == 2 ? strge_img : smpld_img;
+        }
+    }
+    default:
+        throw std::runtime_error("SPIR-V reflection: unsupported descriptor "
+                                 "type (opcode " + std::to_string(t.op) + ")");
+    }
+}
+
+} // namespace
+
+SpirvReflection::SpirvReflection(const std::uint32_t* words, std::size_t sz)
+    : hsh {fnv1a(words, sz)}
+{
+    if (sz % sizeof(uint32_t)) {
+        throw std::runtime_error("SPIR-V reflection: module size isn't a "
+                                 "multiple of 4 bytes");
+    }
+
+    parse(words, sz / sizeof(uint32_t));
+}
+
+SpirvReflection::SpirvReflection(const BinData& bin)
+    : SpirvReflection(bin.u32(), bin.size())
+{}
+
+SpirvReflection::ptr SpirvReflection::reflect(const std::uint32_t* words,
+                                              std::size_t sz)
+{
+    // the module is kept too, so a hash that happens to match a different
+    // module's isn't taken for it; every edit of a reloaded shader is a new
+    // module, hence the bound on how many are held
+
+    struct entry {
+        std::vector<uint32_t> words;
+        ptr refl;
+    };
+
+    static std::mutex cache_mtx;
+    static LRUCache<uint64_t, entry> cache {cache_capacity};
+
+    const uint64_t h = fnv1a(words, sz);
+    const std::size_t word_cnt = sz / sizeof(uint32_t);
+
+    auto same = [words, word_cnt](const entry& e) {
+        return e.words.size() == word_cnt
+               && std::equal(e.words.begin(), e.words.end(), words);
+    };
+
+    {
+        std::lock_guard<std::mutex> lk {cache_mtx};
+        if (auto hit = cache.find(h); hit && same(*hit)) {
+            return hit->refl;
+        }
+    }
+
+    auto refl = std::make_shared<const SpirvReflection>(words, sz);
+
+    std::lock_guard<std::mutex> lk {cache_mtx};
+
+    // another thread may have got there first
+    if (auto hit = cache.find(h); hit && same(*hit)) {
+        return hit->refl;
+    }
+
+    return cache.insert(h, {{words, words + word_cnt}, refl}).refl;
+}
+
+SpirvReflection::ptr SpirvReflection::reflect(const BinData& bin)
+{
+    return reflect(bin.u32(), bin.size());
+}
+
+std::vector<SpirvReflection::Binding>
+SpirvReflection::bindings(uint32_t set) const
+{
+    std::vector<Binding> out;
+    std::copy_if(bndgs.begin(), bndgs.end(), std::back_inserter(out),
+                 [set](const Binding& b) { return b.set == set; });
+
+    return out;
+}
+
+uint32_t SpirvReflection::set_count() const
+{
+    return bndgs.empty() ? 0 : bndgs.back().set + 1;
+}
+
+void SpirvReflection::make_dynamic(uint32_t set, uint32_t binding)
+{
+    for (auto& b : bndgs) {
+        if (b.set == set && b.binding == binding) {
+            if (b.type == vk::DescriptorType::unfrm_buffer) {
+                b.type = vk::DescriptorType::unfrm_buffer_dynmc;
+                return;
+            } else if (b.type == vk::DescriptorType::strge_buffer) {
+                b.type = vk::DescriptorType::strge_buffer_dynmc;
+                return;
+            }
+        }
+    }
+
+    throw std::runtime_error("SPIR-V reflection: no uniform or storage buffer "
+                             "at set " + std::to_string(set) + ", binding "
+                             + std::to_string(binding));
+}
+
+bool SpirvReflection::layout_compatible(const SpirvReflection& other) const
+{
+    if (stgs != other.stgs || bndgs.size() != other.bndgs.size()) {
+        return false;
+    }
+
+    if (pcs.has_value() != other.pcs.has_value()
+        || (pcs && (pcs->offset != other.pcs->offset
+                    || pcs->size != other.pcs->size))) {
+        return false;
+    }
+
+    return std::equal(bndgs.begin(), bndgs.end(), other.bndgs.begin(),
+                      [](const Binding& a, const Binding& b)
+                      {
+                          return a.set == b.set
+                                 && a.binding == b.binding
+                                 && a.type == b.type
+                                 && a.count == b.count;
+                      });
+}
+
+void SpirvReflection::parse(const std::uint32_t* words, std::size_t word_cnt)
+{
+    if (word_cnt < spv_header_words || words[0] != spv_magic) {
+        throw std::runtime_error("SPIR-V reflection: not a SPIR-V module");
+    }
+
+    Module m;
+
+    for (std::size_t i = spv_header_words; i < word_cnt;) {
+        const uint32_t op  = words[i] & 0xffff;
+        const uint32_t len = words[i] >> 16;
+
+        if (len < min_words(op) || len > word_cnt - i) {
+            throw std::runtime_error("SPIR-V reflection: malformed "
+                                     "instruction at word "
+                                     + std::to_string(i));
+        }
+
+        const uint32_t* w = words + i;
+        i += len;
+
+        switch (op) {
+        case op_name:
+            m.names[w[1]] = read_string(w + 2, len - 2);
+            break;
+        case op_entry_point:
+            if (!m.entry_point) {
+                m.exec_model = w[1];
+                m.entry_point = w[2];
+            }
+            break;
+        case op_execution_mode:
+            if (w[2] == mode_local_size && len >= 6) {
+                m.local_size = LocalSize {w[3], w[4], w[5]};
+            }
+            break;
+        case op_execution_mode_id:
+            if (w[2] == mode_local_size_id && len >= 6) {
+                m.local_size_ids = {w[3], w[4], w[5]};
+            }
+            break;
+        case op_type_bool:
+        case op_type_int:
+        case op_type_float:
+        case op_type_vector:
+        case op_type_matrix:
+        case op_type_image:
+        case op_type_sampler:
+        case op_type_sampled_image:
+        case op_type_array:
+        case op_type_runtime_array:
+        case op_type_struct:
+        case op_type_pointer:
+            m.types[w[1]] = Type {op, {w + 2, w + len}};
+            break;
+        case op_constant:
+        case op_spec_constant:
+            m.consts[w[2]] = Constant {w[1], w[3], op == op_spec_constant};
+            break;
+        case op_constant_true:
+        case op_constant_false:
+        case op_spec_constant_true:
+        case op_spec_constant_false:
+            m.consts[w[2]] = Constant {
+                w[1],
+                op == op_constant_true || op == op_spec_constant_true,
+                op == op_spec_constant_true || op == op_spec_constant_false,
+            };
+            break;
+        case op_constant_composite:
+        case op_spec_constant_composite:
+            m.composites[w[2]] = {w + 3, w + len};
+            break;
+        case op_variable:
+            m.vars.push_back({w[2], w[1], w[3]});
+            break;
+        case op_decorate: {
+            Decorations& d = m.decos[w[1]];
+            const uint32_t arg = len > 3 ? w[3] : 0;
+            switch (w[2]) {
+            case dec_spec_id:        d.spec_id = arg;      break;
+            case dec_block:          d.block = true;       break;
+            case dec_buffer_block:   d.buffer_block = true; break;
+            case dec_array_stride:   d.array_stride = arg; break;
+            case dec_built_in:       d.built_in = arg;     break;
+            case dec_binding:        d.binding = arg;      break;
+            case dec_descriptor_set: d.set = arg;          break;
+            }
+            break;
+        }
+        case op_member_decorate: {
+            // a struct can't have more members than there are words
+            if (w[2] >= word_cnt) {
+                throw std::runtime_error("SPIR-V reflection: member "
+                                         + std::to_string(w[2])
+                                         + " is out of range");
+            }
+
+            auto& mds = m.member_decos[w[1]];
+            if (mds.size() <= w[2]) {
+                mds.resize(w[2] + 1);
+            }
+            const uint32_t arg = len > 4 ? w[4] : 0;
+            if (w[3] == dec_offset) {
+                mds.at(w[2]).offset = arg;
+            } else if (w[3] == dec_matrix_stride) {
+                mds.at(w[2]).matrix_stride = arg;
+            }
+            break;
+        }
+        }
+    }
+
+    if (m.exec_model) {
+        stgs = exec_model_stage(*m.exec_model);
+    }
+
+    // descriptors and push constants
+
+    for (const auto& var : m.vars) {
+        const Type& ptr_t = m.type(var.type);
+        if (ptr_t.op != op_type_pointer) {
+            continue;
+        }
+
+        uint32_t pointee = ptr_t.ops.at(1);
+
+        if (var.storage_class == sc_push_constant) {
+            const Type& blk = m.type(pointee);
+            uint32_t offs = UINT32_MAX;
+            auto md = m.member_decos.find(pointee);
+            if (md != m.member_decos.end()) {
+                for (const auto& mem : md->second) {
+                    if (mem.offset) {
+                        offs = std::min(offs, *mem.offset);
+                    }
+                }
+            }
+            if (offs == UINT32_MAX || blk.ops.empty()) {
+                offs = 0;
+            }
+
+            pcs = PushConstantBlock {
+                .offset = offs,
+                .size   = m.size_of(pointee) - offs,
+            };
+            continue;
+        }
+
+        if (var.storage_class != sc_uniform_constant
+            && var.storage_class != sc_uniform
+            && var.storage_class != sc_storage_buffer) {
+            continue;
+        }
+
+        auto vd = m.decos.find(var.id);
+        if (vd == m.decos.end() || !vd->second.binding) {
+            continue;
+        }
+
+        uint32_t count = 1;
+        for (;;) {
+            const Type& t = m.type(pointee);
+            if (t.op == op_type_array) {
+                count *= m.constant(t.ops.at(1)).value;
+                pointee = t.ops.at(0);
+            } else if (t.op == op_type_runtime_array) {
+                throw std::runtime_error("SPIR-V reflection: runtime-sized "
+                                         "descriptor arrays aren't supported "
+                                         "(" + m.name(var.id) + ")");
+            } else {
+                break;
+            }
+        }
+
+        Decorations pointee_d;
+        if (auto pd = m.decos.find(pointee); pd != m.decos.end()) {
+            pointee_d = pd->second;
+        }
+
+        bndgs.push_back({
+            .set     = vd->second.set.value_or(0),
+            .binding = *vd->second.binding,
+            .type    = descriptor_type(m.type(pointee),
+                                       pointee_d,
+                                       var.storage_class),
+            .count   = count,
+            .name    = m.name(var.id),
+        });
+    }
+
+    std::sort(bndgs.begin(), bndgs.end(),
+              [](const Binding& a, const Binding& b)
+              {
+                  return a.set < b.set
+                         || (a.set == b.set && a.binding < b.binding);
+              });
+
+    for (std::size_t i = 1; i < bndgs.size(); ++i) {
+        if (bndgs.at(i).set == bndgs.at(i - 1).set
+            && bndgs.at(i).binding == bndgs.at(i - 1).binding) {
+            throw std::runtime_error("SPIR-V reflection: more than one "
+                                     "variable at set "
+                                     + std::to_string(bndgs.at(i).set)
+                                     + ", binding "
+                                     + std::to_string(bndgs.at(i).binding));
+        }
+    }
+
+    // workgroup size; a WorkgroupSize built-in takes precedence over the
+    // execution mode if both are present
+
+    if (m.local_size) {
+        lcl_sz = *m.local_size;
+    }
+
+    auto axis_from = [this, &m](std::array<uint32_t, 3> ids)
+    {
+        uint32_t* axes[3] = {&lcl_sz.x, &lcl_sz.y, &lcl_sz.z};
+        for (std::size_t a = 0; a < 3; ++a) {
+            *axes[a] = m.constant(ids.at(a)).value;
+            lcl_sz_spec_ids.at(a) = m.spec_id(ids.at(a));
+        }
+    };
+
+    if (m.local_size_ids) {
+        axis_from(*m.local_size_ids);
+    }
+
+    for (const auto& [id, d] : m.decos) {
+        if (d.built_in == builtin_workgroup_size) {
+            auto c = m.composites.find(id);
+            if (c != m.composites.end() && c->second.size() == 3) {
+                axis_from({c->second.at(0), c->second.at(1), c->second.at(2)});
+            }
+        }
+    }
+
+    // specialization constants
+
+    for (const auto& [id, c] : m.consts) {
+        if (!c.spec) {
+            continue;
+        }
+
+        auto d = m.decos.find(id);
+        if (d == m.decos.end() || !d->second.spec_id) {
+            continue;
+        }
+
+        spec_consts.push_back({
+            .spec_id = *d->second.spec_id,
+            .size    = m.size_of(c.type),
+            .name    = m.name(id),
+        });
+    }
+
+    std::sort(spec_consts.begin(), spec_consts.end(),
+              [](const SpecConstant& a, const SpecConstant& b)
+              {
+                  return a.spec_id < b.spec_id;
+              });
+}
+
+} // namespace cu
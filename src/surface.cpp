@@ -41,6 +41,16 @@ Surface::Surface(SDL& sdl, Instance::ptr instance)
              instance->get_proc_addr("vkGetPhysicalDeviceSurfacePresentModesKHR")
          )
      },
+     get_surf_fmts{
+         reinterpret_cast<PFN_vkGetPhysicalDeviceSurfaceFormatsKHR>(
+             instance->get_proc_addr("vkGetPhysicalDeviceSurfaceFormatsKHR")
+         )
+     },
+     get_fmt_props{
+         reinterpret_cast<PFN_vkGetPhysicalDeviceFormatProperties>(
+             instance->get_proc_addr("vkGetPhysicalDeviceFormatProperties")
+         )
+     },
      destroy_surf{
          reinterpret_cast<PFN_vkDestroySurfaceKHR>(
              instance->get_proc_addr("vkDestroySurfaceKHR")
@@ -94,4 +104,27 @@ std::vector<VkPresentModeKHR> Surface::present_modes(PhysDevice& dev)
     return modes;
 }
 
+std::vector<VkSurfaceFormatKHR> Surface::formats(PhysDevice& dev)
+{
+    uint32_t fmts_cnt;
+    Vulkan::vk_try(get_surf_fmts(dev.inner(), surf, &fmts_cnt, NULL),
+                   "get surface formats count");
+    log.brk();
+
+    std::vector<VkSurfaceFormatKHR> fmts (fmts_cnt);
+    Vulkan::vk_try(get_surf_fmts(dev.inner(), surf, &fmts_cnt, fmts.data()),
+                   "get surface formats");
+    log.brk();
+
+    return fmts;
+}
+
+VkFormatFeatureFlags Surface::format_features(PhysDevice& dev, VkFormat fmt)
+{
+    VkFormatProperties props;
+    get_fmt_props(dev.inner(), fmt, &props);
+
+    return props.optimalTilingFeatures;
+}
+
 } // namespace cu
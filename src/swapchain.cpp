@@ -27,44 +27,138 @@
 #include "device.hpp"
 #include "surface.hpp"
 #include "vulkan.hpp"
+#include "trace.hpp"
 
 #include <vector>
 #include <algorithm>
+#include <memory>
 
 namespace cu {
 
-void Swapchain::create(VkSwapchainKHR old_swch)
+std::optional<VkFormat> Swapchain::storage_format()
 {
-    const auto surface_caps = surf.capabilities(p_dev);
-    extent = surface_caps.currentExtent;
-    uint32_t   min_img_cnt  = 2;
-    bool limited_max_imgs = surface_caps.maxImageCount != 0;
-    if (limited_max_imgs && surface_caps.maxImageCount < min_img_cnt) {
-        min_img_cnt = surface_caps.maxImageCount;
+    const auto caps = surf.capabilities(p_dev);
+    if (!(caps.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT)) {
+        return std::nullopt;
+    }
+
+    const auto surf_fmts = surf.formats(p_dev);
+
+    for (auto candidate : {VK_FORMAT_B8G8R8A8_UNORM,
+                           VK_FORMAT_R8G8B8A8_UNORM}) {
+        bool offered = std::any_of(
+            surf_fmts.begin(),
+            surf_fmts.end(),
+            [candidate](const VkSurfaceFormatKHR& f) {
+                return f.format == candidate
+                       && f.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+            }
+        );
+
+        if (offered
+            && (surf.format_features(p_dev, candidate)
+                & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+            return candidate;
+        }
     }
 
+    return std::nullopt;
+}
+
+VkPresentModeKHR Swapchain::choose_present_mode()
+{
+    const auto pres_modes = surf.present_modes(p_dev);
+
+    auto supported = [&](VkPresentModeKHR m) {
+        return std::find(begin(pres_modes), end(pres_modes), m)
+               != end(pres_modes);
+    };
+
     // support for VK_PRESENT_MODE_FIFO_KHR is required by the
     // spec (see VkSwapchainCreateInfoKHR in 33.9 WSI Swapchain)
-    VkPresentModeKHR pres_mode = VK_PRESENT_MODE_FIFO_KHR;
 
-    {
-        const auto pres_modes = surf.present_modes(p_dev);
+    if (cfg.mode) {
+        if (supported(*cfg.mode)) {
+            return *cfg.mode;
+        }
 
-        const bool mailbox_supported =
-            std::find(begin(pres_modes),
-                      end(pres_modes),
-                      VK_PRESENT_MODE_MAILBOX_KHR) != end(pres_modes);
+        log.enter("Vulkan: present mode " + vk::prsnt_mode_str(*cfg.mode)
+                  + " is unsupported, falling back to "
+                  + vk::prsnt_mode_str(VK_PRESENT_MODE_FIFO_KHR));
+        log.brk();
 
-        if (mailbox_supported) {
-            pres_mode = VK_PRESENT_MODE_MAILBOX_KHR;
-        }
+        return VK_PRESENT_MODE_FIFO_KHR;
+    }
+
+    if (supported(VK_PRESENT_MODE_MAILBOX_KHR)) {
+        return VK_PRESENT_MODE_MAILBOX_KHR;
+    }
+
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+uint32_t Swapchain::choose_img_count(const VkSurfaceCapabilitiesKHR& caps)
+{
+    uint32_t cnt = cfg.img_count.value_or(2);
+
+    cnt = std::max(cnt, caps.minImageCount);
+
+    // a maxImageCount of 0 means there's no limit
+    if (caps.maxImageCount != 0) {
+        cnt = std::min(cnt, caps.maxImageCount);
+    }
+
+    if (cfg.img_count && cnt != *cfg.img_count) {
+        log.enter("Vulkan: the surface can't have "
+                  + std::to_string(*cfg.img_count)
+                  + " images, using "
+                  + std::to_string(cnt));
+        log.brk();
     }
 
+    return cnt;
+}
+
+void Swapchain::create(VkSwapchainKHR old_swch)
+{
+    CU_ZONE("Swapchain::create");
+
+    const auto surface_caps = surf.capabilities(p_dev);
+    extent = surface_caps.currentExtent;
+    const uint32_t min_img_cnt = choose_img_count(surface_caps);
+    pres_mode = choose_present_mode();
+
     log.enter("Vulkan: using present mode "
               + vk::prsnt_mode_str(pres_mode));
 
     log.brk();
 
+    // see storage()
+
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                              | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    fmt  = VK_FORMAT_B8G8R8A8_SRGB;
+    strg = false;
+
+    if (want_strg) {
+        if (auto f = storage_format()) {
+            fmt    = *f;
+            usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+            strg   = true;
+        }
+    }
+
+    rdbl = cfg.readable
+           && (surface_caps.supportedUsageFlags
+               & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+    if (rdbl) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    } else if (cfg.readable) {
+        log.enter("Vulkan: the surface's images can't be copied out of");
+        log.brk();
+    }
+
     VkSwapchainCreateInfoKHR create_info {
         .sType                 = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .pNext                 = NULL,
@@ -81,17 +175,15 @@ void Swapchain::create(VkSwapchainKHR old_swch)
         // cases here. I know there are some cards and displays out
         // there right now that support fancier color spaces, but
         // that will have to wait until Lily and I can actually get
-        // our hands on such things.
-        .imageFormat           = VK_FORMAT_B8G8R8A8_SRGB,
+        // our hands on such things. (The format itself may be UNORM
+        // rather than sRGB; see storage().)
+        .imageFormat           = fmt,
         .imageColorSpace       = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
 
         .imageExtent           = extent,
         .imageArrayLayers      = 1,
 
-        // this will probably need to be changed later
-        //.imageUsage            = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-        .imageUsage            = VK_IMAGE_USAGE_TRANSFER_DST_BIT
-                                 | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        .imageUsage            = usage,
 
         .imageSharingMode      = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
@@ -105,6 +197,9 @@ void Swapchain::create(VkSwapchainKHR old_swch)
         //.oldSwapchain          = VK_NULL_HANDLE,
     };
 
+    // needed below to decide how long to keep the old swapchain around
+    const auto old_img_cnt = static_cast<uint32_t>(imgs.size());
+
     _img_views.clear();
     imgs.clear();
 
@@ -130,14 +225,23 @@ void Swapchain::create(VkSwapchainKHR old_swch)
               vk::prsnt_mode_str(create_info.presentMode));
     log.brk();
 
+    // Destroying the old swapchain right away would mean stalling until the
+    // presentation engine is done with it. Instead it's kept, along with the
+    // fences of the presents made from it, until collect_retired() finds it's
+    // safe to go; see there.
+
     if (old_swch != VK_NULL_HANDLE) {
-        log.attempt("Vulkan", "destroying old swapchain");
-        destroy_swch(dev->inner(), old_swch, NULL);
-        log.finish();
-        log.brk();
+        retired.push_back({
+            .swch        = old_swch,
+            .frames_left = old_img_cnt,
+            .fnces       = std::move(pres_fnces),
+            .done        = false,
+        });
+        pres_fnces.clear();
     }
 
     swch = std::move(new_swch);
+    subopt = false;
 
     uint32_t imgs_cnt;
     Vulkan::vk_try(get_swch_imgs(dev->inner(), swch, &imgs_cnt, NULL),
@@ -185,10 +289,14 @@ void Swapchain::create(VkSwapchainKHR old_swch)
 
 Swapchain::Swapchain(PhysDevice p_dev_in,
                      Device::ptr l_dev,
-                     Surface& surf_in)
+                     Surface& surf_in,
+                     bool storage,
+                     PresentConfig cfg_in)
     :p_dev {p_dev_in},
      dev{l_dev},
      surf {surf_in},
+     want_strg {storage},
+     cfg {cfg_in},
      create_swch{
         reinterpret_cast<PFN_vkCreateSwapchainKHR>(
             l_dev->get_proc_addr("vkCreateSwapchainKHR")
@@ -215,6 +323,31 @@ Swapchain::Swapchain(PhysDevice p_dev_in,
 
 Swapchain::~Swapchain() noexcept
 {
+    try {
+        if (dev->present_fences()) {
+            for (auto& r : retired) {
+                for (auto& f : r.fnces) {
+                    f->wait();
+                }
+            }
+
+            for (auto& f : pres_fnces) {
+                f->wait();
+            }
+        } else if (!retired.empty()) {
+            dev->wait_idle(Device::present_queue);
+        }
+    } catch (...) {
+        // the device is gone, so there's nothing to wait for
+    }
+
+    for (auto& r : retired) {
+        log.attempt("Vulkan", "destroying old swapchain");
+        destroy_swch(dev->inner(), r.swch, NULL);
+        log.finish();
+        log.brk();
+    }
+
     log.attempt("Vulkan", "destroying swapchain");
     destroy_swch(dev->inner(), swch, NULL);
     log.finish();
@@ -228,6 +361,76 @@ void Swapchain::recreate()
     create(swch);
 }
 
+void Swapchain::collect_retired()
+{
+    bool waited = false;
+
+    for (auto& r : retired) {
+        if (r.frames_left > 0) {
+            --r.frames_left;
+        }
+
+        if (dev->present_fences()) {
+            // every present made from it signals its fence once the
+            // presentation engine is done with the image, so once they all
+            // have, nothing can still be using it
+
+            r.done = std::all_of(r.fnces.begin(),
+                                 r.fnces.end(),
+                                 [](const auto& f) { return f->signaled(); });
+        } else if (r.frames_left == 0) {
+            // Without VK_EXT_swapchain_maintenance1 nothing says when the
+            // presentation engine has let go of a swapchain. Once as many
+            // frames have gone by as it had images, every image presented from
+            // it has been replaced on screen, and waiting for the present queue
+            // to go idle then seldom blocks for long. This is only a fallback:
+            // the spec offers no stronger guarantee without present fences.
+
+            if (!waited) {
+                dev->wait_idle(Device::present_queue);
+                waited = true;
+            }
+
+            r.done = true;
+        }
+
+        if (r.done) {
+            log.attempt("Vulkan", "destroying old swapchain");
+            destroy_swch(dev->inner(), r.swch, NULL);
+            log.finish();
+            log.brk();
+
+            for (auto& f : r.fnces) {
+                f->reset();
+                spare_fnces.push_back(std::move(f));
+            }
+        }
+    }
+
+    std::erase_if(retired, [](const auto& r) { return r.done; });
+}
+
+VkFence Swapchain::present_fence()
+{
+    // presents finish in about the order they were queued, so the fences at
+    // the front that have signaled can be used again
+
+    while (!pres_fnces.empty() && pres_fnces.front()->signaled()) {
+        pres_fnces.front()->reset();
+        spare_fnces.push_back(std::move(pres_fnces.front()));
+        pres_fnces.pop_front();
+    }
+
+    if (spare_fnces.empty()) {
+        pres_fnces.push_back(std::make_unique<Fence>(dev));
+    } else {
+        pres_fnces.push_back(std::move(spare_fnces.back()));
+        spare_fnces.pop_back();
+    }
+
+    return pres_fnces.back()->inner();
+}
+
 SwapchainResult Swapchain::next_img(VkFence fnce,
                                     VkSemaphore sem,
                                     uint64_t timeout)
@@ -240,7 +443,9 @@ SwapchainResult Swapchain::next_img(VkFence fnce,
                                     fnce,
                                     &current_ndx);
 
-    if (res == VK_ERROR_OUT_OF_DATE_KHR || res == VK_SUBOPTIMAL_KHR) {
+    subopt = false;
+
+    if (res == VK_ERROR_OUT_OF_DATE_KHR) {
         log.enter("swapchain needs recreation");
         log.brk();
         return SwapchainResult::needs_recreate;
@@ -251,6 +456,10 @@ SwapchainResult Swapchain::next_img(VkFence fnce,
     } else {
         log.finish();
         Vulkan::vk_try(res, "double-checking swapchain image acquisition");
+        if (res == VK_SUBOPTIMAL_KHR) {
+            log.enter("swapchain is suboptimal");
+            subopt = true;
+        }
         log.indent();
         log.enter("index", current_ndx);
         log.brk();
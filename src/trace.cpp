@@ -0,0 +1,279 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "trace.hpp"
+
+#include "game.hpp"
+#include "json_escape.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace cu {
+
+Trace trace;
+
+namespace {
+
+std::atomic<uint64_t> next_serial = 1;
+
+// the calling thread's ring in the Trace with the given serial, if it has
+// one yet
+struct thread_ring {
+    uint64_t serial = 0;
+    void* r = nullptr;
+};
+
+thread_local thread_ring this_thread_ring;
+
+} // namespace
+
+Trace::Trace(std::size_t ring_size)
+    : ring_sz {std::max<std::size_t>(ring_size, 1)},
+      epoch {clock::now()},
+      serial {next_serial.fetch_add(1)}
+{}
+
+void Trace::start(std::filesystem::path out)
+{
+    {
+        std::lock_guard<std::mutex> lk {mtx};
+        out_path = std::move(out);
+    }
+
+    on.store(true, std::memory_order_relaxed);
+}
+
+Trace::track_id Trace::add_ring(std::string name)
+{
+    rings.push_back(std::make_unique<ring>());
+    rings.back()->name = std::move(name);
+
+    return static_cast<track_id>(rings.size() - 1);
+}
+
+Trace::ring& Trace::this_ring()
+{
+    auto& tr = this_thread_ring;
+
+    if (tr.serial != serial) {
+        std::lock_guard<std::mutex> lk {mtx};
+        auto t = add_ring("thread " + std::to_string(rings.size()));
+        tr.serial = serial;
+        tr.r = rings[t].get();
+    }
+
+    return *static_cast<ring*>(tr.r);
+}
+
+void Trace::push(ring& r, const event& e) noexcept
+{
+    try {
+        std::lock_guard<std::mutex> lk {r.mtx};
+
+        if (r.evs.size() < ring_sz) {
+            r.evs.push_back(e);
+        } else {
+            r.evs[r.written % ring_sz] = e;
+        }
+
+        ++r.written;
+    } catch (...) {
+        // a trace is never worth taking the program down over
+    }
+}
+
+void Trace::complete(const char* name,
+                     clock::time_point start,
+                     clock::time_point end) noexcept
+{
+    if (!enabled()) {
+        return;
+    }
+
+    try {
+        push(this_ring(), {.name = name, .start = start, .dur = end - start});
+    } catch (...) {}
+}
+
+void Trace::complete(track_id t,
+                     const char* name,
+                     clock::time_point start,
+                     clock::time_point end) noexcept
+{
+    if (!enabled()) {
+        return;
+    }
+
+    ring* r;
+    {
+        std::lock_guard<std::mutex> lk {mtx};
+        if (t >= rings.size()) {
+            return;
+        }
+        r = rings[t].get();
+    }
+
+    push(*r, {.name = name, .start = start, .dur = end - start});
+}
+
+Trace::track_id Trace::track(const std::string& name)
+{
+    std::lock_guard<std::mutex> lk {mtx};
+
+    // tracks aren't threads, so they can be told apart by name alone
+    for (track_id t = 0; t < rings.size(); ++t) {
+        if (rings[t]->name == name) {
+            return t;
+        }
+    }
+
+    return add_ring(name);
+}
+
+void Trace::name_thread(std::string name)
+{
+    auto& r = this_ring();
+
+    std::lock_guard<std::mutex> lk {mtx};
+    r.name = std::move(name);
+}
+
+const char* Trace::intern(const std::string& name)
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    return names.insert(name).first->c_str();
+}
+
+uint64_t Trace::dropped() const
+{
+    std::lock_guard<std::mutex> lk {mtx};
+    return dropped_locked();
+}
+
+uint64_t Trace::dropped_locked() const
+{
+    uint64_t n = 0;
+    for (const auto& r : rings) {
+        std::lock_guard<std::mutex> r_lk {r->mtx};
+        if (r->written > ring_sz) {
+            n += r->written - ring_sz;
+        }
+    }
+
+    return n;
+}
+
+void Trace::write(std::ostream& out) const
+{
+    // timestamps are in microseconds since the Trace was made, which keeps
+    // them small enough to print exactly
+
+    auto us = [](clock::duration d) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.3f",
+                      std::chrono::duration<double, std::micro>(d).count());
+        return std::string {buf};
+    };
+
+    std::lock_guard<std::mutex> lk {mtx};
+
+    out << "{\"displayTimeUnit\":\"ms\",\n"
+        << "\"otherData\":{\"dropped_events\":" << dropped_locked() << "},\n"
+        << "\"traceEvents\":[\n"
+        << "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\","
+        << "\"args\":{\"name\":\"" << json_escape(Game::name) << "\"}}";
+
+    for (track_id t = 0; t < rings.size(); ++t) {
+        const auto& r = *rings[t];
+        std::lock_guard<std::mutex> r_lk {r.mtx};
+
+        const auto tid = std::to_string(t + 1);
+
+        out << ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"name\":\"thread_name\",\"args\":{\"name\":\""
+            << json_escape(r.name) << "\"}}";
+
+        // oldest first; once the ring has wrapped, that's the one the next
+        // event would overwrite
+        const std::size_t first = r.written > r.evs.size()
+                                  ? r.written % r.evs.size()
+                                  : 0;
+
+        for (std::size_t i = 0; i < r.evs.size(); ++i) {
+            const auto& e = r.evs[(first + i) % r.evs.size()];
+
+            out << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                << ",\"name\":\"" << json_escape(e.name)
+                << "\",\"ts\":" << us(e.start - epoch)
+                << ",\"dur\":" << us(e.dur) << "}";
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+std::size_t Trace::dump() const
+{
+    std::filesystem::path path;
+    {
+        std::lock_guard<std::mutex> lk {mtx};
+        path = out_path;
+    }
+
+    if (path.empty()) {
+        throw std::runtime_error("can't dump the trace: no path was given");
+    }
+
+    std::ofstream f {path, std::ios::binary | std::ios::trunc};
+    write(f);
+    f.flush();
+
+    if (!f) {
+        throw std::runtime_error("failed to write the trace to "
+                                 + path.string());
+    }
+
+    std::lock_guard<std::mutex> lk {mtx};
+
+    std::size_t n = 0;
+    for (const auto& r : rings) {
+        std::lock_guard<std::mutex> r_lk {r->mtx};
+        n += r->evs.size();
+    }
+
+    return n;
+}
+
+void Trace::clear()
+{
+    std::lock_guard<std::mutex> lk {mtx};
+
+    for (auto& r : rings) {
+        std::lock_guard<std::mutex> r_lk {r->mtx};
+        r->evs.clear();
+        r->written = 0;
+    }
+}
+
+} // namespace cu
@@ -33,9 +33,17 @@
 #include "command_buffer.hpp"
 #include "fence.hpp"
 #include "push_constants.hpp"
+#include "buffer.hpp"
+#include "metrics.hpp"
+#include "frame_stats.hpp"
+#include "trace.hpp"
+#include "vulkan_loader.hpp"
 
 #include <stdexcept>
+#include <algorithm>
+#include <iterator>
 #include <array>
+#include <cstring>
 #include <iostream>
 
 namespace cu {
@@ -249,245 +257,947 @@ std::string Vulkan::api_ver_to_str(uint32_t ver)
 Vulkan::Vulkan(std::vector<const char*> exts,
                std::vector<const char*> layers,
                SDL& sdl,
-               bool debug)
-    : inst{std::make_shared<Instance>(exts, layers)},
+               bool debug,
+               PresentConfig pres_cfg)
+    : inst{
+          // the device can only use present fences (see
+          // Device::present_fences()) if these are on
+          std::make_shared<Instance>(
+              exts,
+              layers,
+              nullptr,
+              std::vector<const char*> {
+                  VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME,
+                  VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME,
+              }
+          )
+      },
       dbg_msgr{inst, debug},
-      surf{sdl, inst},
+      surf{std::make_unique<Surface>(sdl, inst)},
       phys_devs{inst},
       logi_dev {
-          std::make_shared<Device>(phys_devs.default_device(surf), inst)
+          std::make_shared<Device>(phys_devs.default_device(*surf), inst)
       },
-      swch{phys_devs.default_device(), logi_dev, surf}
-{}
-
-void Vulkan::minicomp_setup()
+      swch {
+          std::make_unique<Swapchain>(phys_devs.default_device(),
+                                      logi_dev,
+                                      *surf,
+                                      true,
+                                      pres_cfg)
+      },
+      compiler {std::make_unique<PipelineCompiler>(logi_dev)},
+      registry {std::make_unique<PipelineRegistry>(*compiler)}
 {
-    using namespace vk;
+    name_latency_metrics();
+}
 
-    static_assert(sizeof(float) == 4,
-                  "shader interface requires 32-bit floats");
+Vulkan::Vulkan(VkExtent2D extent,
+               std::vector<const char*> exts,
+               std::vector<const char*> layers,
+               bool debug)
+    : inst {
+          std::make_shared<Instance>(exts,
+                                     layers,
+                                     VulkanLoader::get_inst_proc_addr())
+      },
+      dbg_msgr{inst, debug},
+      phys_devs{inst},
+      logi_dev {
+          std::make_shared<Device>(phys_devs.default_device(true),
+                                   inst,
+                                   false)
+      },
+      offscr {std::make_unique<Offscreen>(logi_dev, extent)},
+      compiler {std::make_unique<PipelineCompiler>(logi_dev)},
+      registry {std::make_unique<PipelineRegistry>(*compiler)}
+{
+    log.enter("Vulkan", std::string("running headless"));
+    log.brk();
+}
 
-    // set up the "scratch" image descriptor set layout
+uint32_t Vulkan::target_count()
+{
+    return swch ? swch->img_count() : offscr->img_count();
+}
 
-    DescriptorSetLayoutBinding swapimg ({
-        .binding_ndx   = 0,
-        .type          = DescriptorType::strge_img,
-        .count         = 1,
-        .shader_stages = flgs(ShaderStageFlag::cmpte),
-    });
+VkExtent2D Vulkan::target_extent()
+{
+    return swch ? VkExtent2D {swch->width(), swch->height()}
+                : VkExtent2D {offscr->width(), offscr->height()};
+}
 
-    minist.bndgs({swapimg});
+std::vector<std::pair<std::string, std::string>> Vulkan::describe()
+{
+    const auto ext = target_extent();
+
+    std::vector<std::pair<std::string, std::string>> desc = {
+        {"device", logi_dev->name()},
+        {"resolution", std::to_string(ext.width) + "x"
+                       + std::to_string(ext.height)},
+        {"images", std::to_string(target_count())},
+    };
+
+    if (swch) {
+        desc.push_back({"present_mode",
+                        PresentConfig::mode_name(swch->present_mode())});
+    }
 
-    auto d_layt = std::make_shared<DescriptorSetLayout>(logi_dev,
-                                                        "scratch image",
-                                                        minist.bndgs());
+    return desc;
+}
 
-    minist.d_layts({d_layt});
+Image& Vulkan::target_img(uint32_t ndx)
+{
+    return swch ? swch->img(ndx) : offscr->img(ndx);
+}
 
-    // compute pipeline and shader module
+ImageView& Vulkan::target_view(uint32_t ndx)
+{
+    return swch ? swch->view(ndx) : offscr->view(ndx);
+}
 
-    minist.push_consts({new PushConstants<MinicompPCs> {
-        flgs(vk::ShaderStageFlag::cmpte)
-    }});
+void Vulkan::minicomp_setup()
+{
+    using namespace vk;
 
-   static_cast<PushConstants<MinicompPCs>*>(minist.push_consts()[0])
-       ->values()->time = 0;
+    static_assert(sizeof(float) == 4,
+                  "shader interface requires 32-bit floats");
 
-    minist.p_layt(std::make_shared<PipelineLayout>(logi_dev,
-                                                   minist.d_layts(),
-                                                   minist.push_consts()));
+    // everything below up to the pipeline needs the shader's interface, so
+    // this waits for it to finish building (any other shaders carry on in
+    // the background)
 
     if (auto search = shdrs.find("minicomp"); search != shdrs.end()) {
-        minist.minicomp_shdr(search->second);
+        minist.minicomp_shdr(search->second.module.get());
     } else {
         throw std::runtime_error("failed to find shader 'minicomp'");
     }
 
-    minist.pipel(new ComputePipeline {logi_dev,
-                                      minist.minicomp_shdr(),
-                                      minist.p_layt()});
+    // set up the descriptor set and pipeline layouts (scratch image +
+    // per-frame data) from what the shader declares; the per-frame data is
+    // bound with a dynamic offset, which the shader has no way to say
 
-    // create scrach image descriptor pool/set
+    minist.layt_refl = std::make_shared<const SpirvReflection>(
+        minicomp_reflection(*minist.minicomp_shdr()->reflection())
+    );
+    minist.p_layt(std::make_shared<PipelineLayout>(logi_dev,
+                                                   *minist.layt_refl,
+                                                   "minicomp"));
+    minist.d_layts(minist.p_layt()->set_layouts());
 
-    minist.descpool(new DescriptorPool {logi_dev, minist.d_layts()});
+    // write straight into the swapchain images if they can be used as
+    // storage images, rather than rendering elsewhere and copying; offscreen
+    // images always can be
 
-    // set up scratch image and view
+    minist.direct = headless() || swch->storage();
 
-    minist.scratch(new Image {logi_dev, {
-        .extent = {
-            .width  = surf.width(),
-            .height = surf.height(),
-            .depth  = 1,
-        },
-        .usage  = flgs(ImageUsageFlag::strge)
-                  | flgs(ImageUsageFlag::trnsfr_src),
-        .format = Format::r8g8b8a8_uint,
-    }});
+    log.enter("Vulkan", std::string("minicomp renders ")
+                        + (minist.direct ? "directly into the swapchain images"
+                                         : "into a scratch image and copies "
+                                           "it into the swapchain images"));
+    log.brk();
 
-    minist.scratch_v(new ImageView {minist.scratch()});
+    // compute pipeline; built in the background while the rest is set up
 
-    // update scratch image descriptor set
+    auto pipel = registry->compute(shdrs.at("minicomp"),
+                                   minicomp_pipeline_desc());
 
-    minist.descpool().write()
-            .storage_image("scratch image", 0, 0, &minist.scratch_v())
-            .submit();
+    // set up scratch image and view, if needed
 
-    // create compute queue command pool and buffer
+    minicomp_fit_scratch();
 
-    minist.cmd_pool(std::make_shared<CommandPool>(logi_dev,
-                                                      Device::compute_queue));
+    // create compute queue command pool; the command buffers themselves (and
+    // the descriptor sets) are allocated per swapchain image in
+    // minicomp_fit_to_swch() and kept around between frames, so they need to
+    // be individually resettable
 
-    minist.cmd_buff(new CommandBuffer {logi_dev, minist.cmd_pool()});
+    minist.cmd_pool(std::make_shared<CommandPool>(
+        logi_dev,
+        Device::compute_queue,
+        flgs(CommandPoolCreateFlag::reset_cmmnd_buffer)
+    ));
+
+    minicomp_fit_to_swch();
 
     // create fence
 
     minist.fnce(new Fence {logi_dev});
 
+    minist.pipel(pipel.get());
+
     // record start time
 
-    minist.start = std::chrono::steady_clock::now();
+    minist.clk.restart();
+
+    minist.ready = true;
 }
 
-void Vulkan::minicomp_recreate_swch()
+SpirvReflection Vulkan::minicomp_reflection(const SpirvReflection& shdr_refl)
+{
+    SpirvReflection refl = shdr_refl;
+    refl.make_dynamic(0, minicomp_frame_data_binding);
+
+    return refl;
+}
+
+PipelineCompiler::ComputeDesc Vulkan::minicomp_pipeline_desc()
+{
+    // the scratch image is RGBA, and is copied as-is into a swapchain image
+    // that's BGRA (see Swapchain::create())
+    return minicomp_pipeline_desc(minist.p_layt(), !minist.direct);
+}
+
+PipelineCompiler::ComputeDesc
+Vulkan::minicomp_pipeline_desc(PipelineLayout::ptr layt, bool swap_rb)
+{
+    auto spec = std::make_shared<SpecConstants<MinicompSpec>>();
+    spec->entry(0, &MinicompSpec::local_size_x)
+         .entry(1, &MinicompSpec::local_size_y)
+         .entry(2, &MinicompSpec::swap_rb);
+
+    spec->values()->swap_rb = swap_rb;
+
+    return {
+        .layout = layt,
+        .spec   = spec,
+    };
+}
+
+void Vulkan::minicomp_fit_scratch()
 {
     using namespace vk;
 
-    log.enter("Vulkan", std::string("WARNING WARNING WARNING this is probably "
-                                    "a sign of imminent disaster"));
-    log.brk();
+    if (minist.direct) {
+        return;
+    }
 
-    // recreate swapchain
+    // The scratch image is allocated with some room to spare and only
+    // replaced when the swapchain outgrows it or shrinks to well under it,
+    // so a window being resized doesn't mean a new image every time. The
+    // shader is told how much of it is in view through the frame data.
 
-    swch.recreate();
+    const VkExtent2D need = target_extent();
+    const VkExtent2D have = minist.scrtch_ext;
 
-    delete minist.ppl;
-    minist.pipel(new ComputePipeline {logi_dev,
-                                      minist.minicomp_shdr(),
-                                      minist.p_layt()});
+    const bool fits = minist.scrtch
+                      && need.width <= have.width
+                      && need.height <= have.height;
+    const bool wasteful = uint64_t {need.width} * need.height * 4
+                          < uint64_t {have.width} * have.height;
 
-    // recreate scratch image + view
+    if (fits && !wasteful) {
+        return;
+    }
+
+    // a quarter again on each side, rounded up to a multiple of 64, but no
+    // bigger than a swapchain image could ever be
+    const auto max_ext = surf->capabilities(phys_devs.default_device())
+                             .maxImageExtent;
+    auto pad = [](uint32_t len, uint32_t max) {
+        uint32_t padded = (len + len / 4 + 63) / 64 * 64;
+        return std::max(len, std::min(padded, max));
+    };
+
+    const VkExtent2D ext = {
+        pad(need.width,  max_ext.width),
+        pad(need.height, max_ext.height),
+    };
+
+    log.enter("Vulkan", "allocating minicomp scratch image ("
+                        + std::to_string(ext.width) + "x"
+                        + std::to_string(ext.height) + ")");
+    log.brk();
 
     delete minist.scrtch_v;
     delete minist.scrtch;
 
     minist.scratch(new Image {logi_dev, {
         .extent = {
-            .width  = swch.width(),
-            .height = swch.height(),
+            .width  = ext.width,
+            .height = ext.height,
             .depth  = 1,
         },
         .usage  = flgs(ImageUsageFlag::strge)
                   | flgs(ImageUsageFlag::trnsfr_src),
-        .format = Format::r8g8b8a8_uint,
+        .format = Format::r8g8b8a8_unorm,
     }});
     minist.scratch_v(new ImageView {minist.scratch()});
+    minist.scrtch_ext = ext;
+
+    minist.invalidate();
+}
+
+void Vulkan::minicomp_fit_to_swch()
+{
+    using namespace vk;
+
+    const uint32_t img_cnt = target_count();
+
+    while (minist.cmdbs.size() < img_cnt) {
+        minist.cmdbs.push_back(new CommandBuffer {logi_dev, minist.cmd_pool()});
+    }
+
+    minist.rec_keys.resize(minist.cmdbs.size(), 0);
+
+    if (!minist.prof || minist.prof->slots() < minist.cmdbs.size()) {
+        minist.prof = std::make_unique<GpuProfiler>(
+            logi_dev,
+            Device::compute_queue,
+            static_cast<uint32_t>(minist.cmdbs.size())
+        );
+    }
+
+    while (minist.descpls.size() < img_cnt) {
+        minist.descpls.push_back(new DescriptorPool {logi_dev,
+                                                     minist.d_layts()});
+    }
+
+    const VkDeviceSize frame_data_sz = img_cnt * minicomp_frame_data_stride;
+
+    if (!minist.frame_data_buff()
+        || minist.frame_data_buff()->size() < frame_data_sz) {
+        Buffer::params ps {
+            .size     = frame_data_sz,
+            .usage    = flgs(BufferUsageFlag::unfrm_buffer),
+            .location = Heap::Location::host,
+        };
+
+        minist.frame_data_buff(std::make_shared<Buffer>(logi_dev, ps));
+    }
+
+    // point each image's descriptor set at what it renders into; nothing
+    // recorded is in flight here, so they can all just be rewritten
+
+    for (uint32_t i = 0; i < img_cnt; ++i) {
+        ImageView* target = minist.direct ? &target_view(i)
+                                          : &minist.scratch_v();
+
+        minist.descpool(i).write()
+                .storage_image(minicomp_set,
+                               minicomp_scratch_binding,
+                               0,
+                               target)
+                .uniform_buffer(minicomp_set,
+                                minicomp_frame_data_binding,
+                                0,
+                                minist.frame_data_buff().get(),
+                                0,
+                                sizeof(MinicompFrameData),
+                                true)
+                .submit();
+    }
+
+    minist.invalidate();
+}
+
+void Vulkan::minicomp_recreate_swch()
+{
+    // the old swapchain is retired rather than destroyed, so this doesn't
+    // wait on the presentation engine; nothing about the pipeline depends on
+    // the swapchain, so it stays as it is
+
+    swch->recreate();
+    swch_stale = false;
+    tagged_presents.clear();
+    name_latency_metrics();
+
+    minicomp_fit_scratch();
+
+    // the swapchain image count may have changed, and everything recorded so
+    // far refers to stale handles
+
+    minist.cmd_pool()->reset();
+    minicomp_fit_to_swch();
+}
 
-    // update scratch image descriptor set
+void Vulkan::minicomp_record(uint32_t ndx)
+{
+    using namespace vk;
 
-    minist.descpool().write()
-                     .storage_image("scratch image",
-                                    0,
-                                    0,
-                                    &minist.scratch_v())
-                     .submit();
+    const auto frame_data_offs =
+        static_cast<uint32_t>(ndx * minicomp_frame_data_stride);
+
+    auto& cmdb = minist.cmd_buff(ndx);
+
+    // offscreen images are left ready to be copied out of (see
+    // read_back_frame()) rather than presented
+    const auto final_layt = headless() ? ImageLayout::trnsfr_src_optml
+                                       : ImageLayout::prsnt_src;
+
+    // each barrier has a zone of its own (pre: before the dispatch, post:
+    // after it, present: after the copy), so their times aren't lumped into
+    // one metric
+
+    cmdb.record(0)
+        .profile(minist.profiler(), ndx)
+        .begin_zone("minicomp")
+        .bind(minist.pipel(),
+              0,
+              {minist.descpool(ndx)[minicomp_set]},
+              {frame_data_offs});
+
+    if (minist.direct) {
+        // render straight into the swapchain (or offscreen) image
+
+        cmdb.begin_zone("minicomp.barrier.pre")
+            .barrier(target_img(ndx),
+                     PipelineStageFlag::top_of_pipe,
+                     PipelineStageFlag::cmpte_shader,
+                     AccessFlag::none,
+                     AccessFlag::shader_write,
+                     ImageLayout::undfnd,
+                     ImageLayout::gnrl,
+                     ImageAspectFlag::color)
+            .end_zone()
+            .begin_zone("minicomp.dispatch", true)
+            .dispatch_over(target_extent())
+            .end_zone()
+            .begin_zone("minicomp.barrier.post")
+            .barrier(target_img(ndx),
+                     PipelineStageFlag::cmpte_shader,
+                     PipelineStageFlag::bottom_of_pipe,
+                     AccessFlag::shader_write,
+                     AccessFlag::none,
+                     ImageLayout::gnrl,
+                     final_layt,
+                     ImageAspectFlag::color)
+            .end_zone()
+            .end_zone()
+            .end();
+    } else {
+        // render to scratch image + copy to swapchain image
+
+        cmdb.begin_zone("minicomp.barrier.pre")
+            .barrier(minist.scratch(),
+                     PipelineStageFlag::top_of_pipe,
+                     PipelineStageFlag::cmpte_shader,
+                     AccessFlag::none,
+                     AccessFlag::shader_write,
+                     ImageLayout::undfnd,
+                     ImageLayout::gnrl,
+                     ImageAspectFlag::color)
+            .end_zone()
+            .begin_zone("minicomp.dispatch", true)
+            .dispatch_over(target_extent())
+            .end_zone()
+            .begin_zone("minicomp.barrier.post")
+            .barrier(target_img(ndx),
+                     PipelineStageFlag::top_of_pipe,
+                     PipelineStageFlag::trnsfr,
+                     AccessFlag::none,
+                     AccessFlag::trnsfr_write,
+                     ImageLayout::undfnd,
+                     ImageLayout::trnsfr_dst_optml,
+                     ImageAspectFlag::color)
+            .barrier(minist.scratch(),
+                     PipelineStageFlag::cmpte_shader,
+                     PipelineStageFlag::trnsfr,
+                     AccessFlag::shader_write,
+                     AccessFlag::trnsfr_read,
+                     ImageLayout::gnrl,
+                     ImageLayout::trnsfr_src_optml,
+                     ImageAspectFlag::color)
+            .end_zone()
+            .begin_zone("minicomp.copy")
+            .copy(minist.scratch(), target_img(ndx))
+            .end_zone()
+            .begin_zone("minicomp.barrier.present")
+            .barrier(target_img(ndx),
+                     PipelineStageFlag::trnsfr,
+                     PipelineStageFlag::bottom_of_pipe,
+                     AccessFlag::trnsfr_write,
+                     AccessFlag::none,
+                     ImageLayout::trnsfr_dst_optml,
+                     ImageLayout::prsnt_src,
+                     ImageAspectFlag::color)
+            .end_zone()
+            .end_zone()
+            .end();
+    }
+
+    minist.rec_keys.at(ndx) = minist.key;
 }
 
-void Vulkan::minicomp_frame()
+void Vulkan::name_latency_metrics()
+{
+    const auto prefix = "latency."
+                        + PresentConfig::mode_name(swch->present_mode());
+
+    input_to_present_metric = prefix + ".input_to_present_ms";
+    input_to_display_metric = prefix + ".input_to_display_ms";
+}
+
+void Vulkan::collect_presented()
+{
+    auto now = std::chrono::steady_clock::now();
+
+    // presents reach the screen in order, so the first one that hasn't yet
+    // means none of the rest have either
+
+    while (!tagged_presents.empty()
+           && logi_dev->presented(*swch, tagged_presents.front().id)) {
+        metrics.record(input_to_display_metric,
+                       now - tagged_presents.front().input);
+        tagged_presents.pop_front();
+    }
+}
+
+void Vulkan::minicomp_clock(FrameClock clk)
+{
+    minist.clk = std::move(clk);
+    minist.clk.restart();
+}
+
+void Vulkan::minicomp_frame(
+    std::optional<std::chrono::steady_clock::time_point> input
+)
 {
     using namespace vk;
 
-    // get next swapchain image
+    CU_ZONE("Vulkan::minicomp_frame");
+
+    // the GPU is idle here (each frame is waited on before it's presented),
+    // so it's safe to drop the old pipeline if a new one is ready
+
+    apply_reloads();
+
+    collect_presented();
+
+    // frames read back earlier that have made it to the host
 
-    auto res = swch.next(minist.fnce());
-    if (res == SwapchainResult::needs_recreate) {
+    if (rdbk) {
+        rdbk->poll();
+    }
+
+    // GPU timings from earlier frames; whatever isn't in yet is left for
+    // next time
+
+    minist.profiler().collect();
+
+    // a swapchain that still works but no longer fits is only replaced once
+    // the window has stopped changing size for a moment
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (swch_stale && now - last_resize >= resize_settle) {
         minicomp_recreate_swch();
-        return;
-    } else if (res == SwapchainResult::not_ready) {
-        return;
     }
 
-    // render to scratch image + copy to swapchain image
+    // each phase of the frame is timed from the end of the one before, and
+    // goes into the trace as a zone of its own
+
+    auto mark = std::chrono::steady_clock::now();
+    auto lap = [&mark](FrameStats::Phase p) {
+        auto t = std::chrono::steady_clock::now();
+        frame_stats.record(p, t - mark);
+        trace.complete(FrameStats::phase_name(p), mark, t);
+        mark = t;
+    };
+
+    // get next swapchain image; an out-of-date swapchain can't be used at
+    // all, so there's nothing to do then but recreate it straight away.
+    // Offscreen images are never in use by anything else by now, so there's
+    // nothing to wait for.
+
+    uint32_t ndx;
+
+    if (headless()) {
+        ndx = offscr->next();
+        lap(FrameStats::Phase::acquire);
+    } else {
+        auto res = swch->next(minist.fnce());
+        lap(FrameStats::Phase::acquire);
+
+        if (res == SwapchainResult::needs_recreate) {
+            minicomp_recreate_swch();
+            return;
+        } else if (res == SwapchainResult::not_ready) {
+            return;
+        }
+
+        if (swch->suboptimal()) {
+            swch_stale = true;
+        }
+
+        ndx = *swch->ndx();
+    }
+
+    // update this image's slot in the frame data; the previous submission
+    // that read it has already completed, since each frame is waited on
 
     using fp_secs = std::chrono::duration<float,
                                           std::chrono::seconds::period>;
-    auto now = std::chrono::steady_clock::now();
 
-    static_cast<PushConstants<MinicompPCs>*>(minist.push_consts()[0])
-         ->values()->time = fp_secs(now - minist.start).count();
+    auto& fd = minist.frame_data(ndx);
+    fd.time = fp_secs(minist.clk.next(now)).count();
+    fd.extent[0] = target_extent().width;
+    fd.extent[1] = target_extent().height;
 
-    minist.cmd_pool()->reset();
+    if (minist.rec_keys.at(ndx) != minist.key) {
+        minicomp_record(ndx);
+    }
+    lap(FrameStats::Phase::record);
 
-    minist.cmd_buff().record()
-                     .bind(minist.pipel(), {minist.descpool()["scratch image"]})
-                     .barrier(minist.scratch(),
-                              PipelineStageFlag::top_of_pipe,
-                              PipelineStageFlag::cmpte_shader,
-                              AccessFlag::none,
-                              AccessFlag::shader_write,
-                              ImageLayout::undfnd,
-                              ImageLayout::gnrl,
-                              ImageAspectFlag::color)
-                     .push_constants(minist.pipel(), *minist.push_consts()[0])
-                     .dispatch(swch.width(),
-                               swch.height())
-                     .barrier(swch.img(),
-                              PipelineStageFlag::top_of_pipe,
-                              PipelineStageFlag::trnsfr,
-                              AccessFlag::none,
-                              AccessFlag::trnsfr_write,
-                              ImageLayout::undfnd,
-                              ImageLayout::trnsfr_dst_optml,
-                              ImageAspectFlag::color)
-                     .barrier(minist.scratch(),
-                              PipelineStageFlag::cmpte_shader,
-                              PipelineStageFlag::trnsfr,
-                              AccessFlag::shader_write,
-                              AccessFlag::trnsfr_read,
-                              ImageLayout::gnrl,
-                              ImageLayout::trnsfr_src_optml,
-                              ImageAspectFlag::color)
-                     .copy(minist.scratch(), swch.img())
-                     .barrier(swch.img(),
-                              PipelineStageFlag::trnsfr,
-                              PipelineStageFlag::bottom_of_pipe,
-                              AccessFlag::trnsfr_write,
-                              AccessFlag::none,
-                              ImageLayout::trnsfr_dst_optml,
-                              ImageLayout::prsnt_src,
-                              ImageAspectFlag::color)
-                     .end();
-
-    logi_dev->submit(Device::compute_queue, minist.cmd_buff(), minist.fnce());
-
-    while (!logi_dev->present(swch)) {
-        minicomp_recreate_swch();
+    logi_dev->submit_async(Device::compute_queue,
+                           minist.cmd_buff(ndx),
+                           minist.fnce());
+    minist.profiler().submitted(ndx);
+    lap(FrameStats::Phase::submit);
+
+    minist.fnce().wait();
+    lap(FrameStats::Phase::gpu_wait);
+
+    if (headless()) {
+        last_rendered = ndx;
+
+        if (next_read_back) {
+            rdbk->request_view(offscr->img(ndx), std::move(next_read_back));
+            next_read_back = nullptr;
+        }
+
+        return;
+    }
+
+    // The presentation engine can't be given the image while the copy is
+    // still reading it, and presents here wait on nothing but the host, so
+    // the copy is waited for. Handing it over only passes on a view, so
+    // there's nothing else to it on this thread.
+
+    if (next_read_back) {
+        rdbk->request_view(swch->img(ndx),
+                           std::move(next_read_back),
+                           ImageLayout::prsnt_src);
+        next_read_back = nullptr;
+        rdbk->flush();
+    }
+
+    // the image has been presented either way; if the swapchain is out of
+    // date, the next acquire will say so
+
+    uint64_t present_id = 0;
+    if (input && logi_dev->present_wait()) {
+        present_id = ++last_present_id;
+    }
+
+    if (!logi_dev->present(swch, present_id)) {
+        swch_stale = true;
+    }
+    lap(FrameStats::Phase::present);
+
+    if (input) {
+        metrics.record(input_to_present_metric,
+                       std::chrono::steady_clock::now() - *input);
+
+        if (present_id != 0) {
+            tagged_presents.push_back({
+                .id    = present_id,
+                .input = *input,
+            });
+        }
+    }
+
+    swch->collect_retired();
+
+    // pick up anything compiled since the last save (e.g. on resize) without
+    // waiting for shutdown, in case we never get there cleanly
+
+    logi_dev->save_pipeline_cache();
+}
+
+Readback& Vulkan::readback()
+{
+    // one slot for the copy in flight, one for the frame being handed over
+    // and one for a view that hasn't been let go yet (e.g. by Capture)
+
+    if (!rdbk) {
+        rdbk = std::make_unique<Readback>(logi_dev, 3);
+    }
+
+    return *rdbk;
+}
+
+Image& Vulkan::last_frame()
+{
+    if (!headless()) {
+        throw std::runtime_error("the last frame can only be read back when "
+                                 "running headless");
+    }
+
+    if (!last_rendered) {
+        throw std::runtime_error("no frame has been rendered to read back");
+    }
+
+    return offscr->img(*last_rendered);
+}
+
+Pixels Vulkan::read_back_frame()
+{
+    auto& img = last_frame();
+    auto& rb = readback();
+
+    // anything already in flight is handed over first, so there's sure to be
+    // a slot free
+
+    rb.flush();
+
+    Pixels px {};
+    bool started = rb.request(img, [&px](Pixels p) {
+        px = std::move(p);
+    });
+    if (!started) {
+        throw std::runtime_error("every readback slot is still being looked "
+                                 "at");
+    }
+    rb.flush();
+
+    return px;
+}
+
+bool Vulkan::read_back_frame_async(Readback::view_callback_t done)
+{
+    auto& img = last_frame();
+    return readback().request_view(img, std::move(done));
+}
+
+bool Vulkan::read_back_next_frame(Readback::view_callback_t done)
+{
+    if (!headless() && !swch->readable()) {
+        throw std::runtime_error("the swapchain images can't be copied out "
+                                 "of, so frames can't be read back");
+    }
+
+    // nothing else takes a slot before the frame is rendered, so one free
+    // now will still be free then
+
+    if (next_read_back || !readback().ready()) {
+        metrics.count("readback.dropped");
+        return false;
     }
+
+    next_read_back = std::move(done);
+    return true;
 }
 
-void Vulkan::add_shader(std::string name, BinData f)
+bool Vulkan::read_back_bgra() const
+{
+    if (headless()) {
+        return false;
+    }
+
+    return swch->format() == VK_FORMAT_B8G8R8A8_UNORM
+           || swch->format() == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+void Vulkan::flush_read_backs()
+{
+    if (rdbk) {
+        rdbk->flush();
+    }
+}
+
+Batch::Result Vulkan::minicomp_batch(VkExtent2D extent,
+                                     uint64_t count,
+                                     uint32_t slots,
+                                     FrameClock clk,
+                                     const Batch::source_t& src,
+                                     const Batch::callback_t& done)
+{
+    auto search = shdrs.find("minicomp");
+    if (search == shdrs.end()) {
+        throw std::runtime_error("failed to find shader 'minicomp'");
+    }
+
+    // the same layout as when rendering frames, plus the input image if the
+    // shader reads one; the outputs are RGBA images read straight back
+
+    auto refl = minicomp_reflection(*search->second.module.get()->reflection());
+
+    std::optional<uint32_t> input;
+    for (const auto& b : refl.bindings(0)) {
+        if (b.binding == minicomp_input_binding
+            && b.type == vk::DescriptorType::strge_img) {
+            input = b.binding;
+        }
+    }
+
+    if (src && !input) {
+        throw std::runtime_error("the minicomp shader doesn't read an input "
+                                 "image (a storage image at binding "
+                                 + std::to_string(minicomp_input_binding)
+                                 + " of set 0)");
+    }
+
+    auto layt = std::make_shared<PipelineLayout>(logi_dev, refl, "minicomp");
+    auto pipel = registry->compute(search->second,
+                                   minicomp_pipeline_desc(layt, false));
+
+    Batch batch {logi_dev,
+                 pipel.get(),
+                 layt->set_layouts(),
+                 {
+                     .set        = minicomp_set,
+                     .output     = minicomp_scratch_binding,
+                     .frame_data = minicomp_frame_data_binding,
+                     .input      = input,
+                 },
+                 extent,
+                 slots};
+
+    return batch.run(count, std::move(clk), src, done);
+}
+
+void Vulkan::window_resized()
+{
+    swch_stale = true;
+    last_resize = std::chrono::steady_clock::now();
+}
+
+void Vulkan::add_shader(std::string name,
+                        BinData f,
+                        std::filesystem::path source)
 {
     log.enter("Vulkan",  "adding shader " + name);
     log.brk();
 
-    bool ok = shdrs.insert({name, std::make_shared<ShaderModule>(logi_dev,
-                                                                 name,
-                                                                 f)})
-                   .second;
+    // identical bytecode is shared, whatever it's called; adding the same
+    // shader under the same name again is harmless, but a name can't be
+    // pointed at different bytecode this way
+
+    auto shdr = registry->shader(name, std::move(f));
+
+    if (auto search = shdrs.find(name);
+        search != shdrs.end() && !search->second.same_code(shdr)) {
+        throw std::runtime_error("failed to add shader " + name + ": there "
+                                 "is already a different shader by that "
+                                 "name");
+    }
+
+    shdrs.insert({name, shdr});
 
-    if (!ok) {
-        throw std::runtime_error("failed to add shader " + name);
+    if (source.empty() || !ShaderWatcher::supported) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk {reload_mtx};
+        shdr_srcs[name] = source;
+    }
+
+    if (!watcher) {
+        watcher = std::make_unique<ShaderWatcher>(
+            [this](const std::filesystem::path& p) { reload_shaders(p); }
+        );
+    }
+
+    watcher->watch(source);
+}
+
+void Vulkan::reload_shaders(const std::filesystem::path& src)
+{
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lk {reload_mtx};
+        for (const auto& [name, path] : shdr_srcs) {
+            if (path == src) {
+                names.push_back(name);
+            }
+        }
+    }
+
+    for (const auto& name : names) {
+        log.enter("Vulkan", "rebuilding shader " + name + " from "
+                            + src.string());
+        log.brk();
+
+        auto bin = BinData::read_file(src);
+
+        // the descriptor sets and everything bound to them stay as they are,
+        // so a shader whose interface has changed can't be swapped in; this
+        // only needs the bytecode, so it's checked before anything is queued
+
+        const bool is_minicomp = name == "minicomp" && minist.ready;
+
+        if (is_minicomp) {
+            auto new_refl = minicomp_reflection(*SpirvReflection::reflect(bin));
+            if (!new_refl.layout_compatible(*minist.layt_refl)) {
+                throw std::runtime_error("the interface of shader " + name
+                                         + " has changed; restart to pick "
+                                         "it up");
+            }
+        }
+
+        shader_reload r {
+            .name = name,
+            .shdr = registry->shader(name, std::move(bin)),
+        };
+
+        if (is_minicomp) {
+            r.pipel = registry->compute(r.shdr, minicomp_pipeline_desc());
+        }
+
+        std::lock_guard<std::mutex> lk {reload_mtx};
+        std::erase_if(pending_reloads,
+                      [&name](const auto& p) { return p.name == name; });
+        pending_reloads.push_back(std::move(r));
+    }
+}
+
+void Vulkan::apply_reloads()
+{
+    // only take the ones that have finished building; never wait here
+
+    std::vector<shader_reload> ready;
+    {
+        std::lock_guard<std::mutex> lk {reload_mtx};
+
+        auto done = [](const shader_reload& r) {
+            return PipelineCompiler::ready(r.shdr.module)
+                   && (!r.pipel.valid() || PipelineCompiler::ready(r.pipel));
+        };
+
+        auto first_done = std::stable_partition(
+            pending_reloads.begin(),
+            pending_reloads.end(),
+            [&done](const auto& r) { return !done(r); }
+        );
+        std::move(first_done, pending_reloads.end(), std::back_inserter(ready));
+        pending_reloads.erase(first_done, pending_reloads.end());
+    }
+
+    for (auto& r : ready) {
+        try {
+            auto shdr = r.shdr.module.get();
+
+            if (r.pipel.valid()) {
+                minist.pipel(r.pipel.get());
+                minist.minicomp_shdr(shdr);
+                minist.invalidate();
+            }
+
+            shdrs[r.name] = r.shdr;
+        } catch (const std::exception& e) {
+            log.enter("Vulkan", "failed to rebuild " + r.name + ": "
+                                + e.what());
+            log.brk();
+            continue;
+        }
+
+        log.enter("Vulkan", "swapped in new " + r.name + " shader");
+        log.brk();
     }
 }
 
 Vulkan::minicomp_state::~minicomp_state() noexcept
 {
     delete f;
-    delete cmdb;
+    for (auto b : cmdbs) {
+        delete b;
+    }
+    frm_dat.reset();
     delete scrtch_v;
     delete scrtch;
-    delete descpl;
-    delete ppl;
-    delete pcs[0];
+    for (auto p : descpls) {
+        delete p;
+    }
 }
 
 } // namespace cu
@@ -0,0 +1,78 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include "vulkan_loader.hpp"
+
+#include "log.hpp"
+
+#include <dlfcn.h>
+
+#include <array>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+namespace cu {
+
+PFN_vkGetInstanceProcAddr VulkanLoader::get_inst_proc_addr()
+{
+    static std::once_flag loaded;
+    static PFN_vkGetInstanceProcAddr gipa = nullptr;
+
+    std::call_once(loaded, [] {
+        // the unversioned name is usually only there with the development
+        // files installed, so it's the fallback
+        const std::array<const char*, 2> names = {
+            "libvulkan.so.1",
+            "libvulkan.so",
+        };
+
+        void* lib = nullptr;
+        for (auto n : names) {
+            log.attempt("Vulkan", std::string {"loading "} + n);
+            lib = dlopen(n, RTLD_NOW | RTLD_LOCAL);
+            log.finish();
+            log.brk();
+
+            if (lib) {
+                break;
+            }
+        }
+
+        if (!lib) {
+            throw std::runtime_error("failed to load the Vulkan loader: "
+                                     + std::string {dlerror()});
+        }
+
+        gipa = reinterpret_cast<PFN_vkGetInstanceProcAddr>(
+            dlsym(lib, "vkGetInstanceProcAddr")
+        );
+
+        if (!gipa) {
+            throw std::runtime_error("the Vulkan loader has no "
+                                     "vkGetInstanceProcAddr");
+        }
+    });
+
+    return gipa;
+}
+
+} // namespace cu
@@ -0,0 +1,112 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <bench_report.hpp>
+
+#include <chrono>
+#include <memory>
+#include <sstream>
+
+TEST_CASE("BenchReport") {
+    using namespace std::chrono_literals;
+
+    cu::BenchReport rep;
+    cu::Metrics m;
+    auto fs = std::make_unique<cu::FrameStats>();
+
+    SUBCASE("picks the format by extension") {
+        using F = cu::BenchReport::Format;
+
+        CHECK(cu::BenchReport::format_for("out.json") == F::json);
+        CHECK(cu::BenchReport::format_for("a/b.csv") == F::csv);
+        CHECK_FALSE(cu::BenchReport::format_for("out.txt"));
+        CHECK_FALSE(cu::BenchReport::format_for("json"));
+    }
+
+    SUBCASE("works out exact frame time percentiles") {
+        for (int i = 100; i >= 1; --i) {
+            rep.frame(std::chrono::milliseconds {i});
+        }
+        rep.finish(*fs, m);
+
+        CHECK(rep.get("frame_time_ms", "frame", "count") == 100.0);
+        CHECK(rep.get("frame_time_ms", "frame", "mean") == 50.5);
+        CHECK(rep.get("frame_time_ms", "frame", "p50") == 50.0);
+        CHECK(rep.get("frame_time_ms", "frame", "p99") == 99.0);
+        CHECK(rep.get("frame_time_ms", "frame", "max") == 100.0);
+        CHECK(rep.get("frame_time_ms", "frame", "fps")
+              == doctest::Approx(1000.0 / 50.5));
+    }
+
+    SUBCASE("splits allocations at the end of warmup") {
+        m.count("heap.main_pool.allocs", 3);
+        m.record("heap.main_pool.in_use_mib", 12.0);
+        rep.warmed_up(m);
+
+        m.clear();
+        m.count("heap.main_pool.allocs");
+        m.record("heap.main_pool.in_use_mib", 4.0);
+        rep.finish(*fs, m);
+
+        CHECK(rep.get("allocations", "heap.main_pool.allocs", "setup") == 3.0);
+        CHECK(rep.get("allocations", "heap.main_pool.allocs", "measured")
+              == 1.0);
+        CHECK(rep.get("memory", "heap.main_pool", "peak_mib") == 12.0);
+        CHECK(rep.get("memory", "process", "peak_rss_mib") > 0.0);
+    }
+
+    SUBCASE("gathers phases and GPU zones") {
+        fs->record(cu::FrameStats::Phase::submit, 2ms);
+        fs->record(cu::FrameStats::Phase::gpu, 5ms);
+        m.record("gpu.minicomp_ms", 4.0);
+        m.record("gpu.minicomp.invocations", 1024.0);
+        rep.finish(*fs, m);
+
+        CHECK(rep.get("cpu_phase_ms", "submit", "max") == 2.0);
+        CHECK(rep.get("gpu_ms", "frame", "max") == 5.0);
+        CHECK(rep.get("gpu_ms", "minicomp", "mean") == 4.0);
+        CHECK(rep.get("gpu", "minicomp.invocations", "max") == 1024.0);
+        CHECK_FALSE(rep.get("cpu_phase_ms", "poll", "max"));
+    }
+
+    SUBCASE("writes JSON and CSV") {
+        rep.info("shader", "a \"b\", c");
+        rep.frame(10ms);
+        rep.finish(*fs, m);
+
+        std::ostringstream json;
+        rep.write(json, cu::BenchReport::Format::json);
+        CHECK(json.str().find("\"shader\": \"a \\\"b\\\", c\"")
+              != std::string::npos);
+        CHECK(json.str().find("\"frame_time_ms\": {\n        \"frame\": "
+                              "{\"count\": 1, ")
+              != std::string::npos);
+
+        std::ostringstream csv;
+        rep.write(csv, cu::BenchReport::Format::csv);
+        CHECK(csv.str().starts_with("section,name,stat,value\n"
+                                    "info,shader,,\"a \"\"b\"\", c\"\n"));
+        CHECK(csv.str().find("\nframe_time_ms,frame,p50,10\n")
+              != std::string::npos);
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <capture.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+TEST_CASE("capture") {
+    const auto dir = std::filesystem::temp_directory_path()
+                     / "cu_capture_test";
+    std::filesystem::remove_all(dir);
+
+    // 5x3, so the chroma planes are rounded up: 3x2 each
+    const cu::Pixels px {5, 3, std::vector<uint8_t>(5 * 3 * 4, 200)};
+
+    SUBCASE("picks the format from the extension") {
+        CHECK(cu::CaptureConfig::format_for("a.y4m") == cu::CaptureConfig::y4m);
+        CHECK(cu::CaptureConfig::format_for("a.rgb") == cu::CaptureConfig::raw);
+        CHECK(cu::CaptureConfig::format_for("frames")
+              == cu::CaptureConfig::ppm);
+        CHECK_FALSE(cu::CaptureConfig::format_from_str("mp4"));
+    }
+
+    SUBCASE("y4m is one header and a tagged frame each") {
+        std::filesystem::create_directories(dir);
+        const auto path = dir / "out.y4m";
+
+        {
+            cu::Capture capt {{.out = path, .fmt = cu::CaptureConfig::y4m,
+                               .every = 2, .threads = 2, .fps = 30}};
+            CHECK(capt.wanted(0));
+            CHECK_FALSE(capt.wanted(1));
+
+            for (uint64_t i = 0; i < 3; ++i) {
+                CHECK(capt.submit(i * 2, px));
+            }
+            capt.finish();
+
+            CHECK(capt.written() == 3);
+            CHECK(capt.dropped() == 0);
+        }
+
+        std::ifstream in {path, std::ios::binary};
+        std::string data {std::istreambuf_iterator<char> {in}, {}};
+
+        const std::string hdr = "YUV4MPEG2 W5 H3 F30:1 Ip A1:1 C420jpeg\n";
+        CHECK(data.substr(0, hdr.size()) == hdr);
+        CHECK(data.size() == hdr.size() + 3 * (6 + 15 + 2 * 6));
+        CHECK(data.substr(hdr.size(), 6) == "FRAME\n");
+    }
+
+    SUBCASE("ppm writes a file a frame, named by number") {
+        {
+            cu::Capture capt {{.out = dir, .fmt = cu::CaptureConfig::ppm}};
+            CHECK(capt.submit(0, px));
+            CHECK(capt.submit(7, px));
+        }
+
+        CHECK(std::filesystem::file_size(dir / "000000.ppm")
+              == std::string {"P6\n5 3\n255\n"}.size() + 5 * 3 * 3);
+        CHECK(std::filesystem::exists(dir / "000007.ppm"));
+    }
+
+    SUBCASE("drops rather than waits when full") {
+        std::filesystem::create_directories(dir);
+
+        cu::Capture capt {{.out = dir / "out.rgb",
+                           .fmt = cu::CaptureConfig::raw,
+                           .max_queued = 1}};
+
+        uint64_t taken = 0;
+        for (uint64_t i = 0; i < 64; ++i) {
+            taken += capt.submit(i, px);
+        }
+        capt.missed();
+        capt.finish();
+
+        CHECK(capt.written() == taken);
+        CHECK(capt.dropped() == 64 - taken + 1);
+        CHECK(std::filesystem::file_size(dir / "out.rgb") == taken * 5 * 3 * 3);
+    }
+
+    SUBCASE("waits for room when asked to") {
+        std::filesystem::create_directories(dir);
+
+        cu::Capture capt {{.out = dir / "out.rgb",
+                           .fmt = cu::CaptureConfig::raw,
+                           .max_queued = 1,
+                           .block = true}};
+
+        for (uint64_t i = 0; i < 16; ++i) {
+            CHECK(capt.submit(i, px));
+        }
+        capt.finish();
+
+        CHECK(capt.written() == 16);
+        CHECK(capt.dropped() == 0);
+    }
+
+    SUBCASE("lets views go once they've been converted") {
+        std::filesystem::create_directories(dir);
+
+        auto v = cu::PixelView::of(px);
+        std::weak_ptr<const void> held = v.keep;
+
+        cu::Capture capt {{.out = dir / "out.rgb",
+                           .fmt = cu::CaptureConfig::raw}};
+        CHECK(capt.submit(0, std::move(v)));
+        capt.finish();
+
+        CHECK(held.expired());
+        CHECK(std::filesystem::file_size(dir / "out.rgb") == 5 * 3 * 3);
+    }
+
+    std::filesystem::remove_all(dir);
+}
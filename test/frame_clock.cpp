@@ -0,0 +1,110 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <frame_clock.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+TEST_CASE("FrameClock") {
+    using namespace std::chrono_literals;
+    using secs = cu::FrameClock::seconds;
+
+    SUBCASE("real clocks go by the time since restart") {
+        cu::FrameClock c;
+        auto t0 = cu::FrameClock::clock::now();
+        c.restart(t0);
+
+        CHECK(c.next(t0 + 250ms) == secs {0.25});
+        CHECK(c.next(t0 + 1s) == secs {1.0});
+        CHECK(c.frames() == 2);
+    }
+
+    SUBCASE("fixed clocks step once a frame, whatever the time") {
+        auto c = cu::FrameClock::fixed(secs {0.5});
+        auto t0 = cu::FrameClock::clock::now();
+
+        CHECK(c.next(t0) == secs {0.0});
+        CHECK(c.next(t0 + 1h) == secs {0.5});
+        CHECK(c.next(t0) == secs {1.0});
+
+        c.restart();
+        CHECK(c.next() == secs {0.0});
+    }
+
+    SUBCASE("scripted clocks carry on at the pace they end at") {
+        auto c = cu::FrameClock::scripted({secs {1}, secs {3}, secs {4}});
+
+        CHECK(c.next() == secs {1});
+        CHECK(c.next() == secs {3});
+        CHECK(c.next() == secs {4});
+        CHECK(c.next() == secs {5});
+        CHECK(c.next() == secs {6});
+
+        auto one = cu::FrameClock::scripted({secs {2}});
+        one.next();
+        CHECK(one.next() == secs {2});
+
+        CHECK_THROWS_AS(cu::FrameClock::scripted({}), std::runtime_error);
+    }
+
+    SUBCASE("reads scripts") {
+        auto path = std::filesystem::temp_directory_path()
+                    / "cu_frame_clock_test.txt";
+        {
+            std::ofstream f {path};
+            f << "# a comment\n0\n\n  0.25  # another\n1e-1\n";
+        }
+
+        auto c = cu::FrameClock::read_script(path);
+        CHECK(c.mode() == cu::FrameClock::Mode::scripted);
+        CHECK(c.next() == secs {0});
+        CHECK(c.next() == secs {0.25});
+        CHECK(c.next() == secs {0.1});
+
+        {
+            std::ofstream f {path};
+            f << "0\n1 2\n";
+        }
+        CHECK_THROWS_AS(cu::FrameClock::read_script(path), std::runtime_error);
+
+        std::filesystem::remove(path);
+    }
+
+    SUBCASE("parses the command line") {
+        using M = cu::FrameClock::Mode;
+
+        CHECK(cu::FrameClock::from_str("real")->mode() == M::real);
+        CHECK(cu::FrameClock::from_str("fixed")->mode() == M::fixed);
+        CHECK(cu::FrameClock::from_str("fixed:0.02")->str()
+              == "fixed 20.000 ms");
+        CHECK_FALSE(cu::FrameClock::from_str("fixed:"));
+        CHECK_FALSE(cu::FrameClock::from_str("fixed:-1"));
+        CHECK_FALSE(cu::FrameClock::from_str("fixed:1x"));
+        CHECK_FALSE(cu::FrameClock::from_str("wall"));
+        CHECK_THROWS_AS(cu::FrameClock::from_str("script:/nonexistent"),
+                        std::runtime_error);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <frame_convert.hpp>
+
+#include <vector>
+
+TEST_CASE("convert") {
+    SUBCASE("to_rgb drops alpha, in either order") {
+        // long enough to go through the vector path and the tail after it
+        const std::size_t n = 37;
+        std::vector<uint8_t> rgba(n * 4);
+        for (std::size_t i = 0; i < rgba.size(); ++i) {
+            rgba[i] = static_cast<uint8_t>(i);
+        }
+
+        std::vector<uint8_t> rgb(n * 3);
+        cu::convert::to_rgb(rgba.data(), rgb.data(), n, false);
+
+        bool same = true;
+        for (std::size_t i = 0; i < n; ++i) {
+            same = same && rgb[i * 3] == rgba[i * 4]
+                        && rgb[i * 3 + 1] == rgba[i * 4 + 1]
+                        && rgb[i * 3 + 2] == rgba[i * 4 + 2];
+        }
+        CHECK(same);
+
+        cu::convert::to_rgb(rgba.data(), rgb.data(), n, true);
+
+        bool swapped = true;
+        for (std::size_t i = 0; i < n; ++i) {
+            swapped = swapped && rgb[i * 3] == rgba[i * 4 + 2]
+                              && rgb[i * 3 + 1] == rgba[i * 4 + 1]
+                              && rgb[i * 3 + 2] == rgba[i * 4];
+        }
+        CHECK(swapped);
+    }
+
+    SUBCASE("to_rgb gives the same bytes with SIMD as without") {
+        if (!cu::convert::simd()) {
+            MESSAGE("no SIMD path on this CPU; nothing to compare");
+        }
+
+        // every length up to a few vectors' worth, so each way the vector
+        // loop and the tail can split the work is covered
+        uint32_t seed = 1;
+        std::vector<uint8_t> rgba(64 * 4);
+        for (auto& c : rgba) {
+            seed = seed * 1664525 + 1013904223;
+            c = static_cast<uint8_t>(seed >> 24);
+        }
+
+        bool same = true;
+        for (std::size_t n = 0; n <= 64; ++n) {
+            for (bool bgra : {false, true}) {
+                std::vector<uint8_t> fast(n * 3 + 1, 0xa5);
+                std::vector<uint8_t> slow(n * 3 + 1, 0xa5);
+                cu::convert::to_rgb(rgba.data(), fast.data(), n, bgra);
+                cu::convert::to_rgb_scalar(rgba.data(), slow.data(), n, bgra);
+                same = same && fast == slow;
+            }
+        }
+        CHECK(same);
+    }
+
+    SUBCASE("to_yuv420 uses BT.601 limited range") {
+        // a 3x3 image: white but for a red top-left pixel and a black
+        // bottom-right one
+        std::vector<uint8_t> rgba(3 * 3 * 4, 255);
+        rgba[1] = rgba[2] = 0;
+        rgba[8 * 4] = rgba[8 * 4 + 1] = rgba[8 * 4 + 2] = 0;
+
+        CHECK(cu::convert::yuv420_size(3, 3) == 9 + 2 * 4);
+
+        std::vector<uint8_t> yuv(cu::convert::yuv420_size(3, 3));
+        cu::convert::to_yuv420(rgba.data(), 3, 3, yuv.data(), false);
+
+        CHECK(yuv[0] == 82);
+        CHECK(yuv[1] == 235);
+        CHECK(yuv[8] == 16);
+
+        // U then V; the bottom-right sample covers only the black pixel
+        CHECK(yuv[9 + 1] == 128);
+        CHECK(yuv[9 + 3] == 128);
+        CHECK(yuv[13 + 3] == 128);
+        CHECK(yuv[9] < 128);
+        CHECK(yuv[13] > 128);
+
+        std::vector<uint8_t> bgr(yuv.size());
+        std::swap(rgba[0], rgba[2]);
+        cu::convert::to_yuv420(rgba.data(), 3, 3, bgr.data(), true);
+        CHECK(bgr == yuv);
+    }
+}
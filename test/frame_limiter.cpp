@@ -0,0 +1,64 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <frame_limiter.hpp>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+TEST_CASE("FrameLimiter") {
+    using namespace std::chrono_literals;
+    using clock = cu::FrameLimiter::clock;
+
+    SUBCASE("rejects a nonpositive cap") {
+        CHECK_THROWS_AS(cu::FrameLimiter {0}, std::runtime_error);
+        CHECK_THROWS_AS(cu::FrameLimiter {-60}, std::runtime_error);
+    }
+
+    SUBCASE("spaces frames out by the period") {
+        cu::FrameLimiter lim {200};
+        CHECK(lim.period() == std::chrono::duration_cast<clock::duration>(5ms));
+
+        lim.wait();
+        auto start = clock::now();
+        for (int i = 0; i < 10; ++i) {
+            lim.wait();
+        }
+        auto took = clock::now() - start;
+
+        // never early; the upper bound is loose, for busy machines
+        CHECK(took >= 50ms - 5ms);
+        CHECK(took < 200ms);
+    }
+
+    SUBCASE("doesn't try to catch up after a long frame") {
+        cu::FrameLimiter lim {200};
+        lim.wait();
+        std::this_thread::sleep_for(30ms);
+
+        auto start = clock::now();
+        lim.wait();
+        CHECK(clock::now() - start < 1ms);
+    }
+}
@@ -0,0 +1,90 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <frame_stats.hpp>
+
+#include <chrono>
+
+TEST_CASE("FrameStats") {
+    using namespace std::chrono_literals;
+    using cu::FrameStats;
+
+    FrameStats fs;
+
+    SUBCASE("buckets are contiguous and narrow") {
+        for (uint32_t b = 0; b + 1 < FrameStats::bucket_count; ++b) {
+            auto lo = FrameStats::bucket_floor(b);
+            auto hi = FrameStats::bucket_floor(b + 1);
+            CHECK(FrameStats::bucket(lo) == b);
+            CHECK(FrameStats::bucket(hi - 1) == b);
+            CHECK(hi - lo <= lo / 16 + 1);
+        }
+
+        CHECK(FrameStats::bucket(UINT64_MAX) == FrameStats::bucket_count - 1);
+    }
+
+    SUBCASE("percentiles") {
+        for (int i = 1; i <= 100; ++i) {
+            fs.record(FrameStats::Phase::frame, std::chrono::milliseconds {i});
+        }
+
+        auto s = fs.summary(FrameStats::Phase::frame);
+        CHECK(s.count == 100);
+        CHECK(s.max == doctest::Approx(100.0));
+        CHECK(s.mean == doctest::Approx(50.5));
+        CHECK(s.p50 > 50 * 0.94);
+        CHECK(s.p50 < 50 * 1.06);
+        CHECK(s.p99 > 99 * 0.94);
+        CHECK(s.p99 <= 100);
+    }
+
+    SUBCASE("only the window counts") {
+        for (std::size_t i = 0; i < FrameStats::window; ++i) {
+            fs.record(FrameStats::Phase::poll, 100ms);
+        }
+        for (std::size_t i = 0; i < FrameStats::window; ++i) {
+            fs.record(FrameStats::Phase::poll, 1ms);
+        }
+
+        auto s = fs.summary(FrameStats::Phase::poll);
+        CHECK(s.count == FrameStats::window);
+        CHECK(s.max == doctest::Approx(1.0));
+        CHECK(s.p99 <= 1.0);
+    }
+
+    SUBCASE("fps and hitches") {
+        for (int i = 0; i < 99; ++i) {
+            fs.record(FrameStats::Phase::frame, 10ms);
+        }
+        fs.record(FrameStats::Phase::frame, 50ms);
+
+        CHECK(fs.hitches() == 1);
+        CHECK(fs.fps() == doctest::Approx(1000.0 / 10.4));
+        CHECK(fs.total_frames() == 100);
+    }
+
+    SUBCASE("empty") {
+        CHECK(fs.summary(FrameStats::Phase::present).count == 0);
+        CHECK(fs.report().empty());
+    }
+}
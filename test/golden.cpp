@@ -0,0 +1,173 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#define DOCTEST_CONFIG_IMPLEMENT
+#include <doctest.h>
+
+#include "vulkan.hpp"
+#include "bin_data.hpp"
+#include "frame_clock.hpp"
+#include "frame_stats.hpp"
+#include "pixels.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Renders minicomp headless at fixed times and sizes, reads each frame back
+// and compares it with a reference image, so changes to the shader or to how
+// it's dispatched can be checked for correctness without anyone looking.
+// Runs without a display (e.g. on lavapipe in CI).
+//
+// The references live in CU_GOLDEN_DIR, one PPM per case. Run with --update
+// (or CU_UPDATE_GOLDEN set) to write them from what's rendered instead of
+// comparing against them; otherwise a case with no reference fails, so a
+// missing file can't pass for a match. A frame that doesn't match is written
+// to the working directory as NAME.actual.ppm to look at. Either way, each
+// case's CPU and GPU time a frame is reported, and appended to the CSV file
+// CU_GOLDEN_RESULTS names, if set.
+
+namespace {
+
+bool update_refs = false;
+
+struct golden_case {
+    const char* name;
+    double      time;
+    VkExtent2D  extent;
+};
+
+// the last isn't a whole number of workgroups either way
+constexpr golden_case cases[] = {
+    {"circ_0s_256x256",    0.0,  {256, 256}},
+    {"circ_1.5s_256x256",  1.5,  {256, 256}},
+    {"circ_0.75s_320x180", 0.75, {320, 180}},
+    {"circ_3s_100x60",     3.0,  {100, 60}},
+};
+
+// Drivers don't all round floating point the same way, so a channel can be
+// off by a little, and a few pixels (along the edges of shapes, say) by
+// more.
+constexpr uint8_t channel_tolerance = 2;
+constexpr double  over_tolerance    = 0.001;
+
+// Only the last frame of each case is read back; the ones before give the GPU
+// profiler's timings a chance to come in. The clock stays put, so they all
+// draw the same thing.
+constexpr int frames_per_case = 4;
+
+std::filesystem::path env_or(const char* var, const char* fallback)
+{
+    const char* v = std::getenv(var);
+    return v ? v : fallback;
+}
+
+} // namespace
+
+TEST_CASE("Golden images") {
+    using clock = std::chrono::steady_clock;
+    using ms    = std::chrono::duration<double, std::milli>;
+
+    const auto  dir     = env_or("CU_GOLDEN_DIR", CU_GOLDEN_DIR);
+    const auto  shader  = env_or("CU_GOLDEN_SHADER", CU_GOLDEN_SHADER);
+    const bool  update  = update_refs
+                          || std::getenv("CU_UPDATE_GOLDEN") != nullptr;
+    const char* results = std::getenv("CU_GOLDEN_RESULTS");
+
+    if (update) {
+        std::filesystem::create_directories(dir);
+    }
+
+    for (const auto& c : cases) {
+        INFO("case " << c.name);
+
+        cu::Vulkan vulk {c.extent};
+        vulk.add_shader("minicomp", cu::BinData::read_file(shader));
+        vulk.minicomp_setup();
+        vulk.minicomp_clock(cu::FrameClock::scripted({
+            cu::FrameClock::seconds {c.time}
+        }));
+
+        cu::frame_stats.clear();
+
+        auto start = clock::now();
+        for (int i = 0; i < frames_per_case; ++i) {
+            vulk.minicomp_frame();
+        }
+        const double cpu_ms = ms(clock::now() - start).count()
+                              / frames_per_case;
+
+        const auto px = vulk.read_back_frame();
+        const double gpu_ms =
+            cu::frame_stats.summary(cu::FrameStats::Phase::gpu).mean;
+
+        MESSAGE(c.name << ": CPU " << cpu_ms << " ms, GPU " << gpu_ms
+                << " ms a frame");
+
+        if (results) {
+            std::ofstream f {results, std::ios::app};
+            f << c.name << "," << cpu_ms << "," << gpu_ms << "\n";
+        }
+
+        const auto ref = dir / (std::string {c.name} + ".ppm");
+
+        if (update) {
+            cu::write_ppm(ref, px);
+            continue;
+        }
+
+        if (!std::filesystem::exists(ref)) {
+            FAIL("no reference image at " << ref.string()
+                 << "; run with --update to write one");
+        }
+
+        const auto d = cu::compare(px, cu::read_ppm(ref), channel_tolerance);
+        const auto allowed = static_cast<uint64_t>(
+            over_tolerance * c.extent.width * c.extent.height
+        );
+
+        if (d.over > allowed) {
+            cu::write_ppm(std::string {c.name} + ".actual.ppm", px);
+        }
+
+        INFO("largest difference " << int {d.max} << ", mean " << d.mean);
+        CHECK(d.over <= allowed);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    // --update is ours, not doctest's, so take it out before doctest sees it
+    int n = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--update") == 0) {
+            update_refs = true;
+        } else {
+            argv[n++] = argv[i];
+        }
+    }
+
+    doctest::Context ctx {n, argv};
+    return ctx.run();
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <lru_cache.hpp>
+
+#include <string>
+
+TEST_CASE("LRUCache") {
+    cu::LRUCache<std::string, int> c {2};
+
+    c.insert("a", 1);
+    c.insert("b", 2);
+
+    SUBCASE("finds what was inserted") {
+        REQUIRE(c.find("a"));
+        CHECK(*c.find("a") == 1);
+        CHECK(c.find("z") == nullptr);
+        CHECK(c.size() == 2);
+    }
+
+    SUBCASE("evicts the least recently used entry") {
+        c.find("a");
+        c.insert("c", 3);
+
+        CHECK(c.size() == 2);
+        CHECK(c.find("b") == nullptr);
+        CHECK(c.find("a"));
+        CHECK(c.find("c"));
+    }
+
+    SUBCASE("reinserting replaces the value without evicting") {
+        c.insert("a", 10);
+
+        CHECK(c.size() == 2);
+        CHECK(*c.find("a") == 10);
+        CHECK(c.find("b"));
+    }
+
+    SUBCASE("erase") {
+        CHECK(c.erase("a"));
+        CHECK_FALSE(c.erase("a"));
+        CHECK(c.size() == 1);
+    }
+
+    SUBCASE("needs room for at least one entry") {
+        using int_cache = cu::LRUCache<int, int>;
+        CHECK_THROWS_AS(int_cache {0}, std::runtime_error);
+    }
+}
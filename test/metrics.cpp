@@ -0,0 +1,69 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <metrics.hpp>
+
+#include <chrono>
+
+TEST_CASE("Metrics") {
+    cu::Metrics m;
+
+    SUBCASE("summarizes samples") {
+        m.record("a", 2.0);
+        m.record("a", 6.0);
+        m.record("a", 4.0);
+
+        auto a = m.get("a");
+        CHECK(a.count == 3);
+        CHECK(a.sum == 12.0);
+        CHECK(a.mean() == 4.0);
+        CHECK(a.min == 2.0);
+        CHECK(a.max == 6.0);
+        CHECK(a.last == 4.0);
+    }
+
+    SUBCASE("records durations in milliseconds") {
+        m.record("t", std::chrono::microseconds {1500});
+        CHECK(m.get("t").last == doctest::Approx(1.5));
+    }
+
+    SUBCASE("counters") {
+        m.count("c");
+        m.count("c", 2);
+        CHECK(m.get("c").count == 2);
+        CHECK(m.get("c").sum == 3.0);
+    }
+
+    SUBCASE("unknown series are empty") {
+        CHECK(m.get("nothing").count == 0);
+    }
+
+    SUBCASE("report lists every series") {
+        m.count("pipeline_cache.hit");
+        m.record("pipeline.minicomp.create_ms", 12.5);
+
+        auto r = m.report();
+        CHECK(r.find("pipeline_cache.hit") != std::string::npos);
+        CHECK(r.find("pipeline.minicomp.create_ms") != std::string::npos);
+    }
+}
@@ -0,0 +1,99 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <pixels.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+TEST_CASE("Pixels") {
+    cu::Pixels px {
+        .width  = 2,
+        .height = 2,
+        .rgba   = {
+            255, 0,   0,   255,    0,   255, 0,   255,
+            0,   0,   255, 255,    10,  20,  30,  255,
+        },
+    };
+
+    auto path = std::filesystem::temp_directory_path() / "cu_pixels_test.ppm";
+
+    SUBCASE("survive a trip through a PPM") {
+        cu::write_ppm(path, px);
+        auto back = cu::read_ppm(path);
+
+        CHECK(back.width == 2);
+        CHECK(back.height == 2);
+        CHECK(back.rgba == px.rgba);
+
+        std::filesystem::remove(path);
+    }
+
+    SUBCASE("reading skips header comments and refuses other formats") {
+        {
+            std::ofstream f {path, std::ios::binary};
+            f << "P6\n# made by hand\n1 1\n255\n" << "abc";
+        }
+        auto one = cu::read_ppm(path);
+        CHECK(one.rgba == std::vector<uint8_t> {'a', 'b', 'c', 255});
+
+        {
+            std::ofstream f {path, std::ios::binary};
+            f << "P3\n1 1\n255\n1 2 3\n";
+        }
+        CHECK_THROWS_AS(cu::read_ppm(path), std::runtime_error);
+
+        std::filesystem::remove(path);
+    }
+
+    SUBCASE("compare counts the pixels past the tolerance") {
+        auto other = px;
+        other.rgba[0] = 250;
+        other.rgba[13] = 23;
+        other.rgba[15] = 0;
+
+        auto d = cu::compare(px, other, 3);
+        CHECK(d.over == 1);
+        CHECK(d.max == 5);
+        CHECK(d.mean == doctest::Approx(8.0 / 12));
+
+        CHECK(cu::compare(px, px, 0).over == 0);
+
+        other.width = 4;
+        other.height = 1;
+        CHECK_THROWS_AS(cu::compare(px, other, 0), std::runtime_error);
+    }
+
+    SUBCASE("a view holds on to what it was made from") {
+        auto v = cu::PixelView::of(px);
+        CHECK(v.width == 2);
+        CHECK(v.height == 2);
+        CHECK(v.rgba[14] == 30);
+        CHECK(v.copy().rgba == px.rgba);
+
+        std::weak_ptr<const void> held = v.keep;
+        v = {};
+        CHECK(held.expired());
+    }
+}
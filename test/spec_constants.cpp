@@ -0,0 +1,71 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <spec_constants.hpp>
+
+#include <cstddef>
+#include <stdexcept>
+
+namespace {
+
+struct Spec {
+    uint32_t wg_x   = 8;
+    uint32_t wg_y   = 4;
+    float    scale  = 0.5;
+    VkBool32 dither = VK_TRUE;
+};
+
+} // namespace
+
+TEST_CASE("SpecConstants") {
+    cu::SpecConstants<Spec> sc;
+    sc.entry(0, &Spec::wg_x)
+      .entry(1, &Spec::wg_y)
+      .entry(7, &Spec::dither);
+
+    SUBCASE("map entries point at the members") {
+        REQUIRE(sc.entries().size() == 3);
+        CHECK(sc.entries().at(0).offset == offsetof(Spec, wg_x));
+        CHECK(sc.entries().at(1).offset == offsetof(Spec, wg_y));
+        CHECK(sc.entries().at(2).constantID == 7);
+        CHECK(sc.entries().at(2).offset == offsetof(Spec, dither));
+        CHECK(sc.entries().at(2).size == sizeof(VkBool32));
+    }
+
+    SUBCASE("info covers the whole struct") {
+        auto inf = sc.info();
+        CHECK(inf.mapEntryCount == 3);
+        CHECK(inf.dataSize == sizeof(Spec));
+        CHECK(inf.pData == sc.values());
+    }
+
+    SUBCASE("values can be read back by ID") {
+        sc.values()->wg_y = 16;
+        CHECK(sc.u32(1) == 16u);
+        CHECK_FALSE(sc.u32(2));
+    }
+
+    SUBCASE("an ID can only be set once") {
+        CHECK_THROWS_AS(sc.entry(1, &Spec::scale), std::runtime_error);
+    }
+}
@@ -0,0 +1,205 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <spirv_reflection.hpp>
+
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Just enough of an assembler to put together small modules by hand.
+struct SpvBuilder {
+    std::vector<uint32_t> words = {0x07230203, 0x00010300, 0, 100, 0};
+
+    void op(uint32_t opcode, std::initializer_list<uint32_t> operands)
+    {
+        words.push_back(static_cast<uint32_t>(operands.size() + 1) << 16
+                        | opcode);
+        words.insert(words.end(), operands);
+    }
+
+    void name(uint32_t id, const std::string& n)
+    {
+        std::vector<uint32_t> str((n.size() + 4) / 4, 0);
+        for (std::size_t i = 0; i < n.size(); ++i) {
+            str.at(i / 4) |= static_cast<uint32_t>(n.at(i)) << (i % 4 * 8);
+        }
+
+        words.push_back(static_cast<uint32_t>(str.size() + 2) << 16 | 5);
+        words.push_back(id);
+        words.insert(words.end(), str.begin(), str.end());
+    }
+
+    std::size_t size() const { return words.size() * sizeof(uint32_t); }
+};
+
+// Roughly what glslangValidator emits for a compute shader with a storage
+// image, a uniform block, a push constant block and a spec constant:
+//
+//   layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+//   layout(constant_id = 3) const int steps = 4;
+//   layout(set = 0, binding = 0, rgba8) uniform writeonly image2D img[2];
+//   layout(set = 1, binding = 1) uniform frame_data { float time; } fd;
+//   layout(push_constant) uniform pcs { vec4 a; float b; } pc;
+SpvBuilder compute_module()
+{
+    SpvBuilder b;
+
+    b.op(15, {5, 1, 0});               // OpEntryPoint GLCompute %1 ""
+    b.op(16, {1, 17, 8, 8, 1});        // OpExecutionMode LocalSize 8 8 1
+    b.name(20, "img");
+    b.name(21, "fd");
+    b.name(22, "pc");
+    b.name(30, "steps");
+
+    b.op(71, {20, 34, 0});             // %20 DescriptorSet 0
+    b.op(71, {20, 33, 0});             // %20 Binding 0
+    b.op(71, {21, 34, 1});             // %21 DescriptorSet 1
+    b.op(71, {21, 33, 1});             // %21 Binding 1
+    b.op(71, {12, 2});                 // %12 Block
+    b.op(72, {12, 0, 35, 0});          // %12 member 0 Offset 0
+    b.op(71, {14, 2});                 // %14 Block
+    b.op(72, {14, 0, 35, 0});          // %14 member 0 Offset 0
+    b.op(72, {14, 1, 35, 16});         // %14 member 1 Offset 16
+    b.op(71, {30, 1, 3});              // %30 SpecId 3
+
+    b.op(22, {2, 32});                 // %2  float
+    b.op(21, {3, 32, 1});              // %3  int
+    b.op(23, {4, 2, 4});               // %4  vec4
+    b.op(25, {6, 2, 1, 0, 0, 0, 2, 4}); // %6 image2D, Sampled 2
+    b.op(43, {3, 7, 2});               // %7  const int 2
+    b.op(28, {8, 6, 7});               // %8  image2D[2]
+    b.op(32, {9, 0, 8});               // %9  UniformConstant ptr
+    b.op(30, {12, 2});                 // %12 struct { float }
+    b.op(32, {13, 2, 12});             // %13 Uniform ptr
+    b.op(30, {14, 4, 2});              // %14 struct { vec4, float }
+    b.op(32, {15, 9, 14});             // %15 PushConstant ptr
+    b.op(50, {3, 30, 4});              // %30 spec const int 4
+
+    b.op(59, {9, 20, 0});              // OpVariable img
+    b.op(59, {13, 21, 2});             // OpVariable fd
+    b.op(59, {15, 22, 9});             // OpVariable pc
+
+    return b;
+}
+
+} // namespace
+
+TEST_CASE("SpirvReflection") {
+    using cu::SpirvReflection;
+    using enum cu::vk::DescriptorType;
+
+    auto mod = compute_module();
+    SpirvReflection refl(mod.words.data(), mod.size());
+
+    SUBCASE("stage") {
+        CHECK(refl.stages() == cu::flgs(cu::vk::ShaderStageFlag::cmpte));
+    }
+
+    SUBCASE("descriptor bindings") {
+        REQUIRE(refl.bindings().size() == 2);
+        CHECK(refl.set_count() == 2);
+
+        auto img = refl.bindings(0).at(0);
+        CHECK(img.binding == 0);
+        CHECK(img.type == strge_img);
+        CHECK(img.count == 2);
+        CHECK(img.name == "img");
+
+        auto fd = refl.bindings(1).at(0);
+        CHECK(fd.binding == 1);
+        CHECK(fd.type == unfrm_buffer);
+        CHECK(fd.count == 1);
+        CHECK(fd.name == "fd");
+    }
+
+    SUBCASE("make_dynamic") {
+        refl.make_dynamic(1, 1);
+        CHECK(refl.bindings(1).at(0).type == unfrm_buffer_dynmc);
+        CHECK_THROWS_AS(refl.make_dynamic(0, 0), std::runtime_error);
+    }
+
+    SUBCASE("push constants") {
+        REQUIRE(refl.push_constants());
+        CHECK(refl.push_constants()->offset == 0);
+        CHECK(refl.push_constants()->size == 20);
+    }
+
+    SUBCASE("local size") {
+        CHECK(refl.local_size() == SpirvReflection::LocalSize {8, 8, 1});
+        CHECK_FALSE(refl.local_size_spec_ids().at(0));
+    }
+
+    SUBCASE("spec constants") {
+        REQUIRE(refl.spec_constants().size() == 1);
+        CHECK(refl.spec_constants().at(0).spec_id == 3);
+        CHECK(refl.spec_constants().at(0).size == 4);
+        CHECK(refl.spec_constants().at(0).name == "steps");
+    }
+
+    SUBCASE("cached reflection") {
+        auto a = SpirvReflection::reflect(mod.words.data(), mod.size());
+        auto b = SpirvReflection::reflect(mod.words.data(), mod.size());
+        CHECK(a == b);
+        CHECK(a->hash() == refl.hash());
+
+        // enough other modules push it out of the cache
+        for (std::size_t i = 0; i < SpirvReflection::cache_capacity; ++i) {
+            auto other = compute_module();
+            other.words.at(3) = 200 + static_cast<uint32_t>(i); // id bound
+            SpirvReflection::reflect(other.words.data(), other.size());
+        }
+
+        auto c = SpirvReflection::reflect(mod.words.data(), mod.size());
+        CHECK(c != a);
+        CHECK(c->hash() == a->hash());
+    }
+
+    SUBCASE("rejects non-SPIR-V") {
+        std::vector<uint32_t> junk = {0xdeadbeef, 0, 0, 0, 0};
+        CHECK_THROWS_AS(SpirvReflection(junk.data(),
+                                        junk.size() * sizeof(uint32_t)),
+                        std::runtime_error);
+    }
+
+    SUBCASE("rejects instructions too short for their operands") {
+        SpvBuilder b;
+        b.op(71, {20});                // OpDecorate with no decoration
+        CHECK_THROWS_AS(SpirvReflection(b.words.data(), b.size()),
+                        std::runtime_error);
+
+        SpvBuilder c;
+        c.op(72, {20, 0xffffff, 35, 0}); // member far past the module's end
+        CHECK_THROWS_AS(SpirvReflection(c.words.data(), c.size()),
+                        std::runtime_error);
+
+        auto cut = compute_module();
+        cut.words.resize(cut.words.size() - 1);
+        CHECK_THROWS_AS(SpirvReflection(cut.words.data(), cut.size()),
+                        std::runtime_error);
+    }
+}
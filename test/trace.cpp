@@ -0,0 +1,94 @@
+/*
+ * This file is part of Crypt Underworld.
+ *
+ * Crypt Underworld is free software: you can redistribute it
+ * and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, either
+ * version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * Crypt Underworld is distributed in the hope that it will be
+ * useful, but WITHOUT ANY WARRANTY; without even the implied
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+ * PURPOSE. See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with Crypt Underworld. If not, see
+ * <https://www.gnu.org/licenses/>.
+ *
+ * Copyright (c) 2023 Zoë Sparks <zoe@milky.flowers>
+ */
+
+#include <doctest.h>
+
+#include <trace.hpp>
+
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+
+TEST_CASE("Trace") {
+    using namespace std::chrono_literals;
+    using cu::Trace;
+
+    Trace tr {4};
+    const auto t0 = Trace::clock::now();
+
+    auto json = [&tr] {
+        std::ostringstream ss;
+        tr.write(ss);
+        return ss.str();
+    };
+
+    SUBCASE("nothing is recorded until started") {
+        tr.complete("early", t0, t0 + 1ms);
+        CHECK(json().find("early") == std::string::npos);
+
+        tr.start("unused.json");
+        tr.complete("late", t0, t0 + 1ms);
+        CHECK(json().find("\"name\":\"late\"") != std::string::npos);
+
+        tr.stop();
+        tr.complete("stopped", t0, t0 + 1ms);
+        CHECK(json().find("stopped") == std::string::npos);
+    }
+
+    SUBCASE("full rings drop their oldest events") {
+        tr.start("unused.json");
+        const char* names[] = {"a0", "a1", "a2", "a3", "a4", "a5"};
+        for (auto n : names) {
+            tr.complete(n, t0, t0 + 1ms);
+        }
+
+        auto out = json();
+        CHECK(tr.dropped() == 2);
+        CHECK(out.find("\"a1\"") == std::string::npos);
+        CHECK(out.find("\"a2\"") != std::string::npos);
+        CHECK(out.find("\"a5\"") != std::string::npos);
+        CHECK(out.find("\"a2\"") < out.find("\"a5\""));
+        CHECK(out.find("\"dropped_events\":2") != std::string::npos);
+    }
+
+    SUBCASE("threads and tracks get their own names") {
+        tr.start("unused.json");
+        tr.name_thread("main");
+
+        std::thread {[&tr, t0] {
+            tr.name_thread("worker");
+            tr.complete("on worker", t0, t0 + 2ms);
+        }}.join();
+
+        auto gpu = tr.track("GPU");
+        CHECK(tr.track("GPU") == gpu);
+        tr.complete(gpu, tr.intern(std::string {"gpu \"zone\""}),
+                    t0, t0 + 3ms);
+
+        auto out = json();
+        CHECK(out.find("\"name\":\"main\"") != std::string::npos);
+        CHECK(out.find("\"name\":\"worker\"") != std::string::npos);
+        CHECK(out.find("\"name\":\"GPU\"") != std::string::npos);
+        CHECK(out.find("gpu \\\"zone\\\"") != std::string::npos);
+        CHECK(out.find("\"dur\":3000.000") != std::string::npos);
+    }
+}
@@ -22,29 +22,43 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest.h>
 
-#include "sdl.hpp"
+#include "vulkan_loader.hpp"
 #include "instance.hpp"
 #include "debug_msgr.hpp"
 #include "phys_devices.hpp"
 #include "phys_device.hpp"
 #include "device.hpp"
+#include "parallel_recorder.hpp"
+#include "command_pool.hpp"
+#include "command_buffer.hpp"
+#include "fence.hpp"
+#include "pipeline_cache.hpp"
+#include "pipeline_compiler.hpp"
+#include "gpu_profiler.hpp"
+#include "offscreen.hpp"
+#include "readback.hpp"
+#include "buffer.hpp"
+#include "timeline_semaphore.hpp"
+#include "metrics.hpp"
 
-static cu::SDL sdl {};
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <unistd.h>
 
-std::vector<const char*> extensions()
-{
-    auto exts = sdl.get_req_vulk_exts();
-
-    exts.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
-
-    return exts;
-}
+// headless, so this runs without a display (e.g. on lavapipe in CI)
 
 static std::vector<const char*> layers = {"VK_LAYER_KHRONOS_validation"};
-static std::vector<const char*> exts   = extensions();
+static std::vector<const char*> exts   = {VK_EXT_DEBUG_UTILS_EXTENSION_NAME};
 
 static cu::Instance::ptr inst {
-    std::make_shared<cu::Instance>(exts, layers)
+    std::make_shared<cu::Instance>(exts,
+                                   layers,
+                                   cu::VulkanLoader::get_inst_proc_addr())
 };
 
 TEST_CASE("VkInstance is not null") {
@@ -66,9 +80,404 @@ TEST_CASE("Physical device supports graphics") {
 }
 
 static cu::Device::ptr dev {
-    std::make_shared<cu::Device>(phys_dev, inst)
+    std::make_shared<cu::Device>(phys_dev, inst, false)
 };
 
 TEST_CASE("VkDevice is not null") {
     CHECK(dev->inner() != VK_NULL_HANDLE);
 }
+
+TEST_CASE("PipelineCache") {
+    auto path = std::filesystem::temp_directory_path()
+                / ("cu_pipeline_cache_test_" + std::to_string(getpid()))
+                / "pipeline_cache.bin";
+
+    cu::PipelineCache cache;
+    cache.construct(*dev, phys_dev, path);
+    CHECK(cache.inner() != VK_NULL_HANDLE);
+
+    SUBCASE("saves a file stamped with this device") {
+        cache.save(*dev);
+        REQUIRE(std::filesystem::exists(path));
+
+        std::ifstream f {path, std::ios::binary};
+        cu::PipelineCache::FileHeader hdr;
+        f.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+        CHECK(hdr.magic == cu::PipelineCache::file_magic);
+        CHECK(hdr.vendor_id == phys_dev.vk_vend_id);
+        CHECK(hdr.device_id == phys_dev.vk_vend_dev_id);
+        CHECK(hdr.driver_version == phys_dev.raw_vk_driver_ver);
+    }
+
+    SUBCASE("ignores a cache from another device") {
+        cache.save(*dev);
+
+        // the file as saved is taken, so the one below being ignored is down
+        // to the changed header
+        cu::PipelineCache fresh;
+        fresh.construct(*dev, phys_dev, path);
+        CHECK(fresh.loaded_size() > 0);
+        fresh.free_self(*dev);
+
+        {
+            std::fstream f {path,
+                            std::ios::binary | std::ios::in | std::ios::out};
+            f.seekp(offsetof(cu::PipelineCache::FileHeader, device_id));
+            uint32_t other = phys_dev.vk_vend_dev_id + 1;
+            f.write(reinterpret_cast<const char*>(&other), sizeof(other));
+        }
+
+        cu::PipelineCache stale;
+        CHECK_NOTHROW(stale.construct(*dev, phys_dev, path));
+        CHECK(stale.loaded_size() == 0);
+        stale.free_self(*dev);
+    }
+
+    cache.free_self(*dev);
+    std::filesystem::remove_all(path.parent_path());
+}
+
+TEST_CASE("ParallelRecorder") {
+    cu::ParallelRecorder recorder {dev, cu::Device::compute_queue, 3};
+
+    CHECK(recorder.thread_count() == 3);
+
+    std::atomic<int> ran = 0;
+    std::vector<cu::ParallelRecorder::job_t> jobs(
+        7,
+        [&ran](cu::CommandBuffer&) { ++ran; }
+    );
+
+    auto secs = recorder.record(jobs);
+
+    SUBCASE("runs every job once") {
+        CHECK(ran == 7);
+    }
+
+    SUBCASE("returns one distinct secondary per job") {
+        REQUIRE(secs.size() == jobs.size());
+
+        std::set<cu::CommandBuffer*> uniq(secs.begin(), secs.end());
+        CHECK(uniq.size() == secs.size());
+        CHECK(!uniq.contains(nullptr));
+
+        for (auto s : secs) {
+            CHECK(s->level() == cu::vk::CommandBufferLevel::scndry);
+        }
+    }
+
+    SUBCASE("secondaries can be executed and submitted") {
+        auto pool = std::make_shared<cu::CommandPool>(dev,
+                                                      cu::Device::compute_queue);
+        cu::CommandBuffer prim {dev, pool};
+        cu::Fence fnce {dev};
+
+        prim.record().execute(secs).end();
+        dev->submit(cu::Device::compute_queue, prim, fnce);
+    }
+
+    SUBCASE("rethrows exceptions from jobs") {
+        jobs.at(4) = [](cu::CommandBuffer&) {
+            throw std::runtime_error("meow");
+        };
+
+        CHECK_THROWS_AS(recorder.record(jobs), std::runtime_error);
+    }
+}
+
+TEST_CASE("PipelineCompiler") {
+    cu::PipelineCompiler compiler {dev, 2};
+
+    CHECK(compiler.thread_count() == 2);
+
+    SUBCASE("rethrows build failures through the future") {
+        std::istringstream junk {std::string(16, '\x7f')};
+        auto shdr = compiler.shader("junk", cu::BinData {junk, 16});
+        auto pipel = compiler.compute(shdr, {});
+
+        CHECK_THROWS(shdr.get());
+        CHECK_THROWS(pipel.get());
+        CHECK(cu::PipelineCompiler::ready(pipel));
+    }
+
+    SUBCASE("isn't ready before anything is asked for") {
+        cu::PipelineCompiler::handle_t<cu::ComputePipeline::ptr> none;
+        CHECK_FALSE(cu::PipelineCompiler::ready(none));
+    }
+}
+
+TEST_CASE("GpuProfiler") {
+    cu::GpuProfiler prof {dev, cu::Device::compute_queue, 2, 2};
+
+    auto pool = std::make_shared<cu::CommandPool>(dev,
+                                                  cu::Device::compute_queue);
+    cu::CommandBuffer cmdb {dev, pool};
+    cu::Fence fnce {dev};
+
+    SUBCASE("publishes zones once their results are in") {
+        cu::metrics.clear();
+
+        cmdb.record()
+            .profile(prof, 1)
+            .begin_zone("outer")
+            .begin_zone("inner")
+            .end_zone()
+            .end_zone()
+            .end();
+        dev->submit(cu::Device::compute_queue, cmdb, fnce);
+        prof.submitted(1);
+        prof.collect();
+
+        auto expected = prof.enabled() ? 1 : 0;
+        CHECK(cu::metrics.get("gpu.outer_ms").count == expected);
+        CHECK(cu::metrics.get("gpu.inner_ms").count == expected);
+    }
+
+    SUBCASE("refuses more zones than a slot holds") {
+        if (prof.enabled()) {
+            cmdb.record().profile(prof, 0);
+            cmdb.begin_zone("a").end_zone().begin_zone("b").end_zone();
+            CHECK_THROWS_AS(cmdb.begin_zone("c"), std::runtime_error);
+        }
+    }
+
+    SUBCASE("counts invocations in zones that ask") {
+        cu::metrics.clear();
+
+        cmdb.record()
+            .profile(prof, 0)
+            .begin_zone("counted", true)
+            .end_zone()
+            .end();
+        dev->submit(cu::Device::compute_queue, cmdb, fnce);
+        prof.submitted(0);
+        prof.collect();
+
+        auto s = cu::metrics.get("gpu.counted.invocations");
+        CHECK(s.count == (prof.enabled() && prof.counting() ? 1 : 0));
+        CHECK(s.sum == 0);
+    }
+
+    SUBCASE("won't nest zones that count") {
+        if (prof.enabled() && prof.counting()) {
+            cmdb.record().profile(prof, 0).begin_zone("a", true);
+            CHECK_THROWS_AS(cmdb.begin_zone("b", true), std::runtime_error);
+        }
+    }
+
+    SUBCASE("won't end with a zone open") {
+        if (prof.enabled()) {
+            cmdb.record().profile(prof, 0).begin_zone("open");
+            CHECK_THROWS_AS(cmdb.end(), std::runtime_error);
+        }
+    }
+}
+
+TEST_CASE("Offscreen") {
+    using namespace cu::vk;
+
+    cu::Offscreen offscr {dev, {16, 8}, 2};
+
+    CHECK(offscr.img_count() == 2);
+    CHECK(offscr.next() == 0);
+    CHECK(offscr.next() == 1);
+    CHECK(offscr.next() == 0);
+
+    SUBCASE("images can be copied back to the host") {
+        auto pool = std::make_shared<cu::CommandPool>(dev,
+                                                      cu::Device::compute_queue);
+        cu::CommandBuffer cmdb {dev, pool};
+        cu::Fence fnce {dev};
+
+        cu::Buffer staging {dev, {
+            .size     = 16 * 8 * 4,
+            .usage    = cu::flgs(BufferUsageFlag::trnsfr_dst),
+            .location = cu::Heap::Location::host,
+        }};
+
+        cmdb.record()
+            .barrier(offscr.img(0),
+                     PipelineStageFlag::top_of_pipe,
+                     PipelineStageFlag::trnsfr,
+                     AccessFlag::none,
+                     AccessFlag::trnsfr_read,
+                     ImageLayout::undfnd,
+                     ImageLayout::trnsfr_src_optml,
+                     ImageAspectFlag::color)
+            .copy(offscr.img(0), staging)
+            .barrier(PipelineStageFlag::trnsfr,
+                     PipelineStageFlag::host,
+                     AccessFlag::trnsfr_write,
+                     AccessFlag::host_read)
+            .end();
+        dev->submit(cu::Device::compute_queue, cmdb, fnce);
+
+        CHECK(staging.mapped() != nullptr);
+    }
+}
+
+TEST_CASE("Readback") {
+    using namespace cu::vk;
+
+    cu::Offscreen offscr {dev, {16, 8}, 1};
+
+    {
+        auto pool = std::make_shared<cu::CommandPool>(dev,
+                                                      cu::Device::compute_queue);
+        cu::CommandBuffer cmdb {dev, pool};
+        cu::Fence fnce {dev};
+
+        cmdb.record()
+            .barrier(offscr.img(0),
+                     PipelineStageFlag::top_of_pipe,
+                     PipelineStageFlag::trnsfr,
+                     AccessFlag::none,
+                     AccessFlag::trnsfr_read,
+                     ImageLayout::undfnd,
+                     ImageLayout::trnsfr_src_optml,
+                     ImageAspectFlag::color)
+            .end();
+        dev->submit(cu::Device::compute_queue, cmdb, fnce);
+    }
+
+    cu::Readback rb {dev, 2};
+    std::vector<cu::Pixels> got;
+    auto keep = [&got](cu::Pixels px) { got.push_back(std::move(px)); };
+
+    SUBCASE("drops requests while every slot is busy") {
+        CHECK(rb.request(offscr.img(0), keep));
+        CHECK(rb.request(offscr.img(0), keep));
+        CHECK_FALSE(rb.request(offscr.img(0), keep));
+        CHECK(rb.in_flight() == 2);
+
+        rb.flush();
+        CHECK(rb.in_flight() == 0);
+        REQUIRE(got.size() == 2);
+        CHECK(got[0].width == 16);
+        CHECK(got[0].height == 8);
+        CHECK(got[0].rgba.size() == 16 * 8 * 4);
+    }
+
+    SUBCASE("hands copies over from poll once they're done") {
+        REQUIRE(rb.request(offscr.img(0), keep));
+
+        while (rb.poll() == 0);
+        CHECK(got.size() == 1);
+        CHECK(rb.in_flight() == 0);
+    }
+
+    SUBCASE("keeps a slot until its view is let go") {
+        std::vector<cu::PixelView> views;
+        auto hold = [&views](cu::PixelView v) {
+            views.push_back(std::move(v));
+        };
+
+        CHECK(rb.request_view(offscr.img(0), hold));
+        CHECK(rb.request_view(offscr.img(0), hold));
+        rb.flush();
+        REQUIRE(views.size() == 2);
+        CHECK(views[0].width == 16);
+        CHECK(views[0].height == 8);
+        CHECK(rb.in_flight() == 0);
+
+        CHECK_FALSE(rb.request_view(offscr.img(0), hold));
+
+        views.pop_back();
+        CHECK(rb.request_view(offscr.img(0), hold));
+        rb.flush();
+    }
+}
+
+TEST_CASE("Timeline submits") {
+    using namespace cu::vk;
+
+    // up on the transfer queue, back down on the compute queue, chained by
+    // timeline semaphores rather than fences
+
+    // the image is exclusive to one family, so this only runs where the two
+    // queues share one (as on lavapipe)
+    if (dev->queue_ndx(cu::Device::transfer_queue)
+        != dev->queue_ndx(cu::Device::compute_queue)) {
+        return;
+    }
+
+    cu::Image img {dev, {
+        .extent = {4, 4, 1},
+        .usage  = flgs(ImageUsageFlag::trnsfr_src)
+                  | flgs(ImageUsageFlag::trnsfr_dst),
+        .format = Format::r8g8b8a8_unorm,
+    }};
+    const VkDeviceSize sz = 4 * 4 * 4;
+
+    cu::Buffer up {dev, {
+        .size     = sz,
+        .usage    = flgs(BufferUsageFlag::trnsfr_src),
+        .location = cu::Heap::Location::readback,
+    }};
+    cu::Buffer down {dev, {
+        .size     = sz,
+        .usage    = flgs(BufferUsageFlag::trnsfr_dst),
+        .location = cu::Heap::Location::readback,
+    }};
+
+    auto* bytes = up.mapped_as<uint8_t>();
+    for (VkDeviceSize i = 0; i < sz; ++i) {
+        bytes[i] = static_cast<uint8_t>(i * 3);
+    }
+    up.flush();
+
+    auto trnsfr_pool = std::make_shared<cu::CommandPool>(
+        dev, cu::Device::transfer_queue
+    );
+    auto cmpte_pool = std::make_shared<cu::CommandPool>(
+        dev, cu::Device::compute_queue
+    );
+    cu::CommandBuffer upl {dev, trnsfr_pool};
+    cu::CommandBuffer dwn {dev, cmpte_pool};
+
+    upl.record()
+        .barrier(img,
+                 PipelineStageFlag::top_of_pipe,
+                 PipelineStageFlag::trnsfr,
+                 AccessFlag::none,
+                 AccessFlag::trnsfr_write,
+                 ImageLayout::undfnd,
+                 ImageLayout::trnsfr_dst_optml,
+                 ImageAspectFlag::color)
+        .copy(up, img)
+        .barrier(img,
+                 PipelineStageFlag::trnsfr,
+                 PipelineStageFlag::bottom_of_pipe,
+                 AccessFlag::trnsfr_write,
+                 AccessFlag::none,
+                 ImageLayout::trnsfr_dst_optml,
+                 ImageLayout::trnsfr_src_optml,
+                 ImageAspectFlag::color)
+        .end();
+
+    dwn.record()
+        .copy(img, down)
+        .barrier(PipelineStageFlag::trnsfr,
+                 PipelineStageFlag::host,
+                 AccessFlag::trnsfr_write,
+                 AccessFlag::host_read)
+        .end();
+
+    cu::TimelineSemaphore uploaded {dev};
+    cu::TimelineSemaphore done {dev};
+
+    dev->submit_async(cu::Device::transfer_queue,
+                      upl,
+                      {},
+                      {{uploaded.inner(), 1}});
+    dev->submit_async(cu::Device::compute_queue,
+                      dwn,
+                      {{uploaded.inner(), 1, VK_PIPELINE_STAGE_TRANSFER_BIT}},
+                      {{done.inner(), 1}});
+
+    done.wait_for(1);
+    down.invalidate();
+
+    const auto* got = down.mapped_as<uint8_t>();
+    CHECK(std::equal(got, got + sz, bytes));
+}